@@ -0,0 +1,265 @@
+#include "Benchmark.h"
+#include <fstream>
+#include <cmath>
+
+namespace
+{
+	//Every frame is stepped the same, so runs do the same work no matter how fast they are
+	const float FIXED_STEP = 1.0f / 60.0f;
+	const float GRID_SPACING = 2.5f;
+
+	const char * const MODELS[] = { "../Models/Cube.fbx", "../Models/Cylinder.fbx", "../Models/Sphere.fbx", "../Models/Thing.fbx" };
+	const UINT MODEL_COUNT = sizeof(MODELS) / sizeof(MODELS[0]);
+
+	const char * const COUNTER_NAMES[FrameStats::COUNTER_COUNT] = { "draw_calls", "instances", "triangles", "dispatches", "descriptor_copies", "barriers", "upload_bytes",
+		"matrix_updates", "matrix_updates_skipped", "instances_occluded" };
+
+	struct Material
+	{
+		Texture * Albedo = nullptr;
+		Texture * Normal = nullptr;
+		Texture * Metallic = nullptr;
+		Texture * Displacement = nullptr;
+	};
+
+	struct SceneObjects
+	{
+		std::vector<StaticMesh*> Meshes;
+		std::vector<Material> Materials;
+		std::vector<Drawable*> Drawables;
+		std::vector<PointLight*> Lights;
+		Texture * Fire[3] = { nullptr, nullptr, nullptr };
+		std::vector<ParticleEmitter*> Emitters;
+		UINT AnimatedCount = 0;
+	};
+
+	double ToMilliseconds(const int64_t & nanoseconds)
+	{
+		return static_cast<double>(nanoseconds) / 1000000.0;
+	}
+
+	//Lays count objects out on a square grid centered on the origin
+	DirectX::XMFLOAT2 GridPosition(const UINT & index, const UINT & count)
+	{
+		const UINT side = static_cast<UINT>(std::ceil(std::sqrt(static_cast<float>(count ? count : 1))));
+		const float offset = (side - 1) * GRID_SPACING * 0.5f;
+		return DirectX::XMFLOAT2((index % side) * GRID_SPACING - offset, (index / side) * GRID_SPACING - offset);
+	}
+
+	void CreateScene(RenderingManager * renderingManager, Window * window, const Benchmark::Scene & scene, SceneObjects & objects)
+	{
+		for (UINT i = 0; i < scene.Meshes; i++)
+		{
+			//More meshes than models loads the models again, each copy gets its own buffers and instance group
+			StaticMesh * mesh = new StaticMesh();
+			mesh->Init();
+			mesh->LoadStaticMesh(MODELS[i % MODEL_COUNT]);
+			mesh->CreateBuffer();
+			objects.Meshes.push_back(mesh);
+		}
+
+		for (UINT i = 0; i < scene.Materials; i++)
+		{
+			Material material;
+			material.Albedo = new Texture();
+			material.Normal = new Texture();
+			material.Metallic = new Texture();
+			material.Displacement = new Texture();
+			material.Albedo->LoadDDSTexture("../Texture/Brick/Brick_diffuse.DDS", TRUE);
+			material.Normal->LoadDDSTexture("../Texture/Brick/Brick_normal.DDS", TRUE);
+			material.Metallic->LoadDDSTexture("../Texture/Brick/Brick_metallic.DDS", TRUE);
+			material.Displacement->LoadDDSTexture("../Texture/Brick/Brick_height.DDS", TRUE);
+			objects.Materials.push_back(material);
+		}
+
+		for (UINT i = 0; i < scene.Drawables; i++)
+		{
+			const DirectX::XMFLOAT2 position = GridPosition(i, scene.Drawables);
+			const Material & material = objects.Materials[i % scene.Materials];
+			Drawable * drawable = new Drawable();
+			drawable->SetPosition(position.x, 0.0f, position.y);
+			drawable->SetRotation(0, static_cast<float>(i) * 0.1f, 0);
+			drawable->SetMesh(*objects.Meshes[i % scene.Meshes]);
+			drawable->Update();
+			drawable->SetTexture(material.Albedo);
+			drawable->SetNormalMap(material.Normal);
+			drawable->SetMetallicMap(material.Metallic);
+			drawable->SetDisplacementMap(material.Displacement);
+			objects.Drawables.push_back(drawable);
+		}
+		objects.AnimatedCount = static_cast<UINT>(scene.Drawables * scene.AnimatedFraction + 0.5f);
+
+		for (UINT i = 0; i < scene.Lights; i++)
+		{
+			const DirectX::XMFLOAT2 position = GridPosition(i, scene.Lights);
+			PointLight * light = new PointLight(renderingManager, *window);
+			light->Init();
+			light->SetPosition(position.x, 3, position.y);
+			light->SetIntensity(15.5f);
+			light->SetDropOff(2.0f);
+			light->SetPow(1.5f);
+			light->SetRadius(7.5f);
+			light->SetColor(1, 1, 1);
+			light->Update();
+			//The shadow pass keeps the most important of them
+			light->SetCastShadows(true);
+			objects.Lights.push_back(light);
+		}
+
+		for (UINT i = 0; i < 3; i++)
+		{
+			objects.Fire[i] = new Texture();
+			objects.Fire[i]->LoadTexture("../Texture/Fire/Fire" + std::to_string(i + 1) + ".bmp", FALSE);
+		}
+
+		for (UINT i = 0; i < scene.Emitters; i++)
+		{
+			const DirectX::XMFLOAT2 position = GridPosition(i, scene.Emitters);
+			ParticleEmitter * emitter = new ParticleEmitter(*window, 256, 256, 3, DXGI_FORMAT_B8G8R8X8_UNORM);
+			emitter->SetTextures(objects.Fire);
+			emitter->Init();
+			emitter->SetPosition(position.x, 0, position.y);
+			emitter->Update();
+			objects.Emitters.push_back(emitter);
+		}
+	}
+
+	void ReleaseScene(SceneObjects & objects)
+	{
+		for (size_t i = 0; i < objects.Emitters.size(); i++)
+		{
+			objects.Emitters[i]->Release();
+			SAFE_DELETE(objects.Emitters[i]);
+		}
+		for (size_t i = 0; i < objects.Lights.size(); i++)
+		{
+			objects.Lights[i]->Release();
+			SAFE_DELETE(objects.Lights[i]);
+		}
+		for (size_t i = 0; i < objects.Drawables.size(); i++)
+		{
+			objects.Drawables[i]->Release();
+			SAFE_DELETE(objects.Drawables[i]);
+		}
+		for (size_t i = 0; i < objects.Meshes.size(); i++)
+		{
+			objects.Meshes[i]->Release();
+			SAFE_DELETE(objects.Meshes[i]);
+		}
+		for (size_t i = 0; i < objects.Materials.size(); i++)
+		{
+			Texture ** textures[] = { &objects.Materials[i].Albedo, &objects.Materials[i].Normal, &objects.Materials[i].Metallic, &objects.Materials[i].Displacement };
+			for (Texture ** texture : textures)
+			{
+				(*texture)->Release();
+				SAFE_DELETE(*texture);
+			}
+		}
+		for (UINT i = 0; i < 3; i++)
+		{
+			objects.Fire[i]->Release();
+			SAFE_DELETE(objects.Fire[i]);
+		}
+		objects = SceneObjects();
+	}
+
+	//Returns FALSE when the window was closed before the scene was done
+	BOOL RunScene(RenderingManager * renderingManager, Window * window, const Benchmark::Scene & scene, Benchmark::Report & report)
+	{
+		SceneObjects objects;
+		CreateScene(renderingManager, window, scene, objects);
+
+		const DirectX::XMFLOAT2 corner = GridPosition(0, scene.Drawables);
+		Camera * camera = new Camera(DirectX::XM_PI * 0.5, 16.0f / 9.0f, .01f, 100.0f);
+		camera->SetPosition(0, -corner.y, corner.y * 1.5f - 5.0f);
+		camera->Rotate(0.6f, 0, 0);
+		camera->Update();
+
+		report.BeginScene(scene);
+		FrameStatsRecorder * frameStats = renderingManager->GetFrameStats();
+
+		UINT frame = 0;
+		while (frame < scene.WarmupFrames + scene.Frames && Window::IsOpen())
+		{
+			Window::Updating();
+
+			const int64_t animateStart = FrameProfiler::Now();
+			for (UINT i = 0; i < objects.AnimatedCount; i++)
+			{
+				Drawable * drawable = objects.Drawables[i];
+				drawable->SetRotation(0, drawable->GetRotation().y + FIXED_STEP * 0.25f, 0);
+				drawable->Update();
+			}
+
+			const int64_t queueStart = FrameProfiler::Now();
+			for (size_t i = 0; i < objects.Drawables.size(); i++)
+				objects.Drawables[i]->Draw();
+			for (size_t i = 0; i < objects.Lights.size(); i++)
+				objects.Lights[i]->Queue();
+			for (size_t i = 0; i < objects.Emitters.size(); i++)
+				objects.Emitters[i]->Draw();
+
+			//Instancing, culling, light upload and particle update run on the pass threads inside the flush
+			const int64_t flushStart = FrameProfiler::Now();
+			UpdateRenderingManger(renderingManager, FIXED_STEP, camera);
+			const int64_t flushEnd = FrameProfiler::Now();
+
+			if (frame++ < scene.WarmupFrames)
+				continue;
+
+			report.AddStage("animate", ToMilliseconds(queueStart - animateStart));
+			report.AddStage("queue", ToMilliseconds(flushStart - queueStart));
+			report.AddStage("flush", ToMilliseconds(flushEnd - flushStart));
+
+			const FrameStats stats = frameStats->GetLast();
+			report.AddStage("frame", stats.FrameTime);
+			for (UINT i = 0; i < frameStats->GetPassCount(); i++)
+				report.AddStage("pass/" + frameStats->GetPassName(i), stats.PassTime[i]);
+			for (UINT i = 0; i < FrameStats::COUNTER_COUNT; i++)
+				report.AddCounter(COUNTER_NAMES[i], static_cast<double>(stats.Counters[i]));
+		}
+
+		renderingManager->WaitForFrames();
+		ReleaseScene(objects);
+		SAFE_DELETE(camera);
+		return frame == scene.WarmupFrames + scene.Frames;
+	}
+}
+
+int RunBenchmark(const HINSTANCE hInstance, const Benchmark::Options & options)
+{
+	const std::vector<Benchmark::Scene> scenes = Benchmark::SelectScenes(options);
+	if (scenes.empty())
+		return 1;
+
+	Window * window = nullptr;
+	RenderingManager * renderingManager = nullptr;
+	if (!InitDirectX12Engine(window, renderingManager, hInstance, "DirectX Renderer Benchmark", 1280, 720, FALSE, FALSE, FALSE, options.UseWarpAdapter))
+		return 1;
+
+	Benchmark::Report report;
+	BOOL completed = TRUE;
+	for (size_t i = 0; i < scenes.size() && completed; i++)
+		completed = RunScene(renderingManager, window, scenes[i], report);
+
+	const std::vector<std::pair<std::string, std::string>> info =
+	{
+#ifdef _DEBUG
+		{ "configuration", "Debug" },
+#else
+		{ "configuration", "Release" },
+#endif
+		{ "compiled", std::string(__DATE__) + " " + __TIME__ },
+		{ "adapter", renderingManager->GetUseWarpAdapter() ? "WARP" : "Hardware" },
+		{ "completed", completed ? "true" : "false" }
+	};
+	renderingManager->Release(FALSE);
+
+	std::ofstream out(options.OutputPath);
+	if (!out)
+		return 1;
+	report.WriteJson(out, info);
+	out.close();
+
+	return completed ? 0 : 1;
+}
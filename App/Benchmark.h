@@ -0,0 +1,7 @@
+#pragma once
+#include "DirectX12Engine.h"
+#include "Utility/Benchmark.h"
+
+// Runs the scenes the options ask for through the whole frame on the CPU and writes the report.
+// Returns the exit code of the process
+int RunBenchmark(const HINSTANCE hInstance, const Benchmark::Options & options);
@@ -1,4 +1,5 @@
 #include "DirectX12Engine.h"
+#include "Benchmark.h"
 
 void CameraMovement(Camera * camera, const float & deltaTime)
 {
@@ -35,6 +36,13 @@ int WINAPI WinMain(HINSTANCE hInstance,
 	LPSTR lpCmdLine, 
 	int nShowCmd)
 {
+	//-benchmark runs the synthetic scenes instead of the demo, see Utility/Benchmark.h for the arguments
+	Benchmark::Options benchmarkOptions;
+	if (!Benchmark::ParseArguments(lpCmdLine ? lpCmdLine : "", benchmarkOptions))
+		return 1;
+	if (benchmarkOptions.Enabled)
+		return RunBenchmark(hInstance, benchmarkOptions);
+
 	Window * window = nullptr;
 	RenderingManager * renderingManager = nullptr;	
 
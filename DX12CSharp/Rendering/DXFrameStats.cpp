@@ -0,0 +1,55 @@
+#include "DXFrameStats.h"
+#include "../Converter.h"
+
+namespace ID3D12
+{
+	DXFrameStats::DXFrameStats(FrameStatsRecorder * frameStats)
+		: IManagedObject<FrameStatsRecorder>(frameStats, false)
+	{
+	}
+
+	UInt64 DXFrameStats::GetCounter(DXFrameCounter counter)
+	{
+		return p_instance->GetLast().Counters[static_cast<int>(counter)];
+	}
+
+	double DXFrameStats::GetCounterPercentile(DXFrameCounter counter, double percentile)
+	{
+		return p_instance->CounterPercentile(static_cast<FrameStats::Counter>(counter), percentile);
+	}
+
+	double DXFrameStats::GetFrameTime()
+	{
+		return p_instance->GetLast().FrameTime;
+	}
+
+	double DXFrameStats::GetFrameTimePercentile(double percentile)
+	{
+		return p_instance->FrameTimePercentile(percentile);
+	}
+
+	unsigned int DXFrameStats::GetPassCount()
+	{
+		return p_instance->GetPassCount();
+	}
+
+	String^ DXFrameStats::GetPassName(unsigned int pass)
+	{
+		return Converter::StdStringToSystemString(p_instance->GetPassName(pass));
+	}
+
+	double DXFrameStats::GetPassTime(unsigned int pass)
+	{
+		return pass < FrameStats::MAX_PASSES ? p_instance->GetLast().PassTime[pass] : 0.0;
+	}
+
+	double DXFrameStats::GetPassTimePercentile(unsigned int pass, double percentile)
+	{
+		return p_instance->PassTimePercentile(pass, percentile);
+	}
+
+	unsigned int DXFrameStats::GetHistoryCount()
+	{
+		return static_cast<unsigned int>(p_instance->GetHistoryCount());
+	}
+}
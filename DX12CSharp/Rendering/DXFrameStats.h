@@ -0,0 +1,44 @@
+#pragma once
+#include "../IManagedObject.h"
+#include <DirectX/Render/WrapperFunctions/Functions/FrameStats.h>
+
+namespace ID3D12
+{
+	using namespace System;
+
+	public enum class DXFrameCounter
+	{
+		DrawCalls = FrameStats::DRAW_CALLS,
+		Instances = FrameStats::INSTANCES,
+		Triangles = FrameStats::TRIANGLES,
+		Dispatches = FrameStats::DISPATCHES,
+		DescriptorCopies = FrameStats::DESCRIPTOR_COPIES,
+		Barriers = FrameStats::BARRIERS,
+		UploadBytes = FrameStats::UPLOAD_BYTES,
+		MatrixUpdates = FrameStats::MATRIX_UPDATES,
+		MatrixUpdatesSkipped = FrameStats::MATRIX_UPDATES_SKIPPED,
+		InstancesOccluded = FrameStats::INSTANCES_OCCLUDED
+	};
+
+	// Reads the frame stats of the rendering manager, the last frame and percentiles over the frames it keeps
+	public ref class DXFrameStats : IManagedObject<FrameStatsRecorder>
+	{
+	public:
+		DXFrameStats(FrameStatsRecorder * frameStats);
+
+		UInt64 GetCounter(DXFrameCounter counter);
+		double GetCounterPercentile(DXFrameCounter counter, double percentile);
+
+		// Milliseconds
+		double GetFrameTime();
+		double GetFrameTimePercentile(double percentile);
+
+		unsigned int GetPassCount();
+		String^ GetPassName(unsigned int pass);
+		double GetPassTime(unsigned int pass);
+		double GetPassTimePercentile(unsigned int pass, double percentile);
+
+		unsigned int GetHistoryCount();
+	};
+
+}
@@ -13,10 +13,20 @@ namespace ID3D12
 		return SUCCEEDED(p_instance->Init(window->GetInstance(), true));
 	}
 
+	bool DXRenderingManager::Init(DXWindow^ window, bool useWarpAdapter)
+	{
+		return SUCCEEDED(p_instance->Init(window->GetInstance(), true, useWarpAdapter));
+	}
+
 	void DXRenderingManager::Flush(DXCamera^ camera)
 	{
 		p_instance->Flush(camera->GetInstance<Camera>(), 0, TRUE);
 	}
+
+	DXFrameStats^ DXRenderingManager::GetFrameStats()
+	{
+		return gcnew DXFrameStats(p_instance->GetFrameStats());
+	}
 	
 	void DXRenderingManager::Release()
 	{
@@ -2,6 +2,7 @@
 #include "DXWindow.h"
 #include <DirectX/RenderingManager.h>
 #include "../Objects/DXCamera.h"
+#include "DXFrameStats.h"
 
 #include "../DirectX/DXDirectX.h"
 
@@ -15,7 +16,10 @@ namespace ID3D12
 		DXRenderingManager();
 
 		bool Init(DXWindow^ window);
+		// Runs on the WARP software adapter, for machines without a GPU
+		bool Init(DXWindow^ window, bool useWarpAdapter);
 		void Flush(DXCamera^ camera);
+		DXFrameStats^ GetFrameStats();
 		void Release();
 	};
 
@@ -10,6 +10,8 @@ BOOL Camera::Init()
 	this->m_direction	= DirectX::XMFLOAT4(0, 0, 1, 0);
 	this->m_up			= DirectX::XMFLOAT4(0, 1, 0, 0);
 	this->m_focusPoint	= DirectX::XMFLOAT4(0, 0, 0, 1);
+	this->m_viewDirty = TRUE;
+	this->m_projectionDirty = TRUE;
 	this->Update();
 	return TRUE;
 }
@@ -17,9 +19,20 @@ BOOL Camera::Init()
 void Camera::Update()
 {
 	Transform::Update();
-	_calcView();
-	_calcProjection();
-	_calcViewProjection();
+	//The view is made from the position, which has changed if the world matrix was rebuilt
+	if (p_getWorldVersion() != m_viewWorldVersion)
+		m_viewDirty = TRUE;
+	const BOOL viewProjectionDirty = m_viewDirty || m_projectionDirty;
+
+	_countMatrixUpdate(m_viewDirty);
+	if (m_viewDirty)
+		_calcView();
+	_countMatrixUpdate(m_projectionDirty);
+	if (m_projectionDirty)
+		_calcProjection();
+	_countMatrixUpdate(viewProjectionDirty);
+	if (viewProjectionDirty)
+		_calcViewProjection();
 }
 
 void Camera::Release()
@@ -46,6 +59,8 @@ void Camera::_calcView()
 				XMLoadFloat4(&m_direction),
 				XMLoadFloat4(&m_up))));
 	}
+	this->m_viewDirty = FALSE;
+	this->m_viewWorldVersion = p_getWorldVersion();
 }
 
 void Camera::_calcProjection()
@@ -72,7 +87,7 @@ void Camera::_calcProjection()
 					m_nearPlane, 
 					m_farPlane)));	
 	}
-
+	this->m_projectionDirty = FALSE;
 }
 
 void Camera::_calcViewProjection()
@@ -129,9 +144,14 @@ void Camera::SetDirection(const DirectX::XMFLOAT4& direction)
 	using namespace DirectX;
 	XMVECTOR vDir = XMLoadFloat4(&direction);
 	vDir = XMVector3Normalize(vDir);
-	XMStoreFloat4(&this->m_direction, vDir);
+	XMFLOAT4 newDirection;
+	XMStoreFloat4(&newDirection, vDir);
+	newDirection.w = direction.w;
 
-	this->m_direction.w = direction.w;
+	if (_equal(this->m_direction, newDirection))
+		return;
+	this->m_direction = newDirection;
+	this->m_viewDirty = TRUE;
 }
 
 void Camera::SetDirection(const float& x, const float& y, const float& z, const float& w)
@@ -141,7 +161,10 @@ void Camera::SetDirection(const float& x, const float& y, const float& z, const
 
 void Camera::SetFocusPoint(const DirectX::XMFLOAT4& focusPoint)
 {
+	if (_equal(this->m_focusPoint, focusPoint))
+		return;
 	this->m_focusPoint = focusPoint;
+	this->m_viewDirty = TRUE;
 }
 
 void Camera::SetFocusPoint(const float& x, const float& y, const float& z, const float& w)
@@ -177,6 +200,7 @@ void Camera::Rotate(const DirectX::XMFLOAT4& rotation)
 	{
 		DirectX::XMStoreFloat4(&this->m_direction, DirectX::XMVector3Normalize(vNewDir));
 		m_direction.w = 0.0f;
+		m_viewDirty = TRUE;
 	}
 }
 
@@ -221,7 +245,10 @@ void Camera::Translate(const float& x, const float& y, const float& z, const flo
 
 void Camera::SetUp(const DirectX::XMFLOAT4& up)
 {
+	if (_equal(this->m_up, up))
+		return;
 	this->m_up = up;
+	this->m_viewDirty = TRUE;
 }
 
 void Camera::SetUp(const float& x, const float& y, const float& z, const float& w)
@@ -231,32 +258,50 @@ void Camera::SetUp(const float& x, const float& y, const float& z, const float&
 
 void Camera::SetFov(const float& fov)
 {
+	if (this->m_fov == fov)
+		return;
 	this->m_fov = fov;
+	this->m_projectionDirty = TRUE;
 }
 
 void Camera::SetAspectRatio(const float& aspectRatio)
 {
+	if (this->m_aspectRatio == aspectRatio)
+		return;
 	this->m_aspectRatio = aspectRatio;
+	this->m_projectionDirty = TRUE;
 }
 
 void Camera::SetNearPlane(const float& nearPlane)
 {
+	if (this->m_nearPlane == nearPlane)
+		return;
 	this->m_nearPlane = nearPlane;
+	this->m_projectionDirty = TRUE;
 }
 
 void Camera::SetFarPlane(const float& farPlane)
 {
+	if (this->m_farPlane == farPlane)
+		return;
 	this->m_farPlane = farPlane;
+	this->m_projectionDirty = TRUE;
 }
 
 void Camera::SetPerspective(const BOOL& perspective)
 {
+	if (this->m_usePerspective == perspective)
+		return;
 	this->m_usePerspective = perspective;
+	this->m_projectionDirty = TRUE;
 }
 
 void Camera::SetFocusPoint(const BOOL& focusPoint)
 {
+	if (this->m_useFocusPoint == focusPoint)
+		return;
 	this->m_useFocusPoint = focusPoint;
+	this->m_viewDirty = TRUE;
 }
 
 const float& Camera::GetFov() const
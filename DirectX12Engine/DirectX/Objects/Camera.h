@@ -24,6 +24,11 @@ private:
 	BOOL m_usePerspective;
 	BOOL m_useFocusPoint = FALSE;
 
+	//Set by the setters when a value the matrix is made from changes, Update only rebuilds what is set
+	BOOL m_viewDirty = TRUE;
+	BOOL m_projectionDirty = TRUE;
+	UINT64 m_viewWorldVersion = 0;
+
 	void _calcView();
 	void _calcProjection();
 	void _calcViewProjection();
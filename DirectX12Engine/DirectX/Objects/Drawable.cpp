@@ -1,10 +1,12 @@
 #include "DirectX12EnginePCH.h"
 #include "Drawable.h"
 #include "DirectX/Render/Template/IRender.h"
+#include "DirectX/Render/WrapperFunctions/Functions/TransformStore.h"
 
 
 Drawable::Drawable()
 {
+	m_transform = TransformStore::GetInstance()->Allocate();
 	m_mesh = nullptr;
 	m_texture = nullptr;
 	m_normal = nullptr;
@@ -17,16 +19,32 @@ Drawable::Drawable()
 
 Drawable::~Drawable()
 {
+	TransformStore::GetInstance()->Free(m_transform);
 }
 
 BOOL Drawable::Init()
 {
-	return Transform::Init();
+	if (!Transform::Init())
+		return FALSE;
+	if (p_inSceneGraph())
+		return TRUE;
+	TransformStore * store = TransformStore::GetInstance();
+	store->SetPosition(m_transform, GetPosition());
+	store->SetRotation(m_transform, GetRotation());
+	store->SetScale(m_transform, GetScale());
+	return TRUE;
 }
 
 void Drawable::Update()
 {
-	Transform::Update();
+	if (p_inSceneGraph())
+	{
+		Transform::Update();
+		return;
+	}
+	//A changed matrix is rebuilt and counted in UpdateTransforms
+	if (!TransformStore::GetInstance()->IsDirty(m_transform))
+		_countMatrixUpdate(FALSE);
 }
 
 void Drawable::Release()
@@ -34,6 +52,57 @@ void Drawable::Release()
 	Transform::Release();
 }
 
+void Drawable::SetPosition(const DirectX::XMFLOAT4& position)
+{
+	Transform::SetPosition(position);
+	if (!p_inSceneGraph())
+		TransformStore::GetInstance()->SetPosition(m_transform, position);
+}
+
+void Drawable::SetRotation(const DirectX::XMFLOAT4& rotation)
+{
+	Transform::SetRotation(rotation);
+	if (!p_inSceneGraph())
+		TransformStore::GetInstance()->SetRotation(m_transform, rotation);
+}
+
+void Drawable::SetScale(const DirectX::XMFLOAT4& scale)
+{
+	Transform::SetScale(scale);
+	if (!p_inSceneGraph())
+		TransformStore::GetInstance()->SetScale(m_transform, scale);
+}
+
+const DirectX::XMFLOAT4X4A& Drawable::GetWorldMatrix() const
+{
+	TransformStore * store = TransformStore::GetInstance();
+	//Read on the main thread after a change and before the frame rebuilt it
+	if (p_inSceneGraph())
+		UpdateSceneGraph();
+	else if (store->IsDirty(m_transform))
+		UpdateTransforms();
+	return store->GetWorldMatrix(m_transform);
+}
+
+const UINT& Drawable::GetTransformHandle() const
+{
+	return this->m_transform;
+}
+
+void Drawable::UpdateTransforms()
+{
+	const size_t rebuilt = TransformStore::GetInstance()->Update();
+	if (rebuilt)
+		_countMatrixUpdate(TRUE, rebuilt);
+	//After the store so the matrices of the drawables in the graph are not rebuilt over
+	UpdateSceneGraph();
+}
+
+void Drawable::p_sceneWorldChanged()
+{
+	TransformStore::GetInstance()->SetWorldMatrix(m_transform, Transform::GetWorldMatrix());
+}
+
 void Drawable::SetMesh(StaticMesh& mesh)
 {
 	this->m_mesh = &mesh;
@@ -84,6 +153,36 @@ const BOOL& Drawable::GetCastShadows() const
 	return this->m_castShadows;
 }
 
+void Drawable::SetIsOccluder(const BOOL& occluder)
+{
+	this->m_isOccluder = occluder;
+}
+
+const BOOL& Drawable::GetIsOccluder() const
+{
+	return this->m_isOccluder;
+}
+
+void Drawable::SetTessellation(const BOOL& tessellation)
+{
+	this->m_tessellation = tessellation;
+}
+
+const BOOL& Drawable::GetTessellation() const
+{
+	return this->m_tessellation;
+}
+
+void Drawable::SetNormalMapping(const BOOL& normalMapping)
+{
+	this->m_normalMapping = normalMapping;
+}
+
+const BOOL& Drawable::GetNormalMapping() const
+{
+	return this->m_normalMapping;
+}
+
 void Drawable::SetTexture(Texture* texture)
 {
 	this->m_texture = texture;
@@ -115,7 +214,9 @@ bool Drawable::Instance(const Drawable& other) const
 		m_texture == other.m_texture &&
 		m_normal == other.m_normal &&
 		m_metallic == other.m_metallic &&
-		m_displacement == other.m_displacement;
+		m_displacement == other.m_displacement &&
+		!m_tessellation == !other.m_tessellation &&
+		!m_normalMapping == !other.m_normalMapping;
 }
 
 const Texture* Drawable::GetMetallic() const
@@ -5,16 +5,34 @@
 class Texture;
 class IRender;
 
+// The transform of a drawable lives in the TransformStore, its world matrix is rebuilt with every other
+// drawable that changed in UpdateTransforms instead of in Update. A drawable in the scene graph gets its
+// world matrix from there and hands it to the store
 class Drawable :
 	public Transform
 {	
 public:
 	Drawable();
 	~Drawable();
+	Drawable(const Drawable &) = delete;
+	Drawable & operator=(const Drawable &) = delete;
 
 	BOOL Init() override;
 	void Update() override;
 	void Release() override;
+
+	using Transform::SetPosition;
+	using Transform::SetRotation;
+	using Transform::SetScale;
+	void SetPosition(const DirectX::XMFLOAT4 & position) override;
+	void SetRotation(const DirectX::XMFLOAT4 & rotation) override;
+	void SetScale(const DirectX::XMFLOAT4 & scale) override;
+
+	const DirectX::XMFLOAT4X4A & GetWorldMatrix() const override;
+	const UINT & GetTransformHandle() const;
+
+	// Rebuilds the world matrix of every drawable that changed and then the scene graph, the rendering manager calls it before the passes run
+	static void UpdateTransforms();
 	
 	void SetMesh(StaticMesh & mesh);
 
@@ -28,6 +46,17 @@ public:
 	void SetCastShadows(const BOOL & castShadows);
 	const BOOL & GetCastShadows() const;
 
+	// Occluders are drawn into the depth buffer the geometry pass culls instances with, best for large solid meshes
+	void SetIsOccluder(const BOOL & occluder);
+	const BOOL & GetIsOccluder() const;
+
+	// Material features, the geometry pass draws with the shader variant that has only the enabled ones compiled in
+	void SetTessellation(const BOOL & tessellation);
+	const BOOL & GetTessellation() const;
+
+	void SetNormalMapping(const BOOL & normalMapping);
+	const BOOL & GetNormalMapping() const;
+
 	void SetTexture(Texture * texture);
 	void SetNormalMap(Texture * normal);
 	void SetMetallicMap(Texture * metallic);
@@ -40,7 +69,12 @@ public:
 
 	bool Instance(const Drawable & other) const;
 
+protected:
+	void p_sceneWorldChanged() override;
+
 private:	
+	UINT m_transform;
+
 	StaticMesh * m_mesh;
 	Texture * m_texture;
 	Texture * m_normal;
@@ -49,6 +83,9 @@ private:
 
 	BOOL m_isVisible = TRUE;
 	BOOL m_castShadows = TRUE;
+	BOOL m_isOccluder = FALSE;
+	BOOL m_tessellation = TRUE;
+	BOOL m_normalMapping = TRUE;
 
 	RenderingManager * m_renderingManager = nullptr;
 };
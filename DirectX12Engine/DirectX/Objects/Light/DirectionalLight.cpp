@@ -5,6 +5,7 @@ DirectionalLight::DirectionalLight(RenderingManager* renderingManager, const Win
 	: ILight(renderingManager, window, ILight::LightType::Directional)
 {
 	SAFE_NEW(m_camera, new Camera(DirectX::XM_PI * 0.5, 1.0f, 1, 100.0f, FALSE));
+	this->p_renderTargets = m_cascadeSettings.CascadeCount;
 }
 
 DirectionalLight::~DirectionalLight()
@@ -17,15 +18,14 @@ BOOL DirectionalLight::Init()
 	if (!ILight::Init())
 		return FALSE;
 	m_camera->Init();
-	if (FAILED(p_createDirectXContext(1, TRUE)))
-	{
-		return FALSE;
-	}
 	return TRUE;
 }
 
 void DirectionalLight::Update()
 {
+	ILight::Update();
+	//Follows the parent when the light is in the scene graph
+	m_camera->SetPosition(GetWorldPosition());
 	m_camera->Update();
 }
 
@@ -53,7 +53,7 @@ void DirectionalLight::SetDirection(const float& x, const float& y, const float&
 void DirectionalLight::SetPosition(const DirectX::XMFLOAT4& position)
 {
 	Transform::SetPosition(position);
-	this->m_camera->SetPosition(position);
+	this->m_camera->SetPosition(GetWorldPosition());
 }
 
 void DirectionalLight::SetPosition(const float& x, const float& y, const float& z, const float& w)
@@ -61,6 +61,49 @@ void DirectionalLight::SetPosition(const float& x, const float& y, const float&
 	SetPosition(DirectX::XMFLOAT4(x, y, z, w));
 }
 
+void DirectionalLight::SetCascadeCount(const UINT& cascadeCount)
+{
+	UINT count = cascadeCount < CascadedShadows::MAX_CASCADES ? cascadeCount : CascadedShadows::MAX_CASCADES;
+	if (count == 0)
+		count = 1;
+	this->m_cascadeSettings.CascadeCount = count;
+	this->p_renderTargets = count;
+}
+
+void DirectionalLight::SetCascadeSplitLambda(const float& lambda)
+{
+	this->m_cascadeSettings.SplitLambda = lambda;
+}
+
+void DirectionalLight::SetShadowDistance(const float& distance)
+{
+	this->m_cascadeSettings.ShadowDistance = distance;
+}
+
+const CascadedShadows::Settings& DirectionalLight::GetCascadeSettings() const
+{
+	return this->m_cascadeSettings;
+}
+
+void DirectionalLight::UpdateCascades(const Camera& camera, const UINT& resolution)
+{
+	CascadedShadows::ComputeCascades(
+		camera.GetViewMatrix(),
+		camera.GetFov(),
+		camera.GetAspectRatio(),
+		camera.GetNearPlane(),
+		camera.GetFarPlane(),
+		m_camera->GetDirection(),
+		resolution,
+		m_cascadeSettings,
+		m_cascades);
+}
+
+const CascadedShadows::Cascade* DirectionalLight::GetCascades() const
+{
+	return this->m_cascades;
+}
+
 
 
 
@@ -1,4 +1,5 @@
 ﻿#pragma once
+#include "../../Render/WrapperFunctions/Functions/CascadedShadows.h"
 
 class DirectionalLight : 
 	public ILight
@@ -19,6 +20,18 @@ public:
 	void SetPosition(const DirectX::XMFLOAT4& position) override;
 	void SetPosition(const float& x, const float& y, const float& z, const float& w = 1.0f) override;
 
+	void SetCascadeCount(const UINT & cascadeCount);
+	void SetCascadeSplitLambda(const float & lambda);
+	void SetShadowDistance(const float & distance);
+	const CascadedShadows::Settings & GetCascadeSettings() const;
+
+	// Fits one orthographic view per cascade to the slices of the camera frustum, resolution is the tile size in texels
+	void UpdateCascades(const Camera & camera, const UINT & resolution);
+	const CascadedShadows::Cascade * GetCascades() const;
+
 private:
 	Camera * m_camera = nullptr;
+
+	CascadedShadows::Settings	m_cascadeSettings;
+	CascadedShadows::Cascade	m_cascades[CascadedShadows::MAX_CASCADES]{};
 };
@@ -0,0 +1,23 @@
+#include "DirectX12EnginePCH.h"
+#include "LightRegistry.h"
+
+static_assert(sizeof(LightRegistry::GpuLight) == 64, "GpuLight must match LIGHT_STRUCT in LightCalculations.hlsli");
+
+void LightRegistry::Queue(PointLight* light)
+{
+	QueuePoint(light, 
+		light->GetType(), 
+		light->GetWorldPosition(), 
+		light->GetColor(), 
+		DirectX::XMFLOAT4(light->GetIntensity(), light->GetDropOff(), light->GetPow(), light->GetRadius()));
+}
+
+void LightRegistry::Queue(DirectionalLight* light)
+{
+	QueueDirectional(light, 
+		light->GetType(), 
+		light->GetWorldPosition(), 
+		light->GetColor(), 
+		light->GetCamera()->GetDirection(), 
+		light->GetIntensity());
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+
+class PointLight;
+class DirectionalLight;
+
+// Lights queued this frame, split by type so the passes never have to look at the type of a single light.
+// Every type keeps its fields in separate arrays, the Table rows are laid out for the GPU
+// so a whole type is uploaded with one copy.
+// Everything but Queue(light) lives in the header so the store can be measured without the light classes.
+class LightRegistry
+{
+public:
+	// Same layout as LIGHT_STRUCT in LightCalculations.hlsli
+	struct GpuLight
+	{
+		DirectX::XMUINT4 Type;
+		DirectX::XMFLOAT4 Position;
+		DirectX::XMFLOAT4 Color;
+		DirectX::XMFLOAT4 Vector;	//Point: intensity, drop off, pow, radius. Directional: direction and intensity
+	};
+
+	struct PointLights
+	{
+		std::vector<PointLight*> Lights;
+		std::vector<float> X;
+		std::vector<float> Y;
+		std::vector<float> Z;
+		std::vector<float> Radius;
+		std::vector<GpuLight> Table;
+	};
+
+	struct DirectionalLights
+	{
+		std::vector<DirectionalLight*> Lights;
+		std::vector<DirectX::XMFLOAT4> Direction;
+		std::vector<GpuLight> Table;
+	};
+
+public:
+	LightRegistry() = default;
+	~LightRegistry() = default;
+
+	void Queue(PointLight * light);
+	void Queue(DirectionalLight * light);
+
+	// falloff is intensity, drop off, pow and radius
+	void QueuePoint(PointLight * light, const unsigned int & type, const DirectX::XMFLOAT4 & position, const DirectX::XMFLOAT4 & color, const DirectX::XMFLOAT4 & falloff)
+	{
+		m_pointLights.Lights.push_back(light);
+		m_pointLights.X.push_back(position.x);
+		m_pointLights.Y.push_back(position.y);
+		m_pointLights.Z.push_back(position.z);
+		m_pointLights.Radius.push_back(falloff.w);
+		m_pointLights.Table.push_back(GpuLight{ DirectX::XMUINT4(type, type, type, type), position, color, falloff });
+	}
+
+	void QueueDirectional(DirectionalLight * light, const unsigned int & type, const DirectX::XMFLOAT4 & position, const DirectX::XMFLOAT4 & color, const DirectX::XMFLOAT4 & direction, const float & intensity)
+	{
+		m_directionalLights.Lights.push_back(light);
+		m_directionalLights.Direction.push_back(direction);
+		m_directionalLights.Table.push_back(GpuLight{
+			DirectX::XMUINT4(type, type, type, type),
+			position,
+			color,
+			DirectX::XMFLOAT4(direction.x, direction.y, direction.z, intensity) });
+	}
+
+	void Clear()
+	{
+		m_pointLights.Lights.clear();
+		m_pointLights.X.clear();
+		m_pointLights.Y.clear();
+		m_pointLights.Z.clear();
+		m_pointLights.Radius.clear();
+		m_pointLights.Table.clear();
+
+		m_directionalLights.Lights.clear();
+		m_directionalLights.Direction.clear();
+		m_directionalLights.Table.clear();
+	}
+
+	void Reserve(const size_t & pointLights, const size_t & directionalLights)
+	{
+		m_pointLights.Lights.reserve(pointLights);
+		m_pointLights.X.reserve(pointLights);
+		m_pointLights.Y.reserve(pointLights);
+		m_pointLights.Z.reserve(pointLights);
+		m_pointLights.Radius.reserve(pointLights);
+		m_pointLights.Table.reserve(pointLights);
+
+		m_directionalLights.Lights.reserve(directionalLights);
+		m_directionalLights.Direction.reserve(directionalLights);
+		m_directionalLights.Table.reserve(directionalLights);
+	}
+
+	const PointLights & GetPointLights() const
+	{
+		return m_pointLights;
+	}
+
+	const DirectionalLights & GetDirectionalLights() const
+	{
+		return m_directionalLights;
+	}
+
+	size_t GetSize() const
+	{
+		return m_pointLights.Lights.size() + m_directionalLights.Lights.size();
+	}
+
+private:
+	PointLights m_pointLights;
+	DirectionalLights m_directionalLights;
+};
@@ -75,15 +75,7 @@ const Camera* const* PointLight::GetCameras() const
 
 BOOL PointLight::Init()
 {
-	if (!ILight::Init())
-		return FALSE;
-	HRESULT hr = 0;
-
-	if (FAILED(hr = p_createDirectXContext(6u, TRUE)))
-	{
-		return FALSE;
-	}
-	return TRUE;
+	return ILight::Init();
 }
 
 void PointLight::Update()
@@ -91,7 +83,7 @@ void PointLight::Update()
 	ILight::Update();
 	for (UINT i = 0; i < 6; i++)
 	{
-		m_cameras[i]->SetPosition(GetPosition());
+		m_cameras[i]->SetPosition(GetWorldPosition());
 		m_cameras[i]->Update();
 	}
 }
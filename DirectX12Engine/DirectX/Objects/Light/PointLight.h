@@ -1,9 +1,6 @@
 #pragma once
 #include "Template/ILight.h"
 
-class X12DepthStencil;
-class X12RenderTargetView;
-
 class PointLight :
 	public ILight
 {
@@ -1,8 +1,7 @@
 #include "DirectX12EnginePCH.h"
 #include "ILight.h"
 #include "DirectX/Render/Template/IRender.h"
-#include "DirectX/Render/WrapperFunctions/X12RenderTargetView.h"
-#include "DirectX/Render/WrapperFunctions/X12DepthStencil.h"
+#include "DirectX/Objects/Light/LightRegistry.h"
 
 #pragma warning (disable : 4172)
 
@@ -19,42 +18,6 @@ ILight::ILight(RenderingManager* renderingManager, const Window& window, const L
 	this->m_color = DirectX::XMFLOAT4(1, 1, 1, 1);
 }
 
-BOOL ILight::p_createDirectXContext(const UINT& renderTargets, const BOOL& createTexture)
-{
-	HRESULT hr = 0;
-	if (p_renderTarget || p_depthStencil)
-		throw "Shit";
-
-	p_renderTargets = renderTargets;
-	SAFE_NEW(p_depthStencil, new X12DepthStencil());
-	SAFE_NEW(p_renderTarget, new X12RenderTargetView());
-
-	if (SUCCEEDED(hr = p_renderingManager->OpenCommandList()))
-	{
-		if (SUCCEEDED(hr = p_renderTarget->CreateRenderTarget(
-			SHADOW_MAP_SIZE,
-			SHADOW_MAP_SIZE,
-			renderTargets,
-			createTexture)))
-		{
-			if (SUCCEEDED(hr = p_depthStencil->CreateDepthStencil(
-				L"Directional Light",
-				SHADOW_MAP_SIZE,
-				SHADOW_MAP_SIZE,
-				renderTargets,
-				createTexture)))
-			{
-				if (SUCCEEDED(hr = p_renderingManager->SignalGPU()))
-				{
-
-				}
-			}
-		}
-	}
-
-	return FALSE;
-}
-
 BOOL ILight::Init()
 {
 	return Transform::Init();
@@ -68,28 +31,27 @@ void ILight::Update()
 void ILight::Release()
 {
 	Transform::Release();
-	p_renderTarget->Release();
-	p_depthStencil->Release();
 }
 
 
 ILight::~ILight()
 {
-	SAFE_DELETE(p_renderTarget);
-	SAFE_DELETE(p_depthStencil);
 }
 
 void ILight::Queue()
 {
-	if (m_intensity > 0)
+	LightRegistry * lightRegistry = p_renderingManager->GetLightRegistry();
+	if (m_intensity > 0 && lightRegistry)
 	{
-		IRender * deferredPass = reinterpret_cast<IRender*>(p_renderingManager->GetDeferredRender());
-		IRender * shadowPass = reinterpret_cast<IRender*>(p_renderingManager->GetShadowPass());
-
-		if (deferredPass)
-			deferredPass->QueueLight(this);
-		if (shadowPass)
-			shadowPass->QueueLight(this);
+		switch (p_lightType)
+		{
+		case Point:
+			lightRegistry->Queue(static_cast<PointLight*>(this));
+			break;
+		case Directional:
+			lightRegistry->Queue(static_cast<DirectionalLight*>(this));
+			break;
+		}
 	}
 }
 
@@ -137,18 +99,3 @@ const UINT& ILight::GetNumRenderTargets() const
 {
 	return p_renderTargets;
 }
-
-X12DepthStencil* ILight::GetDepthStencil() const
-{
-	return p_depthStencil;
-}
-
-X12RenderTargetView* ILight::GetRenderTargetView() const
-{
-	return p_renderTarget;
-}
-
-
-
-
-
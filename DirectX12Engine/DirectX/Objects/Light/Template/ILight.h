@@ -4,8 +4,6 @@
 #include <d3d12.h>
 #include "Window/Window.h"
 
-class X12DepthStencil;
-class X12RenderTargetView;
 class RenderingManager;
 
 class ILight : public Transform
@@ -33,9 +31,6 @@ public:
 	virtual const UINT & GetType() const;
 	virtual const UINT & GetNumRenderTargets() const;
 
-	X12DepthStencil * GetDepthStencil() const;
-	X12RenderTargetView * GetRenderTargetView() const;
-
 protected:
 	ILight(RenderingManager * renderingManager, const Window & window, const LightType & lightType);
 	RenderingManager * p_renderingManager;
@@ -43,11 +38,7 @@ protected:
 
 	UINT p_renderTargets = 1;
 	LightType p_lightType = LightType::Point;
-	X12DepthStencil * p_depthStencil = nullptr;
-	X12RenderTargetView * p_renderTarget = nullptr;
 
-	BOOL p_createDirectXContext(const UINT & renderTargets = 1, const BOOL & createTexture = FALSE);
-	
 	BOOL Init() override;
 	void Update() override;
 	void Release() override;
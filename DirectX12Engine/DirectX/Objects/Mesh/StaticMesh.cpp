@@ -21,6 +21,9 @@ StaticMesh::~StaticMesh()
 void StaticMesh::_clearMesh()
 {
 	m_staticMesh.clear();
+	m_boundingRadius = 0.0f;
+	m_boundingBoxMin = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	m_boundingBoxMax = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
 }
 
 BOOL StaticMesh::_createMesh(const aiScene* scene)
@@ -39,6 +42,15 @@ BOOL StaticMesh::_createMesh(const aiScene* scene)
 			vertex.Tangent		= Convert_Assimp_To_DirectX(scene->mMeshes[i]->mTangents[j], 0);
 			vertex.TexCord		= Convert_Assimp_To_DirectX(scene->mMeshes[i]->mTextureCoords[0][j], 0);
 			m_staticMesh.push_back(vertex);
+
+			const float radius = sqrtf(vertex.Position.x * vertex.Position.x + vertex.Position.y * vertex.Position.y + vertex.Position.z * vertex.Position.z);
+			if (radius > m_boundingRadius)
+				m_boundingRadius = radius;
+
+			const DirectX::XMVECTOR position = DirectX::XMLoadFloat4(&vertex.Position);
+			const BOOL first = m_staticMesh.size() == 1;
+			DirectX::XMStoreFloat3(&m_boundingBoxMin, first ? position : DirectX::XMVectorMin(DirectX::XMLoadFloat3(&m_boundingBoxMin), position));
+			DirectX::XMStoreFloat3(&m_boundingBoxMax, first ? position : DirectX::XMVectorMax(DirectX::XMLoadFloat3(&m_boundingBoxMax), position));
 		}
 	}
 	return TRUE;
@@ -122,6 +134,21 @@ const std::vector<StaticVertex>& StaticMesh::GetStaticMesh() const
 	return this->m_staticMesh;
 }
 
+const float& StaticMesh::GetBoundingRadius() const
+{
+	return this->m_boundingRadius;
+}
+
+const DirectX::XMFLOAT3& StaticMesh::GetBoundingBoxMin() const
+{
+	return this->m_boundingBoxMin;
+}
+
+const DirectX::XMFLOAT3& StaticMesh::GetBoundingBoxMax() const
+{
+	return this->m_boundingBoxMax;
+}
+
 const D3D12_VERTEX_BUFFER_VIEW& StaticMesh::GetVertexBufferView() const
 {
 	return this->m_vertexBufferView;
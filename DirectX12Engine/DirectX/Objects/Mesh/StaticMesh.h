@@ -25,6 +25,11 @@ public:
 	BOOL CreateBuffer();
 	
 	const std::vector<StaticVertex> & GetStaticMesh() const;
+	// Radius of a sphere around the origin of the mesh holding every vertex
+	const float & GetBoundingRadius() const;
+	// Corners of the box around every vertex, in the space of the mesh
+	const DirectX::XMFLOAT3 & GetBoundingBoxMin() const;
+	const DirectX::XMFLOAT3 & GetBoundingBoxMax() const;
 
 	const D3D12_VERTEX_BUFFER_VIEW & GetVertexBufferView() const;
 
@@ -39,6 +44,9 @@ private:
 	ID3D12Resource *				m_vertexBuffer		= nullptr;
 	ID3D12Resource *				m_vertexHeapBuffer	= nullptr;
 	std::vector<StaticVertex>	m_staticMesh;
+	float m_boundingRadius = 0.0f;
+	DirectX::XMFLOAT3 m_boundingBoxMin = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+	DirectX::XMFLOAT3 m_boundingBoxMax = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
 
 	RenderingManager * m_renderingManager = nullptr;
 
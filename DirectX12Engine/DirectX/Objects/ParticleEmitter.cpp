@@ -3,7 +3,6 @@
 #include "DirectX/Render/ParticlePass.h"
 #include "DirectX/Structs.h"
 #include "DirectX/Render/WrapperFunctions/X12ShaderResourceView.h"
-#include "DirectX/Render/WrapperFunctions/X12ConstantBuffer.h"
 
 
 ParticleEmitter::ParticleEmitter(	
@@ -34,30 +33,27 @@ BOOL ParticleEmitter::Init()
 	HRESULT hr = 0;	
 	if (SUCCEEDED(hr = _createCommandList()))
 	{
-		if (SUCCEEDED(hr = _createBuffer()))
-		{			
-			SAFE_NEW(m_shaderResourceView, new X12ShaderResourceView());
-			if (SUCCEEDED(hr = m_shaderResourceView->CreateShaderResourceView(
-				m_width,
-				m_height,
-				m_arraySize,
-				this->m_format)))
-			{
-				if (SUCCEEDED(hr = OpenCommandList()))
-				{					
-					for (UINT i = 0; i < m_arraySize; i++)
-					{
-						m_shaderResourceView->BeginCopy(m_commandList[m_renderingManager->GetFrameIndex()]);
-				
-						m_shaderResourceView->CopySubresource(m_commandList[m_renderingManager->GetFrameIndex()], i,
-							m_textures[i]->GetResource());
-				
-						m_shaderResourceView->EndCopy(m_commandList[m_renderingManager->GetFrameIndex()]);
-					}
-					if (SUCCEEDED(hr = m_renderingManager->SignalGPU(m_commandList[m_renderingManager->GetFrameIndex()])))
-					{
-						
-					}
+		SAFE_NEW(m_shaderResourceView, new X12ShaderResourceView());
+		if (SUCCEEDED(hr = m_shaderResourceView->CreateShaderResourceView(
+			m_width,
+			m_height,
+			m_arraySize,
+			this->m_format)))
+		{
+			if (SUCCEEDED(hr = OpenCommandList()))
+			{					
+				for (UINT i = 0; i < m_arraySize; i++)
+				{
+					m_shaderResourceView->BeginCopy(m_commandList);
+			
+					m_shaderResourceView->CopySubresource(m_commandList, i,
+						m_textures[i]->GetResource());
+			
+					m_shaderResourceView->EndCopy(m_commandList);
+				}
+				if (SUCCEEDED(hr = m_renderingManager->SignalGPU(m_commandList)))
+				{
+					
 				}
 			}
 		}
@@ -67,25 +63,6 @@ BOOL ParticleEmitter::Init()
 		this->Release();
 		return FALSE;
 	}
-	SAFE_NEW(m_particleBuffer, new X12ConstantBuffer());
-	if (FAILED(hr = m_particleBuffer->CreateSharedBuffer(L"Particle buffer", 0, MAX_PARTICLES * sizeof(DirectX::XMFLOAT4) * 4)))
-	{
-		if (FAILED(hr = m_particleBuffer->CreateBuffer(L"Particle buffer", nullptr, 0, MAX_PARTICLES * sizeof(DirectX::XMFLOAT4) * 4)))
-		{
-			return hr;
-		}
-	}
-
-	ID3D12Device * pDevice = m_renderingManager->GetSecondAdapter() ? m_renderingManager->GetSecondAdapter()->GetDevice() : m_renderingManager->GetMainAdapter()->GetDevice();
-
-	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
-	{
-		SAFE_NEW(m_fences[i], new X12Fence());
-		if (FAILED(hr = m_fences[i]->CreateFence(L"Particle,", pDevice, D3D12_FENCE_FLAG_SHARED | D3D12_FENCE_FLAG_SHARED_CROSS_ADAPTER)))
-			return hr;
-	}
-
-	
 
 	SAFE_NEW(m_particles, new std::vector<Particle>());
 	return TRUE;
@@ -98,29 +75,12 @@ void ParticleEmitter::Release()
 		m_particles->clear();
 	SAFE_DELETE(m_particles);
 
-	if (m_particleBuffer)
-		m_particleBuffer->Release();
-	SAFE_DELETE(m_particleBuffer);
-
 	if (m_shaderResourceView)
 		m_shaderResourceView->Release();
 	SAFE_DELETE(m_shaderResourceView);
 
-	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
-	{
-		if (m_fences[i])
-			m_fences[i]->Release();
-		SAFE_DELETE(m_fences[i]);
-	}
-
-	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
-	{
-		SAFE_RELEASE(m_commandList[i]);
-		SAFE_RELEASE(m_commandAllocator[i]);
-		SAFE_RELEASE(m_vertexResource[i]);
-		SAFE_RELEASE(m_vertexOutputResource[i]);
-		SAFE_RELEASE(m_calculationsOutputResource[i]);
-	}
+	SAFE_RELEASE(m_commandList);
+	SAFE_RELEASE(m_commandAllocator);
 	Transform::Release();
 }
 
@@ -129,24 +89,9 @@ void ParticleEmitter::Update()
 	Transform::Update();
 }
 
-ID3D12Resource* ParticleEmitter::GetVertexResource() const
-{
-	return this->m_vertexOutputResource[m_renderingManager->GetFrameIndex()];
-}
-
-ID3D12Resource* ParticleEmitter::GetCalcResource() const
-{
-	return this->m_calculationsOutputResource[m_renderingManager->GetFrameIndex()];
-}
-
-X12ConstantBuffer* ParticleEmitter::GetParticleBuffer() const
-{
-	return this->m_particleBuffer;
-}
-
 ID3D12GraphicsCommandList* ParticleEmitter::GetCommandList() const
 {
-	return this->m_commandList[m_renderingManager->GetFrameIndex()];
+	return this->m_commandList;
 }
 
 const std::vector<ParticleEmitter::Particle>& ParticleEmitter::GetParticles() const
@@ -157,10 +102,9 @@ const std::vector<ParticleEmitter::Particle>& ParticleEmitter::GetParticles() co
 HRESULT ParticleEmitter::OpenCommandList()
 {
 	HRESULT hr = 0;
-	const UINT frameIndex = m_renderingManager->GetFrameIndex();
-	if (SUCCEEDED(hr = this->m_commandAllocator[frameIndex]->Reset()))
+	if (SUCCEEDED(hr = this->m_commandAllocator->Reset()))
 	{
-		if (SUCCEEDED(hr = this->m_commandList[m_renderingManager->GetFrameIndex()]->Reset(this->m_commandAllocator[frameIndex], nullptr)))
+		if (SUCCEEDED(hr = this->m_commandList->Reset(this->m_commandAllocator, nullptr)))
 		{
 
 		}
@@ -171,46 +115,19 @@ HRESULT ParticleEmitter::OpenCommandList()
 HRESULT ParticleEmitter::ExecuteCommandList() const
 {
 	HRESULT hr = 0;
-	if (SUCCEEDED(hr = m_commandList[m_renderingManager->GetFrameIndex()]->Close()))
+	if (SUCCEEDED(hr = m_commandList->Close()))
 	{
-		ID3D12CommandList* ppCommandLists[] = { m_commandList[m_renderingManager->GetFrameIndex()] };
+		ID3D12CommandList* ppCommandLists[] = { m_commandList };
 		m_renderingManager->GetCommandQueue()->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 	}
 	return hr;
 }
 
-const D3D12_VERTEX_BUFFER_VIEW& ParticleEmitter::GetVertexBufferView() const
-{
-	return this->m_vertexBufferView;
-}
-
-void ParticleEmitter::SwitchToVertexState(ID3D12GraphicsCommandList * commandList)
-{
-	const UINT frameIndex = m_renderingManager->GetFrameIndex();
-	if (D3D12_RESOURCE_STATE_UNORDERED_ACCESS == m_currentState[frameIndex])
-		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_vertexOutputResource[frameIndex], D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
-	m_currentState[frameIndex] = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
-
-}
-
-void ParticleEmitter::SwitchToUAVState(ID3D12GraphicsCommandList * commandList)
-{
-	const UINT frameIndex = m_renderingManager->GetFrameIndex();
-	if (D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER == m_currentState[frameIndex])
-		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_vertexOutputResource[frameIndex], D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-	m_currentState[frameIndex] = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-}
-
 void ParticleEmitter::SetTextures(Texture* const* textures)
 {
 	m_textures = textures;
 }
 
-UINT ParticleEmitter::GetVertexSize() const
-{
-	return static_cast<UINT>(this->m_particles->size()) * 6u;
-}
-
 const ParticleEmitter::EmitterSettings& ParticleEmitter::GetSettings() const
 {
 	return this->m_emitterSettings;
@@ -226,165 +143,28 @@ const Texture* const* ParticleEmitter::GetTextures() const
 	return m_textures;
 }
 
-D3D12_CPU_DESCRIPTOR_HANDLE ParticleEmitter::GetVertexCpuDescriptorHandle() const
-{
-	return m_vertexOutputHandle[m_renderingManager->GetFrameIndex()];
-}
-
-D3D12_CPU_DESCRIPTOR_HANDLE ParticleEmitter::GetCalcCpuDescriptorHandle() const
-{
-	return m_calculationsOutputHandle[m_renderingManager->GetFrameIndex()];
-}
-
-X12Fence* const* ParticleEmitter::GetFence() const
-{
-	return m_fences;
-}
-
-
 HRESULT ParticleEmitter::_createCommandList()
 {
 	HRESULT hr = 0;
 
-	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
+	if (FAILED(hr = m_renderingManager->GetMainAdapter()->GetDevice()->CreateCommandAllocator(
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		IID_PPV_ARGS(&m_commandAllocator))))
 	{
-		if (FAILED(hr = m_renderingManager->GetMainAdapter()->GetDevice()->CreateCommandAllocator(
-			D3D12_COMMAND_LIST_TYPE_DIRECT,
-			IID_PPV_ARGS(&m_commandAllocator[i]))))
-		{
-			return hr;
-		}
-		SET_NAME(m_commandAllocator[i], L"Particle CommandAllocator");
-
-		if (SUCCEEDED(hr = m_renderingManager->GetMainAdapter()->GetDevice()->CreateCommandList(
-			0,
-			D3D12_COMMAND_LIST_TYPE_DIRECT,
-			m_commandAllocator[0],
-			nullptr,
-			IID_PPV_ARGS(&m_commandList[i]))))
-		{
-			SET_NAME(m_commandList[i], L"Particle CommandList");
-			m_commandList[i]->Close();
-		}
+		return hr;
 	}
-	return hr;
-}
-
-HRESULT ParticleEmitter::_createBuffer()
-{
-	HRESULT hr = 0;
-
-	D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(MAX_PARTICLES * 6 * sizeof(ParticleVertex));
-	resourceDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-
-	D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_CUSTOM);
-	heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_BACK;
-	heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
-
-
-	X12Adapter * device = m_renderingManager->GetSecondAdapter() ? m_renderingManager->GetSecondAdapter() : m_renderingManager->GetMainAdapter();
-	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
+	SET_NAME(m_commandAllocator, L"Particle CommandAllocator");
+
+	if (SUCCEEDED(hr = m_renderingManager->GetMainAdapter()->GetDevice()->CreateCommandList(
+		0,
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		m_commandAllocator,
+		nullptr,
+		IID_PPV_ARGS(&m_commandList))))
 	{
-		if (SUCCEEDED(hr = device->GetDevice()->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&resourceDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&m_vertexOutputResource[i]))))
-		{
-			m_currentState[i] = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-			SET_NAME(m_vertexOutputResource[i], L"Particle Vertex output");
-
-			D3D12_BUFFER_UAV uav{};
-			uav.NumElements = 256;
-			uav.FirstElement = 0;
-			uav.StructureByteStride = sizeof(DirectX::XMFLOAT4) * 2;
-			uav.CounterOffsetInBytes = 0;
-			uav.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-
-			D3D12_UNORDERED_ACCESS_VIEW_DESC unorderedAccessViewDesc{};
-			unorderedAccessViewDesc.Format = DXGI_FORMAT_UNKNOWN;
-			unorderedAccessViewDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-			unorderedAccessViewDesc.Buffer = uav;
-
-			m_vertexOutputHandle[i] = device->GetNextHandle().DescriptorHandle;
-			
-			device->GetDevice()->CreateUnorderedAccessView(
-				m_vertexOutputResource[i],
-				nullptr,
-				&unorderedAccessViewDesc,
-				m_vertexOutputHandle[i]);
-		}
-		else
-			return hr;
-
-		if (SUCCEEDED(hr = device->GetDevice()->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&resourceDesc,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			nullptr,
-			IID_PPV_ARGS(&m_calculationsOutputResource[i]))))
-		{
-			SET_NAME(m_calculationsOutputResource[i], L"Particle UAV output");
-
-			D3D12_BUFFER_UAV uav{};
-			uav.NumElements = 256;
-			uav.FirstElement = 0;
-			uav.StructureByteStride = sizeof(DirectX::XMFLOAT4) * 2;
-			uav.CounterOffsetInBytes = 0;
-			uav.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-
-			D3D12_UNORDERED_ACCESS_VIEW_DESC unorderedAccessViewDesc{};
-			unorderedAccessViewDesc.Format = DXGI_FORMAT_UNKNOWN;
-			unorderedAccessViewDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-			unorderedAccessViewDesc.Buffer = uav;
-
-			m_calculationsOutputHandle[i] = device->GetNextHandle().DescriptorHandle;			
-
-			device->GetDevice()->CreateUnorderedAccessView(
-				m_calculationsOutputResource[i],
-				nullptr,
-				&unorderedAccessViewDesc,
-				m_calculationsOutputHandle[i]);
-		}
-		else
-			return hr;
-
-		if (SUCCEEDED(hr = m_renderingManager->GetMainAdapter()->GetDevice()->CreateCommittedResource(
-			&heapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&resourceDesc,
-			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
-			nullptr,
-			IID_PPV_ARGS(&m_vertexResource[i]))))
-		{
-			SET_NAME(m_vertexResource[i], L"Particle Vertex");
-
-			D3D12_BUFFER_UAV uav{};
-			uav.NumElements = 256;
-			uav.FirstElement = 0;
-			uav.StructureByteStride = sizeof(DirectX::XMFLOAT4) * 2;
-			uav.CounterOffsetInBytes = 0;
-			uav.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-
-			D3D12_UNORDERED_ACCESS_VIEW_DESC unorderedAccessViewDesc{};
-			unorderedAccessViewDesc.Format = DXGI_FORMAT_UNKNOWN;
-			unorderedAccessViewDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-			unorderedAccessViewDesc.Buffer = uav;
-
-			m_vertexHandle[i] = m_renderingManager->GetMainAdapter()->GetNextHandle().DescriptorHandle;
-
-			m_renderingManager->GetMainAdapter()->GetDevice()->CreateUnorderedAccessView(
-				m_vertexResource[i],
-				nullptr,
-				&unorderedAccessViewDesc,
-				m_vertexHandle[i]);
-		}
-		else
-			return hr;
-	}	
+		SET_NAME(m_commandList, L"Particle CommandList");
+		m_commandList->Close();
+	}
 	return hr;
 }
 
@@ -392,11 +172,19 @@ void ParticleEmitter::_updateParticles(const float & deltaTime)
 {
 	using namespace DirectX;
 
+	UINT maxParticles = static_cast<UINT>(m_emitterSettings.MaxParticles * m_lodScale);
+	if (maxParticles > m_particleLimit)
+		maxParticles = m_particleLimit;
+	if (m_particles->size() > maxParticles)
+		m_particles->erase(m_particles->begin() + maxParticles, m_particles->end());
+
+	const float spawnRate = m_emitterSettings.SpawnRate / m_lodScale;
+
 	m_spawnTimer += deltaTime;
-	while (m_particles->size() < m_emitterSettings.MaxParticles &&  m_spawnTimer >= m_emitterSettings.SpawnRate)
+	while (m_particles->size() < maxParticles &&  m_spawnTimer >= spawnRate)
 	{
 		const XMVECTOR baseSpawn = XMVectorAdd(
-			XMLoadFloat4(&GetPosition()),
+			XMLoadFloat4(&GetWorldPosition()),
 			XMLoadFloat4(&XMFLOAT4(
 				sinf(static_cast<float>(rand())) * m_emitterSettings.SpawnSpread,
 				0,
@@ -427,57 +215,54 @@ void ParticleEmitter::UpdateEmitter(const float & deltaTime)
 	_updateParticles(deltaTime);
 }
 
-void ParticleEmitter::UpdateData(const UINT & frameIndex)
+void ParticleEmitter::UpdateData(const ParticleCalculation * calculations, const UINT & count)
 {
-	using namespace DirectX;
-	
-	const bool copyData = m_renderingManager->GetSecondAdapter();
-
-	if (copyData)
-	{		
-		ParticleVertex * vertexOutputArray = nullptr;
-		CD3DX12_RANGE vertexReadRange(0, sizeof(ParticleVertex) * GetVertexSize());
-		if (SUCCEEDED(m_vertexOutputResource[frameIndex]->Map(0, &vertexReadRange, reinterpret_cast<void**>(&vertexOutputArray))))
-		{
-			UINT8 * targetDest = nullptr;
-			CD3DX12_RANGE readRange(0, 0);
-			if (SUCCEEDED(m_vertexResource[frameIndex]->Map(0, &readRange, reinterpret_cast<void**>(&targetDest))))
-			{
-				memcpy(targetDest, vertexOutputArray, sizeof(ParticleVertex) * GetVertexSize());
-				m_vertexResource[frameIndex]->Unmap(0, &readRange);
-			}
-		
-			m_vertexOutputResource[frameIndex]->Unmap(0, &vertexReadRange);
-		}
+	const size_t size = count < m_particles->size() ? count : m_particles->size();
+	for (size_t i = 0; i < size; i++)
+	{
+		if (calculations[i].Position.x == 0 &&
+			calculations[i].Position.y == 0 &&	//Not quite sure but sometimes the particle position ain't written to in the GPU 
+			calculations[i].Position.z == 0)
+			continue;
+		m_particles->at(i).Position = calculations[i].Position;
+		m_particles->at(i).TimeAlive = calculations[i].ParticleInfo.y;		
 	}
+}
 
-	m_vertexBufferView.BufferLocation = copyData ? m_vertexResource[frameIndex]->GetGPUVirtualAddress() : m_vertexOutputResource[frameIndex]->GetGPUVirtualAddress();
-	m_vertexBufferView.StrideInBytes = sizeof(ParticleVertex);
-	m_vertexBufferView.SizeInBytes = m_vertexBufferView.StrideInBytes * GetVertexSize();
-
-	struct OutputCalculations
+void ParticleEmitter::SortParticles(const unsigned int * order)
+{
+	const size_t size = m_particles->size();
+	m_sortedParticles.clear();
+	m_sortedParticles.reserve(size);
+	for (size_t i = 0; i < size; i++)
 	{
-		DirectX::XMFLOAT4 Position;
-		DirectX::XMFLOAT4 ParticleInfo;
-	};
+		m_sortedParticles.push_back(m_particles->at(order[i]));
+	}
+	m_particles->swap(m_sortedParticles);
+}
 
+void ParticleEmitter::SetLodScale(const float & scale)
+{
+	m_lodScale = scale > 0.0f ? scale : 1.0f;
+}
 
-	OutputCalculations * outputArray = nullptr;
-	CD3DX12_RANGE readRange(0, sizeof(OutputCalculations) * m_particles->size());
-	if (SUCCEEDED(m_calculationsOutputResource[frameIndex]->Map(0, &readRange, reinterpret_cast<void**>(&outputArray))))
-	{
+void ParticleEmitter::SetLodSleeping(const bool & sleeping)
+{
+	m_lodSleeping = sleeping;
+}
 
-		for (size_t i = 0; i < m_particles->size(); i++)
-		{
-			if (outputArray[i].Position.x == 0 &&
-				outputArray[i].Position.y == 0 &&	//Not quite sure but sometimes the particle position ain't written to in the GPU 
-				outputArray[i].Position.z == 0)
-				continue;
-			m_particles->at(i).Position = outputArray[i].Position;
-			m_particles->at(i).TimeAlive = outputArray[i].ParticleInfo.y;		
-		}
-		
-		
-		m_calculationsOutputResource[frameIndex]->Unmap(0, &readRange);
-	}
+bool ParticleEmitter::IsLodSleeping() const
+{
+	return m_lodSleeping;
+}
+
+void ParticleEmitter::SetParticleLimit(const UINT & limit)
+{
+	m_particleLimit = limit;
+}
+
+float ParticleEmitter::GetBoundingRadius() const
+{
+	const float size = m_emitterSettings.Size.x > m_emitterSettings.Size.y ? m_emitterSettings.Size.x : m_emitterSettings.Size.y;
+	return m_emitterSettings.SpawnSpread + m_emitterSettings.Speed * m_emitterSettings.ParticleMaxLife + size;
 }
@@ -2,7 +2,7 @@
 #include "Transform.h"
 
 class X12ShaderResourceView;
-class X12ConstantBuffer;
+struct ParticleCalculation;
 
 #define MAX_PARTICLES 4096
 
@@ -57,12 +57,14 @@ public:
 	void Update() override;
 	void Draw();
 	void UpdateEmitter(const float & deltaTime);
-	void UpdateData(const UINT & frameIndex);
+	void UpdateData(const ParticleCalculation * calculations, const UINT & count);
+	void SortParticles(const unsigned int * order);
 
-	ID3D12Resource * GetVertexResource() const;
-	ID3D12Resource * GetCalcResource() const;
-
-	X12ConstantBuffer * GetParticleBuffer() const;
+	void SetLodScale(const float & scale);
+	void SetLodSleeping(const bool & sleeping);
+	bool IsLodSleeping() const;
+	void SetParticleLimit(const UINT & limit);
+	float GetBoundingRadius() const;
 
 	ID3D12GraphicsCommandList * GetCommandList() const;
 	const std::vector<Particle> & GetParticles() const;
@@ -70,54 +72,31 @@ public:
 	HRESULT OpenCommandList();
 	HRESULT ExecuteCommandList() const;
 
-	const D3D12_VERTEX_BUFFER_VIEW & GetVertexBufferView() const;
-
-	void SwitchToVertexState(ID3D12GraphicsCommandList * commandList);
-	void SwitchToUAVState(ID3D12GraphicsCommandList * commandList);
-
 	void SetTextures(Texture *const* textures);
 
-	UINT GetVertexSize() const;
-
 	const EmitterSettings & GetSettings() const;
 
 	X12ShaderResourceView * GetShaderResourceView() const;
 
 	const Texture *const* GetTextures() const;
 
-	D3D12_CPU_DESCRIPTOR_HANDLE GetVertexCpuDescriptorHandle() const;
-	D3D12_CPU_DESCRIPTOR_HANDLE GetCalcCpuDescriptorHandle() const;
-
-	X12Fence *const* GetFence() const;
-
 private:
 	HRESULT _createCommandList();
-	HRESULT _createBuffer();
 	void _updateParticles(const float & deltaTime);
 
 	EmitterSettings m_emitterSettings {};
 	float m_spawnTimer = 0;
+	float m_lodScale = 1.0f;
+	bool m_lodSleeping = false;
+	UINT m_particleLimit = MAX_PARTICLES;
 	std::vector<Particle> * m_particles = nullptr;
+	std::vector<Particle> m_sortedParticles;
 
-	D3D12_RESOURCE_STATES m_currentState[FRAME_BUFFER_COUNT] {};
-	ID3D12Resource * m_vertexOutputResource[FRAME_BUFFER_COUNT]{ nullptr };
-	D3D12_CPU_DESCRIPTOR_HANDLE m_vertexOutputHandle[FRAME_BUFFER_COUNT]{{0}};
-
-	ID3D12Resource * m_calculationsOutputResource[FRAME_BUFFER_COUNT]{ nullptr };
-	D3D12_CPU_DESCRIPTOR_HANDLE m_calculationsOutputHandle[FRAME_BUFFER_COUNT]{{0}};
-
-	ID3D12Resource * m_vertexResource[FRAME_BUFFER_COUNT]{ nullptr };
-	D3D12_CPU_DESCRIPTOR_HANDLE m_vertexHandle[FRAME_BUFFER_COUNT]{{0}};
-
-	ID3D12GraphicsCommandList * m_commandList[FRAME_BUFFER_COUNT] = { nullptr };
-	ID3D12CommandAllocator * m_commandAllocator[FRAME_BUFFER_COUNT] { nullptr };
-
-	X12Fence * m_fences[FRAME_BUFFER_COUNT]{ nullptr };
+	ID3D12GraphicsCommandList * m_commandList = nullptr;
+	ID3D12CommandAllocator * m_commandAllocator = nullptr;
 
 	RenderingManager * m_renderingManager = nullptr;
 	const Window * m_window = nullptr;
-
-	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView {};
 	
 	X12ShaderResourceView * m_shaderResourceView = nullptr;
 	UINT m_width;
@@ -125,8 +104,6 @@ private:
 	UINT m_arraySize;
 	DXGI_FORMAT m_format;
 
-	X12ConstantBuffer * m_particleBuffer = nullptr;
-
 	Texture *const* m_textures = nullptr;
 };
 
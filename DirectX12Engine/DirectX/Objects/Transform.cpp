@@ -1,5 +1,6 @@
 #include <DirectX12EnginePCH.h>
 #include "Transform.h"
+#include <algorithm>
 
 
 
@@ -10,6 +11,19 @@ Transform::Transform() : IObject()
 
 Transform::~Transform()
 {
+	if (m_sceneNode == SceneGraph::NO_NODE)
+		return;
+
+	//The children stay where they are relative to the parent, now at the origin
+	while (!m_children.empty())
+		m_children.back()->SetParent(nullptr);
+	SetParent(nullptr);
+	SceneGraph::GetInstance()->Destroy(m_sceneNode);
+
+	std::vector<Transform*> & transforms = _sceneTransforms();
+	transforms[m_sceneIndex] = transforms.back();
+	transforms[m_sceneIndex]->m_sceneIndex = m_sceneIndex;
+	transforms.pop_back();
 }
 
 BOOL Transform::Init()
@@ -18,14 +32,24 @@ BOOL Transform::Init()
 	m_scale		= DirectX::XMFLOAT4(1, 1, 1, 1);
 	m_rotation	= DirectX::XMFLOAT4(0, 0, 0, 1);
 
+	m_worldDirty = TRUE;
 	_calcWorldMatrix();
+	_setSceneLocal();
 
 	return TRUE;
 }
 
 void Transform::Update()
 {
-	_calcWorldMatrix();
+	if (m_sceneNode != SceneGraph::NO_NODE)
+	{
+		//Counted with everything else in the graph
+		UpdateSceneGraph();
+		return;
+	}
+	_countMatrixUpdate(m_worldDirty);
+	if (m_worldDirty)
+		_calcWorldMatrix();
 }
 
 void Transform::Release()
@@ -35,7 +59,11 @@ void Transform::Release()
 
 void Transform::SetPosition(const DirectX::XMFLOAT4& position)
 {
+	if (_equal(this->m_position, position))
+		return;
 	this->m_position = position;
+	this->m_worldDirty = TRUE;
+	_setSceneLocal();
 }
 
 void Transform::SetPosition(const float& x, const float& y, const float& z, const float& w)
@@ -61,7 +89,11 @@ void Transform::Translate(const float& x, const float& y, const float& z, const
 
 void Transform::SetRotation(const DirectX::XMFLOAT4& rotation)
 {
+	if (_equal(this->m_rotation, rotation))
+		return;
 	this->m_rotation = rotation;
+	this->m_worldDirty = TRUE;
+	_setSceneLocal();
 }
 
 void Transform::SetRotation(const float& x, const float& y, const float& z, const float& w)
@@ -71,7 +103,11 @@ void Transform::SetRotation(const float& x, const float& y, const float& z, cons
 
 void Transform::SetScale(const DirectX::XMFLOAT4& scale)
 {
+	if (_equal(this->m_scale, scale))
+		return;
 	this->m_scale = scale;
+	this->m_worldDirty = TRUE;
+	_setSceneLocal();
 }
 
 void Transform::SetScale(const float& x, const float& y, const float& z, const float& w)
@@ -99,6 +135,57 @@ const DirectX::XMFLOAT4X4A& Transform::GetWorldMatrix() const
 	return this->m_worldMatrix;
 }
 
+BOOL Transform::SetParent(Transform* parent)
+{
+	if (parent == m_parent)
+		return TRUE;
+	for (const Transform * ancestor = parent; ancestor; ancestor = ancestor->m_parent)
+	{
+		if (ancestor == this)
+			return FALSE;
+	}
+
+	_createSceneNode();
+	if (parent)
+		parent->_createSceneNode();
+	SceneGraph::GetInstance()->SetParent(m_sceneNode, parent ? parent->m_sceneNode : static_cast<SceneGraph::Node>(SceneGraph::NO_NODE));
+
+	if (m_parent)
+	{
+		std::vector<Transform*> & siblings = m_parent->m_children;
+		siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+	}
+	m_parent = parent;
+	if (parent)
+		parent->m_children.push_back(this);
+	return TRUE;
+}
+
+Transform* Transform::GetParent() const
+{
+	return this->m_parent;
+}
+
+const DirectX::XMFLOAT4& Transform::GetWorldPosition() const
+{
+	return m_sceneNode != SceneGraph::NO_NODE ? this->m_worldPosition : this->m_position;
+}
+
+size_t Transform::UpdateSceneGraph()
+{
+	SceneGraph * sceneGraph = SceneGraph::GetInstance();
+	if (!sceneGraph->IsDirty())
+		return 0;
+
+	const size_t rebuilt = sceneGraph->Update();
+	std::vector<Transform*> & transforms = _sceneTransforms();
+	for (size_t i = 0; i < transforms.size(); i++)
+		transforms[i]->_copySceneWorld();
+	if (rebuilt)
+		_countMatrixUpdate(TRUE, rebuilt);
+	return rebuilt;
+}
+
 void Transform::_calcWorldMatrix()
 {
 	using namespace DirectX;
@@ -108,4 +195,74 @@ void Transform::_calcWorldMatrix()
 	const XMMATRIX translation = XMMatrixTranslationFromVector(XMLoadFloat4(&this->m_position));
 	
 	XMStoreFloat4x4A(&this->m_worldMatrix, XMMatrixTranspose(scale * rotation * translation));
+	this->m_worldDirty = FALSE;
+	this->m_worldVersion++;
+}
+
+const UINT64& Transform::p_getWorldVersion() const
+{
+	return this->m_worldVersion;
+}
+
+BOOL Transform::p_inSceneGraph() const
+{
+	return m_sceneNode != SceneGraph::NO_NODE;
+}
+
+void Transform::p_sceneWorldChanged()
+{
+}
+
+void Transform::_createSceneNode()
+{
+	if (m_sceneNode != SceneGraph::NO_NODE)
+		return;
+	m_sceneNode = SceneGraph::GetInstance()->Create();
+	_setSceneLocal();
+	m_sceneIndex = _sceneTransforms().size();
+	_sceneTransforms().push_back(this);
+}
+
+void Transform::_setSceneLocal() const
+{
+	if (m_sceneNode != SceneGraph::NO_NODE)
+		SceneGraph::GetInstance()->SetLocal(m_sceneNode, m_position, m_rotation, m_scale);
+}
+
+void Transform::_copySceneWorld()
+{
+	using namespace DirectX;
+
+	const SceneGraph * sceneGraph = SceneGraph::GetInstance();
+	const UINT version = sceneGraph->GetWorldVersion(m_sceneNode);
+	if (version == m_sceneVersion)
+		return;
+	m_sceneVersion = version;
+
+	//The graph keeps the matrices untransposed
+	const XMFLOAT4X4A & world = sceneGraph->GetWorld(m_sceneNode);
+	XMStoreFloat4x4A(&this->m_worldMatrix, XMMatrixTranspose(XMLoadFloat4x4A(&world)));
+	m_worldPosition = XMFLOAT4(world._41, world._42, world._43, 1.0f);
+	m_worldDirty = FALSE;
+	m_worldVersion++;
+	p_sceneWorldChanged();
+}
+
+std::vector<Transform*>& Transform::_sceneTransforms()
+{
+	static std::vector<Transform*> transforms;
+	return transforms;
+}
+
+BOOL Transform::_equal(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+void Transform::_countMatrixUpdate(const BOOL& updated, const UINT64& count)
+{
+	//Objects made before the rendering manager is initialized are not counted
+	FrameStatsRecorder * frameStats = RenderingManager::GetInstance()->GetFrameStats();
+	if (frameStats)
+		frameStats->Add(updated ? FrameStats::MATRIX_UPDATES : FrameStats::MATRIX_UPDATES_SKIPPED, count);
 }
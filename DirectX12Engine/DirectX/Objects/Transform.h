@@ -1,12 +1,20 @@
 #pragma once
 #include "Template/IObject.h"
 #include <DirectXMath.h>
+#include <vector>
+#include "../Render/WrapperFunctions/Functions/SceneGraph.h"
+
+// A transform with a parent lives in the SceneGraph, its world matrix is its own matrix times the world matrix of
+// the parent and is rebuilt with the rest of the graph in UpdateSceneGraph
 class Transform : //NOLINT
 	public IObject
 {
 public:
 	Transform();
 	~Transform();
+	//The scene graph node belongs to one transform
+	Transform(const Transform &) = delete;
+	Transform & operator=(const Transform &) = delete;
 
 	BOOL Init() override;
 	void Update() override;
@@ -30,15 +38,55 @@ public:
 
 	virtual const DirectX::XMFLOAT4X4A & GetWorldMatrix() const;
 
+	// The transform follows the parent and keeps its own position, rotation and scale relative to it, nullptr detaches it.
+	// Returns FALSE when the parent is below the transform
+	BOOL SetParent(Transform * parent);
+	Transform * GetParent() const;
+
+	// The translation of the world matrix, the same as the position unless the transform has a parent
+	const DirectX::XMFLOAT4 & GetWorldPosition() const;
+
+	// Rebuilds the scene graph when anything in it changed and hands the new world matrices to their transforms
+	static size_t UpdateSceneGraph();
+
 private:
 	DirectX::XMFLOAT4 m_position	= DirectX::XMFLOAT4(0, 0, 0, 1);
 	DirectX::XMFLOAT4 m_scale		= DirectX::XMFLOAT4(1, 1, 1, 1);
 	DirectX::XMFLOAT4 m_rotation	= DirectX::XMFLOAT4(0, 0, 0, 1);
 
 	DirectX::XMFLOAT4X4A m_worldMatrix;
+
+	//Set by the setters when a value changes, Update only rebuilds the matrix when it is set
+	BOOL m_worldDirty = TRUE;
+	UINT64 m_worldVersion = 0;
+
+	//Made the first time the transform is a parent or gets one, kept until it is destroyed
+	SceneGraph::Node m_sceneNode = SceneGraph::NO_NODE;
+	UINT m_sceneVersion = 0;
+	size_t m_sceneIndex = 0;
+	Transform * m_parent = nullptr;
+	std::vector<Transform*> m_children;
+	DirectX::XMFLOAT4 m_worldPosition = DirectX::XMFLOAT4(0, 0, 0, 1);
+
+	void _createSceneNode();
+	void _setSceneLocal() const;
+	void _copySceneWorld();
+	static std::vector<Transform*> & _sceneTransforms();
 protected:
 
 	void _calcWorldMatrix();
+
+	//Changes every time the world matrix is rebuilt, matrices made from the transform can tell if they are stale
+	const UINT64 & p_getWorldVersion() const;
+
+	//Once it is in the scene graph the world matrix comes from there
+	BOOL p_inSceneGraph() const;
+	//Called when the scene graph rebuilt the world matrix
+	virtual void p_sceneWorldChanged();
+
+	static BOOL _equal(const DirectX::XMFLOAT4 & a, const DirectX::XMFLOAT4 & b);
+	//Counts a matrix as rebuilt or as skipped because nothing it is made from changed
+	static void _countMatrixUpdate(const BOOL & updated, const UINT64 & count = 1);
 	
 };
 
@@ -1,10 +1,11 @@
 #include "DirectX12EnginePCH.h"
 #include "DeferredRender.h"
+#include "WrapperFunctions/X12PipelineStateCache.h"
 #include "WrapperFunctions/X12RenderTargetView.h"
 #include "WrapperFunctions/RenderingHelpClass.h"
 #include "WrapperFunctions/X12ConstantBuffer.h"
-#include "WrapperFunctions/X12ShaderResourceView.h"
-#include "WrapperFunctions/X12BindlessTexture.h"
+#include "WrapperFunctions/X12DepthStencil.h"
+#include "../Objects/Light/LightRegistry.h"
 
 #define SHADOW_SPACE	1
 #define LIGHT_SPACE		2
@@ -24,6 +25,11 @@
 
 #define LIGHT_BUFFER 8
 #define LIGHT_TABLE 9
+#define CLUSTER_RANGES 11
+#define LIGHT_INDICES 12
+
+static const ShaderCreator::ShaderDesc VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/DeferredPass/DefaultDeferredVertex.hlsl", "vs_5_1" };
+static const ShaderCreator::ShaderDesc PIXEL_SHADER{ L"../DirectX12Engine/DirectX/Shaders/DeferredPass/DefaultDeferredPixel.hlsl", "ps_5_1" };
 
 DeferredRender::DeferredRender(RenderingManager* renderingManager, const Window& window)
 	: IRender(renderingManager, window)
@@ -35,8 +41,9 @@ DeferredRender::DeferredRender(RenderingManager* renderingManager, const Window&
 
 	SAFE_NEW(m_lightBuffer, new X12ConstantBuffer());
 	SAFE_NEW(m_lightTable, new X12ConstantBuffer());
+	SAFE_NEW(m_clusterRanges, new X12ConstantBuffer());
+	SAFE_NEW(m_lightIndices, new X12ConstantBuffer());
 	SAFE_NEW(m_shadowBuffer, new X12ConstantBuffer());
-	SAFE_NEW(m_shaderResourceView, new X12ShaderResourceView());
 	SAFE_NEW(m_shadowStructuredBuffer, new X12ConstantBuffer());
 
 
@@ -62,6 +69,15 @@ HRESULT DeferredRender::Init()
 	return hr;
 }
 
+void DeferredRender::QueueShaders()
+{
+	ShaderCreator::QueueShader(VERTEX_SHADER);
+	for (UINT i = 0; i < PERMUTATIONS; i++)
+	{
+		ShaderCreator::QueueShader(PIXEL_SHADER, ShaderPermutation::FromIndex(i, ShaderPermutation::DEFERRED_FEATURES));
+	}
+}
+
 void DeferredRender::Update(const Camera& camera, const float& deltaTime)
 {
 	if (FAILED(p_renderingManager->GetPassFence(SHADOW_PASS)->WaitGgu(p_renderingManager->GetCommandQueue())))
@@ -74,16 +90,18 @@ void DeferredRender::Update(const Camera& camera, const float& deltaTime)
 
 	commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
 
-	commandList->SetPipelineState(m_pipelineState);
+	const ShaderPermutation::Key permutation = _copyLightData(camera);
+
+	commandList->SetPipelineState(m_pipelineStates[ShaderPermutation::Index(permutation, ShaderPermutation::DEFERRED_FEATURES)]);
 	commandList->SetGraphicsRootSignature(m_rootSignature);
 	commandList->RSSetViewports(1, &m_viewport);
 	commandList->RSSetScissorRects(1, &m_rect);
 	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 	
-
-	_copyLightData(camera);
 	m_lightBuffer->SetGraphicsRootConstantBufferView(commandList, LIGHT_BUFFER, 0);
 	m_lightTable->SetGraphicsRootShaderResourceView(commandList, LIGHT_TABLE, 0);
+	m_clusterRanges->SetGraphicsRootShaderResourceView(commandList, CLUSTER_RANGES, 0);
+	m_lightIndices->SetGraphicsRootShaderResourceView(commandList, LIGHT_INDICES, 0);
 
 	for (UINT i = 0; i < this->m_renderTargetSize; i++)
 	{
@@ -101,12 +119,14 @@ void DeferredRender::Update(const Camera& camera, const float& deltaTime)
 	for (size_t i = 0; i < m_shadowMaps->size(); i++)
 	{
 		matrixBuffer.Size.x = m_shadowMaps->at(i)->ViewProjectionSize;
+		//Cascades overlap, the shader only reads the first one holding the fragment
+		matrixBuffer.Size.y = m_shadowMaps->at(i)->Light->GetType() == 1 ? 1 : 0;
 		matrixBuffer.lightValues.x = m_shadowMaps->at(i)->Light->GetIntensity();
 		for (UINT j = 0; j < m_shadowMaps->at(i)->ViewProjectionSize; j++)
 		{
 			matrixBuffer.ViewProjection[j] = m_shadowMaps->at(i)->ViewProjection[j];
+			matrixBuffer.AtlasRect[j] = m_shadowMaps->at(i)->AtlasRect[j];
 		}
-		m_bindlessTexture->PushBackCpuHandle(m_shadowMaps->at(i)->CpuHandle);
 
 		m_shadowStructuredBuffer->Copy(&matrixBuffer, sizeof(ShadowLightMatrixBuffer), offset);
 		offset += sizeof(ShadowLightMatrixBuffer);
@@ -117,9 +137,11 @@ void DeferredRender::Update(const Camera& camera, const float& deltaTime)
 	m_shadowBuffer->SetGraphicsRootConstantBufferView(commandList, SHADOW_BUFFER, 0);
 	m_shadowStructuredBuffer->SetGraphicsRootShaderResourceView(commandList, SHADOW_STRUCTURED_BUFFER, 0);
 
-
-	m_bindlessTexture->SetGraphicsRootDescriptorTable(commandList, SHADOW_TEXTURE);
-	m_bindlessTexture->ResetDescriptorHandle();
+	if (m_shadowAtlas)
+	{
+		m_shadowAtlas->CopyDescriptorHeap();
+		m_shadowAtlas->SetGraphicsRootDescriptorTable(commandList, SHADOW_TEXTURE);
+	}
 
 	if (m_ssao)
 	{
@@ -141,6 +163,7 @@ void DeferredRender::Draw()
 	commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
 
 	commandList->DrawInstanced(4, 1, 0, 0);
+	p_countDraw(4, 1, D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 }
 
 void DeferredRender::Clear()
@@ -157,7 +180,10 @@ void DeferredRender::Clear()
 
 void DeferredRender::Release()
 {
-	SAFE_RELEASE(m_pipelineState);
+	for (UINT i = 0; i < PERMUTATIONS; i++)
+	{
+		SAFE_RELEASE(m_pipelineStates[i]);
+	}
 	SAFE_RELEASE(m_rootSignature);
 
 	SAFE_RELEASE(m_vertexBuffer);
@@ -173,9 +199,13 @@ void DeferredRender::Release()
 		m_lightTable->Release();
 	SAFE_DELETE(m_lightTable);
 
-	if (m_shaderResourceView)
-		m_shaderResourceView->Release();
-	SAFE_DELETE(m_shaderResourceView);
+	if (m_clusterRanges)
+		m_clusterRanges->Release();
+	SAFE_DELETE(m_clusterRanges);
+
+	if (m_lightIndices)
+		m_lightIndices->Release();
+	SAFE_DELETE(m_lightIndices);
 
 	if (m_shadowStructuredBuffer)
 		m_shadowStructuredBuffer->Release();
@@ -184,8 +214,6 @@ void DeferredRender::Release()
 	if (m_shadowBuffer)
 		m_shadowBuffer->Release();
 	SAFE_DELETE(m_shadowBuffer);
-
-	SAFE_DELETE(m_bindlessTexture);
 }
 
 void DeferredRender::SetRenderTarget(X12RenderTargetView** renderTarget, const UINT& size)
@@ -199,22 +227,27 @@ void DeferredRender::SetReflection(X12RenderTargetView* renderTarget)
 	this->m_reflection = renderTarget;
 }
 
-void DeferredRender::AddShadowMap(const D3D12_CPU_DESCRIPTOR_HANDLE& cpuDescriptorHandle,
-	DirectX::XMFLOAT4X4A const* viewProjection, const UINT& size, ILight * light) const
+void DeferredRender::AddShadowMap(DirectX::XMFLOAT4X4A const* viewProjection, 
+	DirectX::XMFLOAT4 const* atlasRect, const UINT& size, ILight * light) const
 {
 	ShadowMap* sm = nullptr;
 	SAFE_NEW(sm, new ShadowMap());
-	sm->CpuHandle = cpuDescriptorHandle;
 	sm->ViewProjectionSize = size;
 	sm->Light = light;
 	for (UINT i = 0; i < size; i++)
 	{
 		sm->ViewProjection[i] = viewProjection[i];
+		sm->AtlasRect[i] = atlasRect[i];
 	}
 	m_shadowMaps->push_back(sm);
 
 }
 
+void DeferredRender::SetShadowAtlas(X12DepthStencil* shadowAtlas)
+{
+	this->m_shadowAtlas = shadowAtlas;
+}
+
 void DeferredRender::SetSSAO(X12RenderTargetView* renderTarget)
 {
 	this->m_ssao = renderTarget;
@@ -259,11 +292,27 @@ HRESULT DeferredRender::_preInit()
 	if (FAILED(hr = m_lightTable->CreateBuffer(
 		L"LightTable",
 		nullptr,
-		sizeof(LightStructuredBuffer),
-		1024 * 64)))
+		sizeof(LightRegistry::GpuLight),
+		MAX_LIGHTS * sizeof(LightRegistry::GpuLight))))
 	{		
 		return hr;
 	}
+	if (FAILED(hr = m_clusterRanges->CreateBuffer(
+		L"Light cluster ranges",
+		nullptr,
+		0,
+		LightClusterBuilder::CLUSTER_COUNT * sizeof(LightClusterBuilder::Range))))
+	{
+		return hr;
+	}
+	if (FAILED(hr = m_lightIndices->CreateBuffer(
+		L"Light cluster indices",
+		nullptr,
+		0,
+		MAX_LIGHT_INDICES * sizeof(UINT))))
+	{
+		return hr;
+	}
 	if (FAILED(hr = m_shadowBuffer->CreateBuffer(
 		L"Deferred Shadow matrix", 
 		nullptr, 
@@ -280,16 +329,6 @@ HRESULT DeferredRender::_preInit()
 	{
 		return hr;
 	}
-	if (FAILED(hr = m_shaderResourceView->CreateShaderResourceView(
-		SHADOW_MAP_SIZE,
-		SHADOW_MAP_SIZE,
-		MAX_SHADOWS,
-		DXGI_FORMAT_R32_FLOAT)))
-	{
-		return hr;
-	}
-	SAFE_NEW(m_bindlessTexture, new X12BindlessTexture());
-				
 	return hr;
 }
 
@@ -317,7 +356,7 @@ HRESULT DeferredRender::_initID3D12RootSignature()
 
 	D3D12_DESCRIPTOR_RANGE shadowRangeTable;
 	D3D12_ROOT_DESCRIPTOR_TABLE shadowTable;
-	RenderingHelpClass::CreateRootDescriptorTable(shadowRangeTable, shadowTable, 1, SHADOW_SPACE, -1);
+	RenderingHelpClass::CreateRootDescriptorTable(shadowRangeTable, shadowTable, 1, SHADOW_SPACE);
 
 	D3D12_DESCRIPTOR_RANGE ssaoRangeTable;
 	D3D12_ROOT_DESCRIPTOR_TABLE ssaoTable;
@@ -331,6 +370,14 @@ HRESULT DeferredRender::_initID3D12RootSignature()
 	LightTable.RegisterSpace = LIGHT_SPACE;
 	LightTable.ShaderRegister = 0;
 
+	D3D12_ROOT_DESCRIPTOR clusterRanges;
+	clusterRanges.RegisterSpace = LIGHT_SPACE;
+	clusterRanges.ShaderRegister = 1;
+
+	D3D12_ROOT_DESCRIPTOR lightIndices;
+	lightIndices.RegisterSpace = LIGHT_SPACE;
+	lightIndices.ShaderRegister = 2;
+
 	D3D12_ROOT_DESCRIPTOR shadowRootDescriptor;
 	shadowRootDescriptor.RegisterSpace = SHADOW_SPACE;
 	shadowRootDescriptor.ShaderRegister = 0;
@@ -383,6 +430,14 @@ HRESULT DeferredRender::_initID3D12RootSignature()
 	m_rootParameters[SHADOW_STRUCTURED_BUFFER].Descriptor = shadowStructuredBuffer;
 	m_rootParameters[SHADOW_STRUCTURED_BUFFER].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+	m_rootParameters[CLUSTER_RANGES].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	m_rootParameters[CLUSTER_RANGES].Descriptor = clusterRanges;
+	m_rootParameters[CLUSTER_RANGES].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+	m_rootParameters[LIGHT_INDICES].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	m_rootParameters[LIGHT_INDICES].Descriptor = lightIndices;
+	m_rootParameters[LIGHT_INDICES].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
 	D3D12_STATIC_SAMPLER_DESC sampler{};
 	RenderingHelpClass::CreateSampler(sampler, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
 
@@ -415,11 +470,10 @@ HRESULT DeferredRender::_initID3D12RootSignature()
 		&signature,
 		nullptr)))
 	{
-		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateRootSignature(
-			0,
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateRootSignature(
 			signature->GetBufferPointer(),
 			signature->GetBufferSize(),
-			IID_PPV_ARGS(&m_rootSignature))))
+			&m_rootSignature)))
 		{
 			SAFE_RELEASE(m_rootSignature);
 		}
@@ -433,7 +487,7 @@ HRESULT DeferredRender::_initShaders()
 	HRESULT hr;
 	ID3DBlob* blob = nullptr;
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/DeferredPass/DefaultDeferredVertex.hlsl", blob, "vs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(VERTEX_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -443,14 +497,14 @@ HRESULT DeferredRender::_initShaders()
 		m_vertexShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/DeferredPass/DefaultDeferredPixel.hlsl", blob, "ps_5_1")))
+	for (UINT i = 0; i < PERMUTATIONS; i++)
 	{
-		return hr;
-	}
-	else
-	{
-		m_pixelShader.BytecodeLength = blob->GetBufferSize();
-		m_pixelShader.pShaderBytecode = blob->GetBufferPointer();
+		if (FAILED(hr = ShaderCreator::CreateShader(PIXEL_SHADER, blob, ShaderPermutation::FromIndex(i, ShaderPermutation::DEFERRED_FEATURES))))
+		{
+			return hr;
+		}
+		m_pixelShader[i].BytecodeLength = blob->GetBufferSize();
+		m_pixelShader[i].pShaderBytecode = blob->GetBufferPointer();
 	}
 	return hr;
 }
@@ -473,7 +527,6 @@ HRESULT DeferredRender::_initID3D12PipelineState()
 	graphicsPipelineStateDesc.InputLayout = m_inputLayoutDesc;
 	graphicsPipelineStateDesc.pRootSignature = m_rootSignature;
 	graphicsPipelineStateDesc.VS = m_vertexShader;
-	graphicsPipelineStateDesc.PS = m_pixelShader;
 	graphicsPipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 	graphicsPipelineStateDesc.NumRenderTargets = 1;
 	graphicsPipelineStateDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -489,11 +542,16 @@ HRESULT DeferredRender::_initID3D12PipelineState()
 	else
 		return hr;
 
-	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateGraphicsPipelineState(
-			&graphicsPipelineStateDesc,
-			IID_PPV_ARGS(&m_pipelineState))))
+	for (UINT i = 0; i < PERMUTATIONS; i++)
 	{
-		SAFE_RELEASE(m_pipelineState);
+		graphicsPipelineStateDesc.PS = m_pixelShader[i];
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateGraphicsPipelineState(
+				graphicsPipelineStateDesc,
+				&m_pipelineStates[i])))
+		{
+			SAFE_RELEASE(m_pipelineStates[i]);
+			return hr;
+		}
 	}
 
 	return hr;
@@ -554,47 +612,70 @@ HRESULT DeferredRender::_createQuadBuffer()
 	return hr;
 }
 
-void DeferredRender::_copyLightData(const Camera& camera) const
+ShaderPermutation::Key DeferredRender::_copyLightData(const Camera& camera)
 {
-	LightStructuredBuffer values;
-
-	PointLight * pl;
-	DirectionalLight * dl;
+	const LightRegistry::PointLights & pointLights = p_renderingManager->GetLightRegistry()->GetPointLights();
+	const LightRegistry::DirectionalLights & directionalLights = p_renderingManager->GetLightRegistry()->GetDirectionalLights();
 
 	struct L_BUFFER
 	{
 		DirectX::XMFLOAT4 CameraPos;
-		DirectX::XMUINT4 NumLights;
+		DirectX::XMUINT4 NumLights;	//X = lights in the table Y = directional lights at the end of the table
+		DirectX::XMFLOAT4X4A ViewMatrix;
+		DirectX::XMUINT4 ClusterSize;
+		DirectX::XMFLOAT4 ClusterDepth;	//X = slice scale Y = slice bias
 	} lBuffer;
 
+	const UINT pointLightSize = pointLights.Table.size() < MAX_LIGHTS ? static_cast<UINT>(pointLights.Table.size()) : MAX_LIGHTS;
+	const UINT directionalLightSize = directionalLights.Table.size() < MAX_LIGHTS - pointLightSize ? static_cast<UINT>(directionalLights.Table.size()) : MAX_LIGHTS - pointLightSize;
+
+	if (pointLightSize)
+		m_lightTable->Copy(pointLights.Table.data(), pointLightSize * sizeof(LightRegistry::GpuLight));
+	if (directionalLightSize)
+		m_lightTable->Copy(directionalLights.Table.data(), directionalLightSize * sizeof(LightRegistry::GpuLight), pointLightSize * sizeof(LightRegistry::GpuLight));
+
 	lBuffer.CameraPos = camera.GetPosition();
-	lBuffer.NumLights.x = static_cast<UINT>(p_lightQueue->size());
+	lBuffer.NumLights = DirectX::XMUINT4(pointLightSize + directionalLightSize, directionalLightSize, 0, 0);
+	lBuffer.ViewMatrix = camera.GetViewMatrix();
+	lBuffer.ClusterSize = DirectX::XMUINT4(
+		LightClusterBuilder::TILES_X, 
+		LightClusterBuilder::TILES_Y, 
+		LightClusterBuilder::DEPTH_SLICES, 
+		0);
+
+	_buildLightClusters(camera, pointLightSize);
+	m_lightClusterBuilder.GetSliceScaleBias(lBuffer.ClusterDepth.x, lBuffer.ClusterDepth.y);
 
 	m_lightBuffer->Copy(&lBuffer, sizeof(lBuffer));
 
-	for (UINT i = 0; i < p_lightQueue->size(); i++)
-	{
-		values.Position = p_lightQueue->at(i)->GetPosition();
-		values.Color = p_lightQueue->at(i)->GetColor();
+	return ShaderPermutation::SelectDeferred(pointLightSize, directionalLightSize);
+}
 
-		values.Type.x = p_lightQueue->at(i)->GetType();
-		values.Type.y = p_lightQueue->at(i)->GetType();
-		values.Type.z = p_lightQueue->at(i)->GetType();
-		values.Type.w = p_lightQueue->at(i)->GetType();
+void DeferredRender::_buildLightClusters(const Camera& camera, const UINT & pointLights)
+{
+	const LightRegistry::PointLights & registry = p_renderingManager->GetLightRegistry()->GetPointLights();
 
-		if ((pl = dynamic_cast<PointLight*>(p_lightQueue->at(i))))
-		{
-			values.PointLight = DirectX::XMFLOAT4(pl->GetIntensity(), pl->GetDropOff(), pl->GetPow(), pl->GetRadius());
-		}
-		if ((dl = dynamic_cast<DirectionalLight*>(p_lightQueue->at(i))))
-		{
-			values.Direction = DirectX::XMFLOAT4A(
-				dl->GetCamera()->GetDirection().x,
-				dl->GetCamera()->GetDirection().y,
-				dl->GetCamera()->GetDirection().z,
-				p_lightQueue->at(i)->GetIntensity());
-		
-		}
-		m_lightTable->Copy(&values, sizeof(LightStructuredBuffer), i * sizeof(LightStructuredBuffer));
-	}
+	const LightClusterBuilder::Frustum frustum = 
+	{
+		&camera.GetViewMatrix()._11,
+		camera.GetFov(),
+		camera.GetAspectRatio(),
+		camera.GetNearPlane(),
+		camera.GetFarPlane()
+	};
+	const LightClusterBuilder::PointLights clusterLights = 
+	{
+		registry.X.data(),
+		registry.Y.data(),
+		registry.Z.data(),
+		registry.Radius.data(),
+		pointLights
+	};
+	m_lightClusterBuilder.Build(frustum, clusterLights);
+
+	//Point lights sit first in the light table so the builder's indices are table indices
+	const std::vector<UINT> & indices = m_lightClusterBuilder.GetLightIndices();
+	if (!indices.empty())
+		m_lightIndices->Copy(indices.data(), static_cast<UINT>(indices.size() * sizeof(UINT)));
+	m_clusterRanges->Copy(m_lightClusterBuilder.GetClusterRanges().data(), LightClusterBuilder::CLUSTER_COUNT * sizeof(LightClusterBuilder::Range));
 }
@@ -1,29 +1,21 @@
 #pragma once
 #include "Template/IRender.h"
+#include "WrapperFunctions/Functions/LightClusterBuilder.h"
 
 class X12ConstantBuffer;
 class X12RenderTargetView;
-class X12ShaderResourceView;
-class X12BindlessTexture;
+class X12DepthStencil;
 
 constexpr auto MAX_SHADOWS = 1024u;
+constexpr auto MAX_LIGHTS = 16384u;
+constexpr auto MAX_LIGHT_INDICES = 1024u * 1024u;
 
 class DeferredRender : public IRender
 {
 private:
-	static const UINT ROOT_PARAMETERS = 11;
-
-	struct LightStructuredBuffer
-	{
-		DirectX::XMUINT4 Type;
-		DirectX::XMFLOAT4	Position;
-		DirectX::XMFLOAT4	Color;
-		union
-		{
-			DirectX::XMFLOAT4	Direction;
-			DirectX::XMFLOAT4	PointLight;			
-		};
-	};
+	static const UINT ROOT_PARAMETERS = 13;
+	//One pipeline per combination of light types in the scene
+	static const UINT PERMUTATIONS = ShaderPermutation::Count(ShaderPermutation::DEFERRED_FEATURES);
 
 	struct ShadowLightBuffer
 	{
@@ -34,13 +26,14 @@ private:
 		DirectX::XMUINT4 Size;
 		DirectX::XMFLOAT4 lightValues;
 		DirectX::XMFLOAT4X4A ViewProjection[6];
+		DirectX::XMFLOAT4 AtlasRect[6];
 	};
 
 	struct ShadowMap
 	{
-		D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle;
 		UINT ViewProjectionSize;
 		DirectX::XMFLOAT4X4A ViewProjection[6];
+		DirectX::XMFLOAT4 AtlasRect[6];
 		ILight * Light;
 	};
 
@@ -48,6 +41,8 @@ public:
 	DeferredRender(RenderingManager * renderingManager, const Window & window);
 	~DeferredRender();
 
+	static void QueueShaders();
+
 
 	HRESULT Init() override;
 	void Update(const Camera& camera, const float & deltaTime) override;
@@ -57,7 +52,8 @@ public:
 
 	void SetRenderTarget(X12RenderTargetView ** renderTarget, const UINT & size);
 	void SetReflection(X12RenderTargetView * renderTarget);
-	void AddShadowMap(const D3D12_CPU_DESCRIPTOR_HANDLE & cpuDescriptorHandle, DirectX::XMFLOAT4X4A const* viewProjection, const UINT & size, ILight * light) const;
+	void AddShadowMap(DirectX::XMFLOAT4X4A const* viewProjection, DirectX::XMFLOAT4 const* atlasRect, const UINT & size, ILight * light) const;
+	void SetShadowAtlas(X12DepthStencil * shadowAtlas);
 
 	void SetSSAO(X12RenderTargetView * renderTarget);
 
@@ -71,7 +67,9 @@ private:
 
 	HRESULT _createQuadBuffer();
 
-	void _copyLightData(const Camera& camera) const;
+	// Returns the shader variant for the lights that were copied
+	ShaderPermutation::Key _copyLightData(const Camera& camera);
+	void _buildLightClusters(const Camera& camera, const UINT & pointLights);
 
 	D3D12_VERTEX_BUFFER_VIEW		m_vertexBufferView{};
 	ID3D12Resource *				m_vertexBuffer = nullptr;
@@ -80,12 +78,12 @@ private:
 	D3D12_VIEWPORT	m_viewport{};
 	D3D12_RECT		m_rect{};
 
-	ID3D12PipelineState * m_pipelineState = nullptr;
+	ID3D12PipelineState * m_pipelineStates[PERMUTATIONS] = { nullptr };
 	ID3D12RootSignature * m_rootSignature = nullptr;
 	D3D12_ROOT_PARAMETER  m_rootParameters[ROOT_PARAMETERS]{};
 
 	D3D12_SHADER_BYTECODE m_vertexShader{};
-	D3D12_SHADER_BYTECODE m_pixelShader{};
+	D3D12_SHADER_BYTECODE m_pixelShader[PERMUTATIONS]{};
 	D3D12_INPUT_LAYOUT_DESC  m_inputLayoutDesc{};
 
 	UINT m_renderTargetSize = 0;
@@ -95,12 +93,15 @@ private:
 
 	X12ConstantBuffer * m_lightBuffer = nullptr;
 	X12ConstantBuffer * m_lightTable = nullptr;
+	X12ConstantBuffer * m_clusterRanges = nullptr;
+	X12ConstantBuffer * m_lightIndices = nullptr;
+
+	LightClusterBuilder m_lightClusterBuilder{ MAX_LIGHT_INDICES };
 
 	X12ConstantBuffer * m_shadowBuffer = nullptr;
 	X12ConstantBuffer * m_shadowStructuredBuffer = nullptr;
 
-	X12ShaderResourceView * m_shaderResourceView = nullptr;
-	X12BindlessTexture * m_bindlessTexture = nullptr;
+	X12DepthStencil * m_shadowAtlas = nullptr;
 
 	
 
@@ -1,5 +1,6 @@
 #include "DirectX12EnginePCH.h"
 #include "GeometryPass.h"
+#include "WrapperFunctions/X12PipelineStateCache.h"
 #include "WrapperFunctions/RenderingHelpClass.h"
 #include "WrapperFunctions/X12DepthStencil.h"
 #include "WrapperFunctions/X12ConstantBuffer.h"
@@ -8,6 +9,14 @@
 #include "WrapperFunctions/X12ShaderResourceView.h"
 #include "SSAOPass.h"
 #include "ReflectionPass.h"
+#include "ParticlePass.h"
+
+static const ShaderCreator::ShaderDesc VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryVertex.hlsl", "vs_5_1" };
+static const ShaderCreator::ShaderDesc HULL_SHADER{ L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryHull.hlsl", "hs_5_1" };
+static const ShaderCreator::ShaderDesc DOMAIN_SHADER{ L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryDomain.hlsl", "ds_5_1" };
+static const ShaderCreator::ShaderDesc PIXEL_SHADER{ L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryPixel.hlsl", "ps_5_1" };
+static const ShaderCreator::ShaderDesc PARTICLE_VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryParticleVertex.hlsl", "vs_5_1" };
+static const ShaderCreator::ShaderDesc PARTICLE_PIXEL_SHADER{ L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryParticlePixel.hlsl", "ps_5_1" };
 
 GeometryPass::GeometryPass(RenderingManager * renderingManager, 
 	const Window & window) :
@@ -16,13 +25,24 @@ GeometryPass::GeometryPass(RenderingManager * renderingManager,
 	if (!renderingManager)
 		Window::CreateError("GeometryPass : Missing RenderingManager");
 	m_inputLayoutDesc = {};
-	SAFE_NEW(m_emitters, new std::vector<ParticleEmitter*>());
 }
 
 
 GeometryPass::~GeometryPass()
 {
-	SAFE_DELETE(m_emitters);
+}
+
+void GeometryPass::QueueShaders()
+{
+	ShaderCreator::QueueShader(VERTEX_SHADER);
+	ShaderCreator::QueueShader(VERTEX_SHADER, ShaderPermutation::TESSELLATION);
+	ShaderCreator::QueueShader(VERTEX_SHADER, ShaderPermutation::DISPLACEMENT);
+	ShaderCreator::QueueShader(HULL_SHADER);
+	ShaderCreator::QueueShader(DOMAIN_SHADER);
+	ShaderCreator::QueueShader(PIXEL_SHADER);
+	ShaderCreator::QueueShader(PIXEL_SHADER, ShaderPermutation::NORMAL_MAP);
+	ShaderCreator::QueueShader(PARTICLE_VERTEX_SHADER);
+	ShaderCreator::QueueShader(PARTICLE_PIXEL_SHADER);
 }
 
 HRESULT GeometryPass::Init()
@@ -42,7 +62,11 @@ void GeometryPass::Update(const Camera & camera, const float & deltaTime)
 {	
 	p_renderingManager->GetPassFence(PARTICLE_PASS)->WaitGgu(p_renderingManager->GetCommandQueue());
 
-	OpenCommandList(m_pipelineState);
+	_cullOccluded(camera);
+	_updateTessellation(camera);
+
+	m_currentPipelineState = PERMUTATIONS - 1;
+	OpenCommandList(m_pipelineStates[m_currentPipelineState]);
 	ID3D12GraphicsCommandList * commandList = p_commandList[p_renderingManager->GetFrameIndex()];
 	//p_renderingManager->ResourceDescriptorHeap(commandList);
 	p_setResourceDescriptorHeap(commandList);
@@ -90,34 +114,6 @@ void GeometryPass::Draw()
 	ID3D12GraphicsCommandList * commandList = p_commandList[p_renderingManager->GetFrameIndex()];
 
 	p_drawInstance(2, TRUE);
-	const size_t emitterSize = m_emitters->size();
-
-	if (emitterSize)
-	{
-		commandList->SetPipelineState(m_particlePipelineState);
-		commandList->SetGraphicsRootSignature(m_particleRootSignature);
-		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_cameraBuffer->SetGraphicsRootConstantBufferView(commandList, 0, 0);
-		
-		ParticleEmitter * emitter = nullptr;
-		for (size_t i = 0; i < emitterSize; i++)
-		{
-			emitter = m_emitters->at(i);
-			const D3D12_GPU_DESCRIPTOR_HANDLE handle = p_copyToDescriptorHeap(emitter->GetShaderResourceView()->GetCpuDescriptorHandle(), emitter->GetShaderResourceView()->GetResource()->GetDesc().DepthOrArraySize);
-			//p_copyToDescriptorHeap(emitter->GetTextures()[1]->GetCpuHandle());
-			//p_copyToDescriptorHeap(emitter->GetTextures()[2]->GetCpuHandle());
-
-			
-
-			commandList->SetGraphicsRootDescriptorTable(1, handle);
-			commandList->IASetVertexBuffers(0, 1, &emitter->GetVertexBufferView());
-
-			commandList->DrawInstanced(
-				emitter->GetVertexSize(),
-				1, 0, 0);
-		}
-
-	}
 
 	m_depthStencil->SwitchToSRV(commandList);
 
@@ -137,11 +133,55 @@ void GeometryPass::Draw()
 	ExecuteCommandList();
 }
 
+void GeometryPass::DrawParticles(ID3D12GraphicsCommandList * commandList, const D3D12_CPU_DESCRIPTOR_HANDLE & renderTarget)
+{
+	ParticlePass * particlePass = p_renderingManager->GetParticlePass();
+	const UINT drawCommands = particlePass->GetDrawCommandCount();
+	if (!drawCommands)
+		return;
+
+	//Tested against the depth of the geometry without writing it, then handed back to the passes that sample it
+	m_depthStencil->SwitchToDSV(commandList);
+	const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_depthStencil->GetDescriptorHeap()->GetCPUDescriptorHandleForHeapStart();
+	commandList->OMSetRenderTargets(1, &renderTarget, FALSE, &dsvHandle);
+	commandList->RSSetViewports(1, &m_viewport);
+	commandList->RSSetScissorRects(1, &m_rect);
+
+	p_setResourceDescriptorHeap(commandList);
+	commandList->SetPipelineState(m_particlePipelineState);
+	commandList->SetGraphicsRootSignature(m_particleRootSignature);
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_cameraBuffer->SetGraphicsRootConstantBufferView(commandList, 0, 0);
+	commandList->IASetVertexBuffers(0, 1, &particlePass->GetInstanceBufferView());
+
+	//One descriptor views a whole texture array, so every emitter texture takes one slot of the table
+	const std::vector<X12ShaderResourceView*> & textures = particlePass->GetEmitterTextures();
+	D3D12_GPU_DESCRIPTOR_HANDLE textureTable{};
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		const D3D12_GPU_DESCRIPTOR_HANDLE handle = p_copyToDescriptorHeap(textures[i]->GetCpuDescriptorHandle(), 1);
+		if (i == 0)
+			textureTable = handle;
+	}
+	commandList->SetGraphicsRootDescriptorTable(1, textureTable);
+
+	//Every emitter in one call, each command sets the texture index root constant before its draw.
+	//The commands are back to front and so are the particles of each emitter, so the blending comes out in order
+	commandList->ExecuteIndirect(
+		m_particleCommandSignature,
+		drawCommands,
+		particlePass->GetDrawCommands(),
+		0,
+		nullptr, 0);
+	p_renderingManager->GetFrameStats()->RecordIndirectDraw(0);
+
+	m_depthStencil->SwitchToSRV(commandList);
+}
+
 void GeometryPass::Clear()
 {
 	this->p_drawQueue->clear();
 	this->p_lightQueue->clear();
-	this->m_emitters->clear();
 	Instancing::ClearInstanceGroup(p_instanceGroups);
 	p_resetDescriptorHeap();
 }
@@ -149,10 +189,14 @@ void GeometryPass::Clear()
 void GeometryPass::Release()
 {	
 	SAFE_RELEASE(m_rootSignature);
-	SAFE_RELEASE(m_pipelineState);
+	for (UINT i = 0; i < PERMUTATIONS; i++)
+	{
+		SAFE_RELEASE(m_pipelineStates[i]);
+	}
 
 	SAFE_RELEASE(m_particlePipelineState);
 	SAFE_RELEASE(m_particleRootSignature);
+	SAFE_RELEASE(m_particleCommandSignature);
 
 	if (m_depthStencil)
 		m_depthStencil->Release();
@@ -182,9 +226,58 @@ void GeometryPass::Release()
 	SAFE_DELETE(m_cameraBuffer);
 }
 
-void GeometryPass::AddEmitter(ParticleEmitter* emitter) const
+void GeometryPass::SetTessellationSettings(const TessellationLod::Settings& settings)
 {
-	m_emitters->push_back(emitter);
+	m_tessellationSettings = settings;
+}
+
+const TessellationLod::Settings& GeometryPass::GetTessellationSettings() const
+{
+	return m_tessellationSettings;
+}
+
+void GeometryPass::SetTessellationBudget(const UINT& budget)
+{
+	m_tessellationBudget = budget;
+}
+
+const UINT& GeometryPass::GetTessellationBudget() const
+{
+	return m_tessellationBudget;
+}
+
+const UINT& GeometryPass::GetTessellatedTriangleCount() const
+{
+	return m_tessellatedTriangles;
+}
+
+void GeometryPass::SetOcclusionCulling(const BOOL& occlusionCulling)
+{
+	m_occlusionCulling = occlusionCulling;
+}
+
+const BOOL& GeometryPass::GetOcclusionCulling() const
+{
+	return m_occlusionCulling;
+}
+
+const UINT& GeometryPass::GetOccludedInstanceCount() const
+{
+	return m_occludedInstances;
+}
+
+void GeometryPass::p_beginInstanceGroup(ID3D12GraphicsCommandList * commandList, const Instancing::InstanceGroup & group)
+{
+	const UINT pipelineState = ShaderPermutation::Index(group.Permutation, ShaderPermutation::GEOMETRY_FEATURES);
+	if (pipelineState == m_currentPipelineState)
+		return;
+
+	commandList->SetPipelineState(m_pipelineStates[pipelineState]);
+	if (group.Permutation & ShaderPermutation::TESSELLATION)
+		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
+	else
+		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_currentPipelineState = pipelineState;
 }
 
 HRESULT GeometryPass::_preInit()
@@ -211,6 +304,10 @@ HRESULT GeometryPass::_preInit()
 	{
 		return hr;
 	}
+	if (FAILED(hr = _initParticleCommandSignature()))
+	{
+		return hr;
+	}
 	if (FAILED(hr = _createViewport()))
 	{
 		return hr;
@@ -313,13 +410,16 @@ HRESULT GeometryPass::_initID3D12RootSignature()
 
 	D3D12_STATIC_SAMPLER_DESC domainSampler{};
 	RenderingHelpClass::CreateSampler(domainSampler, 0, 0, D3D12_SHADER_VISIBILITY_DOMAIN);
+
+	D3D12_STATIC_SAMPLER_DESC vertexSampler{};
+	RenderingHelpClass::CreateSampler(vertexSampler, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 	   
-	D3D12_STATIC_SAMPLER_DESC samplers[] = { sampler, shadowSampler, domainSampler };
+	D3D12_STATIC_SAMPLER_DESC samplers[] = { sampler, shadowSampler, domainSampler, vertexSampler };
 
 	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
 	rootSignatureDesc.Init(_countof(m_rootParameters),
 		m_rootParameters, 
-		3, 
+		_countof(samplers), 
 		samplers,
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |		
@@ -331,20 +431,20 @@ HRESULT GeometryPass::_initID3D12RootSignature()
 		&signature, 
 		nullptr)))
 	{
-		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateRootSignature(
-			0, 
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateRootSignature(
 			signature->GetBufferPointer(),
 			signature->GetBufferSize(),
-			IID_PPV_ARGS(&m_rootSignature))))
+			&m_rootSignature)))
 		{
 			SAFE_RELEASE(m_rootSignature);
 		}
 	}
 	SAFE_RELEASE(signature);
 
+	//Every emitter texture of the frame, the root constant picks one
 	D3D12_DESCRIPTOR_RANGE particleRangeTable;
 	D3D12_ROOT_DESCRIPTOR_TABLE particleTable;
-	RenderingHelpClass::CreateRootDescriptorTable(particleRangeTable, particleTable, 0, 0);
+	RenderingHelpClass::CreateRootDescriptorTable(particleRangeTable, particleTable, 0, 0, UINT_MAX);
 
 	D3D12_ROOT_DESCRIPTOR particleRootDescriptor;
 	particleRootDescriptor.RegisterSpace = 0;
@@ -358,6 +458,12 @@ HRESULT GeometryPass::_initID3D12RootSignature()
 	m_particleRootParameters[1].DescriptorTable = particleTable;
 	m_particleRootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+	m_particleRootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	m_particleRootParameters[2].Constants.ShaderRegister = 1;
+	m_particleRootParameters[2].Constants.RegisterSpace = 0;
+	m_particleRootParameters[2].Constants.Num32BitValues = 1;
+	m_particleRootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
 	CD3DX12_ROOT_SIGNATURE_DESC particleRootSignatureDesc;
 	particleRootSignatureDesc.Init(_countof(m_particleRootParameters),
 		m_particleRootParameters,
@@ -373,11 +479,10 @@ HRESULT GeometryPass::_initID3D12RootSignature()
 		&signature,
 		nullptr)))
 	{
-		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateRootSignature(
-			0,
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateRootSignature(
 			signature->GetBufferPointer(),
 			signature->GetBufferSize(),
-			IID_PPV_ARGS(&m_particleRootSignature))))
+			&m_particleRootSignature)))
 		{
 			SAFE_RELEASE(m_particleRootSignature);
 		}
@@ -402,7 +507,8 @@ HRESULT GeometryPass::_initID3D12PipelineState()
 		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
-		{ "TEXTURE_INDEX", 0, DXGI_FORMAT_R32G32B32A32_UINT, 1, 64, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
+		{ "TEXTURE_INDEX", 0, DXGI_FORMAT_R32G32B32A32_UINT, 1, 64, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+		{ "TESS_FACTOR", 0, DXGI_FORMAT_R32_FLOAT, 1, 80, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
 	};
 
 	m_inputLayoutDesc.NumElements = sizeof(inputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
@@ -411,11 +517,6 @@ HRESULT GeometryPass::_initID3D12PipelineState()
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsPipelineStateDesc = {};
 	graphicsPipelineStateDesc.InputLayout = m_inputLayoutDesc;
 	graphicsPipelineStateDesc.pRootSignature = m_rootSignature;
-	graphicsPipelineStateDesc.VS = m_vertexShader;
-	graphicsPipelineStateDesc.HS = m_hullShader;
-	graphicsPipelineStateDesc.DS = m_domainShader;
-	graphicsPipelineStateDesc.PS = m_pixelShader;
-	graphicsPipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH;
 	graphicsPipelineStateDesc.NumRenderTargets = RENDER_TARGETS;
 
 	for (UINT i = 0; i < RENDER_TARGETS; i++)
@@ -436,17 +537,33 @@ HRESULT GeometryPass::_initID3D12PipelineState()
 	else
 		return hr;
 
-	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateGraphicsPipelineState(
-		&graphicsPipelineStateDesc,
-		IID_PPV_ARGS(&m_pipelineState))))
+	for (UINT i = 0; i < PERMUTATIONS; i++)
 	{
-		SAFE_RELEASE(m_pipelineState);
+		const ShaderPermutation::Key permutation = ShaderPermutation::FromIndex(i, ShaderPermutation::GEOMETRY_FEATURES);
+		const BOOL tessellation = (permutation & ShaderPermutation::TESSELLATION) != 0;
+		//Tessellated instances are displaced in the domain shader, the displacement bit only picks the vertex shader without it
+		const UINT vertexShader = tessellation ? 1 : ((permutation & ShaderPermutation::DISPLACEMENT) ? 2 : 0);
+
+		graphicsPipelineStateDesc.VS = m_vertexShader[vertexShader];
+		graphicsPipelineStateDesc.HS = tessellation ? m_hullShader : D3D12_SHADER_BYTECODE{};
+		graphicsPipelineStateDesc.DS = tessellation ? m_domainShader : D3D12_SHADER_BYTECODE{};
+		graphicsPipelineStateDesc.PS = m_pixelShader[(permutation & ShaderPermutation::NORMAL_MAP) != 0];
+		graphicsPipelineStateDesc.PrimitiveTopologyType = tessellation ? D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH : D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateGraphicsPipelineState(
+			graphicsPipelineStateDesc,
+			&m_pipelineStates[i])))
+		{
+			SAFE_RELEASE(m_pipelineStates[i]);
+			return hr;
+		}
 	}
 
 	D3D12_INPUT_ELEMENT_DESC particleInputLayout[] =
 	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TEXCORD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+		{ "SIZE", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+		{ "TEXTURE_INDEX", 0, DXGI_FORMAT_R32_UINT, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 	};
 
 	m_inputLayoutDesc.NumElements = sizeof(particleInputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
@@ -458,24 +575,33 @@ HRESULT GeometryPass::_initID3D12PipelineState()
 	particleGraphicsPipelineStateDesc.VS = m_particleVertexShader;
 	particleGraphicsPipelineStateDesc.PS = m_particlePixelShader;
 	particleGraphicsPipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-	particleGraphicsPipelineStateDesc.NumRenderTargets = RENDER_TARGETS;
-	for (UINT i = 0; i < RENDER_TARGETS; i++)
-	{
-		particleGraphicsPipelineStateDesc.RTVFormats[i] = RENDER_TARGET_FORMAT;
-
-	}
+	//Blended into the lit back buffer after the deferred pass
+	particleGraphicsPipelineStateDesc.NumRenderTargets = 1;
+	particleGraphicsPipelineStateDesc.RTVFormats[0] = PARTICLE_TARGET_FORMAT;
 	
 	particleGraphicsPipelineStateDesc.SampleMask = 0xffffffff;
 	particleGraphicsPipelineStateDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-	CD3DX12_RASTERIZER_DESC(D3D12_FILL_MODE_WIREFRAME, D3D12_CULL_MODE_NONE, FALSE, 0, 0.0f, 0.0f, TRUE, FALSE, FALSE, 0, D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF);
-	particleGraphicsPipelineStateDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-	particleGraphicsPipelineStateDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+
+	D3D12_BLEND_DESC particleBlend = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	particleBlend.RenderTarget[0].BlendEnable = TRUE;
+	particleBlend.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
+	particleBlend.RenderTarget[0].DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+	particleBlend.RenderTarget[0].BlendOp = D3D12_BLEND_OP_ADD;
+	particleBlend.RenderTarget[0].SrcBlendAlpha = D3D12_BLEND_ONE;
+	particleBlend.RenderTarget[0].DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+	particleBlend.RenderTarget[0].BlendOpAlpha = D3D12_BLEND_OP_ADD;
+	particleGraphicsPipelineStateDesc.BlendState = particleBlend;
+
+	//Hidden by the geometry, but particles do not hide each other
+	D3D12_DEPTH_STENCIL_DESC particleDepth = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	particleDepth.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	particleGraphicsPipelineStateDesc.DepthStencilState = particleDepth;
 	particleGraphicsPipelineStateDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
 	particleGraphicsPipelineStateDesc.SampleDesc = desc.SampleDesc;
 
-	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateGraphicsPipelineState(
-		&particleGraphicsPipelineStateDesc,
-		IID_PPV_ARGS(&m_particlePipelineState))))
+	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateGraphicsPipelineState(
+		particleGraphicsPipelineStateDesc,
+		&m_particlePipelineState)))
 	{
 		SAFE_RELEASE(m_particlePipelineState);
 	}
@@ -488,17 +614,18 @@ HRESULT GeometryPass::_initShaders()
 	HRESULT hr;
 	ID3DBlob * blob = nullptr;
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryVertex.hlsl", blob, "vs_5_1")))
-	{
-		return hr;
-	}
-	else
+	const ShaderPermutation::Key vertexPermutations[VERTEX_SHADERS] = { 0, ShaderPermutation::TESSELLATION, ShaderPermutation::DISPLACEMENT };
+	for (UINT i = 0; i < VERTEX_SHADERS; i++)
 	{
-		m_vertexShader.BytecodeLength = blob->GetBufferSize();
-		m_vertexShader.pShaderBytecode = blob->GetBufferPointer();
+		if (FAILED(hr = ShaderCreator::CreateShader(VERTEX_SHADER, blob, vertexPermutations[i])))
+		{
+			return hr;
+		}
+		m_vertexShader[i].BytecodeLength = blob->GetBufferSize();
+		m_vertexShader[i].pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryHull.hlsl", blob, "hs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(HULL_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -508,7 +635,7 @@ HRESULT GeometryPass::_initShaders()
 		m_hullShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryDomain.hlsl", blob, "ds_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(DOMAIN_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -518,17 +645,17 @@ HRESULT GeometryPass::_initShaders()
 		m_domainShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryPixel.hlsl", blob, "ps_5_1")))
-	{
-		return hr;
-	}
-	else
+	for (UINT i = 0; i < 2; i++)
 	{
-		m_pixelShader.BytecodeLength = blob->GetBufferSize();
-		m_pixelShader.pShaderBytecode = blob->GetBufferPointer();
+		if (FAILED(hr = ShaderCreator::CreateShader(PIXEL_SHADER, blob, i ? ShaderPermutation::NORMAL_MAP : 0)))
+		{
+			return hr;
+		}
+		m_pixelShader[i].BytecodeLength = blob->GetBufferSize();
+		m_pixelShader[i].pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryParticleVertex.hlsl", blob, "vs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(PARTICLE_VERTEX_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -538,7 +665,7 @@ HRESULT GeometryPass::_initShaders()
 		m_particleVertexShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/GeometryPass/DefaultGeometryParticlePixel.hlsl", blob, "ps_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(PARTICLE_PIXEL_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -585,7 +712,7 @@ HRESULT GeometryPass::_createBundle()
 			0, 
 			D3D12_COMMAND_LIST_TYPE_BUNDLE, 
 			m_bundleCommandAllocator,
-			m_pipelineState,
+			m_pipelineStates[PERMUTATIONS - 1],
 			IID_PPV_ARGS(&m_bundleCommandList[i]))))
 		{
 			return hr;
@@ -598,3 +725,145 @@ HRESULT GeometryPass::_createBundle()
 
 	return hr;
 }
+
+void GeometryPass::_cullOccluded(const Camera & camera)
+{
+	m_occludedInstances = 0;
+	if (!m_occlusionCulling)
+		return;
+
+	m_occlusionCuller.BeginFrame(camera.GetViewProjectionMatrix());
+	for (size_t i = 0; i < p_drawQueue->size(); i++)
+	{
+		const Drawable * drawable = p_drawQueue->at(i);
+		const StaticMesh * mesh = drawable->GetMesh();
+		if (!drawable->GetIsOccluder() || !mesh || mesh->GetStaticMesh().empty())
+			continue;
+
+		const std::vector<StaticVertex> & vertices = mesh->GetStaticMesh();
+		m_occlusionCuller.AddOccluder(&vertices[0].Position, vertices.size(), sizeof(StaticVertex), drawable->GetWorldMatrix());
+	}
+	if (!m_occlusionCuller.GetTriangleCount())
+		return;
+	m_occlusionCuller.Rasterize();
+
+	//Visible instances are moved to the front of their group, groups left empty are dropped
+	const TransformStore * store = TransformStore::GetInstance();
+	size_t groupCount = 0;
+	for (size_t i = 0; i < p_instanceGroups->size(); i++)
+	{
+		Instancing::InstanceGroup & group = p_instanceGroups->at(i);
+		const DirectX::XMFLOAT3 & boxMin = group.StaticMesh->GetBoundingBoxMin();
+		const DirectX::XMFLOAT3 & boxMax = group.StaticMesh->GetBoundingBoxMax();
+
+		UINT visible = 0;
+		for (UINT j = 0; j < group.GetSize(); j++)
+		{
+			if (!m_occlusionCuller.IsVisible(boxMin, boxMax, store->GetWorldMatrix(group.Handles[j])))
+				continue;
+			group.TessFactors[visible] = group.TessFactors[j];
+			group.Handles[visible++] = group.Handles[j];
+		}
+		m_occludedInstances += group.GetSize() - visible;
+		group.Truncate(visible);
+
+		if (!visible)
+			continue;
+		if (groupCount != i)
+			p_instanceGroups->at(groupCount) = group;
+		groupCount++;
+	}
+	p_instanceGroups->erase(p_instanceGroups->begin() + groupCount, p_instanceGroups->end());
+	p_renderingManager->GetFrameStats()->Add(FrameStats::INSTANCES_OCCLUDED, m_occludedInstances);
+}
+
+void GeometryPass::_updateTessellation(const Camera & camera)
+{
+	using namespace DirectX;
+
+	const XMVECTOR cameraPosition = XMLoadFloat4(&camera.GetPosition());
+
+	const TransformStore * store = TransformStore::GetInstance();
+	m_requestedTessFactors.clear();
+	m_tessellatedMeshTriangles.clear();
+	for (size_t i = 0; i < p_instanceGroups->size(); i++)
+	{
+		const Instancing::InstanceGroup & group = p_instanceGroups->at(i);
+		if (!(group.Permutation & ShaderPermutation::TESSELLATION))
+			continue;
+
+		const float meshRadius = group.StaticMesh->GetBoundingRadius();
+		const UINT triangles = static_cast<UINT>(group.StaticMesh->GetStaticMesh().size() / 3);
+		for (UINT j = 0; j < group.GetSize(); j++)
+		{
+			const XMFLOAT4X4 & worldMatrix = store->GetWorldMatrix(group.Handles[j]);
+			const XMFLOAT4 position = TessellationLod::Position(worldMatrix);
+			const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat4(&position), cameraPosition)));
+
+			m_requestedTessFactors.push_back(TessellationLod::Factor(
+				distance, 
+				meshRadius * TessellationLod::MaxScale(worldMatrix), 
+				camera.GetFov(), 
+				m_tessellationSettings));
+			m_tessellatedMeshTriangles.push_back(triangles);
+		}
+	}
+
+	const size_t instances = m_requestedTessFactors.size();
+	m_grantedTessFactors.resize(instances);
+	m_tessellatedTriangles = static_cast<UINT>(TessellationLod::ApplyBudget(
+		m_requestedTessFactors.data(), 
+		m_tessellatedMeshTriangles.data(), 
+		m_grantedTessFactors.data(), 
+		instances, 
+		m_tessellationBudget));
+
+	//Groups the budget left at a factor of 1 are drawn without the hull and domain shaders,
+	//the vertex shader displaces them the same way the domain shader does at a factor of 1
+	size_t current = 0;
+	for (size_t i = 0; i < p_instanceGroups->size(); i++)
+	{
+		Instancing::InstanceGroup & group = p_instanceGroups->at(i);
+		if (!(group.Permutation & ShaderPermutation::TESSELLATION))
+			continue;
+
+		BOOL subdivided = FALSE;
+		for (UINT j = 0; j < group.GetSize(); j++)
+		{
+			group.TessFactors[j] = m_grantedTessFactors[current++];
+			subdivided |= group.TessFactors[j] > 1.0f;
+		}
+		if (!subdivided)
+			group.Permutation = (group.Permutation & ~ShaderPermutation::TESSELLATION) | ShaderPermutation::DISPLACEMENT;
+	}
+}
+
+HRESULT GeometryPass::_initParticleCommandSignature()
+{
+	HRESULT hr = 0;
+
+	//Laid out as ParticleRangeAllocator::DrawCommand, the texture index root constant and then the draw
+	D3D12_INDIRECT_ARGUMENT_DESC argumentDesc[2]{};
+	argumentDesc[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	argumentDesc[0].Constant.RootParameterIndex = 2;
+	argumentDesc[0].Constant.DestOffsetIn32BitValues = 0;
+	argumentDesc[0].Constant.Num32BitValuesToSet = 1;
+	argumentDesc[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+
+	D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc{};
+	commandSignatureDesc.ByteStride = sizeof(ParticleRangeAllocator::DrawCommand);
+	commandSignatureDesc.NumArgumentDescs = _countof(argumentDesc);
+	commandSignatureDesc.pArgumentDescs = argumentDesc;
+
+	//A signature that changes root arguments needs the root signature it changes them in
+	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateCommandSignature(
+		&commandSignatureDesc,
+		m_particleRootSignature,
+		IID_PPV_ARGS(&m_particleCommandSignature))))
+	{
+		SAFE_RELEASE(m_particleCommandSignature);
+		return hr;
+	}
+	SET_NAME(m_particleCommandSignature, L"Particle CommandSignature");
+	return hr;
+}
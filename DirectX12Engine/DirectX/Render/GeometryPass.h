@@ -1,5 +1,7 @@
 #pragma once
 #include "Template/IRender.h"
+#include "WrapperFunctions/Functions/TessellationLod.h"
+#include "WrapperFunctions/Functions/OcclusionCuller.h"
 
 class X12RenderTargetView;
 class X12ConstantBuffer;
@@ -11,11 +13,18 @@ class GeometryPass :
 private:
 
 	static const UINT ROOT_PARAMETERS = 3;
-	static const UINT PARTICLE_ROOT_PARAMETERS = 2;
+	static const UINT PARTICLE_ROOT_PARAMETERS = 3;
 	static const UINT NUM_BUFFERS = 2;
 
 	static const UINT RENDER_TARGETS = 4;
 	static const DXGI_FORMAT RENDER_TARGET_FORMAT = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	//The back buffer the particles are blended into
+	static const DXGI_FORMAT PARTICLE_TARGET_FORMAT = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	//One pipeline per combination of the material features, see ShaderPermutation
+	static const UINT PERMUTATIONS = ShaderPermutation::Count(ShaderPermutation::GEOMETRY_FEATURES);
+	//Plain, tessellated and displaced without tessellation
+	static const UINT VERTEX_SHADERS = 3;
 
 	struct CameraBuffer
 	{
@@ -34,15 +43,33 @@ private:
 public:
 	GeometryPass(RenderingManager * renderingManager, const Window & window);
 	~GeometryPass();
+
+	static void QueueShaders();
 	
 	
 	HRESULT Init() override;
 	void Update(const Camera & camera, const float & deltaTime) override;
 	void Draw() override;
+	// Blends the particles of the particle pass into the lit frame, runs on the main command list after the deferred pass
+	void DrawParticles(ID3D12GraphicsCommandList * commandList, const D3D12_CPU_DESCRIPTOR_HANDLE & renderTarget);
 	void Clear() override;
 	void Release() override;
 
-	void AddEmitter(ParticleEmitter * emitter) const;
+	void SetTessellationSettings(const TessellationLod::Settings & settings);
+	const TessellationLod::Settings & GetTessellationSettings() const;
+
+	// Caps the triangles tessellation may produce in a frame, 0 only limits each instance to MaxFactor
+	void SetTessellationBudget(const UINT & budget);
+	const UINT & GetTessellationBudget() const;
+	const UINT & GetTessellatedTriangleCount() const;
+
+	// Leaves out instances hidden behind the drawables marked as occluders, does nothing without occluders
+	void SetOcclusionCulling(const BOOL & occlusionCulling);
+	const BOOL & GetOcclusionCulling() const;
+	const UINT & GetOccludedInstanceCount() const;
+
+protected:
+	void p_beginInstanceGroup(ID3D12GraphicsCommandList * commandList, const Instancing::InstanceGroup & group) override;
 
 private:
 	HRESULT _preInit();
@@ -53,14 +80,21 @@ private:
 	HRESULT _initShaders();
 	HRESULT _createViewport();
 	HRESULT _createBundle();
+	HRESULT _initParticleCommandSignature();
+
+	void _cullOccluded(const Camera & camera);
+	void _updateTessellation(const Camera & camera);
 
-	ID3D12PipelineState * m_pipelineState = nullptr;
+	ID3D12PipelineState * m_pipelineStates[PERMUTATIONS] = { nullptr };
+	//Index of the pipeline set on the command list
+	UINT m_currentPipelineState = PERMUTATIONS;
 	ID3D12RootSignature * m_rootSignature = nullptr;
 	D3D12_ROOT_PARAMETER  m_rootParameters[ROOT_PARAMETERS] {};
 
 	ID3D12PipelineState * m_particlePipelineState = nullptr;
 	ID3D12RootSignature * m_particleRootSignature = nullptr;
 	D3D12_ROOT_PARAMETER m_particleRootParameters[PARTICLE_ROOT_PARAMETERS] {};
+	ID3D12CommandSignature * m_particleCommandSignature = nullptr;
 
 	D3D12_INPUT_LAYOUT_DESC  m_inputLayoutDesc;
 
@@ -73,10 +107,11 @@ private:
 	D3D12_VIEWPORT	m_viewport{};
 	D3D12_RECT		m_rect{};
 
-	D3D12_SHADER_BYTECODE m_vertexShader{};
+	//Without and with the feature compiled in
+	D3D12_SHADER_BYTECODE m_vertexShader[VERTEX_SHADERS]{};
 	D3D12_SHADER_BYTECODE m_hullShader{};
 	D3D12_SHADER_BYTECODE m_domainShader{};
-	D3D12_SHADER_BYTECODE m_pixelShader{};
+	D3D12_SHADER_BYTECODE m_pixelShader[2]{};
 
 	D3D12_SHADER_BYTECODE m_particleVertexShader{};
 	D3D12_SHADER_BYTECODE m_particlePixelShader{};
@@ -97,6 +132,15 @@ private:
 		DirectX::XMFLOAT4 Color;
 	};
 
-	std::vector<ParticleEmitter*>* m_emitters = nullptr;
+	TessellationLod::Settings m_tessellationSettings {};
+	UINT m_tessellationBudget = 0;
+	UINT m_tessellatedTriangles = 0;
+	std::vector<float> m_requestedTessFactors;
+	std::vector<UINT> m_tessellatedMeshTriangles;
+	std::vector<float> m_grantedTessFactors;
+
+	OcclusionCuller m_occlusionCuller;
+	BOOL m_occlusionCulling = TRUE;
+	UINT m_occludedInstances = 0;
 };
 
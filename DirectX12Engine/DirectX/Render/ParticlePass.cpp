@@ -1,28 +1,43 @@
 #include "DirectX12EnginePCH.h"
 #include "ParticlePass.h"
+#include "WrapperFunctions/X12PipelineStateCache.h"
 #include "WrapperFunctions/X12ConstantBuffer.h"
 #include "../Objects/ParticleEmitter.h"
 #include "GeometryPass.h"
 #include <stdlib.h>
 #include "WrapperFunctions/X12Timer.h"
+#include "WrapperFunctions/X12GpuProfiler.h"
+#include <algorithm>
 
 #define PARTICLE_INFO	0
 #define PARTICLE_BUFFER 1
-#define VERTEX_OUTPUT	2
+#define INSTANCE_OUTPUT	2
 #define CALC_OUTPUT		3
 
+#define SORT_PARTICLE_INFO		0
+#define SORT_EMITTER_RANGES		1
+#define SORT_INSTANCE_INPUT		2
+#define SORT_INSTANCE_OUTPUT	3
+
+static_assert(sizeof(ParticleRangeAllocator::DrawArguments) == sizeof(D3D12_DRAW_ARGUMENTS), "Particle draw arguments must match D3D12_DRAW_ARGUMENTS");
+static_assert(sizeof(ParticleRangeAllocator::DrawCommand) == sizeof(UINT) + sizeof(D3D12_DRAW_ARGUMENTS), "Particle draw commands must match the particle command signature");
+static_assert(sizeof(ParticleInstance) == 24, "ParticleInstance must match the layout in DefaultParticleCompute.hlsl");
+
+static const ShaderCreator::ShaderDesc COMPUTE_SHADER{ L"../DirectX12Engine/DirectX/Shaders/ParticlePass/DefaultParticleCompute.hlsl", "cs_5_1" };
+static const ShaderCreator::ShaderDesc SORT_SHADER{ L"../DirectX12Engine/DirectX/Shaders/ParticlePass/ParticleBitonicSort.hlsl", "cs_5_1" };
+
 ParticlePass::ParticlePass(RenderingManager* renderingManager, const Window& window)
 	: IRender(renderingManager, window)
 {
 	SAFE_NEW(m_emitters, new std::vector<ParticleEmitter*>());
 	SAFE_NEW(m_particleBuffer, new X12ConstantBuffer());
 	SAFE_NEW(m_particleInfoBuffer, new X12ConstantBuffer());
+	SAFE_NEW(m_drawCommandBuffer, new X12ConstantBuffer());
+	SAFE_NEW(m_sortRangeBuffer, new X12ConstantBuffer());
 	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
 	{
 		SAFE_NEW(m_fence[i], new X12Fence());
 	}
-
-	this->m_geometryPass = renderingManager->GetGeometryPass();
 }
 
 ParticlePass::~ParticlePass()
@@ -30,6 +45,12 @@ ParticlePass::~ParticlePass()
 	SAFE_DELETE(m_emitters);
 }
 
+void ParticlePass::QueueShaders()
+{
+	ShaderCreator::QueueShader(COMPUTE_SHADER);
+	ShaderCreator::QueueShader(SORT_SHADER);
+}
+
 HRESULT ParticlePass::Init()
 {
 	HRESULT hr = 0;
@@ -65,20 +86,17 @@ HRESULT ParticlePass::Init()
 	}
 
 
-	//if (FAILED(hr = m_particleBuffer->CreateSharedBuffer(L"Particle buffer", sizeof(ParticleBuffer), 4096 * 4096)))
-	//{
-	//	if (FAILED(hr = m_particleBuffer->CreateBuffer(L"Particle buffer", nullptr, 0, 4096 * 4096)))
-	//	{		
-	//		return hr;
-	//	}		
-	//}
-	if (FAILED(hr = m_particleInfoBuffer->CreateSharedBuffer(L"Particle info buffer", 0, 4096 * 4096)))
+	if (FAILED(hr = m_particleInfoBuffer->CreateSharedBuffer(L"Particle info buffer", 0)))
 	{
-		if (FAILED(hr = m_particleInfoBuffer->CreateBuffer(L"Particle info buffer", nullptr, 0, 4096 * 4096)))
+		if (FAILED(hr = m_particleInfoBuffer->CreateBuffer(L"Particle info buffer", nullptr, 0)))
 		{
 			return hr;
 		}	
 	}
+	if (FAILED(hr = _initParticleBuffers(device)))
+	{
+		return hr;
+	}
 
 	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
 	{
@@ -97,7 +115,7 @@ HRESULT ParticlePass::Init()
 
 
 
-	p_renderingManager->GetTimer(PARTICLE_PASS)->CreateTimer(TIMER_COUNT, device);
+	p_renderingManager->GetTimer(PARTICLE_PASS)->CreateTimer(1, device);
 
 	p_renderingManager->GetTimer(PARTICLE_PASS)->SetCommandQueue(m_commandQueue);
 
@@ -110,70 +128,29 @@ void ParticlePass::Update(const Camera& camera, const float & deltaTime)
 	{
 		DirectX::XMFLOAT4	CameraPosition;
 		DirectX::XMFLOAT4X4 WorldMatrix;
+		DirectX::XMUINT4	ParticleCount;
 	}particleInfoBuffer;
 
-	static UINT frameCounter = 1;
-
 	particleInfoBuffer.CameraPosition = DirectX::XMFLOAT4A(
 		camera.GetPosition().x,
 		camera.GetPosition().y,
 		camera.GetPosition().z,
 		camera.GetPosition().w);
+	DirectX::XMStoreFloat4x4(&particleInfoBuffer.WorldMatrix, DirectX::XMMatrixIdentity());
 
-	ParticleEmitter * emitter = nullptr;
+	m_frameIndex = p_renderingManager->GetFrameIndex();
 
 	if (SUCCEEDED(m_fence[m_prevFrame]->WaitCpu()))
 	{
-		for (size_t i = 0; i < m_emitters->size(); i++)
-		{
-			emitter = m_emitters->at(i);
-
-			emitter->UpdateData(m_prevFrame);
-		}
+		_readBack(m_prevFrame);
 	}
 
-	for (size_t i = 0; i < m_emitters->size(); i++)
-	{
-		UINT offset = 0;
-		m_emitters->at(i)->UpdateEmitter(deltaTime);
-		particleInfoBuffer.WorldMatrix = m_emitters->at(i)->GetWorldMatrix();
-		for (size_t j = 0; j < m_emitters->at(i)->GetParticles().size(); j++)
-		{
-			m_particleValues.ParticleInfo.x = deltaTime;
-			m_particleValues.ParticleInfo.y = m_emitters->at(i)->GetParticles()[j].TimeAlive;
-			m_particleValues.ParticleInfo.z = m_emitters->at(i)->GetParticles()[j].TimeToLive;
-			
-			m_particleValues.ParticlePosition = DirectX::XMFLOAT4A(
-				m_emitters->at(i)->GetParticles()[j].Position.x,
-				m_emitters->at(i)->GetParticles()[j].Position.y,
-				m_emitters->at(i)->GetParticles()[j].Position.z,
-				m_emitters->at(i)->GetParticles()[j].Position.w
-			);
-			m_particleValues.ParticleSpawnPosition = DirectX::XMFLOAT4A(
-				m_emitters->at(i)->GetParticles()[j].SpawnPosition.x,
-				m_emitters->at(i)->GetParticles()[j].SpawnPosition.y,
-				m_emitters->at(i)->GetParticles()[j].SpawnPosition.z,
-				m_emitters->at(i)->GetParticles()[j].SpawnPosition.w
-			);
-			m_particleValues.ParticleSpeed = DirectX::XMFLOAT4A(
-				m_emitters->at(i)->GetSettings().Direction.x,
-				m_emitters->at(i)->GetSettings().Direction.y,
-				m_emitters->at(i)->GetSettings().Direction.z,
-				m_emitters->at(i)->GetSettings().Speed
-			);
-			m_particleValues.ParticleSize = DirectX::XMFLOAT4A(
-				m_emitters->at(i)->GetSettings().Size.x,
-				m_emitters->at(i)->GetSettings().Size.y,
-				m_emitters->at(i)->GetSettings().Size.z,
-				m_emitters->at(i)->GetSettings().Size.w
-				);
-			m_emitters->at(i)->GetParticleBuffer()->Copy(&m_particleValues, sizeof(ParticleBuffer), offset);
-			offset += sizeof(ParticleBuffer);
-		}
-		m_particleInfoBuffer->Copy(&particleInfoBuffer, sizeof(ParticleInfoBuffer), static_cast<UINT>(i) * 256);
-	}
+	_packParticles(camera, deltaTime);
+
+	const ParticleRangeAllocator & ranges = m_ranges[m_frameIndex];
+	particleInfoBuffer.ParticleCount = DirectX::XMUINT4(ranges.GetAllocated(), 0, 0, 0);
+	m_particleInfoBuffer->Copy(&particleInfoBuffer, sizeof(ParticleInfoBuffer));
 	
-	m_frameIndex = p_renderingManager->GetFrameIndex();
 	if (FAILED(m_commandAllocator[m_frameIndex]->Reset()))
 	{
 		return;
@@ -184,42 +161,41 @@ void ParticlePass::Update(const Camera& camera, const float & deltaTime)
 	}
 	ID3D12GraphicsCommandList * commandList = m_commandList[m_frameIndex];
 
-	p_renderingManager->GetTimer(PARTICLE_PASS)->Start(commandList);
-
+	X12GpuProfiler * gpuProfiler = (p_renderingManager->GetSecondAdapter() ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter())->GetGpuProfiler();
+	const UINT gpuZone = gpuProfiler->BeginZone(commandList, "Particles");
 
-	
+	p_renderingManager->GetTimer(PARTICLE_PASS)->Start(commandList);
 
-	for (size_t i = 0; i < m_emitters->size(); i++)
+	if (ranges.GetAllocated())
 	{
-		emitter = m_emitters->at(i);
-
-		if (!emitter->GetParticles().empty())
-			m_geometryPass->AddEmitter(emitter);
-
-		emitter->SwitchToUAVState(commandList);
+		_switchResourceState(commandList, m_instanceOutputResource[m_frameIndex], m_instanceOutputState[m_frameIndex], D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
 		commandList->SetComputeRootSignature(m_rootSignature);
 		
-		m_particleInfoBuffer->SetComputeRootConstantBufferView(commandList, PARTICLE_INFO, static_cast<UINT>(i) * 256);
-		m_emitters->at(i)->GetParticleBuffer()->SetComputeRootShaderResourceView(commandList, PARTICLE_BUFFER, 0);
+		m_particleInfoBuffer->SetComputeRootConstantBufferView(commandList, PARTICLE_INFO);
+		m_particleBuffer->SetComputeRootShaderResourceView(commandList, PARTICLE_BUFFER);
 
-		commandList->SetComputeRootUnorderedAccessView(VERTEX_OUTPUT, emitter->GetVertexResource()->GetGPUVirtualAddress());
-		commandList->SetComputeRootUnorderedAccessView(CALC_OUTPUT, emitter->GetCalcResource()->GetGPUVirtualAddress());
+		commandList->SetComputeRootUnorderedAccessView(INSTANCE_OUTPUT, m_instanceOutputResource[m_frameIndex]->GetGPUVirtualAddress());
+		commandList->SetComputeRootUnorderedAccessView(CALC_OUTPUT, m_calculationsOutputResource[m_frameIndex]->GetGPUVirtualAddress());
 		
-		commandList->Dispatch(static_cast<UINT>(m_emitters->at(i)->GetParticles().size()), 1, 1);
-
-		emitter->SwitchToVertexState(commandList);
+		const UINT groups = ranges.GetDispatchGroups(THREAD_GROUP_SIZE);
+		commandList->Dispatch(groups, 1, 1);
 
+		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(m_calculationsOutputResource[m_frameIndex]));
+		p_renderingManager->GetFrameStats()->RecordDispatch(groups, 1, 1);
+		p_renderingManager->GetFrameStats()->RecordBarriers();
 
-		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(emitter->GetCalcResource()));
-		
-	
+		if (m_sortMode == Gpu)
+			_sortInstances(commandList);
+		else
+			_switchResourceState(commandList, m_instanceOutputResource[m_frameIndex], m_instanceOutputState[m_frameIndex], D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 	}
+	m_gpuSorted[m_frameIndex] = m_sortMode == Gpu && ranges.GetAllocated();
 
 	p_renderingManager->GetTimer(PARTICLE_PASS)->Stop(commandList);
 	p_renderingManager->GetTimer(PARTICLE_PASS)->ResolveQueryToCpu(commandList);
-	p_renderingManager->GetTimer(PARTICLE_PASS)->CountTimer();
 
+	gpuProfiler->EndZone(commandList, gpuZone, m_commandQueue);
 
 	if (FAILED(m_commandList[m_frameIndex]->Close()))
 	{
@@ -256,6 +232,8 @@ void ParticlePass::Release()
 	p_releaseCommandList();
 	SAFE_RELEASE(m_rootSignature);
 	SAFE_RELEASE(m_computePipelineState);
+	SAFE_RELEASE(m_sortRootSignature);
+	SAFE_RELEASE(m_sortPipelineState);
 
 	if (m_particleBuffer)
 		m_particleBuffer->Release();
@@ -265,6 +243,14 @@ void ParticlePass::Release()
 		m_particleInfoBuffer->Release();
 	SAFE_DELETE(m_particleInfoBuffer);
 
+	if (m_drawCommandBuffer)
+		m_drawCommandBuffer->Release();
+	SAFE_DELETE(m_drawCommandBuffer);
+
+	if (m_sortRangeBuffer)
+		m_sortRangeBuffer->Release();
+	SAFE_DELETE(m_sortRangeBuffer);
+
 	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
 	{
 		if (m_fence[i])
@@ -277,8 +263,15 @@ void ParticlePass::Release()
 	{
 		SAFE_RELEASE(m_commandAllocator[i]);
 		SAFE_RELEASE(m_commandList[i]);
+
+		SAFE_RELEASE(m_instanceOutputResource[i]);
+		SAFE_RELEASE(m_calculationsOutputResource[i]);
+		SAFE_RELEASE(m_instanceResource[i]);
+		SAFE_RELEASE(m_sortedInstanceResource[i]);
 	}
 
+	if (p_renderingManager->GetTimer(PARTICLE_PASS))
+		p_renderingManager->GetTimer(PARTICLE_PASS)->PrintToFile("ParticlePass.txt");
 	p_renderingManager->DeleteTimer(PARTICLE_PASS);
 
 }
@@ -288,6 +281,61 @@ void ParticlePass::AddEmitter(ParticleEmitter* particleEmitter) const
 	m_emitters->push_back(particleEmitter);
 }
 
+const D3D12_VERTEX_BUFFER_VIEW& ParticlePass::GetInstanceBufferView() const
+{
+	return m_instanceBufferView;
+}
+
+ID3D12Resource* ParticlePass::GetDrawCommands() const
+{
+	return m_drawCommandBuffer->GetResource()[p_renderingManager->GetFrameIndex()];
+}
+
+UINT ParticlePass::GetDrawCommandCount() const
+{
+	return static_cast<UINT>(m_drawCommands.size());
+}
+
+const std::vector<X12ShaderResourceView*>& ParticlePass::GetEmitterTextures() const
+{
+	return m_emitterTextures;
+}
+
+void ParticlePass::SetSortMode(const SortMode& sortMode)
+{
+	m_sortMode = sortMode;
+}
+
+const ParticlePass::SortMode& ParticlePass::GetSortMode() const
+{
+	return m_sortMode;
+}
+
+void ParticlePass::SetLodSettings(const ParticleLod::Settings& settings)
+{
+	m_lodSettings = settings;
+}
+
+const ParticleLod::Settings& ParticlePass::GetLodSettings() const
+{
+	return m_lodSettings;
+}
+
+void ParticlePass::SetParticleBudget(const UINT& budget)
+{
+	m_particleBudget = budget;
+}
+
+const UINT& ParticlePass::GetParticleBudget() const
+{
+	return m_particleBudget;
+}
+
+const UINT& ParticlePass::GetLiveParticleCount() const
+{
+	return m_liveParticles;
+}
+
 HRESULT ParticlePass::_initCommandQueue(ID3D12Device * device, const D3D12_COMMAND_LIST_TYPE& type, const UINT & nodeMask)
 {
 	HRESULT hr = 0;
@@ -343,9 +391,9 @@ HRESULT ParticlePass::_initID3D12RootSignature()
 	particleBuffer.RegisterSpace = 0;
 	particleBuffer.ShaderRegister = 0;
 
-	D3D12_ROOT_DESCRIPTOR uavVertexDescriptor;
-	uavVertexDescriptor.RegisterSpace = 0;
-	uavVertexDescriptor.ShaderRegister = 0;
+	D3D12_ROOT_DESCRIPTOR uavInstanceDescriptor;
+	uavInstanceDescriptor.RegisterSpace = 0;
+	uavInstanceDescriptor.ShaderRegister = 0;
 
 	D3D12_ROOT_DESCRIPTOR uavCalculationsDescriptor;
 	uavCalculationsDescriptor.RegisterSpace = 0;
@@ -359,9 +407,9 @@ HRESULT ParticlePass::_initID3D12RootSignature()
 	m_rootParameters[PARTICLE_BUFFER].Descriptor = particleBuffer;
 	m_rootParameters[PARTICLE_BUFFER].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 
-	m_rootParameters[VERTEX_OUTPUT].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
-	m_rootParameters[VERTEX_OUTPUT].Descriptor = uavVertexDescriptor;
-	m_rootParameters[VERTEX_OUTPUT].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	m_rootParameters[INSTANCE_OUTPUT].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+	m_rootParameters[INSTANCE_OUTPUT].Descriptor = uavInstanceDescriptor;
+	m_rootParameters[INSTANCE_OUTPUT].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 
 	m_rootParameters[CALC_OUTPUT].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
 	m_rootParameters[CALC_OUTPUT].Descriptor = uavCalculationsDescriptor;
@@ -378,7 +426,7 @@ HRESULT ParticlePass::_initID3D12RootSignature()
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS	|
 		D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS);
 
-	ID3D12Device * device = p_renderingManager->GetSecondAdapter() ? p_renderingManager->GetSecondAdapter()->GetDevice() : p_renderingManager->GetMainAdapter()->GetDevice();
+	X12Adapter * adapter = p_renderingManager->GetSecondAdapter() ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
 
 
 	ID3DBlob * signature = nullptr;
@@ -387,16 +435,67 @@ HRESULT ParticlePass::_initID3D12RootSignature()
 		&signature,
 		nullptr)))
 	{
-		if (FAILED(hr = device->CreateRootSignature(
-			0,
+		if (FAILED(hr = adapter->GetPipelineStateCache()->CreateRootSignature(
 			signature->GetBufferPointer(),
 			signature->GetBufferSize(),
-			IID_PPV_ARGS(&m_rootSignature))))
+			&m_rootSignature)))
 		{
 			SAFE_RELEASE(m_rootSignature);
 		}
 	}
 	SAFE_RELEASE(signature);
+	if (FAILED(hr))
+		return hr;
+
+	D3D12_ROOT_DESCRIPTOR emitterRanges;
+	emitterRanges.RegisterSpace = 0;
+	emitterRanges.ShaderRegister = 0;
+
+	D3D12_ROOT_DESCRIPTOR uavSortedDescriptor;
+	uavSortedDescriptor.RegisterSpace = 0;
+	uavSortedDescriptor.ShaderRegister = 1;
+
+	m_sortRootParameters[SORT_PARTICLE_INFO].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+	m_sortRootParameters[SORT_PARTICLE_INFO].Descriptor = rootDescriptor;
+	m_sortRootParameters[SORT_PARTICLE_INFO].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+	m_sortRootParameters[SORT_EMITTER_RANGES].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	m_sortRootParameters[SORT_EMITTER_RANGES].Descriptor = emitterRanges;
+	m_sortRootParameters[SORT_EMITTER_RANGES].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+	m_sortRootParameters[SORT_INSTANCE_INPUT].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+	m_sortRootParameters[SORT_INSTANCE_INPUT].Descriptor = uavInstanceDescriptor;
+	m_sortRootParameters[SORT_INSTANCE_INPUT].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+	m_sortRootParameters[SORT_INSTANCE_OUTPUT].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+	m_sortRootParameters[SORT_INSTANCE_OUTPUT].Descriptor = uavSortedDescriptor;
+	m_sortRootParameters[SORT_INSTANCE_OUTPUT].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+	CD3DX12_ROOT_SIGNATURE_DESC sortRootSignatureDesc;
+	sortRootSignatureDesc.Init(_countof(m_sortRootParameters),
+		m_sortRootParameters,
+		0,
+		nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS	|
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS		|
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS	|
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS	|
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS);
+
+	if (SUCCEEDED(hr = D3D12SerializeRootSignature(&sortRootSignatureDesc,
+		D3D_ROOT_SIGNATURE_VERSION_1,
+		&signature,
+		nullptr)))
+	{
+		if (FAILED(hr = adapter->GetPipelineStateCache()->CreateRootSignature(
+			signature->GetBufferPointer(),
+			signature->GetBufferSize(),
+			&m_sortRootSignature)))
+		{
+			SAFE_RELEASE(m_sortRootSignature);
+		}
+	}
+	SAFE_RELEASE(signature);
 	return hr;
 }
 
@@ -405,7 +504,7 @@ HRESULT ParticlePass::_initShaders()
 	HRESULT hr = 0;
 	ID3DBlob * blob = nullptr;
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/ParticlePass/DefaultParticleCompute.hlsl", blob, "cs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(COMPUTE_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -414,6 +513,16 @@ HRESULT ParticlePass::_initShaders()
 		m_computeShader.BytecodeLength = blob->GetBufferSize();
 		m_computeShader.pShaderBytecode = blob->GetBufferPointer();
 	}
+
+	if (FAILED(hr = ShaderCreator::CreateShader(SORT_SHADER, blob)))
+	{
+		return hr;
+	}
+	else
+	{
+		m_sortShader.BytecodeLength = blob->GetBufferSize();
+		m_sortShader.pShaderBytecode = blob->GetBufferPointer();
+	}
 	return hr;
 }
 
@@ -426,13 +535,344 @@ HRESULT ParticlePass::_initPipelineState()
 	computePipelineStateDesc.CS = m_computeShader;
 
 
-	ID3D12Device * device = p_renderingManager->GetSecondAdapter() ? p_renderingManager->GetSecondAdapter()->GetDevice() : p_renderingManager->GetMainAdapter()->GetDevice();
-	if (FAILED(hr = device->CreateComputePipelineState(
-		&computePipelineStateDesc,
-		IID_PPV_ARGS(&m_computePipelineState))))
+	X12Adapter * adapter = p_renderingManager->GetSecondAdapter() ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
+	if (FAILED(hr = adapter->GetPipelineStateCache()->CreateComputePipelineState(
+		computePipelineStateDesc,
+		&m_computePipelineState)))
 	{
-		
+		return hr;
+	}
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC sortPipelineStateDesc = {};
+	sortPipelineStateDesc.pRootSignature = m_sortRootSignature;
+	sortPipelineStateDesc.CS = m_sortShader;
+
+	if (FAILED(hr = adapter->GetPipelineStateCache()->CreateComputePipelineState(
+		sortPipelineStateDesc,
+		&m_sortPipelineState)))
+	{
+		SAFE_RELEASE(m_sortPipelineState);
+	}
+
+	return hr;
+}
+
+HRESULT ParticlePass::_initParticleBuffers(ID3D12Device * device)
+{
+	HRESULT hr = 0;
+
+	m_particleValues.resize(MAX_PARTICLE_POOL);
+	m_drawCommands.reserve(MAX_PARTICLE_EMITTERS);
+	m_emitterRanges.reserve(MAX_PARTICLE_EMITTERS);
+	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
+	{
+		m_ranges[i].SetCapacity(MAX_PARTICLE_POOL);
+	}
+
+	if (FAILED(hr = m_particleBuffer->CreateSharedBuffer(L"Particle buffer", 0, MAX_PARTICLE_POOL * sizeof(ParticleBuffer))))
+	{
+		if (FAILED(hr = m_particleBuffer->CreateBuffer(L"Particle buffer", nullptr, 0, MAX_PARTICLE_POOL * sizeof(ParticleBuffer))))
+		{
+			return hr;
+		}
+	}
+	if (FAILED(hr = m_drawCommandBuffer->CreateBuffer(L"Particle draw commands", nullptr, 0, MAX_PARTICLE_EMITTERS * sizeof(ParticleRangeAllocator::DrawCommand))))
+	{
+		return hr;
+	}
+	if (FAILED(hr = m_sortRangeBuffer->CreateSharedBuffer(L"Particle sort ranges", 0, MAX_PARTICLE_EMITTERS * sizeof(DirectX::XMUINT2))))
+	{
+		if (FAILED(hr = m_sortRangeBuffer->CreateBuffer(L"Particle sort ranges", nullptr, 0, MAX_PARTICLE_EMITTERS * sizeof(DirectX::XMUINT2))))
+		{
+			return hr;
+		}
 	}
 
+	const D3D12_RESOURCE_DESC instanceDesc = CD3DX12_RESOURCE_DESC::Buffer(
+		MAX_PARTICLE_POOL * sizeof(ParticleInstance), 
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	const D3D12_RESOURCE_DESC calculationsDesc = CD3DX12_RESOURCE_DESC::Buffer(
+		MAX_PARTICLE_POOL * sizeof(ParticleCalculation),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+	D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_CUSTOM);
+	heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_WRITE_BACK;
+	heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
+
+	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
+	{
+		if (FAILED(hr = device->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&instanceDesc,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			nullptr,
+			IID_PPV_ARGS(&m_instanceOutputResource[i]))))
+		{
+			return hr;
+		}
+		m_instanceOutputState[i] = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		SET_NAME(m_instanceOutputResource[i], L"Particle Instance output " + std::to_wstring(i));
+
+		if (FAILED(hr = device->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&calculationsDesc,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			nullptr,
+			IID_PPV_ARGS(&m_calculationsOutputResource[i]))))
+		{
+			return hr;
+		}
+		SET_NAME(m_calculationsOutputResource[i], L"Particle UAV output " + std::to_wstring(i));
+
+		if (FAILED(hr = device->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&instanceDesc,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			nullptr,
+			IID_PPV_ARGS(&m_sortedInstanceResource[i]))))
+		{
+			return hr;
+		}
+		m_sortedInstanceState[i] = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		SET_NAME(m_sortedInstanceResource[i], L"Particle Sorted Instance output " + std::to_wstring(i));
+
+		if (!p_renderingManager->GetSecondAdapter())
+			continue;
+
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateCommittedResource(
+			&heapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&instanceDesc,
+			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+			nullptr,
+			IID_PPV_ARGS(&m_instanceResource[i]))))
+		{
+			return hr;
+		}
+		SET_NAME(m_instanceResource[i], L"Particle Instance " + std::to_wstring(i));
+	}
 	return hr;
 }
+
+void ParticlePass::_readBack(const UINT & frameIndex)
+{
+	const ParticleRangeAllocator & ranges = m_ranges[frameIndex];
+	const std::vector<ParticleEmitter*> & frameEmitters = m_frameEmitters[frameIndex];
+
+	m_drawCommands.clear();
+	m_emitterTextures.clear();
+	m_textureIndices.clear();
+	if (!ranges.GetAllocated())
+		return;
+
+	const bool copyData = p_renderingManager->GetSecondAdapter();
+	const SIZE_T instanceSize = sizeof(ParticleInstance) * ranges.GetAllocated();
+	ID3D12Resource * instanceOutput = m_gpuSorted[frameIndex] ? m_sortedInstanceResource[frameIndex] : m_instanceOutputResource[frameIndex];
+
+	if (copyData)
+	{		
+		ParticleInstance * instanceOutputArray = nullptr;
+		CD3DX12_RANGE instanceReadRange(0, instanceSize);
+		if (SUCCEEDED(instanceOutput->Map(0, &instanceReadRange, reinterpret_cast<void**>(&instanceOutputArray))))
+		{
+			UINT8 * targetDest = nullptr;
+			CD3DX12_RANGE readRange(0, 0);
+			if (SUCCEEDED(m_instanceResource[frameIndex]->Map(0, &readRange, reinterpret_cast<void**>(&targetDest))))
+			{
+				memcpy(targetDest, instanceOutputArray, instanceSize);
+				p_renderingManager->GetFrameStats()->RecordUpload(instanceSize);
+				m_instanceResource[frameIndex]->Unmap(0, nullptr);
+			}
+		
+			instanceOutput->Unmap(0, &readRange);
+		}
+	}
+
+	m_instanceBufferView.BufferLocation = copyData ? m_instanceResource[frameIndex]->GetGPUVirtualAddress() : instanceOutput->GetGPUVirtualAddress();
+	m_instanceBufferView.StrideInBytes = sizeof(ParticleInstance);
+	m_instanceBufferView.SizeInBytes = static_cast<UINT>(instanceSize);
+
+	ParticleCalculation * outputArray = nullptr;
+	CD3DX12_RANGE readRange(0, sizeof(ParticleCalculation) * ranges.GetAllocated());
+	if (FAILED(m_calculationsOutputResource[frameIndex]->Map(0, &readRange, reinterpret_cast<void**>(&outputArray))))
+		return;
+
+	m_queuedEmitters.clear();
+	m_queuedEmitters.insert(m_emitters->begin(), m_emitters->end());
+
+	//The ranges were allocated back to front, drawing them in that order keeps the emitters sorted
+	for (size_t i = 0; i < frameEmitters.size() && m_drawCommands.size() < MAX_PARTICLE_EMITTERS; i++)
+	{
+		ParticleEmitter * emitter = frameEmitters[i];
+		if (m_queuedEmitters.find(emitter) == m_queuedEmitters.end())
+			continue;
+
+		const ParticleRangeAllocator::Range & range = ranges.GetRange(i);
+		if (!range.Count)
+			continue;
+
+		emitter->UpdateData(outputArray + range.Offset, range.Count);
+
+		//Emitters sharing a texture share its slot in the descriptor table
+		X12ShaderResourceView * texture = emitter->GetShaderResourceView();
+		const auto inserted = m_textureIndices.insert(std::make_pair(texture, static_cast<UINT>(m_emitterTextures.size())));
+		if (inserted.second)
+			m_emitterTextures.push_back(texture);
+
+		m_drawCommands.push_back(ParticleRangeAllocator::DrawCommand{ inserted.first->second, ranges.GetDrawArguments(i) });
+	}
+
+	m_calculationsOutputResource[frameIndex]->Unmap(0, nullptr);
+
+	if (!m_drawCommands.empty())
+		m_drawCommandBuffer->Copy(m_drawCommands.data(), static_cast<UINT>(m_drawCommands.size() * sizeof(ParticleRangeAllocator::DrawCommand)));
+}
+
+void ParticlePass::_packParticles(const Camera & camera, const float & deltaTime)
+{
+	using namespace DirectX;
+
+	ParticleRangeAllocator & ranges = m_ranges[m_frameIndex];
+	std::vector<ParticleEmitter*> & frameEmitters = m_frameEmitters[m_frameIndex];
+
+	ranges.Reset();
+	frameEmitters.clear();
+	m_emitterRanges.clear();
+
+	const XMVECTOR cameraPosition = XMLoadFloat4(&camera.GetPosition());
+	const ParticleLod::Frustum frustum = ParticleLod::CreateFrustum(camera.GetViewProjectionMatrix());
+
+	//Culled and sleeping emitters are neither simulated nor drawn, their particles stay as they are
+	m_activeEmitters.clear();
+	m_requestedParticles.clear();
+	for (size_t i = 0; i < m_emitters->size(); i++)
+	{
+		ParticleEmitter * emitter = m_emitters->at(i);
+		const ParticleLod::Result lod = ParticleLod::Evaluate(
+			frustum, 
+			camera.GetPosition(), 
+			camera.GetFov(), 
+			emitter->GetWorldPosition(), 
+			emitter->GetBoundingRadius(), 
+			m_lodSettings,
+			emitter->IsLodSleeping());
+
+		emitter->SetLodSleeping(lod.Sleeping);
+		if (!lod.Visible || lod.Sleeping)
+			continue;
+
+		emitter->SetLodScale(lod.Scale);
+		m_activeEmitters.push_back(emitter);
+		m_requestedParticles.push_back(static_cast<UINT>(emitter->GetSettings().MaxParticles * lod.Scale));
+	}
+
+	const size_t emitterSize = m_activeEmitters.size();
+	const UINT budget = m_particleBudget && m_particleBudget < MAX_PARTICLE_POOL ? m_particleBudget : MAX_PARTICLE_POOL;
+	m_grantedParticles.resize(emitterSize);
+	ParticleLod::ApplyBudget(m_requestedParticles.data(), m_grantedParticles.data(), emitterSize, budget);
+
+	m_liveParticles = 0;
+	m_sortKeys.resize(emitterSize);
+	for (size_t i = 0; i < emitterSize; i++)
+	{
+		m_activeEmitters[i]->SetParticleLimit(m_grantedParticles[i]);
+		m_activeEmitters[i]->UpdateEmitter(deltaTime);
+		m_liveParticles += static_cast<UINT>(m_activeEmitters[i]->GetParticles().size());
+		m_sortKeys[i] = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat4(&m_activeEmitters[i]->GetWorldPosition()), cameraPosition)));
+	}
+	m_emitterOrder = m_particleSort.SortDescending(m_sortKeys.data(), emitterSize);
+
+	for (size_t i = 0; i < emitterSize; i++)
+	{
+		ParticleEmitter * emitter = m_activeEmitters[m_emitterOrder[i]];
+
+		if (m_sortMode == Cpu)
+			_sortParticles(emitter, camera.GetPosition());
+
+		const ParticleRangeAllocator::Range range = ranges.Allocate(static_cast<UINT>(emitter->GetParticles().size()));
+		frameEmitters.push_back(emitter);
+		m_emitterRanges.push_back(XMUINT2(range.Offset, range.Count));
+
+		const XMFLOAT4 speed(
+			emitter->GetSettings().Direction.x,
+			emitter->GetSettings().Direction.y,
+			emitter->GetSettings().Direction.z,
+			emitter->GetSettings().Speed);
+
+		for (UINT j = 0; j < range.Count; j++)
+		{
+			ParticleBuffer & particleValues = m_particleValues[range.Offset + j];
+			particleValues.ParticleInfo = XMFLOAT4(
+				deltaTime, 
+				emitter->GetParticles()[j].TimeAlive, 
+				emitter->GetParticles()[j].TimeToLive, 
+				0);
+			particleValues.ParticlePosition = emitter->GetParticles()[j].Position;
+			particleValues.ParticleSpawnPosition = emitter->GetParticles()[j].SpawnPosition;
+			particleValues.ParticleSpeed = speed;
+			particleValues.ParticleSize = emitter->GetSettings().Size;
+		}
+	}
+
+	if (ranges.GetAllocated())
+		m_particleBuffer->Copy(m_particleValues.data(), ranges.GetAllocated() * static_cast<UINT>(sizeof(ParticleBuffer)));
+
+	if (m_sortMode == Gpu && !m_emitterRanges.empty())
+	{
+		const size_t rangeCount = m_emitterRanges.size() < MAX_PARTICLE_EMITTERS ? m_emitterRanges.size() : MAX_PARTICLE_EMITTERS;
+		m_sortRangeBuffer->Copy(m_emitterRanges.data(), static_cast<UINT>(rangeCount * sizeof(XMUINT2)));
+	}
+}
+
+void ParticlePass::_sortParticles(ParticleEmitter* emitter, const DirectX::XMFLOAT4& cameraPosition)
+{
+	using namespace DirectX;
+
+	const size_t particleSize = emitter->GetParticles().size();
+	if (particleSize < 2)
+		return;
+
+	const XMVECTOR camera = XMLoadFloat4(&cameraPosition);
+	m_sortKeys.resize(particleSize);
+	for (size_t i = 0; i < particleSize; i++)
+	{
+		m_sortKeys[i] = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat4(&emitter->GetParticles()[i].Position), camera)));
+	}
+	emitter->SortParticles(m_particleSort.SortDescending(m_sortKeys.data(), particleSize).data());
+}
+
+void ParticlePass::_sortInstances(ID3D12GraphicsCommandList* commandList)
+{
+	const UINT rangeCount = static_cast<UINT>(m_emitterRanges.size() < MAX_PARTICLE_EMITTERS ? m_emitterRanges.size() : MAX_PARTICLE_EMITTERS);
+
+	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(m_instanceOutputResource[m_frameIndex]));
+	p_renderingManager->GetFrameStats()->RecordBarriers();
+	_switchResourceState(commandList, m_sortedInstanceResource[m_frameIndex], m_sortedInstanceState[m_frameIndex], D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	commandList->SetPipelineState(m_sortPipelineState);
+	commandList->SetComputeRootSignature(m_sortRootSignature);
+
+	m_particleInfoBuffer->SetComputeRootConstantBufferView(commandList, SORT_PARTICLE_INFO);
+	m_sortRangeBuffer->SetComputeRootShaderResourceView(commandList, SORT_EMITTER_RANGES);
+
+	commandList->SetComputeRootUnorderedAccessView(SORT_INSTANCE_INPUT, m_instanceOutputResource[m_frameIndex]->GetGPUVirtualAddress());
+	commandList->SetComputeRootUnorderedAccessView(SORT_INSTANCE_OUTPUT, m_sortedInstanceResource[m_frameIndex]->GetGPUVirtualAddress());
+
+	commandList->Dispatch(rangeCount, 1, 1);
+	p_renderingManager->GetFrameStats()->RecordDispatch(rangeCount, 1, 1);
+
+	_switchResourceState(commandList, m_sortedInstanceResource[m_frameIndex], m_sortedInstanceState[m_frameIndex], D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+}
+
+void ParticlePass::_switchResourceState(ID3D12GraphicsCommandList* commandList, ID3D12Resource* resource, D3D12_RESOURCE_STATES& currentState, const D3D12_RESOURCE_STATES& state)
+{
+	if (currentState != state)
+	{
+		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(resource, currentState, state));
+		RenderingManager::GetInstance()->GetFrameStats()->RecordBarriers();
+	}
+	currentState = state;
+}
@@ -2,15 +2,25 @@
 #include "Template/IRender.h"
 #include "WrapperFunctions/X12ConstantBuffer.h"
 #include "WrapperFunctions/X12Fence.h"
+#include "WrapperFunctions/Functions/ParticleRangeAllocator.h"
+#include "WrapperFunctions/Functions/ParticleSort.h"
+#include "WrapperFunctions/Functions/ParticleLod.h"
+#include <unordered_set>
+#include <unordered_map>
 
 class ParticleEmitter;
 class X12ConstantBuffer;
+class X12ShaderResourceView;
 
 class ParticlePass :
 	public IRender
 {
 private:
 	static const UINT ROOT_PARAMETERS = 4;
+	static const UINT SORT_ROOT_PARAMETERS = 4;
+	static const UINT THREAD_GROUP_SIZE = 64;
+	static const UINT MAX_PARTICLE_POOL = 4096 * 32;
+	static const UINT MAX_PARTICLE_EMITTERS = 1024;
 
 	struct ParticleBuffer
 	{
@@ -22,10 +32,20 @@ private:
 	};
 
 
+public:
+	enum SortMode
+	{
+		None = 0,
+		Cpu = 1,
+		Gpu = 2
+	};
+
 public:
 	ParticlePass(RenderingManager * renderingManager, const Window & window);
 	~ParticlePass();
 
+	static void QueueShaders();
+
 	HRESULT Init() override;
 	void Update(const Camera& camera, const float & deltaTime) override;
 	void Draw() override;
@@ -34,30 +54,90 @@ public:
 
 	void AddEmitter(ParticleEmitter * particleEmitter) const;
 
+	const D3D12_VERTEX_BUFFER_VIEW & GetInstanceBufferView() const;
+	// Every emitter drawn this frame, one ParticleRangeAllocator::DrawCommand each in back to front order
+	ID3D12Resource * GetDrawCommands() const;
+	UINT GetDrawCommandCount() const;
+	// The TextureIndex of a draw command indexes this list
+	const std::vector<X12ShaderResourceView*> & GetEmitterTextures() const;
+
+	void SetSortMode(const SortMode & sortMode);
+	const SortMode & GetSortMode() const;
+
+	void SetLodSettings(const ParticleLod::Settings & settings);
+	const ParticleLod::Settings & GetLodSettings() const;
+
+	// Caps the live particles of all emitters, 0 only limits to the particle pool
+	void SetParticleBudget(const UINT & budget);
+	const UINT & GetParticleBudget() const;
+	const UINT & GetLiveParticleCount() const;
+
 private:
 	HRESULT _initCommandQueue(ID3D12Device * device, const D3D12_COMMAND_LIST_TYPE& type, const UINT& nodeMask);
 	HRESULT _initCommandList(ID3D12Device * device, const D3D12_COMMAND_LIST_TYPE & type, const UINT& nodeMask);
 	HRESULT _initID3D12RootSignature();
 	HRESULT _initShaders();
 	HRESULT _initPipelineState();
+	HRESULT _initParticleBuffers(ID3D12Device * device);
+
+	void _readBack(const UINT & frameIndex);
+	void _packParticles(const Camera & camera, const float & deltaTime);
+	void _sortParticles(ParticleEmitter * emitter, const DirectX::XMFLOAT4 & cameraPosition);
+	void _sortInstances(ID3D12GraphicsCommandList * commandList);
+	static void _switchResourceState(ID3D12GraphicsCommandList * commandList, ID3D12Resource * resource, D3D12_RESOURCE_STATES & currentState, const D3D12_RESOURCE_STATES & state);
 
 	D3D12_ROOT_PARAMETER m_rootParameters[ROOT_PARAMETERS] {};
 	ID3D12RootSignature * m_rootSignature = nullptr;
 	D3D12_SHADER_BYTECODE m_computeShader {};
 	ID3D12PipelineState * m_computePipelineState = nullptr;
 
+	D3D12_ROOT_PARAMETER m_sortRootParameters[SORT_ROOT_PARAMETERS] {};
+	ID3D12RootSignature * m_sortRootSignature = nullptr;
+	D3D12_SHADER_BYTECODE m_sortShader {};
+	ID3D12PipelineState * m_sortPipelineState = nullptr;
+
 	ID3D12CommandQueue * m_commandQueue = nullptr;
 	ID3D12CommandAllocator * m_commandAllocator[FRAME_BUFFER_COUNT]{ nullptr };
 	ID3D12GraphicsCommandList * m_commandList[FRAME_BUFFER_COUNT] {nullptr};
 
-	ParticleBuffer m_particleValues {};
+	std::vector<ParticleBuffer> m_particleValues;
 		
 	std::vector<ParticleEmitter*>* m_emitters = nullptr;
 
+	std::vector<ParticleEmitter*> m_frameEmitters[FRAME_BUFFER_COUNT];
+	ParticleRangeAllocator m_ranges[FRAME_BUFFER_COUNT];
+	std::vector<ParticleRangeAllocator::DrawCommand> m_drawCommands;
+	std::vector<X12ShaderResourceView*> m_emitterTextures;
+	std::unordered_map<const X12ShaderResourceView*, UINT> m_textureIndices;
+	std::vector<DirectX::XMUINT2> m_emitterRanges;
+	std::unordered_set<const ParticleEmitter*> m_queuedEmitters;
+
+	SortMode m_sortMode = Cpu;
+	ParticleSort m_particleSort;
+	std::vector<float> m_sortKeys;
+	std::vector<unsigned int> m_emitterOrder;
+
+	ParticleLod::Settings m_lodSettings {};
+	UINT m_particleBudget = 0;
+	UINT m_liveParticles = 0;
+	std::vector<ParticleEmitter*> m_activeEmitters;
+	std::vector<UINT> m_requestedParticles;
+	std::vector<UINT> m_grantedParticles;
+
+	ID3D12Resource * m_instanceOutputResource[FRAME_BUFFER_COUNT]{ nullptr };
+	ID3D12Resource * m_calculationsOutputResource[FRAME_BUFFER_COUNT]{ nullptr };
+	ID3D12Resource * m_instanceResource[FRAME_BUFFER_COUNT]{ nullptr };
+	D3D12_RESOURCE_STATES m_instanceOutputState[FRAME_BUFFER_COUNT] {};
+	ID3D12Resource * m_sortedInstanceResource[FRAME_BUFFER_COUNT]{ nullptr };
+	D3D12_RESOURCE_STATES m_sortedInstanceState[FRAME_BUFFER_COUNT] {};
+	BOOL m_gpuSorted[FRAME_BUFFER_COUNT] { FALSE };
+
+	D3D12_VERTEX_BUFFER_VIEW m_instanceBufferView {};
+
 	X12ConstantBuffer * m_particleInfoBuffer = nullptr;
 	X12ConstantBuffer * m_particleBuffer = nullptr;
-
-	GeometryPass * m_geometryPass;
+	X12ConstantBuffer * m_drawCommandBuffer = nullptr;
+	X12ConstantBuffer * m_sortRangeBuffer = nullptr;
 
 	X12Fence * m_fence[FRAME_BUFFER_COUNT] { nullptr };
 
@@ -1,10 +1,13 @@
 #include "DirectX12EnginePCH.h"
 #include "ReflectionPass.h"
+#include "WrapperFunctions/X12PipelineStateCache.h"
 #include "WrapperFunctions/RenderingHelpClass.h"
 #include "WrapperFunctions/X12RenderTargetView.h"
 #include "WrapperFunctions/X12DepthStencil.h"
 #include "DeferredRender.h"
 
+static const ShaderCreator::ShaderDesc VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/ReflectionPass/DefaultReflectionVertex.hlsl", "vs_5_1" };
+static const ShaderCreator::ShaderDesc PIXEL_SHADER{ L"../DirectX12Engine/DirectX/Shaders/ReflectionPass/DefaultReflectionPixel.hlsl", "ps_5_1" };
 
 ReflectionPass::ReflectionPass(RenderingManager * renderingManager, const Window & window) : IRender(renderingManager, window)
 {
@@ -36,6 +39,12 @@ HRESULT ReflectionPass::Init()
 	return hr;
 }
 
+void ReflectionPass::QueueShaders()
+{
+	ShaderCreator::QueueShader(VERTEX_SHADER);
+	ShaderCreator::QueueShader(PIXEL_SHADER);
+}
+
 void ReflectionPass::Update(const Camera& camera, const float& deltaTime)
 {
 	OpenCommandList(m_pipelineState);
@@ -80,6 +89,7 @@ void ReflectionPass::Draw()
 	commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
 
 	commandList->DrawInstanced(4, 1, 0, 0);
+	p_countDraw(4, 1, D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
 	m_renderTargetView->SwitchToSRV(commandList);
 
@@ -257,11 +267,10 @@ HRESULT ReflectionPass::_initRootSignature()
 		&signature,
 		nullptr)))
 	{
-		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateRootSignature(
-			0,
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateRootSignature(
 			signature->GetBufferPointer(),
 			signature->GetBufferSize(),
-			IID_PPV_ARGS(&m_rootSignature))))
+			&m_rootSignature)))
 		{
 			SAFE_RELEASE(m_rootSignature);
 		}
@@ -275,7 +284,7 @@ HRESULT ReflectionPass::_initShaders()
 	HRESULT hr;
 	ID3DBlob * blob = nullptr;
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/ReflectionPass/DefaultReflectionVertex.hlsl", blob, "vs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(VERTEX_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -285,7 +294,7 @@ HRESULT ReflectionPass::_initShaders()
 		m_vertexShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/ReflectionPass/DefaultReflectionPixel.hlsl", blob, "ps_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(PIXEL_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -331,9 +340,9 @@ HRESULT ReflectionPass::_initPipelineState()
 	else
 		return hr;
 
-	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateGraphicsPipelineState(
-		&graphicsPipelineStateDesc,
-		IID_PPV_ARGS(&m_pipelineState))))
+	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateGraphicsPipelineState(
+		graphicsPipelineStateDesc,
+		&m_pipelineState)))
 	{
 		SAFE_RELEASE(m_pipelineState);
 	}
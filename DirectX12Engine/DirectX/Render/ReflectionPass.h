@@ -14,6 +14,8 @@ public:
 	ReflectionPass(RenderingManager * renderingManager, const Window & window);
 	~ReflectionPass();
 
+	static void QueueShaders();
+
 
 	HRESULT Init() override;
 	void Update(const Camera& camera, const float& deltaTime) override;
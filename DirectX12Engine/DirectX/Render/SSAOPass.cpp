@@ -1,11 +1,17 @@
 #include "DirectX12EnginePCH.h"
 #include "SSAOPass.h"
+#include "WrapperFunctions/X12PipelineStateCache.h"
 #include "WrapperFunctions/RenderingHelpClass.h"
 #include "WrapperFunctions/X12RenderTargetView.h"
 #include "WrapperFunctions/X12DepthStencil.h"
 #include "WrapperFunctions/X12ConstantBuffer.h"
 #include "DeferredRender.h"
 
+static const ShaderCreator::ShaderDesc VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOVertex.hlsl", "vs_5_1" };
+static const ShaderCreator::ShaderDesc PIXEL_SHADER{ L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOPixel.hlsl", "ps_5_1" };
+static const ShaderCreator::ShaderDesc BLUR_VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOBlurVertex.hlsl", "vs_5_1" };
+static const ShaderCreator::ShaderDesc BLUR_PIXEL_SHADER{ L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOBlurPixel.hlsl", "ps_5_1" };
+
 SSAOPass::SSAOPass(RenderingManager* renderingManager, const Window& window)
 	: IRender(renderingManager, window)
 {
@@ -23,6 +29,14 @@ SSAOPass::~SSAOPass()
 
 }
 
+void SSAOPass::QueueShaders()
+{
+	ShaderCreator::QueueShader(VERTEX_SHADER);
+	ShaderCreator::QueueShader(PIXEL_SHADER);
+	ShaderCreator::QueueShader(BLUR_VERTEX_SHADER);
+	ShaderCreator::QueueShader(BLUR_PIXEL_SHADER);
+}
+
 HRESULT SSAOPass::Init()
 {
 	HRESULT hr = 0;
@@ -87,6 +101,7 @@ void SSAOPass::Update(const Camera& camera, const float& deltaTime)
 
 	commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
 	commandList->DrawInstanced(4, 1, 0, 0);
+	p_countDraw(4, 1, D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
 	if (SUCCEEDED(ExecuteCommandList(p_renderingManager->GetCommandQueue())))
 	{
@@ -132,6 +147,7 @@ void SSAOPass::Draw()
 	
 	commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
 	commandList->DrawInstanced(4, 1, 0, 0);
+	p_countDraw(4, 1, D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
 	if (FAILED(_executeCommandList()))
 		return;
@@ -299,11 +315,10 @@ HRESULT SSAOPass::_initID3D12RootSignature()
 		&signature,
 		nullptr)))
 	{
-		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateRootSignature(
-			0,
+		if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateRootSignature(
 			signature->GetBufferPointer(),
 			signature->GetBufferSize(),
-			IID_PPV_ARGS(&m_rootSignature))))
+			&m_rootSignature)))
 		{
 			SAFE_RELEASE(m_rootSignature);
 		}
@@ -317,7 +332,7 @@ HRESULT SSAOPass::_initShaders()
 	HRESULT hr = 0;
 	ID3DBlob * blob = nullptr;
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOVertex.hlsl", blob, "vs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(VERTEX_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -327,7 +342,7 @@ HRESULT SSAOPass::_initShaders()
 		m_vertexShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOPixel.hlsl", blob, "ps_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(PIXEL_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -374,9 +389,9 @@ HRESULT SSAOPass::_initID3D12PipelineState()
 	else
 		return hr;
 
-	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateGraphicsPipelineState(
-		&graphicsPipelineStateDesc,
-		IID_PPV_ARGS(&m_pipelineState))))
+	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateGraphicsPipelineState(
+		graphicsPipelineStateDesc,
+		&m_pipelineState)))
 	{
 		SAFE_RELEASE(m_pipelineState);
 	}
@@ -430,11 +445,10 @@ HRESULT SSAOPass::_initBlurPass()
 		return hr;
 	}
 
-	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateRootSignature(
-		0,
+	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateRootSignature(
 		signature->GetBufferPointer(),
 		signature->GetBufferSize(),
-		IID_PPV_ARGS(&m_blurRootSignature))))
+		&m_blurRootSignature)))
 	{
 		SAFE_RELEASE(m_blurRootSignature);
 		SAFE_RELEASE(signature);
@@ -444,10 +458,7 @@ HRESULT SSAOPass::_initBlurPass()
 
 	ID3DBlob * shaderBlob = nullptr;
 
-	if (SUCCEEDED(hr = ShaderCreator::CreateShader(
-		L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOBlurVertex.hlsl", 
-		shaderBlob, 
-		"vs_5_1")))
+	if (SUCCEEDED(hr = ShaderCreator::CreateShader(BLUR_VERTEX_SHADER, shaderBlob)))
 	{
 		m_blurVertex.pShaderBytecode = shaderBlob->GetBufferPointer();
 		m_blurVertex.BytecodeLength = shaderBlob->GetBufferSize();
@@ -455,10 +466,7 @@ HRESULT SSAOPass::_initBlurPass()
 	else
 		return hr;
 
-	if (SUCCEEDED(hr = ShaderCreator::CreateShader(
-		L"../DirectX12Engine/DirectX/Shaders/SSAOPass/DefaultSSAOBlurPixel.hlsl",
-		shaderBlob,
-		"ps_5_1")))
+	if (SUCCEEDED(hr = ShaderCreator::CreateShader(BLUR_PIXEL_SHADER, shaderBlob)))
 	{
 		m_blurPixel.pShaderBytecode = shaderBlob->GetBufferPointer();
 		m_blurPixel.BytecodeLength = shaderBlob->GetBufferSize();
@@ -496,9 +504,9 @@ HRESULT SSAOPass::_initBlurPass()
 	else
 		return hr;
 
-	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetDevice()->CreateGraphicsPipelineState(
-		&graphicsPipelineStateDesc,
-		IID_PPV_ARGS(&m_blurPipelineState))))
+	if (FAILED(hr = p_renderingManager->GetMainAdapter()->GetPipelineStateCache()->CreateGraphicsPipelineState(
+		graphicsPipelineStateDesc,
+		&m_blurPipelineState)))
 	{
 		SAFE_RELEASE(m_blurPipelineState);
 		return hr;
@@ -21,6 +21,8 @@ public:
 	SSAOPass(RenderingManager * renderingManager, const Window & window);
 	~SSAOPass();
 
+	static void QueueShaders();
+
 
 	HRESULT Init() override;
 	void Update(const Camera& camera, const float& deltaTime) override;
@@ -1,16 +1,23 @@
 #include "DirectX12EnginePCH.h"
 #include "ShadowPass.h"
+#include "WrapperFunctions/X12PipelineStateCache.h"
 #include "WrapperFunctions/X12DepthStencil.h"
-#include "WrapperFunctions/X12RenderTargetView.h"
 #include "GeometryPass.h"
 #include "DeferredRender.h"
 #include "WrapperFunctions/X12ConstantBuffer.h"
 #include "WrapperFunctions/X12Timer.h"
+#include "../Objects/Light/LightRegistry.h"
+#include <algorithm>
 
+static const ShaderCreator::ShaderDesc VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/ShadowPass/DefaultShadowVertex.hlsl", "vs_5_1" };
+static const ShaderCreator::ShaderDesc GEOMETRY_SHADER{ L"../DirectX12Engine/DirectX/Shaders/ShadowPass/DefaultShadowGeometry.hlsl", "gs_5_1" };
+static const ShaderCreator::ShaderDesc SINGLE_PASS_VERTEX_SHADER{ L"../DirectX12Engine/DirectX/Shaders/ShadowPass/SinglePassShadowVertex.hlsl", "vs_5_1" };
 
 ShadowPass::ShadowPass(RenderingManager* renderingManager, const Window& window)
 	: IRender(renderingManager, window)
 {
+	//TextureIndex.y indexes the caster masks
+	p_lastInstanceSlot = MAX_SHADOW_CASTERS - 1;
 }
 
 ShadowPass::~ShadowPass()
@@ -31,7 +38,7 @@ HRESULT ShadowPass::Init()
 
 	p_renderingManager->NewTimer(SHADOW_PASS);
 
-	if (FAILED(hr = p_renderingManager->GetTimer(SHADOW_PASS)->CreateTimer(TIMER_COUNT)))
+	if (FAILED(hr = p_renderingManager->GetTimer(SHADOW_PASS)->CreateTimer()))
 	{
 		return hr;
 	}
@@ -40,30 +47,64 @@ HRESULT ShadowPass::Init()
 	return hr;	
 }
 
+void ShadowPass::QueueShaders()
+{
+	ShaderCreator::QueueShader(VERTEX_SHADER);
+	ShaderCreator::QueueShader(GEOMETRY_SHADER);
+	ShaderCreator::QueueShader(SINGLE_PASS_VERTEX_SHADER);
+}
+
 void ShadowPass::Update(const Camera& camera, const float & deltaTime)
 {
+	m_shadowCache.BeginFrame();
+	_trackCasters();
+	_allocateShadowTiles(camera);
+	_boundInstances();
 
+	//The single pass reads every caster from one world buffer, more casters than it holds go through the geometry shader
+	const BOOL singlePass = m_singlePass && m_singlePassSupported && m_casterBounds.size() <= MAX_SHADOW_CASTERS;
+	m_faceInstances.clear();
+	m_faceInstanceRanges.clear();
 
-	const UINT lightQueueSize = static_cast<UINT>(p_lightQueue->size());
-	UINT counter = 0;
-	for (UINT i = 0; i < lightQueueSize; i++)
+	for (size_t i = 0; i < m_shadowRequests.size(); i++)
 	{
-		if (dynamic_cast<DirectionalLight*>(p_lightQueue->at(i)))
+		ShadowRequest & request = m_shadowRequests[i];
+		ILight * light = request.Light;
+		m_lightValues.LightType.x = light->GetType();
+		if (light->GetType() == 0)
 		{
-			DirectionalLight* directionalLight = dynamic_cast<DirectionalLight*>(p_lightQueue->at(i));
-			m_lightValues.LightType.x = directionalLight->GetType();
-			m_lightValues.LightViewProjection[0] = directionalLight->GetCamera()->GetViewProjectionMatrix();
+			for (UINT j = 0; j < 6; j++)
+			{
+				m_lightValues.LightViewProjection[j] = static_cast<PointLight*>(light)->GetCameras()[j]->GetViewProjectionMatrix();
+			}
 		}
-		else if (dynamic_cast<PointLight*>(p_lightQueue->at(i)))
+		else
 		{
-			PointLight* directionalLight = dynamic_cast<PointLight*>(p_lightQueue->at(i));
-			m_lightValues.LightType.x = directionalLight->GetType();
-			for (UINT j = 0; j < 6; j++)
+			//The cascades follow the camera, fitted to the tiles they were given
+			DirectionalLight * directionalLight = static_cast<DirectionalLight*>(light);
+			directionalLight->UpdateCascades(camera, request.Size);
+			for (UINT j = 0; j < request.TileCount; j++)
 			{
-				m_lightValues.LightViewProjection[j] = directionalLight->GetCameras()[j]->GetViewProjectionMatrix();
+				m_lightValues.LightViewProjection[j] = directionalLight->GetCascades()[j].ViewProjection;
 			}
 		}
-		m_constantLightBuffer->Copy(&m_lightValues, sizeof(m_lightValues), m_constantLightBufferPerObjectAlignedSize * counter++);
+
+		request.DirtyFaces = m_shadowCache.GetDirtyFaces(light, m_lightValues.LightViewProjection, request.TileCount, m_atlasRepacked == TRUE);
+		m_lightValues.LightType.y = request.DirtyFaces;
+		m_lightValues.LightType.z = request.TileCount;
+		m_constantLightBuffer->Copy(&m_lightValues, sizeof(m_lightValues), m_constantLightBufferPerObjectAlignedSize * static_cast<UINT>(i));
+
+		request.SinglePass = FALSE;
+		if (request.DirtyFaces)
+			_cullCasters(request, m_lightValues.LightViewProjection, static_cast<UINT>(i), singlePass);
+	}
+	m_shadowCache.EndFrame();
+
+	m_faceInstanceCount = static_cast<UINT>(m_faceInstances.size());
+	if (!m_faceInstances.empty())
+	{
+		m_casterWorldBuffer->Copy(m_casterWorlds.data(), static_cast<UINT>(m_casterWorlds.size() * sizeof(DirectX::XMFLOAT4X4)));
+		m_faceInstanceBuffer->Copy(m_faceInstances.data(), static_cast<UINT>(m_faceInstances.size() * sizeof(UINT)));
 	}
 
 	OpenCommandList();
@@ -73,78 +114,81 @@ void ShadowPass::Update(const Camera& camera, const float & deltaTime)
 	p_renderingManager->ResourceDescriptorHeap(commandList);
 	commandList->SetPipelineState(m_pipelineState);
 	commandList->SetGraphicsRootSignature(m_rootSignature);
-	commandList->RSSetViewports(1, &m_viewport);
-	commandList->RSSetScissorRects(1, &m_rect);
 	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);	
 }
 
 void ShadowPass::Draw()
 {
-	const UINT lightQueueSize = static_cast<UINT>(p_lightQueue->size());
 	const UINT frameIndex = p_renderingManager->GetFrameIndex();
-
 	ID3D12GraphicsCommandList * commandList = p_commandList[frameIndex];
 
-	UINT counter = 0;
-	for (UINT i = 0; i < lightQueueSize; i++)
-	{		
-		p_lightQueue->at(i)->GetDepthStencil()->SwitchToDSV(p_commandList[frameIndex]);
-		p_lightQueue->at(i)->GetDepthStencil()->ClearDepthStencil(p_commandList[frameIndex]);
-
-		const CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle (p_lightQueue->at(i)->GetDepthStencil()->GetDescriptorHeap()->GetCPUDescriptorHandleForHeapStart());
-
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(
-			p_lightQueue->at(i)->GetRenderTargetView()->GetDescriptorHeap()->GetCPUDescriptorHandleForHeapStart(),
-			frameIndex,
-			p_lightQueue->at(i)->GetRenderTargetView()->GetDescriptorSize());
-		p_lightQueue->at(i)->GetRenderTargetView()->Clear(commandList, rtvHandle);
-		
-		p_commandList[frameIndex]->OMSetRenderTargets(p_lightQueue->at(i)->GetNumRenderTargets(), &rtvHandle, TRUE, &dsvHandle);
-
-		m_constantLightBuffer->SetGraphicsRootConstantBufferView(commandList, 0, counter * m_constantLightBufferPerObjectAlignedSize);
-		
-		p_drawInstance();
-
-		counter++;
-
-
-		if (dynamic_cast<DirectionalLight*>(p_lightQueue->at(i)))
-		{
-			DirectionalLight* directionalLight = dynamic_cast<DirectionalLight*>(p_lightQueue->at(i));			
-
-			DirectX::XMFLOAT4X4A arr[1] = { directionalLight->GetCamera()->GetViewProjectionMatrix() };
-			if (directionalLight->GetDepthStencil()->GetCpuDescriptorHeap().ptr != 0)
-				p_renderingManager->GetDeferredRender()->AddShadowMap(
-					directionalLight->GetDepthStencil()->GetCpuDescriptorHeap(),
-					arr,
-					1,
-					p_lightQueue->at(i));
-		}
-		else if (dynamic_cast<PointLight*>(p_lightQueue->at(i)))
+	//Only the dirty faces are cleared and drawn, the rest of the atlas is kept from earlier frames
+	m_dirtyRects.clear();
+	for (size_t i = 0; i < m_shadowRequests.size(); i++)
+	{
+		const ShadowRequest & request = m_shadowRequests[i];
+		for (UINT k = 0; k < request.TileCount; k++)
 		{
-			PointLight* pointLight = dynamic_cast<PointLight*>(p_lightQueue->at(i));
-
-			DirectX::XMFLOAT4X4A arr[6];
-			for (UINT k = 0; k < 6; k++)
+			if (request.DirtyFaces & (1u << k))
 			{
-				arr[k] = pointLight->GetCameras()[k]->GetViewProjectionMatrix();
+				const ShadowAtlasPacker::Tile & tile = request.Tiles[k];
+				m_dirtyRects.push_back(D3D12_RECT{ 
+					static_cast<LONG>(tile.X), 
+					static_cast<LONG>(tile.Y), 
+					static_cast<LONG>(tile.X + tile.Size), 
+					static_cast<LONG>(tile.Y + tile.Size) });
 			}
-			if (pointLight->GetDepthStencil()->GetCpuDescriptorHeap().ptr != 0)
-				p_renderingManager->GetDeferredRender()->AddShadowMap(
-					pointLight->GetDepthStencil()->GetCpuDescriptorHeap(),
-					arr,
-					pointLight->GetNumRenderTargets(),
-					p_lightQueue->at(i));
 		}
 	}
-	for (UINT i = 0; i < lightQueueSize; i++)
+
+	if (m_atlasRepacked || !m_dirtyRects.empty())
 	{
-		p_lightQueue->at(i)->GetDepthStencil()->SwitchToSRV(p_commandList[frameIndex]);
+		m_shadowAtlas->SwitchToDSV(commandList);
+		if (m_atlasRepacked)
+			m_shadowAtlas->ClearDepthStencil(commandList);
+		else
+			m_shadowAtlas->ClearDepthStencil(commandList, m_dirtyRects.data(), static_cast<UINT>(m_dirtyRects.size()));
+
+		const CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_shadowAtlas->GetDescriptorHeap()->GetCPUDescriptorHandleForHeapStart());
+		commandList->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
 	}
 
+	const float atlasSize = static_cast<float>(SHADOW_ATLAS_SIZE);
+	DirectX::XMFLOAT4X4A viewProjection[MAX_SHADOW_TILES];
+	DirectX::XMFLOAT4 atlasRect[MAX_SHADOW_TILES];
+	for (size_t i = 0; i < m_shadowRequests.size(); i++)
+	{
+		const ShadowRequest & request = m_shadowRequests[i];
+		if (request.DirtyFaces && request.SinglePass)
+			_drawLightSinglePass(commandList, request, static_cast<UINT>(i));
+		else if (request.DirtyFaces)
+			_drawLight(commandList, request, static_cast<UINT>(i));
+
+		for (UINT k = 0; k < request.TileCount; k++)
+		{
+			if (request.Light->GetType() == 0)
+				viewProjection[k] = static_cast<PointLight*>(request.Light)->GetCameras()[k]->GetViewProjectionMatrix();
+			else
+				viewProjection[k] = static_cast<DirectionalLight*>(request.Light)->GetCascades()[k].ViewProjection;
+
+			atlasRect[k] = DirectX::XMFLOAT4(
+				static_cast<float>(request.Tiles[k].X) / atlasSize,
+				static_cast<float>(request.Tiles[k].Y) / atlasSize,
+				static_cast<float>(request.Tiles[k].Size) / atlasSize,
+				static_cast<float>(request.Tiles[k].Size) / atlasSize);
+		}
+		p_renderingManager->GetDeferredRender()->AddShadowMap(
+			viewProjection,
+			atlasRect,
+			request.TileCount,
+			request.Light);
+	}
+
+	m_shadowAtlas->SwitchToSRV(commandList);
+	p_renderingManager->GetDeferredRender()->SetShadowAtlas(m_shadowAtlas);
+
 	p_renderingManager->GetTimer(SHADOW_PASS)->Stop(commandList);
 	p_renderingManager->GetTimer(SHADOW_PASS)->ResolveQueryToCpu(commandList);
-	p_renderingManager->GetTimer(SHADOW_PASS)->CountTimer();
 
 	ExecuteCommandList();
 	p_renderingManager->GetPassFence(SHADOW_PASS)->Signal(p_renderingManager->GetCommandQueue());
@@ -161,22 +205,72 @@ void ShadowPass::Release()
 {
 	SAFE_RELEASE(m_rootSignature);
 	SAFE_RELEASE(m_pipelineState);
+	SAFE_RELEASE(m_singlePassPipelineState);
 
 	if (m_constantLightBuffer)
 		m_constantLightBuffer->Release();
 	SAFE_DELETE(m_constantLightBuffer);
 
+	if (m_shadowAtlas)
+		m_shadowAtlas->Release();
+	SAFE_DELETE(m_shadowAtlas);
+
+	if (m_casterMaskBuffer)
+		m_casterMaskBuffer->Release();
+	SAFE_DELETE(m_casterMaskBuffer);
+
+	if (m_casterWorldBuffer)
+		m_casterWorldBuffer->Release();
+	SAFE_DELETE(m_casterWorldBuffer);
+
+	if (m_faceInstanceBuffer)
+		m_faceInstanceBuffer->Release();
+	SAFE_DELETE(m_faceInstanceBuffer);
+
+	m_shadowCache.Clear();
+
 	p_releaseInstanceBuffer();
 	p_releaseCommandList();
 
+	if (p_renderingManager->GetTimer(SHADOW_PASS))
+		p_renderingManager->GetTimer(SHADOW_PASS)->PrintToFile("ShadowPass.txt");
 	p_renderingManager->DeleteTimer(SHADOW_PASS);
 }
 
+const ShadowAtlasPacker& ShadowPass::GetShadowAtlasPacker() const
+{
+	return m_shadowAtlasPacker;
+}
+
+const ShadowCache& ShadowPass::GetShadowCache() const
+{
+	return m_shadowCache;
+}
+
+void ShadowPass::SetSinglePassFaces(const BOOL& singlePass)
+{
+	this->m_singlePass = singlePass;
+}
+
+const BOOL& ShadowPass::GetSinglePassFaces() const
+{
+	return this->m_singlePass;
+}
+
+const BOOL& ShadowPass::GetSinglePassFacesSupported() const
+{
+	return this->m_singlePassSupported;
+}
+
+const UINT& ShadowPass::GetFaceInstanceCount() const
+{
+	return this->m_faceInstanceCount;
+}
+
 HRESULT ShadowPass::_preInit()
 {
 	HRESULT hr = 0;
 
-	_createViewport();
 	p_useSecondaryAdapter(false);
 
 	X12Adapter * device = p_getUseSecondaryAdapter() ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
@@ -198,10 +292,33 @@ HRESULT ShadowPass::_preInit()
 	{
 		return hr;
 	}
+
+	//Without the option the driver emulates the viewport index with a geometry shader, which is the path this avoids
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options{};
+	if (SUCCEEDED(device->GetDevice()->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+	{
+		m_singlePassSupported = options.VPAndRTArrayIndexFromAnyShaderFeedingRasterizerSupportedWithoutGSEmulation;
+	}
+	if (m_singlePassSupported && FAILED(hr = _initSinglePassPipelineState()))
+	{
+		return hr;
+	}
 	if (FAILED(hr = _createConstantBuffer()))
 	{
 		return hr;
 	}
+	if (FAILED(hr = _createShadowAtlas()))
+	{
+		return hr;
+	}
+	if (FAILED(hr = _createCasterMaskBuffer()))
+	{
+		return hr;
+	}
+	if (FAILED(hr = _createFaceInstanceBuffers()))
+	{
+		return hr;
+	}
 	if (FAILED(hr = p_createInstanceBuffer(L"Shadow")))
 	{
 		return hr;
@@ -239,6 +356,22 @@ HRESULT ShadowPass::_initRootSignature()
 	m_rootParameter[0].Descriptor = lightDescriptor;
 	m_rootParameter[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 
+	D3D12_ROOT_DESCRIPTOR casterMaskDescriptor;
+	casterMaskDescriptor.RegisterSpace = 0;
+	casterMaskDescriptor.ShaderRegister = 0;
+
+	m_rootParameter[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	m_rootParameter[1].Descriptor = casterMaskDescriptor;
+	m_rootParameter[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+	D3D12_ROOT_DESCRIPTOR casterWorldDescriptor;
+	casterWorldDescriptor.RegisterSpace = 0;
+	casterWorldDescriptor.ShaderRegister = 1;
+
+	m_rootParameter[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	m_rootParameter[2].Descriptor = casterWorldDescriptor;
+	m_rootParameter[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
 	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
 	rootSignatureDesc.Init(_countof(m_rootParameter),
 		m_rootParameter,
@@ -257,11 +390,10 @@ HRESULT ShadowPass::_initRootSignature()
 		&signature,
 		nullptr)))
 	{
-		if (FAILED(hr = device->GetDevice()->CreateRootSignature(
-			0,
+		if (FAILED(hr = device->GetPipelineStateCache()->CreateRootSignature(
 			signature->GetBufferPointer(),
 			signature->GetBufferSize(),
-			IID_PPV_ARGS(&m_rootSignature))))
+			&m_rootSignature)))
 		{
 			SAFE_RELEASE(m_rootSignature);
 		}	
@@ -276,7 +408,7 @@ HRESULT ShadowPass::_initShaders()
 	HRESULT hr = 0;
 	ID3DBlob * blob = nullptr;
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/ShadowPass/DefaultShadowVertex.hlsl", blob, "vs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(VERTEX_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -286,7 +418,7 @@ HRESULT ShadowPass::_initShaders()
 		m_vertexShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
-	if (FAILED(hr = ShaderCreator::CreateShader(L"../DirectX12Engine/DirectX/Shaders/ShadowPass/DefaultShadowGeometry.hlsl", blob, "gs_5_1")))
+	if (FAILED(hr = ShaderCreator::CreateShader(GEOMETRY_SHADER, blob)))
 	{
 		return hr;
 	}
@@ -296,6 +428,16 @@ HRESULT ShadowPass::_initShaders()
 		m_geometryShader.pShaderBytecode = blob->GetBufferPointer();
 	}
 
+	if (FAILED(hr = ShaderCreator::CreateShader(SINGLE_PASS_VERTEX_SHADER, blob)))
+	{
+		return hr;
+	}
+	else
+	{
+		m_singlePassVertexShader.BytecodeLength = blob->GetBufferSize();
+		m_singlePassVertexShader.pShaderBytecode = blob->GetBufferPointer();
+	}
+
 	return hr;
 }
 
@@ -313,7 +455,8 @@ HRESULT ShadowPass::_initPipelineState()
 		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
-		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
+		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+		{ "TEXTURE_INDEX", 0, DXGI_FORMAT_R32G32B32A32_UINT, 1, 64, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
 	};
 
 	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc;
@@ -327,13 +470,7 @@ HRESULT ShadowPass::_initPipelineState()
 	graphicsPipelineStateDesc.VS = m_vertexShader;
 	graphicsPipelineStateDesc.GS = m_geometryShader; 
 	graphicsPipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-	graphicsPipelineStateDesc.NumRenderTargets = 6;
-	graphicsPipelineStateDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	graphicsPipelineStateDesc.RTVFormats[1] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	graphicsPipelineStateDesc.RTVFormats[2] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	graphicsPipelineStateDesc.RTVFormats[3] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	graphicsPipelineStateDesc.RTVFormats[4] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	graphicsPipelineStateDesc.RTVFormats[5] = DXGI_FORMAT_R8G8B8A8_UNORM;
+	graphicsPipelineStateDesc.NumRenderTargets = 0;
 	graphicsPipelineStateDesc.SampleMask = 0xffffffff;
 	graphicsPipelineStateDesc.RasterizerState = 
 	CD3DX12_RASTERIZER_DESC(D3D12_FILL_MODE_SOLID, D3D12_CULL_MODE_NONE, FALSE, 0, 0.0f, 0.0f, TRUE, FALSE, FALSE, 0, D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF);
@@ -351,9 +488,9 @@ HRESULT ShadowPass::_initPipelineState()
 
 	X12Adapter * device = p_getUseSecondaryAdapter() ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
 	
-	if (FAILED(hr = device->GetDevice()->CreateGraphicsPipelineState(
-		&graphicsPipelineStateDesc,
-		IID_PPV_ARGS(&m_pipelineState))))
+	if (FAILED(hr = device->GetPipelineStateCache()->CreateGraphicsPipelineState(
+		graphicsPipelineStateDesc,
+		&m_pipelineState)))
 	{
 		SAFE_RELEASE(m_pipelineState);
 	}
@@ -361,29 +498,394 @@ HRESULT ShadowPass::_initPipelineState()
 	return hr;
 }
 
+HRESULT ShadowPass::_initSinglePassPipelineState()
+{
+	HRESULT hr = 0;
+
+	D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCORD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 48, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+
+		{ "FACE_INSTANCE", 0, DXGI_FORMAT_R32_UINT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
+	};
+
+	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc;
+
+	inputLayoutDesc.NumElements = sizeof(inputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
+	inputLayoutDesc.pInputElementDescs = inputLayout;
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsPipelineStateDesc = {};
+	graphicsPipelineStateDesc.InputLayout = inputLayoutDesc;
+	graphicsPipelineStateDesc.pRootSignature = m_rootSignature;
+	graphicsPipelineStateDesc.VS = m_singlePassVertexShader;
+	graphicsPipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	graphicsPipelineStateDesc.NumRenderTargets = 0;
+	graphicsPipelineStateDesc.SampleMask = 0xffffffff;
+	graphicsPipelineStateDesc.RasterizerState = 
+	CD3DX12_RASTERIZER_DESC(D3D12_FILL_MODE_SOLID, D3D12_CULL_MODE_NONE, FALSE, 0, 0.0f, 0.0f, TRUE, FALSE, FALSE, 0, D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF);
+	graphicsPipelineStateDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	graphicsPipelineStateDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	graphicsPipelineStateDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+
+	DXGI_SWAP_CHAIN_DESC desc;
+	if (SUCCEEDED(hr = p_renderingManager->GetSwapChain()->GetDesc(&desc)))
+	{
+		graphicsPipelineStateDesc.SampleDesc = desc.SampleDesc;
+	}
+	else
+		return hr;
+
+	X12Adapter * device = p_getUseSecondaryAdapter() ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
+	
+	if (FAILED(hr = device->GetPipelineStateCache()->CreateGraphicsPipelineState(
+		graphicsPipelineStateDesc,
+		&m_singlePassPipelineState)))
+	{
+		SAFE_RELEASE(m_singlePassPipelineState);
+	}
+
+	return hr;
+}
+
 HRESULT ShadowPass::_createConstantBuffer()
 {
 	HRESULT hr = 0;
 	   
 	SAFE_NEW(m_constantLightBuffer, new X12ConstantBuffer());
-	if (FAILED(hr = m_constantLightBuffer->CreateBuffer(L"Shadow matrix", &m_lightValues, sizeof(LightBuffer))))
+	if (FAILED(hr = m_constantLightBuffer->CreateBuffer(
+		L"Shadow matrix", 
+		&m_lightValues, 
+		sizeof(LightBuffer), 
+		MAX_SHADOW_LIGHTS * m_constantLightBufferPerObjectAlignedSize)))
 	{
 		return hr;
 	}
 	return hr;
 }
 
-void ShadowPass::_createViewport()
+HRESULT ShadowPass::_createShadowAtlas()
+{
+	HRESULT hr = 0;
+
+	SAFE_NEW(m_shadowAtlas, new X12DepthStencil());
+	if (SUCCEEDED(hr = p_renderingManager->OpenCommandList()))
+	{
+		if (SUCCEEDED(hr = m_shadowAtlas->CreateDepthStencil(
+			L"Shadow atlas",
+			SHADOW_ATLAS_SIZE,
+			SHADOW_ATLAS_SIZE,
+			1,
+			TRUE)))
+		{
+			hr = p_renderingManager->SignalGPU();
+		}
+	}
+	return hr;
+}
+
+HRESULT ShadowPass::_createCasterMaskBuffer()
 {
-	m_viewport.TopLeftX = 0;
-	m_viewport.TopLeftY = 0;
-	m_viewport.Width	= static_cast<FLOAT>(SHADOW_MAP_SIZE);
-	m_viewport.Height	= static_cast<FLOAT>(SHADOW_MAP_SIZE);
-	m_viewport.MinDepth = 0.0f;
-	m_viewport.MaxDepth = 1.0f;
-
-	m_rect.left = 0;
-	m_rect.top = 0;
-	m_rect.right = SHADOW_MAP_SIZE;
-	m_rect.bottom = SHADOW_MAP_SIZE;
+	HRESULT hr = 0;
+
+	SAFE_NEW(m_casterMaskBuffer, new X12ConstantBuffer());
+	if (FAILED(hr = m_casterMaskBuffer->CreateBuffer(
+		L"Shadow caster mask",
+		nullptr,
+		0,
+		MAX_SHADOW_LIGHTS * MAX_SHADOW_CASTERS * sizeof(UINT))))
+	{
+		return hr;
+	}
+	return hr;
+}
+
+HRESULT ShadowPass::_createFaceInstanceBuffers()
+{
+	HRESULT hr = 0;
+
+	SAFE_NEW(m_casterWorldBuffer, new X12ConstantBuffer());
+	if (FAILED(hr = m_casterWorldBuffer->CreateBuffer(
+		L"Shadow caster world",
+		nullptr,
+		0,
+		MAX_SHADOW_CASTERS * sizeof(DirectX::XMFLOAT4X4))))
+	{
+		return hr;
+	}
+
+	SAFE_NEW(m_faceInstanceBuffer, new X12ConstantBuffer());
+	if (FAILED(hr = m_faceInstanceBuffer->CreateBuffer(
+		L"Shadow face instance",
+		nullptr,
+		0,
+		MAX_SHADOW_FACE_INSTANCES * sizeof(UINT))))
+	{
+		return hr;
+	}
+	return hr;
+}
+
+void ShadowPass::_trackCasters()
+{
+	for (size_t i = 0; i < p_drawQueue->size(); i++)
+	{
+		const Drawable * drawable = p_drawQueue->at(i);
+		const StaticMesh * mesh = drawable->GetMesh();
+
+		auto bounds = m_meshBounds.find(mesh);
+		if (bounds == m_meshBounds.end())
+		{
+			const std::vector<StaticVertex> & vertices = mesh->GetStaticMesh();
+			bounds = m_meshBounds.emplace(mesh, ShadowCache::ComputeLocalBounds(
+				vertices.empty() ? nullptr : &vertices[0].Position,
+				vertices.size(),
+				sizeof(StaticVertex))).first;
+		}
+		m_shadowCache.TrackCaster(drawable, drawable->GetWorldMatrix(), bounds->second);
+	}
+	m_shadowCache.EndCasters();
+}
+
+void ShadowPass::_allocateShadowTiles(const Camera& camera)
+{
+	using namespace DirectX;
+
+	const LightRegistry::PointLights & pointLights = p_renderingManager->GetLightRegistry()->GetPointLights();
+	const LightRegistry::DirectionalLights & directionalLights = p_renderingManager->GetLightRegistry()->GetDirectionalLights();
+
+	m_newRequests.clear();
+
+	//Point lights get texels from how large they are on screen, directional lights cover the scene and always get the largest tile
+	const XMVECTOR cameraPosition = XMLoadFloat4(&camera.GetPosition());
+	for (size_t i = 0; i < pointLights.Lights.size(); i++)
+	{
+		PointLight * pointLight = pointLights.Lights[i];
+		if (!pointLight->GetCastShadows())
+			continue;
+
+		const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat4(&pointLight->GetWorldPosition()), cameraPosition)));
+		const float & farPlane = pointLight->GetCameras()[0]->GetFarPlane();
+		const float radius = pointLight->GetRadius() < farPlane ? pointLight->GetRadius() : farPlane;
+
+		ShadowRequest request{};
+		request.Light = pointLight;
+		request.TileCount = pointLight->GetNumRenderTargets();
+		request.Size = ShadowAtlasPacker::ChooseTileSize(distance, radius, camera.GetFov(), SHADOW_TILE_MIN_SIZE, SHADOW_TILE_MAX_SIZE);
+
+		//A light keeps its size until it wants one two steps away, so the atlas is not repacked while the camera moves a little
+		const auto previous = m_tileSizes.find(pointLight);
+		if (previous != m_tileSizes.end() && request.Size <= previous->second * 2 && request.Size * 2 >= previous->second)
+			request.Size = previous->second;
+
+		m_newRequests.push_back(request);
+	}
+	for (size_t i = 0; i < directionalLights.Lights.size(); i++)
+	{
+		if (!directionalLights.Lights[i]->GetCastShadows())
+			continue;
+
+		ShadowRequest request{};
+		request.Light = directionalLights.Lights[i];
+		request.TileCount = directionalLights.Lights[i]->GetNumRenderTargets();
+		request.Size = SHADOW_TILE_MAX_SIZE;
+		m_newRequests.push_back(request);
+	}
+
+	//Largest first, the packer never fragments when fed in that order
+	std::stable_sort(m_newRequests.begin(), m_newRequests.end(), [](const ShadowRequest & a, const ShadowRequest & b)
+	{
+		return a.Size > b.Size;
+	});
+	if (m_newRequests.size() > MAX_SHADOW_LIGHTS)
+		m_newRequests.resize(MAX_SHADOW_LIGHTS);
+
+	m_requestSizes.resize(m_newRequests.size());
+	m_requestTileCounts.resize(m_newRequests.size());
+	for (size_t i = 0; i < m_newRequests.size(); i++)
+	{
+		m_requestSizes[i] = m_newRequests[i].Size;
+		m_requestTileCounts[i] = m_newRequests[i].TileCount;
+	}
+	m_newRequests.resize(m_shadowAtlasPacker.FitRequests(m_requestSizes.data(), m_requestTileCounts.data(), m_newRequests.size()));
+
+	//Same lights at the same sizes keep their tiles and whatever is cached in them
+	m_atlasRepacked = m_newRequests.size() != m_shadowRequests.size();
+	for (size_t i = 0; i < m_newRequests.size() && !m_atlasRepacked; i++)
+	{
+		m_atlasRepacked = m_newRequests[i].Light != m_shadowRequests[i].Light || 
+			m_requestSizes[i] != m_shadowRequests[i].Size || 
+			m_newRequests[i].TileCount != m_shadowRequests[i].TileCount;
+	}
+	if (!m_atlasRepacked)
+		return;
+
+	m_shadowAtlasPacker.Reset();
+	m_shadowRequests.clear();
+	m_tileSizes.clear();
+	for (size_t i = 0; i < m_newRequests.size(); i++)
+	{
+		ShadowRequest request = m_newRequests[i];
+		request.Size = m_shadowAtlasPacker.AllocateGroup(m_requestSizes[i], request.TileCount, request.Tiles);
+		if (request.Size)
+		{
+			m_shadowRequests.push_back(request);
+			m_tileSizes[request.Light] = request.Size;
+		}
+	}
+}
+
+void ShadowPass::_boundInstances()
+{
+	//Every instance gets its slot in the caster masks, the instance buffer is the same for all lights
+	m_casterBounds.clear();
+	m_casterWorlds.clear();
+	m_casterTree.Clear();
+	const TransformStore * store = TransformStore::GetInstance();
+	for (size_t i = 0; i < p_instanceGroups->size(); i++)
+	{
+		const Instancing::InstanceGroup & group = p_instanceGroups->at(i);
+		const DirectX::XMFLOAT4 & localBounds = m_meshBounds[group.StaticMesh];
+		for (UINT j = 0; j < group.GetSize(); j++)
+		{
+			//The same index the instance gets as its TextureIndex.y when it is uploaded
+			const UINT index = static_cast<UINT>(m_casterBounds.size());
+			const DirectX::XMFLOAT4X4A & worldMatrix = store->GetWorldMatrix(group.Handles[j]);
+			m_casterBounds.push_back(ShadowCache::WorldBounds(worldMatrix, localBounds));
+			m_casterWorlds.push_back(worldMatrix);
+			m_casterTree.Add(BoundingVolumeHierarchy::SphereBox(m_casterBounds.back()), index);
+		}
+	}
+	//Every light culls against the same tree
+	m_casterTree.Build();
+}
+
+void ShadowPass::_cullCasters(ShadowRequest& request, const DirectX::XMFLOAT4X4A* viewProjection, const UINT& index, const BOOL& singlePass)
+{
+	ParticleLod::Frustum frustum[MAX_SHADOW_TILES];
+	for (UINT i = 0; i < request.TileCount; i++)
+		frustum[i] = ParticleLod::CreateFrustum(viewProjection[i]);
+
+	if (m_casterBounds.empty())
+		return;
+
+	UINT faceCount = 0;
+	m_casterMasks.assign(m_casterBounds.size(), 0);
+	for (UINT k = 0; k < request.TileCount; k++)
+	{
+		if (!(request.DirtyFaces & (1u << k)))
+			continue;
+		//The tree tests boxes, the sphere test keeps the same casters as testing every one of them
+		m_casterTree.QueryFrustum(frustum[k], [&](const uint32_t & caster)
+		{
+			if (ParticleLod::Intersects(frustum[k], m_casterBounds[caster], m_casterBounds[caster].w))
+			{
+				m_casterMasks[caster] |= 1u << k;
+				faceCount++;
+			}
+		});
+	}
+
+	//One instance per face a caster touches, each instance group draws its own range
+	if (singlePass && m_faceInstances.size() + faceCount <= MAX_SHADOW_FACE_INSTANCES)
+	{
+		request.SinglePass = TRUE;
+		request.FaceInstanceRange = static_cast<UINT>(m_faceInstanceRanges.size());
+
+		UINT caster = 0;
+		for (size_t i = 0; i < p_instanceGroups->size(); i++)
+		{
+			m_faceInstanceRanges.push_back(static_cast<UINT>(m_faceInstances.size()));
+			for (UINT j = 0; j < p_instanceGroups->at(i).GetSize(); j++, caster++)
+			{
+				for (UINT k = 0; k < request.TileCount; k++)
+				{
+					if (m_casterMasks[caster] & (1u << k))
+						m_faceInstances.push_back((caster << 3) | k);
+				}
+			}
+		}
+		m_faceInstanceRanges.push_back(static_cast<UINT>(m_faceInstances.size()));
+		return;
+	}
+
+	//Instances past the last slot share it, so it gets the faces of all of them
+	const size_t casterCount = m_casterMasks.size() < MAX_SHADOW_CASTERS ? m_casterMasks.size() : MAX_SHADOW_CASTERS;
+	for (size_t i = casterCount; i < m_casterMasks.size(); i++)
+		m_casterMasks[casterCount - 1] |= m_casterMasks[i];
+	m_casterMaskBuffer->Copy(m_casterMasks.data(), static_cast<UINT>(casterCount * sizeof(UINT)), index * MAX_SHADOW_CASTERS * sizeof(UINT));
+}
+
+void ShadowPass::_setTileViewports(ID3D12GraphicsCommandList* commandList, const ShadowRequest& request) const
+{
+	//One viewport per tile, every face is routed to its tile with SV_ViewportArrayIndex
+	D3D12_VIEWPORT viewports[MAX_SHADOW_TILES];
+	D3D12_RECT rects[MAX_SHADOW_TILES];
+	for (UINT i = 0; i < request.TileCount; i++)
+	{
+		const ShadowAtlasPacker::Tile & tile = request.Tiles[i];
+
+		viewports[i].TopLeftX = static_cast<FLOAT>(tile.X);
+		viewports[i].TopLeftY = static_cast<FLOAT>(tile.Y);
+		viewports[i].Width = static_cast<FLOAT>(tile.Size);
+		viewports[i].Height = static_cast<FLOAT>(tile.Size);
+		viewports[i].MinDepth = 0.0f;
+		viewports[i].MaxDepth = 1.0f;
+
+		rects[i].left = tile.X;
+		rects[i].top = tile.Y;
+		rects[i].right = tile.X + tile.Size;
+		rects[i].bottom = tile.Y + tile.Size;
+	}
+	commandList->RSSetViewports(request.TileCount, viewports);
+	commandList->RSSetScissorRects(request.TileCount, rects);
+}
+
+void ShadowPass::_drawLight(ID3D12GraphicsCommandList* commandList, const ShadowRequest& request, const UINT& index)
+{
+	_setTileViewports(commandList, request);
+	commandList->SetPipelineState(m_pipelineState);
+
+	m_constantLightBuffer->SetGraphicsRootConstantBufferView(commandList, 0, index * m_constantLightBufferPerObjectAlignedSize);
+	m_casterMaskBuffer->SetGraphicsRootShaderResourceView(commandList, 1, index * MAX_SHADOW_CASTERS * sizeof(UINT));
+
+	p_drawInstance();
+}
+
+void ShadowPass::_drawLightSinglePass(ID3D12GraphicsCommandList* commandList, const ShadowRequest& request, const UINT& index) const
+{
+	_setTileViewports(commandList, request);
+	commandList->SetPipelineState(m_singlePassPipelineState);
+
+	m_constantLightBuffer->SetGraphicsRootConstantBufferView(commandList, 0, index * m_constantLightBufferPerObjectAlignedSize);
+	m_casterWorldBuffer->SetGraphicsRootShaderResourceView(commandList, 2);
+
+	D3D12_VERTEX_BUFFER_VIEW faceInstanceView;
+	faceInstanceView.BufferLocation = m_faceInstanceBuffer->GetResource()[p_renderingManager->GetFrameIndex()]->GetGPUVirtualAddress();
+	faceInstanceView.StrideInBytes = sizeof(UINT);
+	faceInstanceView.SizeInBytes = m_faceInstanceCount * sizeof(UINT);
+
+	for (size_t i = 0; i < p_instanceGroups->size(); i++)
+	{
+		const UINT start = m_faceInstanceRanges[request.FaceInstanceRange + i];
+		const UINT count = m_faceInstanceRanges[request.FaceInstanceRange + i + 1] - start;
+		if (!count)
+			continue;
+
+		D3D12_VERTEX_BUFFER_VIEW bufferArr[2] =
+		{
+			p_instanceGroups->at(i).StaticMesh->GetVertexBufferView(),
+			faceInstanceView
+		};
+		commandList->IASetVertexBuffers(0, 2, bufferArr);
+		const UINT vertexCount = static_cast<UINT>(p_instanceGroups->at(i).StaticMesh->GetStaticMesh().size());
+		commandList->DrawInstanced(
+			vertexCount,
+			count,
+			0,
+			start);
+		p_countDraw(vertexCount, count);
+	}
 }
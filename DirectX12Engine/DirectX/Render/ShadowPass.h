@@ -1,15 +1,22 @@
 #pragma once
 #include "Template/IRender.h"
+#include "WrapperFunctions/Functions/ShadowAtlasPacker.h"
+#include "WrapperFunctions/Functions/ShadowCache.h"
+#include "WrapperFunctions/Functions/BoundingVolumeHierarchy.h"
+#include <unordered_map>
 
 class X12DepthStencil;
 class X12ConstantBuffer;
-class X12RenderTargetView;
 
 class ShadowPass :
 	public IRender
 {
 private:
-	static const UINT ROOT_PARAMETERS = 1;
+	static const UINT ROOT_PARAMETERS = 3;
+	static const UINT MAX_SHADOW_LIGHTS = 48;
+	static const UINT MAX_SHADOW_TILES = 6;
+	static const UINT MAX_SHADOW_CASTERS = 4096;
+	static const UINT MAX_SHADOW_FACE_INSTANCES = 65536;
 
 	struct LightBuffer
 	{
@@ -18,16 +25,39 @@ private:
 
 		DirectX::XMFLOAT4A		Padding[43];
 	};
+
+	struct ShadowRequest
+	{
+		ILight * Light;
+		UINT Size;
+		UINT TileCount;
+		UINT DirtyFaces;
+		BOOL SinglePass;			//Drawn with one instance per caster and face instead of the geometry shader
+		UINT FaceInstanceRange;		//First of the per group offsets into the face instances
+		ShadowAtlasPacker::Tile Tiles[MAX_SHADOW_TILES];
+	};
 public:
 	ShadowPass(RenderingManager * renderingManager, const Window & window);
 	~ShadowPass();
 
+	static void QueueShaders();
+
 	HRESULT Init() override;
 	void Update(const Camera& camera, const float & deltaTime) override;
 	void Draw() override;
 	void Clear() override;
 	void Release() override;
 
+	const ShadowAtlasPacker & GetShadowAtlasPacker() const;
+	const ShadowCache & GetShadowCache() const;
+
+	// Casters are drawn once per face they touch and routed to the tile from the vertex shader, 
+	// the geometry shader is only used when the device would emulate this or the face instances do not fit
+	void SetSinglePassFaces(const BOOL & singlePass);
+	const BOOL & GetSinglePassFaces() const;
+	const BOOL & GetSinglePassFacesSupported() const;
+	const UINT & GetFaceInstanceCount() const;
+
 private:
 	HRESULT _preInit();
 	HRESULT _signalGPU() const;
@@ -35,19 +65,57 @@ private:
 	HRESULT _initRootSignature();
 	HRESULT _initShaders();
 	HRESULT _initPipelineState();
+	HRESULT _initSinglePassPipelineState();
 	HRESULT _createConstantBuffer();
-	void _createViewport();
-	
+	HRESULT _createShadowAtlas();
+	HRESULT _createCasterMaskBuffer();
+	HRESULT _createFaceInstanceBuffers();
+	void _trackCasters();
+	void _allocateShadowTiles(const Camera & camera);
+	void _boundInstances();
+	void _cullCasters(ShadowRequest & request, const DirectX::XMFLOAT4X4A * viewProjection, const UINT & index, const BOOL & singlePass);
+	void _setTileViewports(ID3D12GraphicsCommandList * commandList, const ShadowRequest & request) const;
+	void _drawLight(ID3D12GraphicsCommandList * commandList, const ShadowRequest & request, const UINT & index);
+	void _drawLightSinglePass(ID3D12GraphicsCommandList * commandList, const ShadowRequest & request, const UINT & index) const;
 
 	ID3D12RootSignature *	m_rootSignature = nullptr;
 	D3D12_ROOT_PARAMETER	m_rootParameter[ROOT_PARAMETERS]{};
 
 	D3D12_SHADER_BYTECODE	m_vertexShader{};
 	D3D12_SHADER_BYTECODE	m_geometryShader{};
+	D3D12_SHADER_BYTECODE	m_singlePassVertexShader{};
 
 	ID3D12PipelineState *	m_pipelineState = nullptr;
-	D3D12_VIEWPORT	m_viewport{};
-	D3D12_RECT		m_rect{};
+	ID3D12PipelineState *	m_singlePassPipelineState = nullptr;
+	BOOL	m_singlePassSupported = FALSE;
+	BOOL	m_singlePass = TRUE;
+
+	X12DepthStencil *	m_shadowAtlas = nullptr;
+	ShadowAtlasPacker	m_shadowAtlasPacker{ SHADOW_ATLAS_SIZE, SHADOW_TILE_MIN_SIZE };
+	std::vector<ShadowRequest>	m_shadowRequests;
+	std::vector<ShadowRequest>	m_newRequests;
+	std::vector<UINT>			m_requestSizes;
+	std::vector<UINT>			m_requestTileCounts;
+	std::unordered_map<const ILight*, UINT>	m_tileSizes;
+	BOOL	m_atlasRepacked = FALSE;
+
+	ShadowCache	m_shadowCache;
+	std::unordered_map<const StaticMesh*, DirectX::XMFLOAT4>	m_meshBounds;
+	std::vector<D3D12_RECT>	m_dirtyRects;
+
+	//A face mask per instance and light, the geometry shader drops the faces an instance is outside of
+	X12ConstantBuffer *	m_casterMaskBuffer = nullptr;
+	std::vector<DirectX::XMFLOAT4>	m_casterBounds;
+	std::vector<UINT>				m_casterMasks;
+	BoundingVolumeHierarchy			m_casterTree;
+
+	//Caster slot << 3 | face, one per face a caster touches, in instance group order per light
+	X12ConstantBuffer *	m_casterWorldBuffer = nullptr;
+	X12ConstantBuffer *	m_faceInstanceBuffer = nullptr;
+	std::vector<DirectX::XMFLOAT4X4>	m_casterWorlds;
+	std::vector<UINT>					m_faceInstances;
+	std::vector<UINT>					m_faceInstanceRanges;
+	UINT	m_faceInstanceCount = 0;
 
 	X12ConstantBuffer *	m_constantLightBuffer = nullptr;
 	int m_constantLightBufferPerObjectAlignedSize = (sizeof(LightBuffer) + 255) & ~255;
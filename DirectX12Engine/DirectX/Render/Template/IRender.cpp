@@ -1,16 +1,36 @@
 #include  "DirectX12EnginePCH.h"
 #include "IRender.h"
 #include "DirectX/Render/WrapperFunctions/Functions/Instancing.h"
+#include "DirectX/Render/WrapperFunctions/Functions/InstanceDraw.h"
+#include "DirectX/Render/WrapperFunctions/X12CommandContext.h"
 #include "DirectX/Render/WrapperFunctions/X12BindlessTexture.h"
+#include "DirectX/Render/WrapperFunctions/X12GpuProfiler.h"
+#include "DirectX/Render/WrapperFunctions/Functions/FrameProfiler.h"
 
 void IRender::_updateWithThreads()
 {
+	bool named = false;
 	while (m_threadRunning)
 	{	
 		if (!m_threadDone)
 		{
-			this->Update(this->m_camera, this->m_deltaTime);
-			this->Draw();
+			FrameProfiler * profiler = p_renderingManager->GetProfiler();
+			if (!named && profiler)
+			{
+				profiler->SetThreadName(m_name);
+				named = true;
+			}
+			//A stream can be attached between frames
+			CommandStream * commandStream = p_renderingManager->GetFrameStats()->GetCommandStream();
+			if (commandStream)
+				commandStream->SetThreadPass(m_name);
+			{
+				FrameProfiler::Scope scope(profiler, m_name.c_str());
+				const int64_t begin = FrameProfiler::Now();
+				this->Update(this->m_camera, this->m_deltaTime);
+				this->Draw();
+				p_renderingManager->GetFrameStats()->AddPassTime(m_statsPass, FrameProfiler::Now() - begin);
+			}
 			m_threadDone = true;
 		}
 	}
@@ -93,6 +113,9 @@ HRESULT IRender::p_createCommandList(const std::wstring & name, const bool & cre
 	HRESULT hr = 0;
 
 	X12Adapter * adapter = m_useSecondaryAdapter ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
+	//Pass names are plain ascii
+	m_name = std::string(name.begin(), name.end());
+	m_statsPass = p_renderingManager->GetFrameStats()->RegisterPass(m_name);
 
 	if (createCommandQueue)
 	{
@@ -123,6 +146,7 @@ HRESULT IRender::p_createCommandList(const std::wstring & name, const bool & cre
 		{		
 			SET_NAME(p_commandList[i], name + L" Command list " + std::to_wstring(i));
 			p_commandList[i]->Close();
+			SAFE_NEW(m_commandContext[i], new X12CommandContext(adapter->GetDevice(), p_commandList[i], p_renderingManager->GetFrameStats()));
 		}
 	}
 	return hr;
@@ -135,12 +159,18 @@ void IRender::p_releaseCommandList()
 	{
 		SAFE_RELEASE(p_commandList[i]);
 		SAFE_RELEASE(p_commandAllocator[i]);
+		SAFE_DELETE(m_commandContext[i]);
 	}
 }
 
+ICommandContext * IRender::p_getCommandContext() const
+{
+	return m_commandContext[p_renderingManager->GetFrameIndex()];
+}
+
 void IRender::p_resetDescriptorHeap()
 {
-	m_copyOffset = 0;
+	m_descriptorCursor.Rewind();
 }
 
 void IRender::p_setResourceDescriptorHeap(ID3D12GraphicsCommandList* commandList) const
@@ -155,7 +185,6 @@ HRESULT IRender::p_createDescriptorHeap()
 
 	X12Adapter * adapter = m_useSecondaryAdapter ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
 
-	m_resourceIncrementalSize = adapter->GetDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	const D3D12_DESCRIPTOR_HEAP_DESC desc{ D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, MAX_DESCRIPTOR_SIZE, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE, 0 };
 	const HRESULT hr = adapter->GetDevice()->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_gpuDescriptorHeap));
 	if (FAILED(hr))
@@ -163,6 +192,11 @@ HRESULT IRender::p_createDescriptorHeap()
 		return hr;
 	}
 	SET_NAME(m_gpuDescriptorHeap, L"pass descriptor heap");
+	m_descriptorCursor.Reset(
+		m_gpuDescriptorHeap->GetCPUDescriptorHandleForHeapStart().ptr,
+		m_gpuDescriptorHeap->GetGPUDescriptorHandleForHeapStart().ptr,
+		adapter->GetDevice()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV),
+		MAX_DESCRIPTOR_SIZE);
 	return hr;
 }
 
@@ -173,28 +207,17 @@ void IRender::p_releaseDescriptorHeap()
 
 D3D12_GPU_DESCRIPTOR_HANDLE IRender::p_copyToDescriptorHeap(const D3D12_CPU_DESCRIPTOR_HANDLE& descriptorHandle, const UINT& numDescriptors)
 {
-	if (numDescriptors == 0)
-		throw;
-	const SIZE_T offset = m_copyOffset;
-	const D3D12_CPU_DESCRIPTOR_HANDLE destHandle = { m_gpuDescriptorHeap->GetCPUDescriptorHandleForHeapStart().ptr + m_copyOffset };
-
-	X12Adapter * adapter = m_useSecondaryAdapter ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
-
-
-	adapter->GetDevice()->CopyDescriptorsSimple(
-		numDescriptors,
-		destHandle,
-		descriptorHandle,
-		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
-	m_copyOffset += m_resourceIncrementalSize * numDescriptors;
-
-	return { m_gpuDescriptorHeap->GetGPUDescriptorHandleForHeapStart().ptr + offset };
+	const ICommandContext::GpuDescriptor handle = m_descriptorCursor.Copy(*p_getCommandContext(), descriptorHandle.ptr, numDescriptors);
+	if (!handle)
+		throw "FAILED TO COPY TO THE DESCRIPTOR HEAP";
+	return { handle };
 }
 
-HRESULT IRender::p_createInstanceBuffer(const std::wstring & name, const UINT & bufferSize)
+HRESULT IRender::p_createInstanceBuffer(const std::wstring & name, const UINT64 & bufferSize)
 {
 	HRESULT hr = 0;
+	m_instanceBufferName = name;
+	m_instanceBufferSize = bufferSize;
 
 	X12Adapter * adapter = m_useSecondaryAdapter ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
 
@@ -226,88 +249,69 @@ HRESULT IRender::p_createInstanceBuffer(const std::wstring & name, const UINT &
 	return hr;
 }
 
-UINT64 IRender::p_updateInstanceBuffer(D3D12_VERTEX_BUFFER_VIEW & vertexBufferView) const
-{
-	UINT64 bufferSize = 0;
-
-	bufferSize = Instancing::UpdateInstanceGroup(p_commandList[p_renderingManager->GetFrameIndex()],
-		vertexBufferView,
-		p_instanceBuffer,
-		p_intermediateInstanceBuffer,
-		p_instanceGroups,
-		sizeof(Instancing::InstanceBuffer),
-		bufferSize);
-	
-	if (bufferSize)
-	{
-		vertexBufferView.BufferLocation = p_instanceBuffer->GetGPUVirtualAddress();
-		vertexBufferView.StrideInBytes = sizeof(Instancing::InstanceBuffer);
-		vertexBufferView.SizeInBytes = static_cast<UINT>(bufferSize);
-	}
-
-	return bufferSize;
-}
-
 void IRender::p_drawInstance(const UINT & textureStartIndex, const BOOL& mapTextures)
 {
-	ID3D12GraphicsCommandList * gcl = p_commandList[p_renderingManager->GetFrameIndex()] ? p_commandList[p_renderingManager->GetFrameIndex()] : p_renderingManager->GetCommandList();
-
-	const size_t instanceGroupSize = p_instanceGroups->size();
+	X12CommandContext * context = m_commandContext[p_renderingManager->GetFrameIndex()];
 
-	if (instanceGroupSize <= 0)
-		return;
-
-	D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle {0};
-
-	UINT counter = 0;
-	for (size_t i = 0; i < instanceGroupSize && mapTextures; i++)
+	std::vector<InstanceDraw::Group> groups(p_instanceGroups->size());
+	for (size_t i = 0; i < groups.size(); i++)
 	{
-		if (counter == 0)
-			gpu_handle = p_copyToDescriptorHeap(p_instanceGroups->at(i).Albedo->GetCpuHandle(), p_instanceGroups->at(i).Albedo->GetResource()->GetDesc().DepthOrArraySize);
-		else
-			p_copyToDescriptorHeap(p_instanceGroups->at(i).Albedo->GetCpuHandle(), p_instanceGroups->at(i).Albedo->GetResource()->GetDesc().DepthOrArraySize);
-		p_copyToDescriptorHeap(p_instanceGroups->at(i).Normal->GetCpuHandle(), p_instanceGroups->at(i).Normal->GetResource()->GetDesc().DepthOrArraySize);
-		p_copyToDescriptorHeap(p_instanceGroups->at(i).Metallic->GetCpuHandle(), p_instanceGroups->at(i).Metallic->GetResource()->GetDesc().DepthOrArraySize);
-		p_copyToDescriptorHeap(p_instanceGroups->at(i).Displacement->GetCpuHandle(), p_instanceGroups->at(i).Displacement->GetResource()->GetDesc().DepthOrArraySize);
-
-		for (UINT j = 0; j < p_instanceGroups->at(i).GetSize(); j++)
+		const Instancing::InstanceGroup & instanceGroup = p_instanceGroups->at(i);
+		InstanceDraw::Group & group = groups[i];
+		const D3D12_VERTEX_BUFFER_VIEW & mesh = instanceGroup.StaticMesh->GetVertexBufferView();
+		group.Mesh = { mesh.BufferLocation, mesh.SizeInBytes, mesh.StrideInBytes };
+		group.VertexCount = static_cast<uint32_t>(instanceGroup.StaticMesh->GetStaticMesh().size());
+		group.InstanceCount = instanceGroup.GetSize();
+
+		const Texture * textures[InstanceDraw::TEXTURES] = { instanceGroup.Albedo, instanceGroup.Normal, instanceGroup.Metallic, instanceGroup.Displacement };
+		for (UINT t = 0; t < InstanceDraw::TEXTURES && mapTextures; t++)
 		{
-			p_instanceGroups->at(i).Transforms[j].TextureIndex.x = counter;
+			group.Textures[t] = textures[t]->GetCpuHandle().ptr;
+			group.TextureDescriptors[t] = textures[t]->GetResource()->GetDesc().DepthOrArraySize;
 		}
-		counter += 4;
 	}
 
-	D3D12_VERTEX_BUFFER_VIEW instanceBufferView = {};
-	if (!p_updateInstanceBuffer(instanceBufferView))
-		throw "FAILED TO UPDATE INSTANCE BUFFER";
-	
-	UINT instanceOffset = 0;
-	ID3D12GraphicsCommandList * commandList = p_commandList[p_renderingManager->GetFrameIndex()];
-	for (size_t i = 0; i < instanceGroupSize; i++)
-	{		
+	//The old buffers stay alive for the frames that still draw from them
+	const UINT64 bufferSize = InstanceDraw::BufferSize(InstanceDraw::CountInstances(groups), sizeof(Instancing::InstanceBuffer));
+	if (bufferSize > m_instanceBufferSize)
+	{
+		m_retiredInstanceBuffers.push_back(p_instanceBuffer);
+		m_retiredInstanceBuffers.push_back(p_intermediateInstanceBuffer);
+		p_instanceBuffer = nullptr;
+		p_intermediateInstanceBuffer = nullptr;
+		if (FAILED(p_createInstanceBuffer(m_instanceBufferName, bufferSize)))
+			throw "FAILED TO GROW INSTANCE BUFFER";
+	}
 
-		if (mapTextures)
+	const bool uploaded = InstanceDraw::Draw(
+		*context,
+		mapTextures ? &m_descriptorCursor : nullptr,
+		textureStartIndex,
+		p_instanceBuffer,
+		p_intermediateInstanceBuffer,
+		sizeof(Instancing::InstanceBuffer),
+		groups,
+		[this](const size_t & group, const uint32_t & textureIndex, const uint32_t & firstInstance, uint8_t * destination)
 		{
-			//p_bindlessTexture->SetGraphicsRootDescriptorTable(commandList, textureStartIndex);
-			commandList->SetGraphicsRootDescriptorTable(textureStartIndex, gpu_handle);
-		}
+			Instancing::WriteInstances(p_instanceGroups->at(group), textureIndex, firstInstance, p_lastInstanceSlot, destination);
+		},
+		[this, context](const size_t & group)
+		{
+			p_beginInstanceGroup(context->GetCommandList(), p_instanceGroups->at(group));
+		});
 
-		D3D12_VERTEX_BUFFER_VIEW bufferArr[2] = 
-			{ 
-				p_instanceGroups->at(i).StaticMesh->GetVertexBufferView(),
-				instanceBufferView
-			};
-		
-		gcl->IASetVertexBuffers(0, 2, bufferArr);
-
-		gcl->DrawInstanced(
-			static_cast<UINT>(p_instanceGroups->at(i).StaticMesh->GetStaticMesh().size()),
-			p_instanceGroups->at(i).GetSize(),
-			0,
-			instanceOffset);
-		instanceOffset += p_instanceGroups->at(i).GetSize();
-	}
+	if (!uploaded)
+		throw "FAILED TO UPDATE INSTANCE BUFFER";
+}
+
+void IRender::p_beginInstanceGroup(ID3D12GraphicsCommandList * commandList, const Instancing::InstanceGroup & group)
+{
+}
 
+void IRender::p_countDraw(const UINT & vertexCount, const UINT & instanceCount, const D3D_PRIMITIVE_TOPOLOGY & topology) const
+{
+	const UINT triangles = topology == D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP ? (vertexCount > 2 ? vertexCount - 2 : 0) : vertexCount / 3;
+	p_renderingManager->GetFrameStats()->RecordDraw(vertexCount, instanceCount, static_cast<uint64_t>(triangles) * instanceCount);
 }
 
 void IRender::p_releaseInstanceBuffer()
@@ -315,6 +319,10 @@ void IRender::p_releaseInstanceBuffer()
 	Instancing::ClearInstanceGroup(p_instanceGroups);
 	SAFE_RELEASE(p_instanceBuffer);
 	SAFE_RELEASE(p_intermediateInstanceBuffer);
+	for (size_t i = 0; i < m_retiredInstanceBuffers.size(); i++)
+		SAFE_RELEASE(m_retiredInstanceBuffers[i]);
+	m_retiredInstanceBuffers.clear();
+	m_instanceBufferSize = 0;
 }
 
 void IRender::p_useSecondaryAdapter(const BOOL& value)
@@ -335,16 +343,20 @@ HRESULT IRender::OpenCommandList(ID3D12PipelineState * pipelineState)
 	{
 		if (SUCCEEDED(hr = this->p_commandList[frameIndex]->Reset(this->p_commandAllocator[frameIndex], pipelineState)))
 		{
-
+			X12Adapter * adapter = m_useSecondaryAdapter ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
+			m_gpuZone = adapter->GetGpuProfiler()->BeginZone(this->p_commandList[frameIndex], m_name);
 		}
 	}
 	return hr;
 }
 
-HRESULT IRender::ExecuteCommandList(ID3D12CommandQueue * commandQueue) const
+HRESULT IRender::ExecuteCommandList(ID3D12CommandQueue * commandQueue)
 {
 	HRESULT hr = 0;
 	ID3D12CommandQueue * cq = commandQueue ? commandQueue : p_renderingManager->GetCommandQueue();
+	X12Adapter * adapter = m_useSecondaryAdapter ? p_renderingManager->GetSecondAdapter() : p_renderingManager->GetMainAdapter();
+	adapter->GetGpuProfiler()->EndZone(p_commandList[p_renderingManager->GetFrameIndex()], m_gpuZone, cq);
+	m_gpuZone = X12GpuProfiler::NO_ZONE;
 	if (SUCCEEDED(hr = p_commandList[p_renderingManager->GetFrameIndex()]->Close()))
 	{
 		ID3D12CommandList* ppCommandLists[] = { p_commandList[p_renderingManager->GetFrameIndex()] };
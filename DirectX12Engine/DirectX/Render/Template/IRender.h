@@ -2,8 +2,10 @@
 #include <thread>
 #include "DirectX12EnginePCH.h"
 #include "../WrapperFunctions/Functions/Instancing.h"
+#include "../WrapperFunctions/Functions/CommandContext.h"
 
 class Camera;
+class X12CommandContext;
 
 class IRender
 {
@@ -18,11 +20,24 @@ private:
 	void _updateWithThreads();
 
 	ID3D12DescriptorHeap * m_gpuDescriptorHeap;
-	SIZE_T m_copyOffset;
-	SIZE_T m_resourceIncrementalSize;
+	DescriptorHeapCursor m_descriptorCursor;
+
+	//Records onto the command list of the same frame
+	X12CommandContext * m_commandContext[FRAME_BUFFER_COUNT] { nullptr };
 
 	bool m_useSecondaryAdapter = false;
 
+	//Names the thread and the zones of the pass in the profiler
+	std::string m_name;
+	UINT m_gpuZone = UINT_MAX;
+	UINT m_statsPass = UINT_MAX;
+
+	//What p_createInstanceBuffer made, to grow the instance buffer with
+	std::wstring m_instanceBufferName;
+	UINT64 m_instanceBufferSize = 0;
+	//Grown out of but maybe still read by a frame in flight, released with the instance buffer
+	std::vector<ID3D12Resource*> m_retiredInstanceBuffers;
+
 
 protected:
 	RenderingManager * p_renderingManager;
@@ -36,6 +51,8 @@ protected:
 	std::vector<ILight*> * p_lightQueue = nullptr;
 
 	std::vector<Instancing::InstanceGroup> * p_instanceGroups = nullptr;
+	//Instances past this slot get it as their TextureIndex.y
+	UINT p_lastInstanceSlot = UINT_MAX;
 	ID3D12Resource * p_instanceBuffer = nullptr;
 	ID3D12Resource * p_intermediateInstanceBuffer = nullptr;
 
@@ -45,6 +62,7 @@ protected:
 
 	HRESULT p_createCommandList(const std::wstring & name, const bool & createCommandQueue = false, const D3D12_COMMAND_LIST_TYPE & type = D3D12_COMMAND_LIST_TYPE_DIRECT);
 	void p_releaseCommandList();
+	ICommandContext * p_getCommandContext() const;
 
 	void p_resetDescriptorHeap();
 	void p_setResourceDescriptorHeap(ID3D12GraphicsCommandList * commandList) const;
@@ -53,11 +71,15 @@ protected:
 	D3D12_GPU_DESCRIPTOR_HANDLE p_copyToDescriptorHeap(const D3D12_CPU_DESCRIPTOR_HANDLE & descriptorHandle, const UINT & numDescriptors = 1);
 	
 
-	HRESULT p_createInstanceBuffer(const std::wstring & name, const UINT & bufferSize = 1024u * 64u);
-	UINT64 p_updateInstanceBuffer(D3D12_VERTEX_BUFFER_VIEW & vertexBufferView) const;
+	HRESULT p_createInstanceBuffer(const std::wstring & name, const UINT64 & bufferSize = InstanceDraw::INSTANCE_BUFFER_SIZE);
 
+	// Grows the instance buffer when the queued instances do not fit in it
 	void p_drawInstance(const UINT & textureStartIndex = 0, const BOOL & mapTextures = FALSE);
+	// Called by p_drawInstance before each group is drawn, lets a pass switch to the shader variant of the group
+	virtual void p_beginInstanceGroup(ID3D12GraphicsCommandList * commandList, const Instancing::InstanceGroup & group);
 	void p_releaseInstanceBuffer();
+	// Counts a draw in the frame stats, patch lists are counted by their input triangles
+	void p_countDraw(const UINT & vertexCount, const UINT & instanceCount, const D3D_PRIMITIVE_TOPOLOGY & topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST) const;
 
 	void p_useSecondaryAdapter(const BOOL & value);
 	const bool & p_getUseSecondaryAdapter() const;
@@ -65,7 +87,7 @@ protected:
 public:
 
 	HRESULT OpenCommandList(ID3D12PipelineState * pipelineState = nullptr);
-	HRESULT ExecuteCommandList(ID3D12CommandQueue * commandQueue = nullptr) const;	
+	HRESULT ExecuteCommandList(ID3D12CommandQueue * commandQueue = nullptr);	
 
 	virtual~IRender();
 
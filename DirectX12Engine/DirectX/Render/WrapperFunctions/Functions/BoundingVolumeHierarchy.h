@@ -0,0 +1,786 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <DirectXMath.h>
+#include "ParticleLod.h"
+#include "WorkerPool.h"
+
+// Dynamic bounding volume hierarchy over axis aligned boxes, one item per leaf.
+// Build makes the whole tree from scratch with binned SAH splits, the subtrees are built by the workers of a pool.
+// Insert and Remove change the tree right away, moved items keep their old box in the tree until Refit.
+// Insert and Refit rotate the nodes on their way up when that makes a child smaller.
+// Queries are const and can run on several threads at once, as long as nothing changes the tree meanwhile.
+// Only uses DirectXMath and the standard library so it can be built and measured without a device.
+class BoundingVolumeHierarchy
+{
+public:
+	typedef uint32_t Item;
+	static const Item NO_ITEM = 0xFFFFFFFF;
+
+	struct Box
+	{
+		DirectX::XMFLOAT3 Min;
+		DirectX::XMFLOAT3 Max;
+	};
+
+	// XYZ = center W = radius, like the bounds of ShadowCache
+	static Box SphereBox(const DirectX::XMFLOAT4 & sphere)
+	{
+		Box box;
+		box.Min = DirectX::XMFLOAT3(sphere.x - sphere.w, sphere.y - sphere.w, sphere.z - sphere.w);
+		box.Max = DirectX::XMFLOAT3(sphere.x + sphere.w, sphere.y + sphere.w, sphere.z + sphere.w);
+		return box;
+	}
+
+private:
+	static const uint32_t NO_NODE = 0xFFFFFFFF;
+	static const uint32_t PENDING_NODE = 0xFFFFFFFE;	//Added but not in the tree before the next Build
+	static const unsigned int BIN_COUNT = 16;
+	// Below this many items handing subtrees to the workers costs more than it saves
+	static const size_t MIN_ITEMS_PER_THREAD = 8192;
+
+	struct Node
+	{
+		Box Bounds;
+		uint32_t Parent;
+		uint32_t Left;		//NO_NODE for a leaf
+		uint32_t Right;		//The item of a leaf
+	};
+
+	struct ItemData
+	{
+		Box Bounds;
+		uint32_t UserData;
+		uint32_t Leaf;		//NO_NODE for a removed item, PENDING_NODE for an added one
+		bool Moved;
+	};
+
+	// Copied out of the items so the build only reads and sorts one array
+	struct BuildItem
+	{
+		Box Bounds;
+		float Centroid[3];
+		Item Id;
+	};
+
+	// A range of the build items and the node it becomes, a range of n items takes 2n - 1 nodes starting at Node
+	struct BuildTask
+	{
+		uint32_t Begin;
+		uint32_t End;
+		uint32_t Node;
+		uint32_t Parent;
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_freeNodes;
+	uint32_t m_root = NO_NODE;
+
+	std::vector<ItemData> m_items;
+	std::vector<Item> m_freeItems;
+	std::vector<Item> m_moved;
+
+	std::vector<BuildItem> m_buildItems;
+
+	WorkerPool m_workers;
+
+public:
+	// threadCount includes the thread calling Build, 0 uses every hardware thread
+	explicit BoundingVolumeHierarchy(const unsigned int & threadCount = 0)
+		: m_workers(threadCount)
+	{
+	}
+
+	Item Insert(const Box & box, const uint32_t & userData)
+	{
+		const Item item = _allocateItem(box, userData);
+		const uint32_t leaf = _allocateNode();
+		m_nodes[leaf].Bounds = box;
+		m_nodes[leaf].Left = NO_NODE;
+		m_nodes[leaf].Right = item;
+		m_items[item].Leaf = leaf;
+		_insertLeaf(leaf);
+		return item;
+	}
+
+	// Only goes into the tree in the next Build, for filling it in bulk
+	Item Add(const Box & box, const uint32_t & userData)
+	{
+		const Item item = _allocateItem(box, userData);
+		m_items[item].Leaf = PENDING_NODE;
+		return item;
+	}
+
+	void Remove(const Item & item)
+	{
+		const uint32_t leaf = m_items[item].Leaf;
+		if (leaf == NO_NODE)
+			return;
+		if (leaf != PENDING_NODE)
+		{
+			_removeLeaf(leaf);
+			m_freeNodes.push_back(leaf);
+		}
+		m_items[item].Leaf = NO_NODE;
+		m_freeItems.push_back(item);
+	}
+
+	// Queries find the item at its old box until the next Refit or Build
+	void Move(const Item & item, const Box & box)
+	{
+		ItemData & data = m_items[item];
+		data.Bounds = box;
+		if (!data.Moved)
+		{
+			data.Moved = true;
+			m_moved.push_back(item);
+		}
+	}
+
+	// Gives every item moved since the last Refit or Build its new box and fits the ancestors around it
+	void Refit()
+	{
+		for (size_t i = 0; i < m_moved.size(); i++)
+		{
+			ItemData & data = m_items[m_moved[i]];
+			if (!data.Moved || data.Leaf == NO_NODE || data.Leaf == PENDING_NODE)
+				continue;
+			data.Moved = false;
+
+			//Leaves only change here, so every other node always holds its children
+			m_nodes[data.Leaf].Bounds = data.Bounds;
+			for (uint32_t node = m_nodes[data.Leaf].Parent; node != NO_NODE; node = m_nodes[node].Parent)
+			{
+				const Box bounds = _union(m_nodes[m_nodes[node].Left].Bounds, m_nodes[m_nodes[node].Right].Bounds);
+				//Everything above already holds the unchanged box
+				if (_equal(bounds, m_nodes[node].Bounds))
+					break;
+				m_nodes[node].Bounds = bounds;
+				_rotate(node);
+			}
+		}
+		m_moved.clear();
+	}
+
+	// Throws the tree away and builds it again from every item
+	void Build()
+	{
+		m_nodes.clear();
+		m_freeNodes.clear();
+		m_moved.clear();
+		m_root = NO_NODE;
+
+		m_buildItems.clear();
+		for (Item i = 0; i < m_items.size(); i++)
+		{
+			ItemData & data = m_items[i];
+			if (data.Leaf == NO_NODE)
+				continue;
+			data.Moved = false;
+			const Box & box = data.Bounds;
+			m_buildItems.push_back(BuildItem{ box,
+				{ (box.Min.x + box.Max.x) * 0.5f, (box.Min.y + box.Max.y) * 0.5f, (box.Min.z + box.Max.z) * 0.5f }, i });
+		}
+		if (m_buildItems.empty())
+			return;
+
+		const uint32_t itemCount = static_cast<uint32_t>(m_buildItems.size());
+		m_nodes.resize(itemCount * 2 - 1);
+		m_root = 0;
+
+		//The top of the tree is split here until the ranges are small enough to hand out
+		const unsigned int threads = itemCount >= MIN_ITEMS_PER_THREAD * 2 ? m_workers.GetThreadCount() : 1;
+		size_t grain = threads > 1 ? itemCount / (threads * 8u) : itemCount;
+		if (grain < MIN_ITEMS_PER_THREAD)
+			grain = MIN_ITEMS_PER_THREAD;
+		std::vector<BuildTask> pending(1, BuildTask{ 0, itemCount, 0, NO_NODE }), ready;
+		while (!pending.empty())
+		{
+			const BuildTask task = pending.back();
+			pending.pop_back();
+			if (task.End - task.Begin <= grain)
+				ready.push_back(task);
+			else
+				_buildNode(task, pending);
+		}
+
+		if (threads == 1)
+		{
+			for (size_t i = 0; i < ready.size(); i++)
+				_buildSubtree(ready[i]);
+			return;
+		}
+
+		//Biggest first, a worker takes the next subtree when it is done so they end up with about the same number of items
+		std::sort(ready.begin(), ready.end(), [](const BuildTask & a, const BuildTask & b) { return a.End - a.Begin > b.End - b.Begin; });
+		m_workers.Run(static_cast<unsigned int>(ready.size()), [this, &ready](const unsigned int i) { _buildSubtree(ready[i]); });
+	}
+
+	void Clear()
+	{
+		m_nodes.clear();
+		m_freeNodes.clear();
+		m_items.clear();
+		m_freeItems.clear();
+		m_moved.clear();
+		m_root = NO_NODE;
+	}
+
+	size_t GetItemCount() const
+	{
+		return m_items.size() - m_freeItems.size();
+	}
+
+	const uint32_t & GetUserData(const Item & item) const
+	{
+		return m_items[item].UserData;
+	}
+
+	const Box & GetBox(const Item & item) const
+	{
+		return m_items[item].Bounds;
+	}
+
+	// Surface area heuristic of the tree, the area of every inner node relative to the root summed up.
+	// Lower is better, Build gives the reference to compare a refitted tree against
+	float GetCost() const
+	{
+		if (m_root == NO_NODE || _isLeaf(m_root))
+			return 0.0f;
+		const float rootArea = _area(m_nodes[m_root].Bounds);
+		double cost = 0.0;
+		std::vector<uint32_t> stack(1, m_root);
+		while (!stack.empty())
+		{
+			const Node & node = m_nodes[stack.back()];
+			stack.pop_back();
+			if (node.Left == NO_NODE)
+				continue;
+			cost += _area(node.Bounds);
+			stack.push_back(node.Left);
+			stack.push_back(node.Right);
+		}
+		return rootArea > 0.0f ? static_cast<float>(cost / rootArea) : 0.0f;
+	}
+
+	// callback(userData) for every item whose box overlaps the box
+	template<typename Callback>
+	void QueryBox(const Box & box, Callback callback) const
+	{
+		_query([&box](const Box & bounds) { return _overlaps(bounds, box); }, callback);
+	}
+
+	// callback(userData) for every item whose box the sphere touches
+	template<typename Callback>
+	void QuerySphere(const DirectX::XMFLOAT3 & center, const float & radius, Callback callback) const
+	{
+		const float radiusSq = radius * radius;
+		_query([&center, &radiusSq](const Box & bounds) { return _distanceSq(bounds, center) <= radiusSq; }, callback);
+	}
+
+	// callback(userData) for every item whose box is at least partly inside the frustum.
+	// Subtrees entirely inside are reported without testing them
+	template<typename Callback>
+	void QueryFrustum(const ParticleLod::Frustum & frustum, Callback callback) const
+	{
+		if (m_root == NO_NODE)
+			return;
+
+		std::vector<uint32_t> stack(1, m_root);
+		while (!stack.empty())
+		{
+			const uint32_t index = stack.back();
+			stack.pop_back();
+			const Node & node = m_nodes[index];
+
+			bool inside = true;
+			bool outside = false;
+			for (unsigned int i = 0; i < 6 && !outside; i++)
+			{
+				const DirectX::XMFLOAT4 & plane = frustum.Planes[i];
+				//The corner furthest along the normal decides if the box is out, the nearest if it is in
+				const float furthest = plane.w +
+					plane.x * (plane.x >= 0.0f ? node.Bounds.Max.x : node.Bounds.Min.x) +
+					plane.y * (plane.y >= 0.0f ? node.Bounds.Max.y : node.Bounds.Min.y) +
+					plane.z * (plane.z >= 0.0f ? node.Bounds.Max.z : node.Bounds.Min.z);
+				const float nearest = plane.w +
+					plane.x * (plane.x >= 0.0f ? node.Bounds.Min.x : node.Bounds.Max.x) +
+					plane.y * (plane.y >= 0.0f ? node.Bounds.Min.y : node.Bounds.Max.y) +
+					plane.z * (plane.z >= 0.0f ? node.Bounds.Min.z : node.Bounds.Max.z);
+				outside = furthest < 0.0f;
+				inside = inside && nearest >= 0.0f;
+			}
+			if (outside)
+				continue;
+
+			if (inside)
+				_reportSubtree(index, callback);
+			else if (node.Left == NO_NODE)
+				callback(m_items[node.Right].UserData);
+			else
+			{
+				stack.push_back(node.Left);
+				stack.push_back(node.Right);
+			}
+		}
+	}
+
+	// Closest item along the ray, or NO_ITEM. hit(userData, boxDistance) returns the distance to the item itself
+	// or a negative number when the ray misses it, returning boxDistance hits the box.
+	// The direction does not have to be normalized, distances are in multiples of it
+	template<typename Hit>
+	uint32_t Raycast(const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & direction, const float & maxDistance, Hit hit, float & distance) const
+	{
+		distance = maxDistance;
+		uint32_t closest = NO_ITEM;
+		if (m_root == NO_NODE)
+			return closest;
+
+		const DirectX::XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float entry;
+		if (!_rayBox(m_nodes[m_root].Bounds, origin, inverse, distance, entry))
+			return closest;
+
+		std::vector<std::pair<uint32_t, float>> stack(1, std::make_pair(m_root, entry));
+		while (!stack.empty())
+		{
+			const std::pair<uint32_t, float> top = stack.back();
+			stack.pop_back();
+			if (top.second > distance)
+				continue;
+
+			const Node & node = m_nodes[top.first];
+			if (node.Left == NO_NODE)
+			{
+				const float itemDistance = hit(m_items[node.Right].UserData, top.second);
+				if (itemDistance >= 0.0f && itemDistance <= distance)
+				{
+					distance = itemDistance;
+					closest = m_items[node.Right].UserData;
+				}
+				continue;
+			}
+
+			//The nearer child goes on top so it is visited first and shortens the ray for the other
+			float leftEntry, rightEntry;
+			const bool left = _rayBox(m_nodes[node.Left].Bounds, origin, inverse, distance, leftEntry);
+			const bool right = _rayBox(m_nodes[node.Right].Bounds, origin, inverse, distance, rightEntry);
+			if (left && right)
+			{
+				const bool leftFirst = leftEntry <= rightEntry;
+				stack.push_back(leftFirst ? std::make_pair(node.Right, rightEntry) : std::make_pair(node.Left, leftEntry));
+				stack.push_back(leftFirst ? std::make_pair(node.Left, leftEntry) : std::make_pair(node.Right, rightEntry));
+			}
+			else if (left)
+				stack.push_back(std::make_pair(node.Left, leftEntry));
+			else if (right)
+				stack.push_back(std::make_pair(node.Right, rightEntry));
+		}
+		return closest;
+	}
+
+private:
+	bool _isLeaf(const uint32_t & node) const
+	{
+		return m_nodes[node].Left == NO_NODE;
+	}
+
+	Item _allocateItem(const Box & box, const uint32_t & userData)
+	{
+		Item item;
+		if (!m_freeItems.empty())
+		{
+			item = m_freeItems.back();
+			m_freeItems.pop_back();
+		}
+		else
+		{
+			item = static_cast<Item>(m_items.size());
+			m_items.push_back(ItemData());
+		}
+		m_items[item] = { box, userData, NO_NODE, false };
+		return item;
+	}
+
+	uint32_t _allocateNode()
+	{
+		if (!m_freeNodes.empty())
+		{
+			const uint32_t node = m_freeNodes.back();
+			m_freeNodes.pop_back();
+			return node;
+		}
+		m_nodes.push_back(Node());
+		return static_cast<uint32_t>(m_nodes.size() - 1);
+	}
+
+	void _insertLeaf(const uint32_t & leaf)
+	{
+		if (m_root == NO_NODE)
+		{
+			m_root = leaf;
+			m_nodes[leaf].Parent = NO_NODE;
+			return;
+		}
+
+		//Walks down to the sibling that grows the tree the least, every node on the way grows by the box either way
+		const Box box = m_nodes[leaf].Bounds;
+		uint32_t sibling = m_root;
+		while (!_isLeaf(sibling))
+		{
+			const Node & node = m_nodes[sibling];
+			const float area = _area(node.Bounds);
+			const float combinedArea = _area(_union(node.Bounds, box));
+			const float inherited = 2.0f * (combinedArea - area);
+
+			const float leftCost = _descendCost(node.Left, box) + inherited;
+			const float rightCost = _descendCost(node.Right, box) + inherited;
+			if (2.0f * combinedArea < leftCost && 2.0f * combinedArea < rightCost)
+				break;
+			sibling = leftCost < rightCost ? node.Left : node.Right;
+		}
+
+		const uint32_t oldParent = m_nodes[sibling].Parent;
+		const uint32_t parent = _allocateNode();
+		m_nodes[parent].Bounds = _union(m_nodes[sibling].Bounds, box);
+		m_nodes[parent].Parent = oldParent;
+		m_nodes[parent].Left = sibling;
+		m_nodes[parent].Right = leaf;
+		m_nodes[sibling].Parent = parent;
+		m_nodes[leaf].Parent = parent;
+
+		if (oldParent == NO_NODE)
+			m_root = parent;
+		else if (m_nodes[oldParent].Left == sibling)
+			m_nodes[oldParent].Left = parent;
+		else
+			m_nodes[oldParent].Right = parent;
+
+		_refitUp(oldParent);
+	}
+
+	float _descendCost(const uint32_t & child, const Box & box) const
+	{
+		const float combinedArea = _area(_union(m_nodes[child].Bounds, box));
+		return _isLeaf(child) ? combinedArea : combinedArea - _area(m_nodes[child].Bounds);
+	}
+
+	void _removeLeaf(const uint32_t & leaf)
+	{
+		if (leaf == m_root)
+		{
+			m_root = NO_NODE;
+			return;
+		}
+
+		//The sibling takes the place of the parent
+		const uint32_t parent = m_nodes[leaf].Parent;
+		const uint32_t grandParent = m_nodes[parent].Parent;
+		const uint32_t sibling = m_nodes[parent].Left == leaf ? m_nodes[parent].Right : m_nodes[parent].Left;
+		m_nodes[sibling].Parent = grandParent;
+		m_freeNodes.push_back(parent);
+
+		if (grandParent == NO_NODE)
+		{
+			m_root = sibling;
+			return;
+		}
+		if (m_nodes[grandParent].Left == parent)
+			m_nodes[grandParent].Left = sibling;
+		else
+			m_nodes[grandParent].Right = sibling;
+		_refitUp(grandParent);
+	}
+
+	void _refitUp(uint32_t node)
+	{
+		for (; node != NO_NODE; node = m_nodes[node].Parent)
+		{
+			m_nodes[node].Bounds = _union(m_nodes[m_nodes[node].Left].Bounds, m_nodes[m_nodes[node].Right].Bounds);
+			_rotate(node);
+		}
+	}
+
+	// Swaps a child of the node with a grandchild on the other side when that makes the other child smaller.
+	// The bounds of the node itself stay the same
+	void _rotate(const uint32_t & node)
+	{
+		const uint32_t left = m_nodes[node].Left;
+		const uint32_t right = m_nodes[node].Right;
+
+		float bestGain = 0.0f;
+		uint32_t swapChild = NO_NODE, swapGrandChild = NO_NODE, other = NO_NODE;
+		const uint32_t sides[2][2] = { { left, right }, { right, left } };
+		for (unsigned int s = 0; s < 2; s++)
+		{
+			const uint32_t child = sides[s][0];
+			const uint32_t parent = sides[s][1];
+			if (_isLeaf(parent))
+				continue;
+
+			const float area = _area(m_nodes[parent].Bounds);
+			const uint32_t grandChildren[2] = { m_nodes[parent].Left, m_nodes[parent].Right };
+			for (unsigned int g = 0; g < 2; g++)
+			{
+				//The child takes the place of the grandchild, the parent then holds the child and the other grandchild
+				const float gain = area - _area(_union(m_nodes[child].Bounds, m_nodes[grandChildren[1 - g]].Bounds));
+				if (gain > bestGain)
+				{
+					bestGain = gain;
+					swapChild = child;
+					swapGrandChild = grandChildren[g];
+					other = parent;
+				}
+			}
+		}
+		if (swapChild == NO_NODE)
+			return;
+
+		Node & nodeData = m_nodes[node];
+		if (nodeData.Left == swapChild)
+			nodeData.Left = swapGrandChild;
+		else
+			nodeData.Right = swapGrandChild;
+		Node & otherData = m_nodes[other];
+		if (otherData.Left == swapGrandChild)
+			otherData.Left = swapChild;
+		else
+			otherData.Right = swapChild;
+		m_nodes[swapGrandChild].Parent = node;
+		m_nodes[swapChild].Parent = other;
+		otherData.Bounds = _union(m_nodes[otherData.Left].Bounds, m_nodes[otherData.Right].Bounds);
+	}
+
+	void _buildSubtree(const BuildTask & root)
+	{
+		std::vector<BuildTask> stack(1, root);
+		while (!stack.empty())
+		{
+			const BuildTask task = stack.back();
+			stack.pop_back();
+			_buildNode(task, stack);
+		}
+	}
+
+	// Makes the node of the task, a leaf for one item, and pushes the tasks of its children
+	void _buildNode(const BuildTask & task, std::vector<BuildTask> & children)
+	{
+		Node & node = m_nodes[task.Node];
+		node.Parent = task.Parent;
+		if (task.End - task.Begin == 1)
+		{
+			const Item item = m_buildItems[task.Begin].Id;
+			node.Bounds = m_buildItems[task.Begin].Bounds;
+			node.Left = NO_NODE;
+			node.Right = item;
+			m_items[item].Leaf = task.Node;
+			return;
+		}
+
+		const uint32_t middle = _split(task.Begin, task.End, node.Bounds);
+		node.Left = task.Node + 1;
+		node.Right = task.Node + 2 * (middle - task.Begin);
+		children.push_back(BuildTask{ task.Begin, middle, node.Left, task.Node });
+		children.push_back(BuildTask{ middle, task.End, node.Right, task.Node });
+	}
+
+	// Sorts the range into two by the cheapest binned SAH split and returns where the second half starts
+	uint32_t _split(const uint32_t & begin, const uint32_t & end, Box & bounds)
+	{
+		const float INF = 3.402823466e+38f;
+		const Box empty = { DirectX::XMFLOAT3(INF, INF, INF), DirectX::XMFLOAT3(-INF, -INF, -INF) };
+		bounds = empty;
+		float minimum[3] = { INF, INF, INF }, maximum[3] = { -INF, -INF, -INF };
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const BuildItem & item = m_buildItems[i];
+			bounds = _union(bounds, item.Bounds);
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				minimum[axis] = std::min(minimum[axis], item.Centroid[axis]);
+				maximum[axis] = std::max(maximum[axis], item.Centroid[axis]);
+			}
+		}
+
+		//All three axes are binned in the same pass over the items, small ranges get fewer bins
+		const unsigned int binCount = end - begin < BIN_COUNT ? end - begin : BIN_COUNT;
+		float scale[3];
+		for (unsigned int axis = 0; axis < 3; axis++)
+			scale[axis] = maximum[axis] > minimum[axis] ? binCount / (maximum[axis] - minimum[axis]) : 0.0f;
+		uint32_t counts[3][BIN_COUNT] = {};
+		Box binBounds[3][BIN_COUNT];
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			for (unsigned int b = 0; b < binCount; b++)
+				binBounds[axis][b] = empty;
+		}
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const BuildItem & item = m_buildItems[i];
+			for (unsigned int axis = 0; axis < 3; axis++)
+			{
+				const unsigned int b = _bin(item.Centroid[axis], minimum[axis], scale[axis], binCount);
+				counts[axis][b]++;
+				binBounds[axis][b] = _union(binBounds[axis][b], item.Bounds);
+			}
+		}
+
+		float bestCost = INF;
+		unsigned int bestAxis = 0, bestBin = 0;
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			if (scale[axis] == 0.0f)
+				continue;
+
+			//Right side areas swept from the end, then every split point from the start
+			float rightArea[BIN_COUNT];
+			uint32_t rightCount[BIN_COUNT];
+			Box sweep = empty;
+			uint32_t count = 0;
+			for (unsigned int b = binCount - 1; b > 0; b--)
+			{
+				sweep = _union(sweep, binBounds[axis][b]);
+				count += counts[axis][b];
+				rightArea[b] = count ? _area(sweep) : 0.0f;
+				rightCount[b] = count;
+			}
+			sweep = empty;
+			count = 0;
+			for (unsigned int b = 0; b + 1 < binCount; b++)
+			{
+				sweep = _union(sweep, binBounds[axis][b]);
+				count += counts[axis][b];
+				if (!count || !rightCount[b + 1])
+					continue;
+				const float cost = count * _area(sweep) + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		//Items with the same centroid are split in half
+		if (bestCost == INF)
+			return begin + (end - begin) / 2;
+
+		const std::vector<BuildItem>::iterator middle = std::partition(m_buildItems.begin() + begin, m_buildItems.begin() + end,
+			[&](const BuildItem & item) { return _bin(item.Centroid[bestAxis], minimum[bestAxis], scale[bestAxis], binCount) <= bestBin; });
+		return static_cast<uint32_t>(middle - m_buildItems.begin());
+	}
+
+	static unsigned int _bin(const float & centroid, const float & minimum, const float & scale, const unsigned int & binCount)
+	{
+		const int bin = static_cast<int>((centroid - minimum) * scale);
+		return static_cast<unsigned int>(bin < 0 ? 0 : (bin >= static_cast<int>(binCount) ? binCount - 1 : bin));
+	}
+
+	template<typename Test, typename Callback>
+	void _query(Test test, Callback & callback) const
+	{
+		if (m_root == NO_NODE)
+			return;
+
+		std::vector<uint32_t> stack(1, m_root);
+		while (!stack.empty())
+		{
+			const Node & node = m_nodes[stack.back()];
+			stack.pop_back();
+			if (!test(node.Bounds))
+				continue;
+			if (node.Left == NO_NODE)
+				callback(m_items[node.Right].UserData);
+			else
+			{
+				stack.push_back(node.Left);
+				stack.push_back(node.Right);
+			}
+		}
+	}
+
+	template<typename Callback>
+	void _reportSubtree(const uint32_t & root, Callback & callback) const
+	{
+		std::vector<uint32_t> stack(1, root);
+		while (!stack.empty())
+		{
+			const Node & node = m_nodes[stack.back()];
+			stack.pop_back();
+			if (node.Left == NO_NODE)
+				callback(m_items[node.Right].UserData);
+			else
+			{
+				stack.push_back(node.Left);
+				stack.push_back(node.Right);
+			}
+		}
+	}
+
+	static bool _rayBox(const Box & box, const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & inverse, const float & maxDistance, float & entry)
+	{
+		const float minimum[3] = { box.Min.x, box.Min.y, box.Min.z };
+		const float maximum[3] = { box.Max.x, box.Max.y, box.Max.z };
+		const float start[3] = { origin.x, origin.y, origin.z };
+		const float scale[3] = { inverse.x, inverse.y, inverse.z };
+
+		float enter = 0.0f, exit = maxDistance;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			float t0 = (minimum[i] - start[i]) * scale[i];
+			float t1 = (maximum[i] - start[i]) * scale[i];
+			if (t0 > t1)
+				std::swap(t0, t1);
+			//NaN, a ray in the plane of a face, fails both and leaves the slab open
+			if (t0 > enter)
+				enter = t0;
+			if (t1 < exit)
+				exit = t1;
+			if (enter > exit)
+				return false;
+		}
+		entry = enter;
+		return true;
+	}
+
+	static bool _overlaps(const Box & a, const Box & b)
+	{
+		return a.Min.x <= b.Max.x && a.Max.x >= b.Min.x &&
+			a.Min.y <= b.Max.y && a.Max.y >= b.Min.y &&
+			a.Min.z <= b.Max.z && a.Max.z >= b.Min.z;
+	}
+
+	static float _distanceSq(const Box & box, const DirectX::XMFLOAT3 & point)
+	{
+		const float x = point.x < box.Min.x ? box.Min.x - point.x : (point.x > box.Max.x ? point.x - box.Max.x : 0.0f);
+		const float y = point.y < box.Min.y ? box.Min.y - point.y : (point.y > box.Max.y ? point.y - box.Max.y : 0.0f);
+		const float z = point.z < box.Min.z ? box.Min.z - point.z : (point.z > box.Max.z ? point.z - box.Max.z : 0.0f);
+		return x * x + y * y + z * z;
+	}
+
+	static Box _union(const Box & a, const Box & b)
+	{
+		return
+		{
+			DirectX::XMFLOAT3(std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z)),
+			DirectX::XMFLOAT3(std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z))
+		};
+	}
+
+	// Half the surface area, only ever compared
+	static float _area(const Box & box)
+	{
+		const float x = box.Max.x - box.Min.x;
+		const float y = box.Max.y - box.Min.y;
+		const float z = box.Max.z - box.Min.z;
+		return x * y + y * z + z * x;
+	}
+
+	static bool _equal(const Box & a, const Box & b)
+	{
+		return a.Min.x == b.Min.x && a.Min.y == b.Min.y && a.Min.z == b.Min.z &&
+			a.Max.x == b.Max.x && a.Max.y == b.Max.y && a.Max.z == b.Max.z;
+	}
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cmath>
+
+// Cascade splits and the fitting of one orthographic shadow view per split of the camera frustum.
+// Only depends on DirectXMath so the cascades can be checked without a device.
+namespace CascadedShadows
+{
+	static const unsigned int MAX_CASCADES = 4;
+
+	struct Settings
+	{
+		unsigned int CascadeCount = MAX_CASCADES;
+		float SplitLambda = 0.75f;			//0 = uniform splits, 1 = logarithmic splits
+		float ShadowDistance = 100.0f;		//Shadows end here or at the camera far plane, whichever is closer
+		float DepthExtension = 100.0f;		//How far towards the light casters outside the slice are still caught
+	};
+
+	struct Cascade
+	{
+		DirectX::XMFLOAT4X4A ViewProjection;	//Transposed, like the cameras keep it for the shaders
+		DirectX::XMFLOAT4 Bounds;				//World space sphere around the slice, XYZ = center W = radius
+		float SplitNear;
+		float SplitFar;
+	};
+
+	// Practical split scheme, a blend of the logarithmic and the uniform split.
+	// Writes count + 1 distances, splits[0] = nearPlane and splits[count] = farPlane
+	inline void ComputeSplits(const float & nearPlane, const float & farPlane, const unsigned int & count, const float & lambda, float * splits)
+	{
+		splits[0] = nearPlane;
+		for (unsigned int i = 1; i < count; i++)
+		{
+			const float fraction = static_cast<float>(i) / static_cast<float>(count);
+			const float logarithmic = nearPlane * powf(farPlane / nearPlane, fraction);
+			const float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+			splits[i] = lambda * logarithmic + (1.0f - lambda) * uniform;
+		}
+		splits[count] = farPlane;
+	}
+
+	// Smallest sphere around the slice of a symmetric perspective frustum between splitNear and splitFar, in view space it sits on the view axis.
+	// Returns the view space depth of the center and writes the radius
+	inline float SliceBounds(const float & fov, const float & aspectRatio, const float & splitNear, const float & splitFar, float & radius)
+	{
+		const float tanHalfFov = tanf(fov * 0.5f);
+		const float diagonal = tanHalfFov * tanHalfFov * (1.0f + aspectRatio * aspectRatio);
+
+		float center = 0.5f * (splitNear + splitFar) * (1.0f + diagonal);
+		if (center > splitFar)
+			center = splitFar;
+
+		const float farDistance = sqrtf((splitFar - center) * (splitFar - center) + splitFar * splitFar * diagonal);
+		const float nearDistance = sqrtf((center - splitNear) * (center - splitNear) + splitNear * splitNear * diagonal);
+		radius = farDistance > nearDistance ? farDistance : nearDistance;
+		return center;
+	}
+
+	// Expects the transposed view matrix the camera keeps for the shaders.
+	// The sphere keeps the cascade the same size while the camera turns and the center is snapped to whole shadow texels,
+	// so the shadow edges do not crawl when the camera moves
+	inline Cascade FitCascade(
+		const DirectX::XMFLOAT4X4A & viewMatrix,
+		const float & fov,
+		const float & aspectRatio,
+		const float & splitNear,
+		const float & splitFar,
+		const DirectX::XMFLOAT4 & lightDirection,
+		const unsigned int & resolution,
+		const float & depthExtension)
+	{
+		using namespace DirectX;
+
+		Cascade cascade;
+		cascade.SplitNear = splitNear;
+		cascade.SplitFar = splitFar;
+
+		float radius;
+		const float centerDepth = SliceBounds(fov, aspectRatio, splitNear, splitFar, radius);
+		//Rounded up so float noise in the radius does not change the texel size from frame to frame
+		radius = ceilf(radius * 16.0f) / 16.0f;
+
+		//The rows of the transposed view matrix are the camera axes and the translation in w
+		const XMMATRIX view = XMLoadFloat4x4A(&viewMatrix);
+		const XMVECTOR translation = XMVectorSet(viewMatrix.m[0][3], viewMatrix.m[1][3], viewMatrix.m[2][3], 0.0f);
+		const XMVECTOR cameraPosition = XMVectorNegate(XMVector3TransformNormal(translation, view));
+		const XMVECTOR forward = XMVectorSetW(view.r[2], 0.0f);
+		const XMVECTOR center = XMVectorSetW(XMVectorAdd(cameraPosition, XMVectorScale(forward, centerDepth)), 1.0f);
+		XMStoreFloat4(&cascade.Bounds, XMVectorSetW(center, radius));
+
+		//The light view sits in the origin so it only changes with the light direction
+		const XMVECTOR direction = XMVector3Normalize(XMLoadFloat4(&lightDirection));
+		const XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+		const XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), direction, up);
+
+		XMFLOAT4 lightCenter;
+		XMStoreFloat4(&lightCenter, XMVector3TransformCoord(center, lightView));
+
+		const float texelSize = 2.0f * radius / static_cast<float>(resolution);
+		lightCenter.x = floorf(lightCenter.x / texelSize) * texelSize;
+		lightCenter.y = floorf(lightCenter.y / texelSize) * texelSize;
+
+		const XMMATRIX projection = XMMatrixOrthographicOffCenterLH(
+			lightCenter.x - radius, lightCenter.x + radius,
+			lightCenter.y - radius, lightCenter.y + radius,
+			lightCenter.z - radius - depthExtension, lightCenter.z + radius);
+
+		XMStoreFloat4x4A(&cascade.ViewProjection, XMMatrixTranspose(XMMatrixMultiply(lightView, projection)));
+		return cascade;
+	}
+
+	// Returns the number of cascades written
+	inline unsigned int ComputeCascades(
+		const DirectX::XMFLOAT4X4A & viewMatrix,
+		const float & fov,
+		const float & aspectRatio,
+		const float & nearPlane,
+		const float & farPlane,
+		const DirectX::XMFLOAT4 & lightDirection,
+		const unsigned int & resolution,
+		const Settings & settings,
+		Cascade * cascades)
+	{
+		unsigned int count = settings.CascadeCount;
+		if (count > MAX_CASCADES)
+			count = MAX_CASCADES;
+		if (count == 0)
+			count = 1;
+
+		const float shadowFar = settings.ShadowDistance < farPlane ? settings.ShadowDistance : farPlane;
+
+		float splits[MAX_CASCADES + 1];
+		ComputeSplits(nearPlane, shadowFar, count, settings.SplitLambda, splits);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			cascades[i] = FitCascade(viewMatrix, fov, aspectRatio, splits[i], splits[i + 1], lightDirection, resolution, settings.DepthExtension);
+		}
+		return count;
+	}
+}
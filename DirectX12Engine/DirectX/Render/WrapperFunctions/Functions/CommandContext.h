@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+
+// The command list and device calls IRender makes for its instanced draws each frame, in plain types.
+// X12CommandContext forwards them to D3D12, RecordingCommandContext records them so the frame runs without a device.
+class ICommandContext
+{
+public:
+	typedef void * Resource;		//ID3D12Resource
+	typedef uint64_t CpuDescriptor;	//D3D12_CPU_DESCRIPTOR_HANDLE
+	typedef uint64_t GpuDescriptor;	//D3D12_GPU_DESCRIPTOR_HANDLE
+
+	// Same layout as D3D12_VERTEX_BUFFER_VIEW
+	struct VertexBufferView
+	{
+		uint64_t BufferLocation;
+		uint32_t SizeInBytes;
+		uint32_t StrideInBytes;
+	};
+
+	virtual ~ICommandContext() = default;
+
+	virtual void CopyDescriptors(const CpuDescriptor & destination, const CpuDescriptor & source, const uint32_t & count) = 0;
+	virtual void SetGraphicsRootDescriptorTable(const uint32_t & rootParameterIndex, const GpuDescriptor & table) = 0;
+
+	// Where size bytes for the start of destination are written, nullptr when they can not be mapped.
+	// Every BeginUpload that succeeds is followed by an EndUpload, which copies the bytes over on the GPU
+	virtual uint8_t * BeginUpload(Resource destination, Resource intermediate, const uint64_t & size) = 0;
+	virtual void EndUpload(Resource destination, Resource intermediate, const uint64_t & size) = 0;
+	virtual uint64_t GetGpuAddress(Resource resource) const = 0;
+
+	virtual void SetVertexBuffers(const uint32_t & startSlot, const uint32_t & count, const VertexBufferView * views) = 0;
+	virtual void DrawInstanced(const uint32_t & vertexCount, const uint32_t & instanceCount, const uint32_t & startVertex, const uint32_t & startInstance) = 0;
+};
+
+// Linear allocator over the shader visible heap of a pass, the descriptors of a frame are copied in one after another
+class DescriptorHeapCursor
+{
+public:
+	void Reset(const ICommandContext::CpuDescriptor & cpuStart, const ICommandContext::GpuDescriptor & gpuStart, const uint64_t & increment, const uint32_t & capacity)
+	{
+		m_cpuStart = cpuStart;
+		m_gpuStart = gpuStart;
+		m_increment = increment;
+		m_capacity = capacity;
+		m_used = 0;
+	}
+
+	// Starts the next frame from the beginning of the heap
+	void Rewind()
+	{
+		m_used = 0;
+	}
+
+	// Returns the GPU descriptor of the first copy, 0 when count is 0 or the heap is full
+	ICommandContext::GpuDescriptor Copy(ICommandContext & context, const ICommandContext::CpuDescriptor & source, const uint32_t & count)
+	{
+		if (!count || m_used + count > m_capacity)
+			return 0;
+		const uint64_t offset = m_increment * m_used;
+		context.CopyDescriptors(m_cpuStart + offset, source, count);
+		m_used += count;
+		return m_gpuStart + offset;
+	}
+
+	const uint32_t & GetUsed() const
+	{
+		return m_used;
+	}
+
+private:
+	ICommandContext::CpuDescriptor m_cpuStart = 0;
+	ICommandContext::GpuDescriptor m_gpuStart = 0;
+	uint64_t m_increment = 0;
+	uint32_t m_capacity = 0;
+	uint32_t m_used = 0;
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <ostream>
+#include <algorithm>
+#include <cstdint>
+
+// The GPU work a frame asked for, recorded on the CPU as it is issued so it can be inspected and compared without a device.
+// Every command carries the pass of the thread that recorded it. Only uses the standard library.
+class CommandStream
+{
+public:
+	enum CommandType
+	{
+		DRAW,				//A vertices, B instances, C triangles
+		DRAW_INDIRECT,		//A argument offset
+		DISPATCH,			//A, B, C thread groups
+		BARRIER,			//A barriers
+		DESCRIPTOR_COPY,	//A descriptors
+		UPLOAD,				//A bytes
+		TYPE_COUNT
+	};
+
+	struct Command
+	{
+		CommandType Type;
+		std::string Pass;
+		uint64_t A;
+		uint64_t B;
+		uint64_t C;
+	};
+
+	static const char * TypeName(const CommandType & type)
+	{
+		static const char * const NAMES[TYPE_COUNT] = { "Draw", "DrawIndirect", "Dispatch", "Barrier", "DescriptorCopy", "Upload" };
+		return type < TYPE_COUNT ? NAMES[type] : "Unknown";
+	}
+
+	// Commands recorded on the calling thread are put in the pass until it is set again
+	void SetThreadPass(const std::string & pass)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_threadPasses[std::this_thread::get_id()] = pass;
+	}
+
+	void Record(const CommandType & type, const uint64_t & a = 0, const uint64_t & b = 0, const uint64_t & c = 0)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_threadPasses.find(std::this_thread::get_id());
+		m_commands.push_back(Command{ type, it != m_threadPasses.end() ? it->second : std::string(), a, b, c });
+	}
+
+	// Copy of every command since the last Clear, in the order they were recorded
+	std::vector<Command> GetCommands() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_commands;
+	}
+
+	// An empty pass counts every pass
+	size_t Count(const CommandType & type, const std::string & pass = std::string()) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t count = 0;
+		for (size_t i = 0; i < m_commands.size(); i++)
+		{
+			if (m_commands[i].Type == type && (pass.empty() || m_commands[i].Pass == pass))
+				count++;
+		}
+		return count;
+	}
+
+	// Sum of the A argument, the number of barriers, descriptors or bytes
+	uint64_t Sum(const CommandType & type, const std::string & pass = std::string()) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint64_t sum = 0;
+		for (size_t i = 0; i < m_commands.size(); i++)
+		{
+			if (m_commands[i].Type == type && (pass.empty() || m_commands[i].Pass == pass))
+				sum += m_commands[i].A;
+		}
+		return sum;
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_commands.clear();
+	}
+
+	// One command per line grouped by pass, passes sorted by name.
+	// Pass threads record concurrently, grouping keeps the text the same from run to run so it can be diffed
+	void WriteText(std::ostream & out) const
+	{
+		const std::vector<Command> commands = GetCommands();
+		std::vector<std::string> passes;
+		for (size_t i = 0; i < commands.size(); i++)
+			passes.push_back(commands[i].Pass);
+		std::sort(passes.begin(), passes.end());
+		passes.erase(std::unique(passes.begin(), passes.end()), passes.end());
+
+		for (size_t i = 0; i < passes.size(); i++)
+		{
+			out << "[" << passes[i] << "]\n";
+			for (size_t j = 0; j < commands.size(); j++)
+			{
+				if (commands[j].Pass != passes[i])
+					continue;
+				out << TypeName(commands[j].Type) << " " << commands[j].A << " " << commands[j].B << " " << commands[j].C << "\n";
+			}
+		}
+	}
+
+private:
+	std::vector<Command> m_commands;
+	std::unordered_map<std::thread::id, std::string> m_threadPasses;
+	mutable std::mutex m_mutex;
+};
@@ -0,0 +1,297 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <cstdio>
+#include <cstdint>
+
+// Ring buffer of the last frames, each with the CPU zones of every thread and the GPU zones of every queue on one timeline.
+// CPU times are steady clock nanoseconds, GPU timestamps are moved onto that clock with a calibration pair taken from the queue.
+// Only uses the standard library so it can record and export without a device.
+class FrameProfiler
+{
+public:
+	struct Zone
+	{
+		std::string Name;
+		uint32_t Track;
+		int64_t Begin;
+		int64_t End;
+	};
+
+	struct Frame
+	{
+		uint64_t Index = 0;
+		int64_t Begin = 0;
+		int64_t End = 0;
+		std::vector<Zone> CpuZones;
+		std::vector<Zone> GpuZones;
+	};
+
+	// A GPU timestamp and the CPU time it was taken at
+	struct Calibration
+	{
+		uint64_t GpuTicks = 0;
+		uint64_t Frequency = 0;
+		int64_t CpuTime = 0;
+	};
+
+	// Records a CPU zone on the calling thread from construction to destruction
+	class Scope
+	{
+	public:
+		Scope(FrameProfiler * profiler, const char * name) : m_profiler(profiler), m_name(name), m_begin(profiler ? Now() : 0) {}
+		~Scope()
+		{
+			if (m_profiler)
+				m_profiler->AddCpuZone(m_name, m_begin, Now());
+		}
+		Scope(const Scope &) = delete;
+		Scope & operator=(const Scope &) = delete;
+
+	private:
+		FrameProfiler * m_profiler;
+		const char * m_name;
+		int64_t m_begin;
+	};
+
+	static const uint64_t NO_FRAME = ~0ull;
+
+	explicit FrameProfiler(const size_t & frameCount = 120)
+		: m_frames(frameCount ? frameCount : 1), m_origin(Now())
+	{
+	}
+
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// GPU ticks to steady clock nanoseconds
+	static int64_t ToCpuTime(const Calibration & calibration, const uint64_t & ticks)
+	{
+		if (!calibration.Frequency)
+			return calibration.CpuTime;
+		const int64_t delta = static_cast<int64_t>(ticks - calibration.GpuTicks);
+		const int64_t seconds = delta / static_cast<int64_t>(calibration.Frequency);
+		const int64_t remainder = delta % static_cast<int64_t>(calibration.Frequency);
+		return calibration.CpuTime + seconds * 1000000000ll + remainder * 1000000000ll / static_cast<int64_t>(calibration.Frequency);
+	}
+
+	// Ends the frame before it and returns the index of the new one
+	uint64_t BeginFrame()
+	{
+		const int64_t now = Now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_frameCount)
+		{
+			Frame & previous = _frame(m_frameCount - 1);
+			if (!previous.End)
+				previous.End = now;
+		}
+
+		Frame & frame = _frame(m_frameCount);
+		frame.Index = m_frameCount;
+		frame.Begin = now;
+		frame.End = 0;
+		frame.CpuZones.clear();
+		frame.GpuZones.clear();
+		return m_frameCount++;
+	}
+
+	void EndFrame()
+	{
+		const int64_t now = Now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_frameCount)
+			_frame(m_frameCount - 1).End = now;
+	}
+
+	// Index of the frame zones are added to, NO_FRAME before the first frame
+	uint64_t GetCurrentFrame() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_frameCount ? m_frameCount - 1 : NO_FRAME;
+	}
+
+	// Names the track of the calling thread, threads that never call this are named by their order
+	void SetThreadName(const std::string & name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cpuTracks[_threadTrack()] = name;
+	}
+
+	// Returns the track of a GPU queue, created the first time the name is seen
+	uint32_t GetGpuTrack(const std::string & name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (uint32_t i = 0; i < m_gpuTracks.size(); i++)
+		{
+			if (m_gpuTracks[i] == name)
+				return i;
+		}
+		m_gpuTracks.push_back(name);
+		return static_cast<uint32_t>(m_gpuTracks.size() - 1);
+	}
+
+	// Zones outside of a frame are dropped
+	void AddCpuZone(const std::string & name, const int64_t & begin, const int64_t & end)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_frameCount)
+			return;
+		_frame(m_frameCount - 1).CpuZones.push_back(Zone{ name, _threadTrack(), begin, end });
+	}
+
+	// GPU zones arrive frames later, returns false when the frame already left the ring
+	bool AddGpuZone(const uint64_t & frameIndex, const std::string & name, const uint32_t & track, const int64_t & begin, const int64_t & end)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (frameIndex >= m_frameCount || m_frameCount - frameIndex > m_frames.size())
+			return false;
+		_frame(frameIndex).GpuZones.push_back(Zone{ name, track, begin, end });
+		return true;
+	}
+
+	// Copy of the frames in the ring, oldest first
+	std::vector<Frame> GetFrames() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<Frame> frames;
+		const uint64_t count = m_frameCount < m_frames.size() ? m_frameCount : m_frames.size();
+		frames.reserve(static_cast<size_t>(count));
+		for (uint64_t i = m_frameCount - count; i < m_frameCount; i++)
+			frames.push_back(_frame(i));
+		return frames;
+	}
+
+	// Chrome trace_event JSON, open it in chrome://tracing or Perfetto.
+	// CPU threads are the tracks of process 0, GPU queues the tracks of process 1
+	void WriteChromeTrace(std::ostream & out) const
+	{
+		const std::vector<Frame> frames = GetFrames();
+		std::vector<std::string> cpuTracks, gpuTracks;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			cpuTracks = m_cpuTracks;
+			gpuTracks = m_gpuTracks;
+		}
+
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		_writeMetadata(out, first, 0, 0, "process_name", "CPU");
+		_writeMetadata(out, first, 1, 0, "process_name", "GPU");
+		_writeMetadata(out, first, 0, 0, "thread_name", "Frames");
+		for (uint32_t i = 0; i < cpuTracks.size(); i++)
+			_writeMetadata(out, first, 0, i + 1, "thread_name", cpuTracks[i]);
+		for (uint32_t i = 0; i < gpuTracks.size(); i++)
+			_writeMetadata(out, first, 1, i, "thread_name", gpuTracks[i]);
+
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			const Frame & frame = frames[i];
+			if (frame.End)
+				_writeEvent(out, first, 0, 0, "Frame " + std::to_string(frame.Index), "frame", frame.Begin, frame.End);
+			for (size_t j = 0; j < frame.CpuZones.size(); j++)
+				_writeEvent(out, first, 0, frame.CpuZones[j].Track + 1, frame.CpuZones[j].Name, "cpu", frame.CpuZones[j].Begin, frame.CpuZones[j].End);
+			for (size_t j = 0; j < frame.GpuZones.size(); j++)
+				_writeEvent(out, first, 1, frame.GpuZones[j].Track, frame.GpuZones[j].Name, "gpu", frame.GpuZones[j].Begin, frame.GpuZones[j].End);
+		}
+		out << "\n]}\n";
+	}
+
+	bool ExportChromeTrace(const std::string & path) const
+	{
+		std::ofstream out(path);
+		if (!out)
+			return false;
+		WriteChromeTrace(out);
+		return static_cast<bool>(out);
+	}
+
+private:
+	std::vector<Frame> m_frames;
+	uint64_t m_frameCount = 0;
+	int64_t m_origin;
+
+	std::unordered_map<std::thread::id, uint32_t> m_threads;
+	std::vector<std::string> m_cpuTracks;
+	std::vector<std::string> m_gpuTracks;
+
+	mutable std::mutex m_mutex;
+
+	Frame & _frame(const uint64_t & index)
+	{
+		return m_frames[static_cast<size_t>(index % m_frames.size())];
+	}
+
+	const Frame & _frame(const uint64_t & index) const
+	{
+		return m_frames[static_cast<size_t>(index % m_frames.size())];
+	}
+
+	// Expects the lock to be held
+	uint32_t _threadTrack()
+	{
+		auto it = m_threads.find(std::this_thread::get_id());
+		if (it != m_threads.end())
+			return it->second;
+		const uint32_t track = static_cast<uint32_t>(m_cpuTracks.size());
+		m_threads.emplace(std::this_thread::get_id(), track);
+		m_cpuTracks.push_back("Thread " + std::to_string(track));
+		return track;
+	}
+
+	static void _writeString(std::ostream & out, const std::string & text)
+	{
+		out << '"';
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			const unsigned char c = static_cast<unsigned char>(text[i]);
+			if (c == '"' || c == '\\')
+				out << '\\' << c;
+			else if (c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out << escaped;
+			}
+			else
+				out << c;
+		}
+		out << '"';
+	}
+
+	// Microseconds since the profiler was created
+	void _writeTime(std::ostream & out, const int64_t & nanoseconds) const
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "%.3f", static_cast<double>(nanoseconds) / 1000.0);
+		out << text;
+	}
+
+	static void _writeMetadata(std::ostream & out, bool & first, const uint32_t & pid, const uint32_t & tid, const char * type, const std::string & name)
+	{
+		out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"name\":\"" << type << "\",\"args\":{\"name\":";
+		_writeString(out, name);
+		out << "}}";
+		first = false;
+	}
+
+	void _writeEvent(std::ostream & out, bool & first, const uint32_t & pid, const uint32_t & tid, const std::string & name, const char * category, const int64_t & begin, const int64_t & end) const
+	{
+		out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"cat\":\"" << category << "\",\"name\":";
+		_writeString(out, name);
+		out << ",\"ts\":";
+		_writeTime(out, begin - m_origin);
+		out << ",\"dur\":";
+		_writeTime(out, end > begin ? end - begin : 0);
+		out << "}";
+		first = false;
+	}
+};
@@ -0,0 +1,256 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "CommandStream.h"
+
+// What one frame did. Filled by FrameStatsRecorder, read by tools and overlays
+struct FrameStats
+{
+	enum Counter
+	{
+		DRAW_CALLS,
+		INSTANCES,
+		TRIANGLES,
+		DISPATCHES,
+		DESCRIPTOR_COPIES,
+		BARRIERS,
+		UPLOAD_BYTES,
+		MATRIX_UPDATES,				//World, view and projection matrices rebuilt
+		MATRIX_UPDATES_SKIPPED,		//Updates that kept the matrix because nothing it is made from changed
+		INSTANCES_OCCLUDED,			//Instances the geometry pass left out because occluders hid them
+		COUNTER_COUNT
+	};
+
+	static const unsigned int MAX_PASSES = 16;
+
+	uint64_t Index = 0;
+	double FrameTime = 0.0;					//Milliseconds of CPU time since the frame before ended
+	uint64_t Counters[COUNTER_COUNT] = {};
+	double PassTime[MAX_PASSES] = {};		//Milliseconds of CPU time each pass spent on its thread
+};
+
+// Counts the work of the current frame from any thread and keeps the last frames for percentiles.
+// Only uses the standard library so the counters can be checked without a device.
+class FrameStatsRecorder
+{
+public:
+	static const unsigned int NO_PASS = FrameStats::MAX_PASSES;
+
+	explicit FrameStatsRecorder(const size_t & historySize = 240)
+		: m_history(historySize ? historySize : 1), m_lastEnd(_now())
+	{
+		for (unsigned int i = 0; i < FrameStats::COUNTER_COUNT; i++)
+			m_counters[i] = 0;
+		for (unsigned int i = 0; i < FrameStats::MAX_PASSES; i++)
+			m_passTime[i] = 0;
+	}
+
+	void Add(const FrameStats::Counter & counter, const uint64_t & value = 1)
+	{
+		m_counters[counter].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	// Every command recorded below is also written to the stream, nullptr stops it
+	void SetCommandStream(CommandStream * commandStream)
+	{
+		m_commandStream.store(commandStream, std::memory_order_release);
+	}
+
+	CommandStream * GetCommandStream() const
+	{
+		return m_commandStream.load(std::memory_order_acquire);
+	}
+
+	void RecordDraw(const uint64_t & vertexCount, const uint64_t & instanceCount, const uint64_t & triangles)
+	{
+		Add(FrameStats::DRAW_CALLS);
+		Add(FrameStats::INSTANCES, instanceCount);
+		Add(FrameStats::TRIANGLES, triangles);
+		_record(CommandStream::DRAW, vertexCount, instanceCount, triangles);
+	}
+
+	// The size of an indirect draw is only known on the GPU
+	void RecordIndirectDraw(const uint64_t & argumentOffset)
+	{
+		Add(FrameStats::DRAW_CALLS);
+		_record(CommandStream::DRAW_INDIRECT, argumentOffset);
+	}
+
+	void RecordDispatch(const uint64_t & x, const uint64_t & y, const uint64_t & z)
+	{
+		Add(FrameStats::DISPATCHES);
+		_record(CommandStream::DISPATCH, x, y, z);
+	}
+
+	void RecordBarriers(const uint64_t & count = 1)
+	{
+		Add(FrameStats::BARRIERS, count);
+		_record(CommandStream::BARRIER, count);
+	}
+
+	void RecordDescriptorCopies(const uint64_t & count)
+	{
+		Add(FrameStats::DESCRIPTOR_COPIES, count);
+		_record(CommandStream::DESCRIPTOR_COPY, count);
+	}
+
+	void RecordUpload(const uint64_t & bytes)
+	{
+		Add(FrameStats::UPLOAD_BYTES, bytes);
+		_record(CommandStream::UPLOAD, bytes);
+	}
+
+	// The same name gets the same pass, NO_PASS when every pass is taken
+	unsigned int RegisterPass(const std::string & name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (unsigned int i = 0; i < m_passNames.size(); i++)
+		{
+			if (m_passNames[i] == name)
+				return i;
+		}
+		if (m_passNames.size() >= FrameStats::MAX_PASSES)
+			return NO_PASS;
+		m_passNames.push_back(name);
+		return static_cast<unsigned int>(m_passNames.size() - 1);
+	}
+
+	void AddPassTime(const unsigned int & pass, const int64_t & nanoseconds)
+	{
+		if (pass < FrameStats::MAX_PASSES)
+			m_passTime[pass].fetch_add(nanoseconds, std::memory_order_relaxed);
+	}
+
+	// Moves the counters into the history and starts the next frame from zero
+	FrameStats EndFrame()
+	{
+		const int64_t now = _now();
+		FrameStats stats;
+		for (unsigned int i = 0; i < FrameStats::COUNTER_COUNT; i++)
+			stats.Counters[i] = m_counters[i].exchange(0, std::memory_order_relaxed);
+		for (unsigned int i = 0; i < FrameStats::MAX_PASSES; i++)
+			stats.PassTime[i] = static_cast<double>(m_passTime[i].exchange(0, std::memory_order_relaxed)) / 1000000.0;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		stats.Index = m_frameCount;
+		stats.FrameTime = static_cast<double>(now - m_lastEnd) / 1000000.0;
+		m_lastEnd = now;
+		m_history[static_cast<size_t>(m_frameCount % m_history.size())] = stats;
+		m_frameCount++;
+		return stats;
+	}
+
+	// The last frame that ended, zeroed before the first
+	FrameStats GetLast() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_frameCount ? m_history[static_cast<size_t>((m_frameCount - 1) % m_history.size())] : FrameStats();
+	}
+
+	// Oldest first
+	std::vector<FrameStats> GetHistory() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<FrameStats> history;
+		const uint64_t count = _historyCount();
+		history.reserve(static_cast<size_t>(count));
+		for (uint64_t i = m_frameCount - count; i < m_frameCount; i++)
+			history.push_back(m_history[static_cast<size_t>(i % m_history.size())]);
+		return history;
+	}
+
+	size_t GetHistoryCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return static_cast<size_t>(_historyCount());
+	}
+
+	// Nearest rank percentile over the history, percentile is in [0, 100]
+	double CounterPercentile(const FrameStats::Counter & counter, const double & percentile) const
+	{
+		return _percentile(percentile, [&counter](const FrameStats & stats) { return static_cast<double>(stats.Counters[counter]); });
+	}
+
+	double FrameTimePercentile(const double & percentile) const
+	{
+		return _percentile(percentile, [](const FrameStats & stats) { return stats.FrameTime; });
+	}
+
+	double PassTimePercentile(const unsigned int & pass, const double & percentile) const
+	{
+		if (pass >= FrameStats::MAX_PASSES)
+			return 0.0;
+		return _percentile(percentile, [&pass](const FrameStats & stats) { return stats.PassTime[pass]; });
+	}
+
+	unsigned int GetPassCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return static_cast<unsigned int>(m_passNames.size());
+	}
+
+	std::string GetPassName(const unsigned int & pass) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return pass < m_passNames.size() ? m_passNames[pass] : std::string();
+	}
+
+private:
+	std::atomic<uint64_t> m_counters[FrameStats::COUNTER_COUNT];
+	std::atomic<int64_t> m_passTime[FrameStats::MAX_PASSES];
+	std::atomic<CommandStream*> m_commandStream{ nullptr };
+
+	std::vector<FrameStats> m_history;
+	uint64_t m_frameCount = 0;
+	int64_t m_lastEnd;
+	std::vector<std::string> m_passNames;
+
+	mutable std::mutex m_mutex;
+
+	static int64_t _now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void _record(const CommandStream::CommandType & type, const uint64_t & a, const uint64_t & b = 0, const uint64_t & c = 0)
+	{
+		CommandStream * commandStream = m_commandStream.load(std::memory_order_acquire);
+		if (commandStream)
+			commandStream->Record(type, a, b, c);
+	}
+
+	// Expects the lock to be held
+	uint64_t _historyCount() const
+	{
+		return m_frameCount < m_history.size() ? m_frameCount : m_history.size();
+	}
+
+	template<typename Value>
+	double _percentile(const double & percentile, Value value) const
+	{
+		std::vector<double> values;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			const uint64_t count = _historyCount();
+			values.reserve(static_cast<size_t>(count));
+			for (uint64_t i = m_frameCount - count; i < m_frameCount; i++)
+				values.push_back(value(m_history[static_cast<size_t>(i % m_history.size())]));
+		}
+		if (values.empty())
+			return 0.0;
+
+		const double clamped = percentile < 0.0 ? 0.0 : (percentile > 100.0 ? 100.0 : percentile);
+		size_t rank = static_cast<size_t>(std::ceil(clamped / 100.0 * values.size()));
+		rank = rank ? rank - 1 : 0;
+		if (rank >= values.size())
+			rank = values.size() - 1;
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <vector>
+#include "CommandContext.h"
+
+// The instanced draws of a pass for one frame, what IRender::p_drawInstance records.
+// Only talks to the command context, so the same frame can be recorded on a device or headless.
+namespace InstanceDraw
+{
+	static const uint32_t TEXTURES = 4;	//Albedo, normal, metallic and displacement, in the order the shaders read them
+
+	static const uint32_t INSTANCE_STRIDE = 84;				//sizeof(Instancing::InstanceBuffer), asserted next to it
+	static const uint32_t INSTANCE_BUFFER_SIZE = 1024u * 64u;	//Bytes the instance buffer of a pass starts with
+
+	struct Group
+	{
+		ICommandContext::VertexBufferView Mesh;
+		uint32_t VertexCount;
+		uint32_t InstanceCount;
+		ICommandContext::CpuDescriptor Textures[TEXTURES];
+		uint32_t TextureDescriptors[TEXTURES];	//One per array slice
+	};
+
+	inline uint64_t CountInstances(const std::vector<Group> & groups)
+	{
+		uint64_t instances = 0;
+		for (size_t i = 0; i < groups.size(); i++)
+			instances += groups[i].InstanceCount;
+		return instances;
+	}
+
+	// Bytes an instance buffer needs for the instances, INSTANCE_BUFFER_SIZE doubled until they fit
+	inline uint64_t BufferSize(const uint64_t & instances, const uint32_t & stride)
+	{
+		uint64_t size = INSTANCE_BUFFER_SIZE;
+		while (size < instances * stride)
+			size *= 2;
+		return size;
+	}
+
+	// With a texture heap the textures of every group are copied into it and bound to textureTable, group i reads them from TEXTURES * i on.
+	// writeInstances(group, textureIndex, firstInstance, destination) writes the instances of a group into the upload memory, stride bytes apart.
+	// beginGroup(group) runs before a group is drawn. Returns false when the instances could not be uploaded
+	template<typename WriteInstances, typename BeginGroup>
+	bool Draw(
+		ICommandContext & context,
+		DescriptorHeapCursor * textureHeap,
+		const uint32_t & textureTable,
+		ICommandContext::Resource instanceBuffer,
+		ICommandContext::Resource intermediate,
+		const uint32_t & stride,
+		const std::vector<Group> & groups,
+		const WriteInstances & writeInstances,
+		const BeginGroup & beginGroup)
+	{
+		const uint64_t instances = CountInstances(groups);
+		if (!instances)
+			return true;
+
+		ICommandContext::GpuDescriptor table = 0;
+		for (size_t i = 0; i < groups.size() && textureHeap; i++)
+		{
+			for (uint32_t t = 0; t < TEXTURES; t++)
+			{
+				const ICommandContext::GpuDescriptor handle = textureHeap->Copy(context, groups[i].Textures[t], groups[i].TextureDescriptors[t]);
+				if (i == 0 && t == 0)
+					table = handle;
+			}
+		}
+
+		const uint64_t size = instances * stride;
+		uint8_t * destination = context.BeginUpload(instanceBuffer, intermediate, size);
+		if (!destination)
+			return false;
+		uint64_t offset = 0;
+		for (size_t i = 0; i < groups.size(); i++)
+		{
+			writeInstances(i, textureHeap ? static_cast<uint32_t>(TEXTURES * i) : 0u, static_cast<uint32_t>(offset), destination + offset * stride);
+			offset += groups[i].InstanceCount;
+		}
+		context.EndUpload(instanceBuffer, intermediate, size);
+
+		ICommandContext::VertexBufferView views[2] = { {}, { context.GetGpuAddress(instanceBuffer), static_cast<uint32_t>(size), stride } };
+		if (textureHeap)
+			context.SetGraphicsRootDescriptorTable(textureTable, table);
+
+		uint32_t startInstance = 0;
+		for (size_t i = 0; i < groups.size(); i++)
+		{
+			//Groups culled down to nothing
+			if (!groups[i].InstanceCount)
+				continue;
+			beginGroup(i);
+			views[0] = groups[i].Mesh;
+			context.SetVertexBuffers(0, 2, views);
+			context.DrawInstanced(groups[i].VertexCount, groups[i].InstanceCount, 0, startInstance);
+			startInstance += groups[i].InstanceCount;
+		}
+		return true;
+	}
+}
@@ -3,6 +3,9 @@
 #include "DirectX/Objects/Drawable.h"
 #include "DirectX/Objects/Mesh/StaticMesh.h"
 #include "DirectX12Engine.h"
+#include "DirectX/Shaders/ShaderPermutation.h"
+#include "TransformStore.h"
+#include "InstanceDraw.h"
 
 class Texture;
 class Transform;
@@ -19,10 +22,14 @@ namespace Instancing
 		}
 		DirectX::XMFLOAT4X4 WorldMatrix;
 		DirectX::XMUINT4 TextureIndex;
+		float TessFactor = 1.0f;
 	};
+	static_assert(sizeof(InstanceBuffer) == InstanceDraw::INSTANCE_STRIDE, "InstanceDraw::INSTANCE_STRIDE has to match InstanceBuffer");
 
 	struct InstanceGroup
 	{
+		static const UINT MAX_INSTANCES = 1024;
+
 		const StaticMesh * StaticMesh;
 
 		const Texture * Albedo;
@@ -30,7 +37,13 @@ namespace Instancing
 		const Texture * Metallic;
 		const Texture * Displacement;
 
-		InstanceBuffer Transforms[1024];
+		//Shader variant the group is drawn with
+		ShaderPermutation::Key Permutation;
+
+		//Where the world matrix of each instance is read from, see WriteInstances
+		TransformStore::Handle Handles[MAX_INSTANCES];
+		//Set by the tessellation budget of the geometry pass
+		float TessFactors[MAX_INSTANCES];
 
 		InstanceGroup(Drawable * drawable)
 		{
@@ -39,9 +52,10 @@ namespace Instancing
 			Normal = drawable->GetNormal();
 			Metallic = drawable->GetMetallic();
 			Displacement = drawable->GetDisplacement();
+			Permutation = ShaderPermutation::SelectGeometry(drawable->GetTessellation() != FALSE, drawable->GetNormalMapping() != FALSE);
 			
 			currentIndex = 0;
-			Add(drawable->GetWorldMatrix());
+			Add(drawable->GetTransformHandle());
 		}
 		void MapTextures(const UINT& rootParameterIndex, ID3D12GraphicsCommandList * commandList)const
 		{
@@ -53,9 +67,16 @@ namespace Instancing
 				arr[i]->MapTexture(rootParameterIndex + i, commandList);
 			}
 		}
-		void Add(const DirectX::XMFLOAT4X4 & worldMatrix)
+		void Add(const TransformStore::Handle & transform)
+		{
+			TessFactors[currentIndex] = 1.0f;
+			Handles[currentIndex++] = transform;
+		}
+		// Drops every instance from size on
+		void Truncate(const UINT & size)
 		{
-			Transforms[currentIndex++] = InstanceBuffer(worldMatrix);
+			if (size < currentIndex)
+				currentIndex = size;
 		}
 		const UINT & GetSize() const
 		{
@@ -67,33 +88,36 @@ namespace Instancing
 		}
 	private:
 		UINT currentIndex = 0;
-		UINT maxSize = 1024;
+		UINT maxSize = MAX_INSTANCES;
 		
 	};
 
-	inline bool MatchGroup(InstanceGroup group, Drawable * drawable)
+	inline bool MatchGroup(const InstanceGroup & group, Drawable * drawable)
 	{
 		return drawable->GetMesh() == group.StaticMesh &&
 			drawable->GetTexture() == group.Albedo &&
 			drawable->GetNormal() == group.Normal &&
 			drawable->GetMetallic() == group.Metallic &&
-			drawable->GetDisplacement() == group.Displacement;
+			drawable->GetDisplacement() == group.Displacement &&
+			ShaderPermutation::SelectGeometry(drawable->GetTessellation() != FALSE, drawable->GetNormalMapping() != FALSE) == group.Permutation;
 	}
 
 	inline void AddInstance(std::vector<InstanceGroup> * instanceGroups, Drawable * drawable)
 	{
+		//Only the newest group of a kind can have room, the ones before it are full
 		InstanceGroup * currentInstanceGroup = nullptr;
-		for (unsigned int group = 0; group < instanceGroups->size(); group++)
+		for (size_t group = instanceGroups->size(); group-- > 0;)
 		{
 			if (MatchGroup(instanceGroups->at(group), drawable))
 			{
-				currentInstanceGroup = &instanceGroups->at(group);	
+				currentInstanceGroup = &instanceGroups->at(group);
+				break;
 			}
 		}
 
-		if (currentInstanceGroup)
+		if (currentInstanceGroup && currentInstanceGroup->GetSize() < currentInstanceGroup->GetMaxSize())
 		{			
-			currentInstanceGroup->Add(drawable->GetWorldMatrix());
+			currentInstanceGroup->Add(drawable->GetTransformHandle());
 		}
 		else
 		{
@@ -102,74 +126,24 @@ namespace Instancing
 		}
 	}
 
-	inline void ClearInstanceGroup(std::vector<InstanceGroup>* instanceGroups)
+	// Writes the instances of a group straight into the mapped instance buffer, the world matrices come from the transform store,
+	// which has to be updated for the frame. TextureIndex.x is where the textures of the group start and
+	// TextureIndex.y the index of the instance in the frame, instances past lastSlot share it
+	inline void WriteInstances(const InstanceGroup & group, const UINT & textureIndex, const UINT & firstInstance, const UINT & lastSlot, uint8_t * destination)
 	{
-		instanceGroups->clear();
-	}
-
-	inline UINT64 UpdateInstanceGroup(
-		ID3D12GraphicsCommandList * commandList,
-		D3D12_VERTEX_BUFFER_VIEW & instanceBufferView,
-		ID3D12Resource * dstResource, 
-		ID3D12Resource * intermediate, 
-		std::vector<InstanceGroup> * groups, 
-		UINT structSize = sizeof(InstanceBuffer),
-		const UINT64 & offset = 0)
-	{
-		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(dstResource, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_COPY_DEST));
-		UINT64 dataSize = 0;
-		UINT current = 0;
-		InstanceBuffer arr[4096];
-		for (size_t i = 0; i < groups->size(); i++)
+		InstanceBuffer * instances = reinterpret_cast<InstanceBuffer*>(destination);
+		TransformStore::GetInstance()->CopyWorldMatrices(group.Handles, group.GetSize(), &instances[0].WorldMatrix, sizeof(InstanceBuffer));
+		for (UINT j = 0; j < group.GetSize(); j++)
 		{
-			dataSize += static_cast<UINT64>(structSize * groups->at(i).GetSize());
-			for (size_t j = 0; j < groups->at(i).GetSize(); j++)
-			{
-				arr[current++] = groups->at(i).Transforms[j];
-			}
+			const UINT slot = firstInstance + j;
+			instances[j].TextureIndex = DirectX::XMUINT4(textureIndex, slot < lastSlot ? slot : lastSlot, 0, 0);
+			instances[j].TessFactor = group.TessFactors[j];
 		}
+	}
 
-		D3D12_PLACED_SUBRESOURCE_FOOTPRINT placedSubresourceFootprint;
-		UINT pNumRows;
-		UINT64 pBytesPerRow;
-		UINT64 pTotalSize;
-
-		ID3D12Device * device = nullptr;
-		dstResource->GetDevice(IID_PPV_ARGS(&device));
-
-		D3D12_RESOURCE_DESC dstResourceDesc = dstResource->GetDesc();
-		device->GetCopyableFootprints(
-			&dstResourceDesc,
-			0,
-			1,
-			offset,
-			&placedSubresourceFootprint,
-			&pNumRows,
-			&pBytesPerRow,
-			&pTotalSize);
-
-		device->Release();		
-
-		D3D12_SUBRESOURCE_DATA instanceData = {};
-		instanceData.pData = arr;
-		instanceData.RowPitch = dataSize;
-		instanceData.SlicePitch = dataSize;
-
-		const UINT64 retValue = UpdateSubresources(
-			commandList, 
-			dstResource, 
-			intermediate, 
-			0, 1, pTotalSize,
-			&placedSubresourceFootprint,
-			&pNumRows,
-			&pTotalSize,
-			&instanceData);
-
-		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(dstResource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
-
-		if (retValue)
-			return dataSize;
-		return retValue;
+	inline void ClearInstanceGroup(std::vector<InstanceGroup>* instanceGroups)
+	{
+		instanceGroups->clear();
 	}
 
 }
@@ -0,0 +1,383 @@
+#pragma once
+#include "WorkerPool.h"
+#include <xmmintrin.h>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+
+// Assigns point lights to a froxel grid, TILES_X * TILES_Y screen tiles times DEPTH_SLICES exponential depth slices.
+// Every cluster gets an offset and a count into one compact light index list.
+// Only uses SSE and the standard library so it can be built and measured without a device.
+class LightClusterBuilder
+{
+public:
+	static const unsigned int TILES_X = 16;
+	static const unsigned int TILES_Y = 9;
+	static const unsigned int DEPTH_SLICES = 24;
+	static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * DEPTH_SLICES;
+
+	// Same layout as uint2 in the shader
+	struct Range
+	{
+		unsigned int Offset;
+		unsigned int Count;
+	};
+
+	struct Frustum
+	{
+		const float * ViewMatrix;	//16 floats, the transposed view matrix the camera keeps for the shaders
+		float Fov;
+		float AspectRatio;
+		float NearPlane;
+		float FarPlane;
+	};
+
+	// Structure of arrays, world space
+	struct PointLights
+	{
+		const float * X;
+		const float * Y;
+		const float * Z;
+		const float * Radius;
+		size_t Count;
+	};
+
+private:
+	// Below this many lights waking the workers costs more than it saves
+	static const size_t MIN_LIGHTS_PER_THREAD = 256;
+	static const unsigned int TILES_X_SIMD = (TILES_X + 3) / 4;
+	static const unsigned int TILES_PER_SLICE = TILES_X * TILES_Y;
+
+	struct Slice
+	{
+		float Near, Far;
+		alignas(16) float MinX[TILES_X_SIMD * 4];
+		alignas(16) float MaxX[TILES_X_SIMD * 4];
+		float MinY[TILES_Y];
+		float MaxY[TILES_Y];
+	};
+
+	struct SliceBin
+	{
+		std::vector<unsigned int> Cluster;
+		std::vector<unsigned int> Light;
+		std::vector<unsigned int> Indices;
+		unsigned int Counts[TILES_PER_SLICE];
+	};
+
+public:
+	explicit LightClusterBuilder(const unsigned int & maxIndices = 1u << 20, const unsigned int & threadCount = 0)
+		: m_maxIndices(maxIndices), m_workers(threadCount)
+	{
+		m_threadCount = m_workers.GetThreadCount() < DEPTH_SLICES ? m_workers.GetThreadCount() : DEPTH_SLICES;
+
+		m_ranges.resize(CLUSTER_COUNT);
+		m_bins.resize(DEPTH_SLICES);
+	}
+
+	void Build(const Frustum & frustum, const PointLights & lights)
+	{
+		_initSlices(frustum);
+
+		m_viewX.resize(lights.Count + 4);
+		m_viewY.resize(lights.Count + 4);
+		m_viewZ.resize(lights.Count + 4);
+		m_firstSlice.resize(lights.Count);
+		m_lastSlice.resize(lights.Count);
+
+		const unsigned int threads = lights.Count >= MIN_LIGHTS_PER_THREAD * 2 ? m_threadCount : 1;
+		if (threads > 1)
+		{
+			const size_t lightsPerThread = ((lights.Count + threads - 1) / threads + 3) & ~static_cast<size_t>(3);
+			m_workers.Run(threads, [&](const unsigned int t)
+			{
+				const size_t begin = t * lightsPerThread;
+				const size_t end = begin + lightsPerThread < lights.Count ? begin + lightsPerThread : lights.Count;
+				if (begin < end)
+					_transformLights(frustum, lights, begin, end);
+			});
+
+			_bucketLights(lights.Count);
+
+			m_workers.Run(threads, [&](const unsigned int t)
+			{
+				_assignSlices(lights, t, threads);
+			});
+		}
+		else
+		{
+			_transformLights(frustum, lights, 0, lights.Count);
+			_bucketLights(lights.Count);
+			_assignSlices(lights, 0, 1);
+		}
+
+		_compact();
+	}
+
+	const std::vector<Range> & GetClusterRanges() const
+	{
+		return m_ranges;
+	}
+
+	const std::vector<unsigned int> & GetLightIndices() const
+	{
+		return m_indices;
+	}
+
+	// Multiply log(viewZ) with X and add Y to get the depth slice, the same mapping the builder uses
+	void GetSliceScaleBias(float & scale, float & bias) const
+	{
+		scale = m_sliceScale;
+		bias = m_sliceBias;
+	}
+
+	static unsigned int GetClusterIndex(const unsigned int & x, const unsigned int & y, const unsigned int & slice)
+	{
+		return (slice * TILES_Y + y) * TILES_X + x;
+	}
+
+private:
+	void _initSlices(const Frustum & frustum)
+	{
+		const float tanY = tanf(frustum.Fov * 0.5f);
+		const float tanX = tanY * frustum.AspectRatio;
+		const float depthRatio = logf(frustum.FarPlane / frustum.NearPlane);
+
+		m_sliceScale = static_cast<float>(DEPTH_SLICES) / depthRatio;
+		m_sliceBias = -m_sliceScale * logf(frustum.NearPlane);
+
+		for (unsigned int s = 0; s < DEPTH_SLICES; s++)
+		{
+			Slice & slice = m_slices[s];
+			slice.Near = frustum.NearPlane * powf(frustum.FarPlane / frustum.NearPlane, static_cast<float>(s) / DEPTH_SLICES);
+			slice.Far = frustum.NearPlane * powf(frustum.FarPlane / frustum.NearPlane, static_cast<float>(s + 1) / DEPTH_SLICES);
+
+			//The cluster is a frustum piece, its bounding box spans the corners on both depths
+			for (unsigned int x = 0; x < TILES_X_SIMD * 4; x++)
+			{
+				if (x >= TILES_X)
+				{
+					slice.MinX[x] = 1e30f;
+					slice.MaxX[x] = 1e30f;
+					continue;
+				}
+				const float left = (-1.0f + 2.0f * x / TILES_X) * tanX;
+				const float right = (-1.0f + 2.0f * (x + 1) / TILES_X) * tanX;
+				slice.MinX[x] = left * slice.Near < left * slice.Far ? left * slice.Near : left * slice.Far;
+				slice.MaxX[x] = right * slice.Near > right * slice.Far ? right * slice.Near : right * slice.Far;
+			}
+			//Tile row 0 is the top of the screen
+			for (unsigned int y = 0; y < TILES_Y; y++)
+			{
+				const float top = (1.0f - 2.0f * y / TILES_Y) * tanY;
+				const float bottom = (1.0f - 2.0f * (y + 1) / TILES_Y) * tanY;
+				slice.MinY[y] = bottom * slice.Near < bottom * slice.Far ? bottom * slice.Near : bottom * slice.Far;
+				slice.MaxY[y] = top * slice.Near > top * slice.Far ? top * slice.Near : top * slice.Far;
+			}
+		}
+	}
+
+	// Moves four lights at a time into view space and finds the depth slices they touch
+	void _transformLights(const Frustum & frustum, const PointLights & lights, const size_t & begin, const size_t & end)
+	{
+		const float * m = frustum.ViewMatrix;
+		const __m128 row0[4] = { _mm_set1_ps(m[0]), _mm_set1_ps(m[1]), _mm_set1_ps(m[2]), _mm_set1_ps(m[3]) };
+		const __m128 row1[4] = { _mm_set1_ps(m[4]), _mm_set1_ps(m[5]), _mm_set1_ps(m[6]), _mm_set1_ps(m[7]) };
+		const __m128 row2[4] = { _mm_set1_ps(m[8]), _mm_set1_ps(m[9]), _mm_set1_ps(m[10]), _mm_set1_ps(m[11]) };
+
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(lights.X + i);
+			const __m128 y = _mm_loadu_ps(lights.Y + i);
+			const __m128 z = _mm_loadu_ps(lights.Z + i);
+
+			_mm_storeu_ps(&m_viewX[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(row0[0], x), _mm_mul_ps(row0[1], y)), _mm_add_ps(_mm_mul_ps(row0[2], z), row0[3])));
+			_mm_storeu_ps(&m_viewY[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(row1[0], x), _mm_mul_ps(row1[1], y)), _mm_add_ps(_mm_mul_ps(row1[2], z), row1[3])));
+			_mm_storeu_ps(&m_viewZ[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(row2[0], x), _mm_mul_ps(row2[1], y)), _mm_add_ps(_mm_mul_ps(row2[2], z), row2[3])));
+		}
+		for (; i < end; i++)
+		{
+			m_viewX[i] = m[0] * lights.X[i] + m[1] * lights.Y[i] + m[2] * lights.Z[i] + m[3];
+			m_viewY[i] = m[4] * lights.X[i] + m[5] * lights.Y[i] + m[6] * lights.Z[i] + m[7];
+			m_viewZ[i] = m[8] * lights.X[i] + m[9] * lights.Y[i] + m[10] * lights.Z[i] + m[11];
+		}
+
+		for (i = begin; i < end; i++)
+		{
+			const float nearZ = m_viewZ[i] - lights.Radius[i];
+			const float farZ = m_viewZ[i] + lights.Radius[i];
+			if (farZ < frustum.NearPlane || nearZ > frustum.FarPlane)
+			{
+				m_firstSlice[i] = 1;
+				m_lastSlice[i] = 0;
+				continue;
+			}
+			m_firstSlice[i] = _slice(nearZ);
+			m_lastSlice[i] = _slice(farZ);
+		}
+	}
+
+	unsigned int _slice(const float & viewZ) const
+	{
+		if (viewZ <= m_slices[0].Near)
+			return 0;
+		const float slice = logf(viewZ) * m_sliceScale + m_sliceBias;
+		return slice >= DEPTH_SLICES - 1 ? DEPTH_SLICES - 1 : static_cast<unsigned int>(slice);
+	}
+
+	// Lists the lights touching every depth slice so a slice only visits its own lights
+	void _bucketLights(const size_t & count)
+	{
+		unsigned int sliceCounts[DEPTH_SLICES] = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			for (unsigned int s = m_firstSlice[i]; s <= m_lastSlice[i]; s++)
+				sliceCounts[s]++;
+		}
+
+		unsigned int offset = 0;
+		for (unsigned int s = 0; s < DEPTH_SLICES; s++)
+		{
+			m_sliceOffsets[s] = offset;
+			offset += sliceCounts[s];
+		}
+		m_sliceOffsets[DEPTH_SLICES] = offset;
+		m_sliceLights.resize(offset);
+
+		unsigned int fill[DEPTH_SLICES];
+		memcpy(fill, m_sliceOffsets, sizeof(fill));
+		for (size_t i = 0; i < count; i++)
+		{
+			for (unsigned int s = m_firstSlice[i]; s <= m_lastSlice[i]; s++)
+				m_sliceLights[fill[s]++] = static_cast<unsigned int>(i);
+		}
+	}
+
+	// Every thread owns whole depth slices so no cluster is written by two threads
+	void _assignSlices(const PointLights & lights, const unsigned int & thread, const unsigned int & threadCount)
+	{
+		alignas(16) float distanceX[TILES_X_SIMD * 4];
+
+		for (unsigned int s = thread; s < DEPTH_SLICES; s += threadCount)
+		{
+			const Slice & slice = m_slices[s];
+			SliceBin & bin = m_bins[s];
+			bin.Cluster.clear();
+			bin.Light.clear();
+			memset(bin.Counts, 0, sizeof(bin.Counts));
+
+			for (unsigned int l = m_sliceOffsets[s]; l < m_sliceOffsets[s + 1]; l++)
+			{
+				const unsigned int i = m_sliceLights[l];
+				const float radiusSq = lights.Radius[i] * lights.Radius[i];
+				const float z = m_viewZ[i];
+				const float dz = z < slice.Near ? slice.Near - z : (z > slice.Far ? z - slice.Far : 0.0f);
+				const float distanceZ = dz * dz;
+				if (distanceZ > radiusSq)
+					continue;
+
+				//Separable sphere vs box test, four tiles at a time along x
+				const __m128 x = _mm_set1_ps(m_viewX[i]);
+				const __m128 radiusXY = _mm_set1_ps(radiusSq - distanceZ);
+				const __m128 zero = _mm_setzero_ps();
+				unsigned int tileMask = 0;
+				for (unsigned int t = 0; t < TILES_X_SIMD; t++)
+				{
+					const __m128 d = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(slice.MinX + t * 4), x), _mm_sub_ps(x, _mm_load_ps(slice.MaxX + t * 4))), zero);
+					const __m128 distance = _mm_mul_ps(d, d);
+					_mm_store_ps(distanceX + t * 4, distance);
+					tileMask |= static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(distance, radiusXY))) << (t * 4);
+				}
+				tileMask &= (1u << TILES_X) - 1;
+				if (!tileMask)
+					continue;
+
+				unsigned int tiles[TILES_X];
+				unsigned int tileCount = 0;
+				for (unsigned int tx = 0; tx < TILES_X; tx++)
+				{
+					if (tileMask & (1u << tx))
+						tiles[tileCount++] = tx;
+				}
+
+				const float y = m_viewY[i];
+				for (unsigned int ty = 0; ty < TILES_Y; ty++)
+				{
+					const float dy = y < slice.MinY[ty] ? slice.MinY[ty] - y : (y > slice.MaxY[ty] ? y - slice.MaxY[ty] : 0.0f);
+					const float distanceYZ = dy * dy + distanceZ;
+					if (distanceYZ > radiusSq)
+						continue;
+					for (unsigned int t = 0; t < tileCount; t++)
+					{
+						if (distanceX[tiles[t]] + distanceYZ > radiusSq)
+							continue;
+						const unsigned int cluster = ty * TILES_X + tiles[t];
+						bin.Cluster.push_back(cluster);
+						bin.Light.push_back(i);
+						bin.Counts[cluster]++;
+					}
+				}
+			}
+
+			//Counting sort on the cluster keeps the lights of a cluster in queue order
+			unsigned int offsets[TILES_PER_SLICE];
+			unsigned int offset = 0;
+			for (unsigned int c = 0; c < TILES_PER_SLICE; c++)
+			{
+				offsets[c] = offset;
+				offset += bin.Counts[c];
+			}
+			bin.Indices.resize(bin.Light.size());
+			for (size_t p = 0; p < bin.Light.size(); p++)
+				bin.Indices[offsets[bin.Cluster[p]]++] = bin.Light[p];
+		}
+	}
+
+	void _compact()
+	{
+		size_t total = 0;
+		for (unsigned int s = 0; s < DEPTH_SLICES; s++)
+			total += m_bins[s].Indices.size();
+		m_indices.resize(total < m_maxIndices ? total : m_maxIndices);
+
+		unsigned int offset = 0;
+		for (unsigned int s = 0; s < DEPTH_SLICES; s++)
+		{
+			const SliceBin & bin = m_bins[s];
+			const unsigned int * source = bin.Indices.data();
+			for (unsigned int c = 0; c < TILES_PER_SLICE; c++)
+			{
+				Range & range = m_ranges[s * TILES_PER_SLICE + c];
+				const unsigned int left = m_maxIndices - offset;
+				range.Offset = offset;
+				range.Count = bin.Counts[c] < left ? bin.Counts[c] : left;
+				if (range.Count)
+					memcpy(m_indices.data() + offset, source, range.Count * sizeof(unsigned int));
+				source += bin.Counts[c];
+				offset += range.Count;
+			}
+		}
+	}
+
+	unsigned int m_maxIndices;
+	unsigned int m_threadCount;
+	float m_sliceScale = 0.0f;
+	float m_sliceBias = 0.0f;
+
+	Slice m_slices[DEPTH_SLICES];
+	std::vector<SliceBin> m_bins;
+	WorkerPool m_workers;
+
+	std::vector<float> m_viewX;
+	std::vector<float> m_viewY;
+	std::vector<float> m_viewZ;
+	std::vector<unsigned int> m_firstSlice;
+	std::vector<unsigned int> m_lastSlice;
+	unsigned int m_sliceOffsets[DEPTH_SLICES + 1] = {};
+	std::vector<unsigned int> m_sliceLights;
+
+	std::vector<Range> m_ranges;
+	std::vector<unsigned int> m_indices;
+};
@@ -0,0 +1,378 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <emmintrin.h>
+#include <DirectXMath.h>
+#include "WorkerPool.h"
+
+// Occlusion culling against a small depth buffer drawn on the CPU.
+// Occluder triangles are moved to the screen once, binned into tiles and drawn four pixels at a time, the workers of a
+// pool draw one tile each. Each tile then keeps the farthest depth of every block and of the whole tile, a box is hidden
+// when its nearest depth is behind those everywhere it covers the screen.
+// A pixel is covered when its center is inside a triangle and keeps the farthest depth the triangle has anywhere in the
+// pixel. Boxes are tested one pixel past their bounds, so the part of a pixel beyond the edge of an occluder never hides
+// anything. A gap between two occluders narrower than one pixel is closed though, a box seen only through such a gap can
+// be culled. At 256 x 128 that is a gap under 1/256 of the screen width.
+// Depth goes from 0 at the near plane to 1 at the far plane, like the depth buffer of the geometry pass.
+// Only uses SSE and the standard library so it can be built and measured without a device.
+class OcclusionCuller
+{
+public:
+	static const unsigned int TILE_WIDTH = 64;
+	static const unsigned int TILE_HEIGHT = 32;
+	static const unsigned int BLOCK_SIZE = 8;
+
+private:
+	// Below this many triangles handing tiles to the workers costs more than it saves
+	static const size_t MIN_TRIANGLES_PER_THREAD = 256;
+
+	struct Triangle
+	{
+		float X[3];
+		float Y[3];
+		float Z[3];
+	};
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_tilesX;
+	unsigned int m_tilesY;
+
+	DirectX::XMFLOAT4X4A m_viewProjection;
+	std::vector<Triangle> m_triangles;
+	std::vector<std::vector<uint32_t>> m_bins;	//Triangles touching each tile
+
+	std::vector<float> m_depth;
+	std::vector<float> m_blockMax;
+	std::vector<float> m_tileMax;
+
+	WorkerPool m_workers;
+
+public:
+	// The size is rounded up to whole tiles. threadCount includes the thread calling Rasterize, 0 uses every hardware thread
+	explicit OcclusionCuller(const unsigned int & width = 256, const unsigned int & height = 128, const unsigned int & threadCount = 0)
+		: m_workers(threadCount)
+	{
+		m_tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+		m_tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		m_tilesX = m_tilesX ? m_tilesX : 1;
+		m_tilesY = m_tilesY ? m_tilesY : 1;
+		m_width = m_tilesX * TILE_WIDTH;
+		m_height = m_tilesY * TILE_HEIGHT;
+
+		m_bins.resize(m_tilesX * m_tilesY);
+		m_depth.assign(m_width * m_height, 1.0f);
+		m_blockMax.assign((m_width / BLOCK_SIZE) * (m_height / BLOCK_SIZE), 1.0f);
+		m_tileMax.assign(m_tilesX * m_tilesY, 1.0f);
+		DirectX::XMStoreFloat4x4A(&m_viewProjection, DirectX::XMMatrixIdentity());
+	}
+
+	// Expects the transposed view projection matrix the camera keeps for the shaders. Drops the occluders of the last frame
+	void BeginFrame(const DirectX::XMFLOAT4X4A & viewProjection)
+	{
+		DirectX::XMStoreFloat4x4A(&m_viewProjection, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4A(&viewProjection)));
+		m_triangles.clear();
+		for (size_t i = 0; i < m_bins.size(); i++)
+			m_bins[i].clear();
+	}
+
+	// A triangle list, every three positions are one triangle. Both sides are drawn.
+	// Expects the transposed world matrix Transform keeps for the shaders
+	void AddOccluder(const DirectX::XMFLOAT4 * positions, const size_t & count, const size_t & stride, const DirectX::XMFLOAT4X4 & worldMatrix)
+	{
+		using namespace DirectX;
+
+		const XMMATRIX worldViewProjection = _worldViewProjection(worldMatrix);
+		const char * bytes = reinterpret_cast<const char *>(positions);
+		for (size_t i = 0; i + 2 < count; i += 3)
+		{
+			XMFLOAT4 clip[3];
+			for (unsigned int v = 0; v < 3; v++)
+			{
+				const XMFLOAT4 & position = *reinterpret_cast<const XMFLOAT4 *>(bytes + (i + v) * stride);
+				XMStoreFloat4(&clip[v], XMVector4Transform(XMVectorSet(position.x, position.y, position.z, 1.0f), worldViewProjection));
+			}
+			_clipTriangle(clip);
+		}
+	}
+
+	// Draws the occluders added since BeginFrame and builds the block and tile depths from them
+	void Rasterize()
+	{
+		const unsigned int tileCount = m_tilesX * m_tilesY;
+		if (m_triangles.size() < MIN_TRIANGLES_PER_THREAD * 2)
+		{
+			for (unsigned int tile = 0; tile < tileCount; tile++)
+				_rasterizeTile(tile);
+			return;
+		}
+		m_workers.Run(tileCount, [this](const unsigned int tile) { _rasterizeTile(tile); });
+	}
+
+	// A box in object space and the transposed world matrix of the object.
+	// False when the box is outside the screen or behind the occluders everywhere it covers
+	bool IsVisible(const DirectX::XMFLOAT3 & boxMin, const DirectX::XMFLOAT3 & boxMax, const DirectX::XMFLOAT4X4 & worldMatrix) const
+	{
+		using namespace DirectX;
+
+		const XMMATRIX worldViewProjection = _worldViewProjection(worldMatrix);
+		float minX = 3.402823466e+38f, minY = minX, minZ = minX;
+		float maxX = -minX, maxY = -minX;
+		for (unsigned int i = 0; i < 8; i++)
+		{
+			const XMVECTOR corner = XMVectorSet(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z, 1.0f);
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(corner, worldViewProjection));
+			//A box through the near plane covers the camera
+			if (clip.z < 0.0f || clip.w <= 0.0f)
+				return true;
+
+			const float inverseW = 1.0f / clip.w;
+			const float x = (clip.x * inverseW * 0.5f + 0.5f) * m_width;
+			const float y = (0.5f - clip.y * inverseW * 0.5f) * m_height;
+			const float z = clip.z * inverseW;
+			minX = x < minX ? x : minX;
+			maxX = x > maxX ? x : maxX;
+			minY = y < minY ? y : minY;
+			maxY = y > maxY ? y : maxY;
+			minZ = z < minZ ? z : minZ;
+		}
+		if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height || minZ > 1.0f)
+			return false;
+
+		//One pixel more on every side, a pixel covered at its center can still show the box past the edge of the occluder
+		const unsigned int x0 = minX >= 1.0f ? static_cast<unsigned int>(minX) - 1 : 0;
+		const unsigned int y0 = minY >= 1.0f ? static_cast<unsigned int>(minY) - 1 : 0;
+		const unsigned int x1 = maxX < m_width - 2 ? static_cast<unsigned int>(maxX) + 1 : m_width - 1;
+		const unsigned int y1 = maxY < m_height - 2 ? static_cast<unsigned int>(maxY) + 1 : m_height - 1;
+
+		//Whole tiles first, then the blocks of the tiles that are not hidden all over
+		const unsigned int blocksX = m_width / BLOCK_SIZE;
+		for (unsigned int tileY = y0 / TILE_HEIGHT; tileY <= y1 / TILE_HEIGHT; tileY++)
+		{
+			for (unsigned int tileX = x0 / TILE_WIDTH; tileX <= x1 / TILE_WIDTH; tileX++)
+			{
+				if (m_tileMax[tileY * m_tilesX + tileX] < minZ)
+					continue;
+
+				const unsigned int bx0 = (x0 > tileX * TILE_WIDTH ? x0 : tileX * TILE_WIDTH) / BLOCK_SIZE;
+				const unsigned int by0 = (y0 > tileY * TILE_HEIGHT ? y0 : tileY * TILE_HEIGHT) / BLOCK_SIZE;
+				const unsigned int bx1 = (x1 < (tileX + 1) * TILE_WIDTH - 1 ? x1 : (tileX + 1) * TILE_WIDTH - 1) / BLOCK_SIZE;
+				const unsigned int by1 = (y1 < (tileY + 1) * TILE_HEIGHT - 1 ? y1 : (tileY + 1) * TILE_HEIGHT - 1) / BLOCK_SIZE;
+				for (unsigned int by = by0; by <= by1; by++)
+				{
+					for (unsigned int bx = bx0; bx <= bx1; bx++)
+					{
+						if (m_blockMax[by * blocksX + bx] >= minZ)
+							return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	const unsigned int & GetWidth() const
+	{
+		return m_width;
+	}
+
+	const unsigned int & GetHeight() const
+	{
+		return m_height;
+	}
+
+	// Occluder triangles left after clipping to the near plane and the screen
+	size_t GetTriangleCount() const
+	{
+		return m_triangles.size();
+	}
+
+	const float & GetDepth(const unsigned int & x, const unsigned int & y) const
+	{
+		return m_depth[y * m_width + x];
+	}
+
+private:
+	DirectX::XMMATRIX _worldViewProjection(const DirectX::XMFLOAT4X4 & worldMatrix) const
+	{
+		using namespace DirectX;
+		return XMMatrixMultiply(XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix)), XMLoadFloat4x4A(&m_viewProjection));
+	}
+
+	// Cuts off the part in front of the near plane, which leaves one or two triangles
+	void _clipTriangle(const DirectX::XMFLOAT4 clip[3])
+	{
+		DirectX::XMFLOAT4 polygon[4];
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			const DirectX::XMFLOAT4 & a = clip[i];
+			const DirectX::XMFLOAT4 & b = clip[(i + 1) % 3];
+			if (a.z >= 0.0f)
+				polygon[count++] = a;
+			if ((a.z >= 0.0f) != (b.z >= 0.0f))
+			{
+				const float t = a.z / (a.z - b.z);
+				polygon[count++] = DirectX::XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.0f, a.w + (b.w - a.w) * t);
+			}
+		}
+		for (unsigned int i = 2; i < count; i++)
+			_addTriangle(polygon[0], polygon[i - 1], polygon[i]);
+	}
+
+	void _addTriangle(const DirectX::XMFLOAT4 & a, const DirectX::XMFLOAT4 & b, const DirectX::XMFLOAT4 & c)
+	{
+		const DirectX::XMFLOAT4 * vertices[3] = { &a, &b, &c };
+		Triangle triangle;
+		for (unsigned int v = 0; v < 3; v++)
+		{
+			if (vertices[v]->w <= 0.0f)
+				return;
+			const float inverseW = 1.0f / vertices[v]->w;
+			triangle.X[v] = (vertices[v]->x * inverseW * 0.5f + 0.5f) * m_width;
+			triangle.Y[v] = (0.5f - vertices[v]->y * inverseW * 0.5f) * m_height;
+			triangle.Z[v] = vertices[v]->z * inverseW;
+		}
+
+		const float area = (triangle.X[1] - triangle.X[0]) * (triangle.Y[2] - triangle.Y[0]) - (triangle.X[2] - triangle.X[0]) * (triangle.Y[1] - triangle.Y[0]);
+		if (area == 0.0f)
+			return;
+		//Both sides are drawn, the edges are always walked the same way round
+		if (area < 0.0f)
+		{
+			std::swap(triangle.X[1], triangle.X[2]);
+			std::swap(triangle.Y[1], triangle.Y[2]);
+			std::swap(triangle.Z[1], triangle.Z[2]);
+		}
+
+		const float minX = (std::min)(triangle.X[0], (std::min)(triangle.X[1], triangle.X[2]));
+		const float maxX = (std::max)(triangle.X[0], (std::max)(triangle.X[1], triangle.X[2]));
+		const float minY = (std::min)(triangle.Y[0], (std::min)(triangle.Y[1], triangle.Y[2]));
+		const float maxY = (std::max)(triangle.Y[0], (std::max)(triangle.Y[1], triangle.Y[2]));
+		const float minZ = (std::min)(triangle.Z[0], (std::min)(triangle.Z[1], triangle.Z[2]));
+		if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height || minZ > 1.0f)
+			return;
+
+		const uint32_t index = static_cast<uint32_t>(m_triangles.size());
+		m_triangles.push_back(triangle);
+		const unsigned int tileX0 = minX > 0.0f ? static_cast<unsigned int>(minX) / TILE_WIDTH : 0;
+		const unsigned int tileY0 = minY > 0.0f ? static_cast<unsigned int>(minY) / TILE_HEIGHT : 0;
+		const unsigned int tileX1 = maxX < m_width - 1 ? static_cast<unsigned int>(maxX) / TILE_WIDTH : m_tilesX - 1;
+		const unsigned int tileY1 = maxY < m_height - 1 ? static_cast<unsigned int>(maxY) / TILE_HEIGHT : m_tilesY - 1;
+		for (unsigned int y = tileY0; y <= tileY1; y++)
+		{
+			for (unsigned int x = tileX0; x <= tileX1; x++)
+				m_bins[y * m_tilesX + x].push_back(index);
+		}
+	}
+
+	void _rasterizeTile(const unsigned int & tile)
+	{
+		const unsigned int tileX = (tile % m_tilesX) * TILE_WIDTH;
+		const unsigned int tileY = (tile / m_tilesX) * TILE_HEIGHT;
+		for (unsigned int y = tileY; y < tileY + TILE_HEIGHT; y++)
+			std::fill(m_depth.begin() + y * m_width + tileX, m_depth.begin() + y * m_width + tileX + TILE_WIDTH, 1.0f);
+
+		const std::vector<uint32_t> & bin = m_bins[tile];
+		for (size_t i = 0; i < bin.size(); i++)
+			_rasterizeTriangle(m_triangles[bin[i]], tileX, tileY);
+		_buildTileDepth(tile, tileX, tileY);
+	}
+
+	// Fills the pixels of the tile whose centers are inside the triangle, keeping the nearest depth
+	void _rasterizeTriangle(const Triangle & triangle, const unsigned int & tileX, const unsigned int & tileY)
+	{
+		const float * x = triangle.X;
+		const float * y = triangle.Y;
+		const float * z = triangle.Z;
+
+		//Edge functions are positive inside, ax + by + c for the edge from vertex i to the next
+		float a[3], b[3], c[3];
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			const unsigned int j = (i + 1) % 3;
+			a[i] = y[i] - y[j];
+			b[i] = x[j] - x[i];
+			c[i] = (y[j] - y[i]) * x[i] - (x[j] - x[i]) * y[i];
+		}
+
+		//Depth as a plane over the screen, raised to the farthest it gets within half a pixel of the center
+		const float inverseArea = 1.0f / ((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+		const float depthX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * inverseArea;
+		const float depthY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * inverseArea;
+		const float depthC = z[0] - depthX * x[0] - depthY * y[0] + 0.5f * (std::fabs(depthX) + std::fabs(depthY));
+
+		//Pixel centers inside the tile and the bounds of the triangle, four pixels at a time
+		const float minX = (std::min)(x[0], (std::min)(x[1], x[2]));
+		const float maxX = (std::max)(x[0], (std::max)(x[1], x[2]));
+		const float minY = (std::min)(y[0], (std::min)(y[1], y[2]));
+		const float maxY = (std::max)(y[0], (std::max)(y[1], y[2]));
+		const int startX = (std::max)(static_cast<int>(tileX), static_cast<int>(std::floor(minX - 0.5f)) & ~3);
+		const int endX = (std::min)(static_cast<int>(tileX + TILE_WIDTH), static_cast<int>(std::ceil(maxX - 0.5f)) + 1);
+		const int startY = (std::max)(static_cast<int>(tileY), static_cast<int>(std::ceil(minY - 0.5f)));
+		const int endY = (std::min)(static_cast<int>(tileY + TILE_HEIGHT), static_cast<int>(std::floor(maxY - 0.5f)) + 1);
+		if (startX >= endX || startY >= endY)
+			return;
+
+		const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 edgeA[3] = { _mm_set1_ps(a[0]), _mm_set1_ps(a[1]), _mm_set1_ps(a[2]) };
+		const __m128 depthA = _mm_set1_ps(depthX);
+		for (int py = startY; py < endY; py++)
+		{
+			const float centerY = py + 0.5f;
+			const __m128 edgeRow[3] =
+			{
+				_mm_set1_ps(b[0] * centerY + c[0]),
+				_mm_set1_ps(b[1] * centerY + c[1]),
+				_mm_set1_ps(b[2] * centerY + c[2])
+			};
+			const __m128 depthRow = _mm_set1_ps(depthY * centerY + depthC);
+
+			float * row = &m_depth[py * m_width];
+			for (int px = startX; px < endX; px += 4)
+			{
+				const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(px)), offsets);
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]);
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]);
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]);
+				const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+				if (!_mm_movemask_ps(inside))
+					continue;
+
+				const __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow);
+				const __m128 current = _mm_loadu_ps(row + px);
+				const __m128 nearest = _mm_min_ps(current, depth);
+				_mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+		}
+	}
+
+	// The farthest depth of every block in the tile and of the tile itself
+	void _buildTileDepth(const unsigned int & tile, const unsigned int & tileX, const unsigned int & tileY)
+	{
+		const unsigned int blocksX = m_width / BLOCK_SIZE;
+		__m128 tileMax = _mm_setzero_ps();
+		for (unsigned int blockY = tileY; blockY < tileY + TILE_HEIGHT; blockY += BLOCK_SIZE)
+		{
+			for (unsigned int blockX = tileX; blockX < tileX + TILE_WIDTH; blockX += BLOCK_SIZE)
+			{
+				__m128 blockMax = _mm_setzero_ps();
+				for (unsigned int y = blockY; y < blockY + BLOCK_SIZE; y++)
+				{
+					const float * row = &m_depth[y * m_width + blockX];
+					for (unsigned int x = 0; x < BLOCK_SIZE; x += 4)
+						blockMax = _mm_max_ps(blockMax, _mm_loadu_ps(row + x));
+				}
+				blockMax = _mm_max_ps(blockMax, _mm_shuffle_ps(blockMax, blockMax, _MM_SHUFFLE(1, 0, 3, 2)));
+				blockMax = _mm_max_ps(blockMax, _mm_shuffle_ps(blockMax, blockMax, _MM_SHUFFLE(2, 3, 0, 1)));
+				_mm_store_ss(&m_blockMax[(blockY / BLOCK_SIZE) * blocksX + blockX / BLOCK_SIZE], blockMax);
+				tileMax = _mm_max_ps(tileMax, blockMax);
+			}
+		}
+		_mm_store_ss(&m_tileMax[tile], tileMax);
+	}
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <DirectXMath.h>
+#include "DirectX/Structs.h"
+
+// CPU reference of the quad expansion done in DefaultGeometryParticleVertex.hlsl and of the texture picked in DefaultParticleCompute.hlsl.
+// Only depends on DirectXMath so the output can be compared without a device.
+namespace ParticleBillboard
+{
+	static const unsigned int VERTICES_PER_PARTICLE = 6;
+	static const unsigned int AGE_TEXTURES = 3;	//A particle moves to the next texture every third of its life
+
+	// The texture index the compute shader packs into ParticleInstance
+	inline unsigned int GetTextureIndex(const float & timeAlive, const float & timeToLive)
+	{
+		const float third = timeToLive / 3.0f;
+		unsigned int textureIndex = 0;
+		if (timeAlive > third)
+			textureIndex = 1;
+		if (timeAlive > third * 2)
+			textureIndex = 2;
+		return textureIndex;
+	}
+
+	// lowerLeft, upperLeft, upperRight, lowerRight, lowerLeft, upperRight
+	inline DirectX::XMFLOAT2 GetCorner(const unsigned int & vertexId)
+	{
+		static const DirectX::XMFLOAT2 corners[VERTICES_PER_PARTICLE] =
+		{
+			DirectX::XMFLOAT2(-1, -1), DirectX::XMFLOAT2(-1, 1), DirectX::XMFLOAT2(1, 1),
+			DirectX::XMFLOAT2(1, -1), DirectX::XMFLOAT2(-1, -1), DirectX::XMFLOAT2(1, 1)
+		};
+		return corners[vertexId % VERTICES_PER_PARTICLE];
+	}
+
+	inline ParticleVertex ExpandVertex(const ParticleInstance & instance, const DirectX::XMFLOAT4 & cameraPosition, const unsigned int & vertexId)
+	{
+		using namespace DirectX;
+
+		const XMFLOAT2 corner = GetCorner(vertexId);
+		const XMVECTOR position = XMLoadFloat3(&instance.Position);
+
+		const XMVECTOR dir = XMVector3Normalize(XMVectorSubtract(position, XMLoadFloat4(&cameraPosition)));
+		const XMVECTOR right = XMVector3Normalize(XMVector3Cross(dir, XMVectorSet(0, 1, 0, 0)));
+		const XMVECTOR up = XMVector3Normalize(XMVector3Cross(dir, right));
+
+		XMVECTOR worldPos = XMVectorAdd(position, XMVectorScale(right, corner.x * instance.Size.x));
+		worldPos = XMVectorAdd(worldPos, XMVectorScale(up, corner.y * instance.Size.y));
+
+		ParticleVertex vertex;
+		XMStoreFloat4(&vertex.Position, XMVectorSetW(worldPos, 1.0f));
+		vertex.TexCord = XMFLOAT4(
+			corner.x * 0.5f + 0.5f,
+			0.5f - corner.y * 0.5f,
+			static_cast<float>(instance.TextureIndex),
+			0);
+		return vertex;
+	}
+
+	inline void Expand(const ParticleInstance & instance, const DirectX::XMFLOAT4 & cameraPosition, ParticleVertex * vertices)
+	{
+		for (unsigned int i = 0; i < VERTICES_PER_PARTICLE; i++)
+		{
+			vertices[i] = ExpandVertex(instance, cameraPosition, i);
+		}
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cmath>
+#include <cstddef>
+
+// Per emitter level of detail and the particle budget split.
+// Only depends on DirectXMath so the decisions can be checked without a device.
+namespace ParticleLod
+{
+	struct Settings
+	{
+		float FullDetailSize = 0.25f;	//Projected radius, in screen heights, where an emitter runs at full rate
+		float MinScale = 0.1f;
+		float SleepSize = 0.005f;		//Emitters projected smaller than this stop simulating
+		float WakeSize = 0.0075f;		//Sleeping emitters start again once projected larger than this, so they do not toggle at one distance
+	};
+
+	struct Result
+	{
+		bool Visible;
+		bool Sleeping;
+		float Scale;
+	};
+
+	// Left, right, bottom, top, near, far. Normals point inwards
+	struct Frustum
+	{
+		DirectX::XMFLOAT4 Planes[6];
+	};
+
+	// Expects the transposed view projection matrix the camera keeps for the shaders,
+	// the rows of it are the columns Gribb/Hartmann extract the planes from
+	inline Frustum CreateFrustum(const DirectX::XMFLOAT4X4A & viewProjection)
+	{
+		using namespace DirectX;
+
+		const XMMATRIX matrix = XMLoadFloat4x4A(&viewProjection);
+		const XMVECTOR planes[6] =
+		{
+			XMVectorAdd(matrix.r[3], matrix.r[0]),
+			XMVectorSubtract(matrix.r[3], matrix.r[0]),
+			XMVectorAdd(matrix.r[3], matrix.r[1]),
+			XMVectorSubtract(matrix.r[3], matrix.r[1]),
+			matrix.r[2],
+			XMVectorSubtract(matrix.r[3], matrix.r[2])
+		};
+
+		Frustum frustum;
+		for (unsigned int i = 0; i < 6; i++)
+			XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+		return frustum;
+	}
+
+	inline bool Intersects(const Frustum & frustum, const DirectX::XMFLOAT4 & center, const float & radius)
+	{
+		using namespace DirectX;
+
+		const XMVECTOR point = XMVectorSetW(XMLoadFloat4(&center), 1.0f);
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			if (XMVectorGetX(XMPlaneDot(XMLoadFloat4(&frustum.Planes[i]), point)) < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	// Radius of a sphere on screen as a fraction of the screen height
+	inline float ProjectedSize(const float & distance, const float & radius, const float & fov)
+	{
+		if (distance <= radius)
+			return 1.0f;
+		return radius / (distance * tanf(fov * 0.5f));
+	}
+
+	// sleeping is what the emitter got last frame, it stays asleep until it is projected larger than WakeSize.
+	// Emitters outside the frustum get a scale of 0 and keep whether they sleep
+	inline Result Evaluate(
+		const Frustum & frustum,
+		const DirectX::XMFLOAT4 & cameraPosition,
+		const float & fov,
+		const DirectX::XMFLOAT4 & center,
+		const float & radius,
+		const Settings & settings,
+		const bool & sleeping = false)
+	{
+		using namespace DirectX;
+
+		Result result{ Intersects(frustum, center, radius), sleeping, 0.0f };
+		if (!result.Visible)
+			return result;
+
+		const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat4(&center), XMLoadFloat4(&cameraPosition))));
+		const float size = ProjectedSize(distance, radius, fov);
+
+		result.Sleeping = size < (sleeping ? settings.WakeSize : settings.SleepSize);
+		result.Scale = settings.FullDetailSize > 0.0f ? size / settings.FullDetailSize : 1.0f;
+		if (result.Scale > 1.0f)
+			result.Scale = 1.0f;
+		if (result.Scale < settings.MinScale)
+			result.Scale = settings.MinScale;
+		return result;
+	}
+
+	// Scales every request down by the same factor when the total is over budget.
+	// Returns the total granted, never more than the budget
+	inline unsigned int ApplyBudget(const unsigned int * requested, unsigned int * granted, const size_t & count, const unsigned int & budget)
+	{
+		unsigned long long total = 0;
+		for (size_t i = 0; i < count; i++)
+			total += requested[i];
+
+		if (total <= budget)
+		{
+			for (size_t i = 0; i < count; i++)
+				granted[i] = requested[i];
+			return static_cast<unsigned int>(total);
+		}
+
+		unsigned int grantedTotal = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			granted[i] = static_cast<unsigned int>(requested[i] * static_cast<unsigned long long>(budget) / total);
+			grantedTotal += granted[i];
+		}
+		return grantedTotal;
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Packs the particles of every emitter into one contiguous buffer.
+// Kept free of any D3D12 types so the packing can be exercised without a device.
+class ParticleRangeAllocator
+{
+public:
+	struct Range
+	{
+		unsigned int Offset;
+		unsigned int Count;
+	};
+
+	// Same layout as D3D12_DRAW_ARGUMENTS
+	struct DrawArguments
+	{
+		unsigned int VertexCountPerInstance;
+		unsigned int InstanceCount;
+		unsigned int StartVertexLocation;
+		unsigned int StartInstanceLocation;
+	};
+
+	// One command of the particle command signature, the root constant picking the texture and then the draw
+	struct DrawCommand
+	{
+		unsigned int TextureIndex;
+		DrawArguments Arguments;
+	};
+
+public:
+	explicit ParticleRangeAllocator(const unsigned int & capacity = 0, const unsigned int & verticesPerInstance = 6)
+		: m_capacity(capacity), m_verticesPerInstance(verticesPerInstance)
+	{
+	}
+
+	void SetCapacity(const unsigned int & capacity)
+	{
+		m_capacity = capacity;
+		Reset();
+	}
+
+	void Reset()
+	{
+		m_allocated = 0;
+		m_ranges.clear();
+	}
+
+	// Returns the range the caller may write to. Count is clamped to what is left of the capacity,
+	// a full allocator hands out empty ranges so the index of every range still matches the caller's index.
+	Range Allocate(const unsigned int & count)
+	{
+		const unsigned int left = m_capacity - m_allocated;
+		const Range range{ m_allocated, count < left ? count : left };
+		m_allocated += range.Count;
+		m_ranges.push_back(range);
+		return range;
+	}
+
+	unsigned int GetDispatchGroups(const unsigned int & groupSize) const
+	{
+		return (m_allocated + groupSize - 1) / groupSize;
+	}
+
+	// One instance per particle, the quad is expanded from SV_VertexID
+	DrawArguments GetDrawArguments(const size_t & index) const
+	{
+		const Range & range = m_ranges[index];
+		return DrawArguments{ m_verticesPerInstance, range.Count, 0, range.Offset };
+	}
+
+	const Range & GetRange(const size_t & index) const
+	{
+		return m_ranges[index];
+	}
+
+	size_t GetRangeCount() const
+	{
+		return m_ranges.size();
+	}
+
+	unsigned int GetAllocated() const
+	{
+		return m_allocated;
+	}
+
+	unsigned int GetCapacity() const
+	{
+		return m_capacity;
+	}
+
+private:
+	unsigned int m_capacity;
+	unsigned int m_verticesPerInstance;
+	unsigned int m_allocated = 0;
+	std::vector<Range> m_ranges;
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <cstddef>
+
+// LSD radix sort over 32 bit keys producing an index permutation.
+// Keys and indices are kept in separate arrays and the scratch memory is reused between calls.
+// Free of any D3D12 types so it can be measured and verified without a device.
+class ParticleSort
+{
+private:
+	static const unsigned int RADIX_BITS = 8;
+	static const unsigned int RADIX_SIZE = 1u << RADIX_BITS;
+	static const unsigned int RADIX_MASK = RADIX_SIZE - 1;
+	static const unsigned int PASSES = 32 / RADIX_BITS;
+
+public:
+	// Maps a float to an unsigned key with the same ordering, negative values included
+	static unsigned int FloatToKey(const float & value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const unsigned int mask = (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+		return bits ^ mask;
+	}
+
+	// Largest key first, used for back to front ordering on camera distance
+	const std::vector<unsigned int> & SortDescending(const float * keys, const size_t & count)
+	{
+		_resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			m_keys[0][i] = ~FloatToKey(keys[i]);
+			m_indices[0][i] = static_cast<unsigned int>(i);
+		}
+		return _sort(count);
+	}
+
+	const std::vector<unsigned int> & SortAscending(const float * keys, const size_t & count)
+	{
+		_resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			m_keys[0][i] = FloatToKey(keys[i]);
+			m_indices[0][i] = static_cast<unsigned int>(i);
+		}
+		return _sort(count);
+	}
+
+	const std::vector<unsigned int> & Sort(const unsigned int * keys, const size_t & count)
+	{
+		_resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			m_keys[0][i] = keys[i];
+			m_indices[0][i] = static_cast<unsigned int>(i);
+		}
+		return _sort(count);
+	}
+
+private:
+	void _resize(const size_t & count)
+	{
+		if (m_keys[0].size() < count)
+		{
+			for (unsigned int i = 0; i < 2; i++)
+			{
+				m_keys[i].resize(count);
+				m_indices[i].resize(count);
+			}
+		}
+		m_result.resize(count);
+	}
+
+	const std::vector<unsigned int> & _sort(const size_t & count)
+	{
+		size_t histogram[PASSES][RADIX_SIZE];
+		memset(histogram, 0, sizeof(histogram));
+
+		const unsigned int * keys = m_keys[0].data();
+		for (size_t i = 0; i < count; i++)
+		{
+			for (unsigned int pass = 0; pass < PASSES; pass++)
+				histogram[pass][(keys[i] >> (pass * RADIX_BITS)) & RADIX_MASK]++;
+		}
+
+		unsigned int source = 0;
+		for (unsigned int pass = 0; pass < PASSES; pass++)
+		{
+			const unsigned int shift = pass * RADIX_BITS;
+
+			//Every key shares this digit, the pass would not move anything
+			if (count && histogram[pass][(keys[0] >> shift) & RADIX_MASK] == count)
+				continue;
+
+			size_t offset = 0;
+			for (unsigned int digit = 0; digit < RADIX_SIZE; digit++)
+			{
+				const size_t digitCount = histogram[pass][digit];
+				histogram[pass][digit] = offset;
+				offset += digitCount;
+			}
+
+			const unsigned int * srcKeys = m_keys[source].data();
+			const unsigned int * srcIndices = m_indices[source].data();
+			unsigned int * dstKeys = m_keys[source ^ 1].data();
+			unsigned int * dstIndices = m_indices[source ^ 1].data();
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const size_t destination = histogram[pass][(srcKeys[i] >> shift) & RADIX_MASK]++;
+				dstKeys[destination] = srcKeys[i];
+				dstIndices[destination] = srcIndices[i];
+			}
+			source ^= 1;
+			keys = m_keys[source].data();
+		}
+
+		if (count)
+			memcpy(m_result.data(), m_indices[source].data(), count * sizeof(unsigned int));
+		return m_result;
+	}
+
+	std::vector<unsigned int> m_keys[2];
+	std::vector<unsigned int> m_indices[2];
+	std::vector<unsigned int> m_result;
+};
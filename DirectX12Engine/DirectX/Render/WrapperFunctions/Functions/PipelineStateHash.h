@@ -0,0 +1,236 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include "../../../Shaders/ShaderCache.h"
+
+// Canonical serialization of pipeline descriptions, two descriptions that build the same pipeline serialize to the same bytes.
+// Pointers are followed instead of written, padding is never written and fields the pipeline ignores are left out,
+// like the blend factors of a target that does not blend or RTVFormats past NumRenderTargets.
+// The root signature is passed as a key because the object itself can not be read back.
+// The descriptions are template parameters so the header does not need d3d12.h, anything with the same fields serializes.
+namespace PipelineStateHash
+{
+	static const uint32_t FORMAT_VERSION = 1;
+	static const uint32_t MAX_RENDER_TARGETS = 8;	//D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT
+	static const uint32_t PER_INSTANCE_DATA = 1;	//D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA
+
+	class Writer
+	{
+	public:
+		void Put(const uint32_t & value)
+		{
+			const unsigned char bytes[4] = {
+				static_cast<unsigned char>(value),
+				static_cast<unsigned char>(value >> 8),
+				static_cast<unsigned char>(value >> 16),
+				static_cast<unsigned char>(value >> 24) };
+			Bytes.insert(Bytes.end(), bytes, bytes + 4);
+		}
+
+		void Put(const uint64_t & value)
+		{
+			Put(static_cast<uint32_t>(value));
+			Put(static_cast<uint32_t>(value >> 32));
+		}
+
+		void PutBool(const int & value)
+		{
+			Put(static_cast<uint32_t>(value ? 1 : 0));
+		}
+
+		void PutFloat(float value)
+		{
+			//-0 and 0 are the same pipeline
+			if (value == 0.0f)
+				value = 0.0f;
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			Put(bits);
+		}
+
+		// Semantics are case insensitive
+		void PutSemantic(const char * name)
+		{
+			const size_t length = name ? strlen(name) : 0;
+			Put(static_cast<uint32_t>(length));
+			for (size_t i = 0; i < length; i++)
+			{
+				const char c = name[i];
+				Bytes.push_back(static_cast<unsigned char>(c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c));
+			}
+		}
+
+		// Size and content hash, the same bytecode loaded twice is the same shader
+		template<typename ShaderBytecode>
+		void PutShader(const ShaderBytecode & shader)
+		{
+			if (!shader.pShaderBytecode || !shader.BytecodeLength)
+			{
+				Put(static_cast<uint64_t>(0));
+				return;
+			}
+			Put(static_cast<uint64_t>(shader.BytecodeLength));
+			Put(ShaderCache::Hash(shader.pShaderBytecode, shader.BytecodeLength));
+		}
+
+		std::vector<unsigned char> Bytes;
+	};
+
+	template<typename DepthStencilOpDesc>
+	void WriteStencilOp(Writer & writer, const DepthStencilOpDesc & desc)
+	{
+		writer.Put(static_cast<uint32_t>(desc.StencilFailOp));
+		writer.Put(static_cast<uint32_t>(desc.StencilDepthFailOp));
+		writer.Put(static_cast<uint32_t>(desc.StencilPassOp));
+		writer.Put(static_cast<uint32_t>(desc.StencilFunc));
+	}
+
+	template<typename RenderTargetBlendDesc>
+	void WriteRenderTargetBlend(Writer & writer, const RenderTargetBlendDesc & desc)
+	{
+		writer.PutBool(desc.BlendEnable);
+		if (desc.BlendEnable)
+		{
+			writer.Put(static_cast<uint32_t>(desc.SrcBlend));
+			writer.Put(static_cast<uint32_t>(desc.DestBlend));
+			writer.Put(static_cast<uint32_t>(desc.BlendOp));
+			writer.Put(static_cast<uint32_t>(desc.SrcBlendAlpha));
+			writer.Put(static_cast<uint32_t>(desc.DestBlendAlpha));
+			writer.Put(static_cast<uint32_t>(desc.BlendOpAlpha));
+		}
+		writer.PutBool(desc.LogicOpEnable);
+		if (desc.LogicOpEnable)
+			writer.Put(static_cast<uint32_t>(desc.LogicOp));
+		writer.Put(static_cast<uint32_t>(desc.RenderTargetWriteMask));
+	}
+
+	// D3D12_GRAPHICS_PIPELINE_STATE_DESC
+	template<typename GraphicsPipelineStateDesc>
+	std::vector<unsigned char> SerializeGraphics(const GraphicsPipelineStateDesc & desc, const uint64_t & rootSignatureKey)
+	{
+		Writer writer;
+		writer.Put(static_cast<uint32_t>('G'));
+		writer.Put(FORMAT_VERSION);
+		writer.Put(rootSignatureKey);
+
+		writer.PutShader(desc.VS);
+		writer.PutShader(desc.PS);
+		writer.PutShader(desc.DS);
+		writer.PutShader(desc.HS);
+		writer.PutShader(desc.GS);
+
+		const auto & streamOutput = desc.StreamOutput;
+		const uint32_t entries = streamOutput.pSODeclaration ? streamOutput.NumEntries : 0;
+		writer.Put(entries);
+		for (uint32_t i = 0; i < entries; i++)
+		{
+			const auto & entry = streamOutput.pSODeclaration[i];
+			writer.Put(static_cast<uint32_t>(entry.Stream));
+			writer.PutSemantic(entry.SemanticName);
+			writer.Put(static_cast<uint32_t>(entry.SemanticIndex));
+			writer.Put(static_cast<uint32_t>(entry.StartComponent));
+			writer.Put(static_cast<uint32_t>(entry.ComponentCount));
+			writer.Put(static_cast<uint32_t>(entry.OutputSlot));
+		}
+		const uint32_t strides = streamOutput.pBufferStrides ? streamOutput.NumStrides : 0;
+		writer.Put(strides);
+		for (uint32_t i = 0; i < strides; i++)
+			writer.Put(static_cast<uint32_t>(streamOutput.pBufferStrides[i]));
+		if (entries)
+			writer.Put(static_cast<uint32_t>(streamOutput.RasterizedStream));
+
+		const uint32_t renderTargets = desc.NumRenderTargets < MAX_RENDER_TARGETS ? static_cast<uint32_t>(desc.NumRenderTargets) : MAX_RENDER_TARGETS;
+		writer.PutBool(desc.BlendState.AlphaToCoverageEnable);
+		writer.PutBool(desc.BlendState.IndependentBlendEnable);
+		//Without independent blending every target uses the first description
+		const uint32_t blendTargets = desc.BlendState.IndependentBlendEnable ? renderTargets : 1;
+		for (uint32_t i = 0; i < blendTargets; i++)
+			WriteRenderTargetBlend(writer, desc.BlendState.RenderTarget[i]);
+		writer.Put(static_cast<uint32_t>(desc.SampleMask));
+
+		const auto & rasterizer = desc.RasterizerState;
+		writer.Put(static_cast<uint32_t>(rasterizer.FillMode));
+		writer.Put(static_cast<uint32_t>(rasterizer.CullMode));
+		writer.PutBool(rasterizer.FrontCounterClockwise);
+		writer.Put(static_cast<uint32_t>(rasterizer.DepthBias));
+		writer.PutFloat(rasterizer.DepthBiasClamp);
+		writer.PutFloat(rasterizer.SlopeScaledDepthBias);
+		writer.PutBool(rasterizer.DepthClipEnable);
+		writer.PutBool(rasterizer.MultisampleEnable);
+		writer.PutBool(rasterizer.AntialiasedLineEnable);
+		writer.Put(static_cast<uint32_t>(rasterizer.ForcedSampleCount));
+		writer.Put(static_cast<uint32_t>(rasterizer.ConservativeRaster));
+
+		const auto & depthStencil = desc.DepthStencilState;
+		writer.PutBool(depthStencil.DepthEnable);
+		if (depthStencil.DepthEnable)
+		{
+			writer.Put(static_cast<uint32_t>(depthStencil.DepthWriteMask));
+			writer.Put(static_cast<uint32_t>(depthStencil.DepthFunc));
+		}
+		writer.PutBool(depthStencil.StencilEnable);
+		if (depthStencil.StencilEnable)
+		{
+			writer.Put(static_cast<uint32_t>(depthStencil.StencilReadMask));
+			writer.Put(static_cast<uint32_t>(depthStencil.StencilWriteMask));
+			WriteStencilOp(writer, depthStencil.FrontFace);
+			WriteStencilOp(writer, depthStencil.BackFace);
+		}
+
+		const uint32_t elements = desc.InputLayout.pInputElementDescs ? desc.InputLayout.NumElements : 0;
+		writer.Put(elements);
+		for (uint32_t i = 0; i < elements; i++)
+		{
+			const auto & element = desc.InputLayout.pInputElementDescs[i];
+			writer.PutSemantic(element.SemanticName);
+			writer.Put(static_cast<uint32_t>(element.SemanticIndex));
+			writer.Put(static_cast<uint32_t>(element.Format));
+			writer.Put(static_cast<uint32_t>(element.InputSlot));
+			writer.Put(static_cast<uint32_t>(element.AlignedByteOffset));
+			writer.Put(static_cast<uint32_t>(element.InputSlotClass));
+			//The step rate has to be 0 for vertex data, whatever was left in it does not matter
+			writer.Put(static_cast<uint32_t>(static_cast<uint32_t>(element.InputSlotClass) == PER_INSTANCE_DATA ? element.InstanceDataStepRate : 0));
+		}
+
+		writer.Put(static_cast<uint32_t>(desc.IBStripCutValue));
+		writer.Put(static_cast<uint32_t>(desc.PrimitiveTopologyType));
+		writer.Put(renderTargets);
+		for (uint32_t i = 0; i < renderTargets; i++)
+			writer.Put(static_cast<uint32_t>(desc.RTVFormats[i]));
+		writer.Put(static_cast<uint32_t>(desc.DSVFormat));
+		writer.Put(static_cast<uint32_t>(desc.SampleDesc.Count));
+		writer.Put(static_cast<uint32_t>(desc.SampleDesc.Quality));
+		writer.Put(static_cast<uint32_t>(desc.NodeMask));
+		writer.Put(static_cast<uint32_t>(desc.Flags));
+		//CachedPSO only speeds the creation up, it is left out
+		return writer.Bytes;
+	}
+
+	// D3D12_COMPUTE_PIPELINE_STATE_DESC
+	template<typename ComputePipelineStateDesc>
+	std::vector<unsigned char> SerializeCompute(const ComputePipelineStateDesc & desc, const uint64_t & rootSignatureKey)
+	{
+		Writer writer;
+		writer.Put(static_cast<uint32_t>('C'));
+		writer.Put(FORMAT_VERSION);
+		writer.Put(rootSignatureKey);
+		writer.PutShader(desc.CS);
+		writer.Put(static_cast<uint32_t>(desc.NodeMask));
+		writer.Put(static_cast<uint32_t>(desc.Flags));
+		return writer.Bytes;
+	}
+
+	inline uint64_t Hash(const std::vector<unsigned char> & serialized)
+	{
+		return ShaderCache::Hash(serialized.data(), serialized.size());
+	}
+
+	// Root signatures are keyed by their serialized blob
+	inline uint64_t HashRootSignature(const void * blob, const size_t & size)
+	{
+		const uint64_t key = ShaderCache::Hash(blob, size);
+		return key ? key : 1;
+	}
+}
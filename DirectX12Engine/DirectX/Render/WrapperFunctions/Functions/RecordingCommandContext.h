@@ -0,0 +1,145 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "CommandContext.h"
+#include "CommandStream.h"
+
+// Command context without a device. Every call goes into the command stream the way the D3D12 context counts it,
+// uploads land in memory per resource and the bound state is kept so a test can look at what the frame drew.
+class RecordingCommandContext :
+	public ICommandContext
+{
+public:
+	struct Draw
+	{
+		uint32_t VertexCount;
+		uint32_t InstanceCount;
+		uint32_t StartVertex;
+		uint32_t StartInstance;
+		std::vector<VertexBufferView> VertexBuffers;	//Bound when the draw was recorded
+	};
+
+	struct DescriptorCopy
+	{
+		CpuDescriptor Destination;
+		CpuDescriptor Source;
+		uint32_t Count;
+	};
+
+	explicit RecordingCommandContext(CommandStream * commandStream = nullptr) : m_commandStream(commandStream) {}
+
+	// Gives the resource a fake GPU address and the size uploads to it are checked against
+	void AddResource(Resource resource, const uint64_t & size)
+	{
+		m_resources[resource] = ResourceData{ m_nextAddress, std::vector<uint8_t>(static_cast<size_t>(size)) };
+		//Keeps the addresses of two resources apart like separate allocations
+		m_nextAddress += (size + 0xFFFF) & ~0xFFFFull;
+	}
+
+	void CopyDescriptors(const CpuDescriptor & destination, const CpuDescriptor & source, const uint32_t & count) override
+	{
+		m_descriptorCopies.push_back(DescriptorCopy{ destination, source, count });
+		_record(CommandStream::DESCRIPTOR_COPY, count);
+	}
+
+	void SetGraphicsRootDescriptorTable(const uint32_t & rootParameterIndex, const GpuDescriptor & table) override
+	{
+		m_rootTables[rootParameterIndex] = table;
+	}
+
+	uint8_t * BeginUpload(Resource destination, Resource intermediate, const uint64_t & size) override
+	{
+		auto it = m_resources.find(intermediate);
+		if (m_resources.find(destination) == m_resources.end() || it == m_resources.end() || size > it->second.Data.size())
+			return nullptr;
+		return it->second.Data.data();
+	}
+
+	void EndUpload(Resource destination, Resource intermediate, const uint64_t & size) override
+	{
+		const std::vector<uint8_t> & source = m_resources[intermediate].Data;
+		std::vector<uint8_t> & target = m_resources[destination].Data;
+		std::copy(source.begin(), source.begin() + static_cast<size_t>((std::min)(size, static_cast<uint64_t>(target.size()))), target.begin());
+		//Into and out of the copy state around the copy
+		_record(CommandStream::BARRIER, 2);
+		_record(CommandStream::UPLOAD, size);
+	}
+
+	uint64_t GetGpuAddress(Resource resource) const override
+	{
+		auto it = m_resources.find(resource);
+		return it != m_resources.end() ? it->second.Address : 0;
+	}
+
+	void SetVertexBuffers(const uint32_t & startSlot, const uint32_t & count, const VertexBufferView * views) override
+	{
+		if (m_vertexBuffers.size() < startSlot + count)
+			m_vertexBuffers.resize(startSlot + count);
+		for (uint32_t i = 0; i < count; i++)
+			m_vertexBuffers[startSlot + i] = views[i];
+	}
+
+	void DrawInstanced(const uint32_t & vertexCount, const uint32_t & instanceCount, const uint32_t & startVertex, const uint32_t & startInstance) override
+	{
+		m_draws.push_back(Draw{ vertexCount, instanceCount, startVertex, startInstance, m_vertexBuffers });
+		//Triangle lists, like IRender::p_countDraw
+		_record(CommandStream::DRAW, vertexCount, instanceCount, static_cast<uint64_t>(vertexCount / 3) * instanceCount);
+	}
+
+	// What the GPU would read from the resource after the recorded copies
+	const std::vector<uint8_t> & GetData(Resource resource) const
+	{
+		static const std::vector<uint8_t> EMPTY;
+		auto it = m_resources.find(resource);
+		return it != m_resources.end() ? it->second.Data : EMPTY;
+	}
+
+	const std::vector<Draw> & GetDraws() const
+	{
+		return m_draws;
+	}
+
+	const std::vector<DescriptorCopy> & GetDescriptorCopies() const
+	{
+		return m_descriptorCopies;
+	}
+
+	// 0 when nothing was bound to the root parameter
+	GpuDescriptor GetRootTable(const uint32_t & rootParameterIndex) const
+	{
+		auto it = m_rootTables.find(rootParameterIndex);
+		return it != m_rootTables.end() ? it->second : 0;
+	}
+
+	// Forgets what was recorded, the resources and what was uploaded to them stay
+	void Clear()
+	{
+		m_draws.clear();
+		m_descriptorCopies.clear();
+		m_rootTables.clear();
+		m_vertexBuffers.clear();
+	}
+
+private:
+	struct ResourceData
+	{
+		uint64_t Address;
+		std::vector<uint8_t> Data;
+	};
+
+	CommandStream * m_commandStream;
+	uint64_t m_nextAddress = 0x10000;
+	std::unordered_map<Resource, ResourceData> m_resources;
+
+	std::vector<Draw> m_draws;
+	std::vector<DescriptorCopy> m_descriptorCopies;
+	std::unordered_map<uint32_t, GpuDescriptor> m_rootTables;
+	std::vector<VertexBufferView> m_vertexBuffers;
+
+	void _record(const CommandStream::CommandType & type, const uint64_t & a, const uint64_t & b = 0, const uint64_t & c = 0)
+	{
+		if (m_commandStream)
+			m_commandStream->Record(type, a, b, c);
+	}
+};
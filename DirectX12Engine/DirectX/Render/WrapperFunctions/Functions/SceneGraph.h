@@ -0,0 +1,369 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "WorkerPool.h"
+
+// Parent relative transforms kept in one flat array sorted depth first, so every parent comes before its children
+// and every tree is one contiguous range. Update walks the array once, rebuilding the world matrix of every node that
+// was set or whose parent was rebuilt, and skips trees where nothing was set. Trees are split over the workers of a pool.
+// Matrices are untransposed, a world matrix is the local matrix times the world matrix of the parent.
+class SceneGraph
+{
+public:
+	typedef uint32_t Node;
+	static const Node NO_NODE = 0xFFFFFFFF;
+
+	// The graph Transform::SetParent attaches objects to
+	static SceneGraph * GetInstance()
+	{
+		static SceneGraph sceneGraph;
+		return &sceneGraph;
+	}
+
+private:
+	// Below this many nodes handing trees to the workers costs more than it saves
+	static const size_t MIN_NODES_PER_THREAD = 16384;
+
+	//Per node, indexed by node
+	std::vector<uint32_t> m_index;
+	std::vector<Node> m_parent;
+	std::vector<uint8_t> m_alive;
+	std::vector<Node> m_free;
+
+	//Per index, depth first order
+	std::vector<Node> m_node;
+	std::vector<uint32_t> m_parentIndex;
+	std::vector<uint32_t> m_tree;
+	std::vector<DirectX::XMFLOAT4X4A> m_local;
+	std::vector<DirectX::XMFLOAT4X4A> m_world;
+	std::vector<uint8_t> m_dirty;
+	std::vector<uint32_t> m_rebuilt;			//The update the node was last rebuilt in
+
+	//Per tree, the first index of the tree and whether anything in it was set
+	std::vector<uint32_t> m_treeBegin;
+	std::vector<uint8_t> m_treeDirty;
+
+	bool m_orderDirty = false;
+	bool m_localSet = false;
+	uint32_t m_updateIndex = 0;
+	WorkerPool m_workers;
+	std::vector<size_t> m_rangeBegin;
+	std::vector<size_t> m_rangeRebuilt;
+
+public:
+	// threadCount includes the thread calling Update, 0 uses every hardware thread
+	explicit SceneGraph(const unsigned int & threadCount = 0)
+		: m_workers(threadCount)
+	{
+	}
+
+	// A node with an identity local matrix, a root when parent is NO_NODE
+	Node Create(const Node parent = NO_NODE)
+	{
+		//Checked before a destroyed parent can be handed out as the node itself
+		const Node liveParent = IsAlive(parent) ? parent : static_cast<Node>(NO_NODE);
+		Node node;
+		if (!m_free.empty())
+		{
+			node = m_free.back();
+			m_free.pop_back();
+		}
+		else
+		{
+			node = static_cast<Node>(m_alive.size());
+			m_index.push_back(0);
+			m_parent.push_back(0);
+			m_alive.push_back(0);
+		}
+		m_alive[node] = 1;
+		m_parent[node] = liveParent;
+
+		//Appended after everything, the order is made depth first again in the next update
+		m_index[node] = static_cast<uint32_t>(m_node.size());
+		m_node.push_back(node);
+		m_parentIndex.push_back(0);
+		m_tree.push_back(0);
+		m_local.push_back(DirectX::XMFLOAT4X4A());
+		DirectX::XMStoreFloat4x4A(&m_local.back(), DirectX::XMMatrixIdentity());
+		m_world.push_back(m_local.back());
+		m_dirty.push_back(1);
+		m_rebuilt.push_back(0);
+		m_orderDirty = true;
+		return node;
+	}
+
+	// Destroys the node and everything below it
+	void Destroy(const Node & node)
+	{
+		if (!IsAlive(node))
+			return;
+		_sort();
+
+		const uint32_t begin = m_index[node];
+		const uint32_t end = _subtreeEnd(begin);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			m_alive[m_node[i]] = 0;
+			m_free.push_back(m_node[i]);
+		}
+		m_orderDirty = true;
+	}
+
+	// The local matrix stays, so the node moves with its new parent. Returns false when the parent is below the node
+	bool SetParent(const Node & node, const Node & parent)
+	{
+		if (!IsAlive(node))
+			return false;
+		for (Node ancestor = parent; IsAlive(ancestor); ancestor = m_parent[ancestor])
+		{
+			if (ancestor == node)
+				return false;
+		}
+		m_parent[node] = IsAlive(parent) ? parent : static_cast<Node>(NO_NODE);
+		//The node and everything below it get the new parent matrix
+		m_dirty[m_index[node]] = 1;
+		m_orderDirty = true;
+		return true;
+	}
+
+	const Node & GetParent(const Node & node) const
+	{
+		return m_parent[node];
+	}
+
+	bool IsAlive(const Node & node) const
+	{
+		return node < m_alive.size() && m_alive[node];
+	}
+
+	void SetLocal(const Node & node, const DirectX::XMFLOAT4X4A & local)
+	{
+		const uint32_t index = m_index[node];
+		m_local[index] = local;
+		m_dirty[index] = 1;
+		m_localSet = true;
+		if (!m_orderDirty)
+			m_treeDirty[m_tree[index]] = 1;
+	}
+
+	// Built like Transform builds its world matrix, scale then roll pitch yaw rotation then translation
+	void SetLocal(const Node & node, const DirectX::XMFLOAT4 & position, const DirectX::XMFLOAT4 & rotation, const DirectX::XMFLOAT4 & scale)
+	{
+		using namespace DirectX;
+		DirectX::XMFLOAT4X4A local;
+		XMStoreFloat4x4A(&local,
+			XMMatrixScalingFromVector(XMLoadFloat4(&scale)) *
+			XMMatrixRotationRollPitchYawFromVector(XMLoadFloat4(&rotation)) *
+			XMMatrixTranslationFromVector(XMLoadFloat4(&position)));
+		SetLocal(node, local);
+	}
+
+	const DirectX::XMFLOAT4X4A & GetLocal(const Node & node) const
+	{
+		return m_local[m_index[node]];
+	}
+
+	// As of the last update
+	const DirectX::XMFLOAT4X4A & GetWorld(const Node & node) const
+	{
+		return m_world[m_index[node]];
+	}
+
+	// The update the world matrix was last rebuilt in, it changes every time the matrix does
+	uint32_t GetWorldVersion(const Node & node) const
+	{
+		return m_rebuilt[m_index[node]];
+	}
+
+	size_t GetNodeCount() const
+	{
+		return m_node.size() - (m_orderDirty ? _deadCount() : 0);
+	}
+
+	// Whether anything was created, destroyed, moved or set since the last update
+	bool IsDirty() const
+	{
+		return m_orderDirty || m_localSet;
+	}
+
+	// Rebuilds every node set since the last update and everything below them, returns how many were rebuilt
+	size_t Update()
+	{
+		_sort();
+		m_updateIndex++;
+		m_localSet = false;
+
+		const size_t treeCount = m_treeBegin.size();
+		const unsigned int threads = m_node.size() >= MIN_NODES_PER_THREAD * 2 && treeCount > 1 ? m_workers.GetThreadCount() : 1;
+		if (threads == 1)
+			return _updateTrees(0, treeCount);
+
+		//Every range gets whole trees and about the same number of nodes
+		m_rangeBegin.clear();
+		size_t firstTree = 0;
+		for (unsigned int t = 0; t < threads && firstTree < treeCount; t++)
+		{
+			m_rangeBegin.push_back(firstTree);
+			const size_t targetEnd = m_node.size() * (t + 1) / threads;
+			size_t lastTree = firstTree + 1;
+			while (lastTree < treeCount && (t + 1 == threads || m_treeBegin[lastTree] < targetEnd))
+				lastTree++;
+			firstTree = lastTree;
+		}
+		m_rangeBegin.push_back(treeCount);
+
+		const unsigned int ranges = static_cast<unsigned int>(m_rangeBegin.size() - 1);
+		m_rangeRebuilt.assign(ranges, 0);
+		m_workers.Run(ranges, [this](const unsigned int r) { m_rangeRebuilt[r] = _updateTrees(m_rangeBegin[r], m_rangeBegin[r + 1]); });
+		size_t rebuilt = 0;
+		for (size_t r = 0; r < ranges; r++)
+			rebuilt += m_rangeRebuilt[r];
+		return rebuilt;
+	}
+
+private:
+	size_t _deadCount() const
+	{
+		size_t dead = 0;
+		for (size_t i = 0; i < m_node.size(); i++)
+			dead += !_isLive(static_cast<uint32_t>(i));
+		return dead;
+	}
+
+	bool _isLive(const uint32_t & index) const
+	{
+		//A destroyed node handed out again is appended, its old entry stays behind until the next sort
+		const Node node = m_node[index];
+		return m_alive[node] && m_index[node] == index;
+	}
+
+	uint32_t _subtreeEnd(const uint32_t & begin) const
+	{
+		//Everything after the node that is deeper in the depth first order is below it
+		uint32_t end = begin + 1;
+		while (end < m_node.size() && _isBelow(end, begin))
+			end++;
+		return end;
+	}
+
+	bool _isBelow(uint32_t index, const uint32_t & ancestor) const
+	{
+		while (index != NO_NODE && index > ancestor)
+			index = m_parentIndex[index];
+		return index == ancestor;
+	}
+
+	// Lays the live nodes out depth first again after nodes were created, destroyed or moved
+	void _sort()
+	{
+		if (!m_orderDirty)
+			return;
+
+		//Children of each node as a range of one list, in the order they are in now
+		const size_t nodeCount = m_alive.size();
+		std::vector<uint32_t> childBegin(nodeCount + 2, 0);
+		std::vector<Node> roots;
+		for (size_t i = 0; i < m_node.size(); i++)
+		{
+			const Node node = m_node[i];
+			if (!_isLive(static_cast<uint32_t>(i)))
+				continue;
+			if (m_parent[node] == NO_NODE)
+				roots.push_back(node);
+			else
+				childBegin[m_parent[node] + 2]++;
+		}
+		for (size_t i = 2; i < childBegin.size(); i++)
+			childBegin[i] += childBegin[i - 1];
+		std::vector<Node> children(childBegin[nodeCount + 1]);
+		for (size_t i = 0; i < m_node.size(); i++)
+		{
+			const Node node = m_node[i];
+			if (_isLive(static_cast<uint32_t>(i)) && m_parent[node] != NO_NODE)
+				children[childBegin[m_parent[node] + 1]++] = node;
+		}
+
+		std::vector<Node> order;
+		std::vector<uint32_t> parentIndex, tree;
+		std::vector<DirectX::XMFLOAT4X4A> local, world;
+		std::vector<uint8_t> dirty;
+		std::vector<uint32_t> rebuilt;
+		order.reserve(m_node.size());
+		parentIndex.reserve(m_node.size());
+		tree.reserve(m_node.size());
+		local.reserve(m_node.size());
+		world.reserve(m_node.size());
+		dirty.reserve(m_node.size());
+		rebuilt.reserve(m_node.size());
+		m_treeBegin.clear();
+
+		std::vector<Node> stack;
+		for (size_t r = 0; r < roots.size(); r++)
+		{
+			m_treeBegin.push_back(static_cast<uint32_t>(order.size()));
+			stack.push_back(roots[r]);
+			while (!stack.empty())
+			{
+				const Node node = stack.back();
+				stack.pop_back();
+				const uint32_t oldIndex = m_index[node];
+				const uint32_t newIndex = static_cast<uint32_t>(order.size());
+
+				order.push_back(node);
+				parentIndex.push_back(m_parent[node] == NO_NODE ? static_cast<uint32_t>(NO_NODE) : m_index[m_parent[node]]);
+				tree.push_back(static_cast<uint32_t>(r));
+				local.push_back(m_local[oldIndex]);
+				world.push_back(m_world[oldIndex]);
+				dirty.push_back(m_dirty[oldIndex]);
+				rebuilt.push_back(m_rebuilt[oldIndex]);
+				m_index[node] = newIndex;
+
+				//Pushed in reverse so the children keep their order
+				for (uint32_t c = childBegin[node + 1]; c-- > childBegin[node];)
+					stack.push_back(children[c]);
+			}
+		}
+
+		m_node.swap(order);
+		m_parentIndex.swap(parentIndex);
+		m_tree.swap(tree);
+		m_local.swap(local);
+		m_world.swap(world);
+		m_dirty.swap(dirty);
+		m_rebuilt.swap(rebuilt);
+		m_treeDirty.assign(m_treeBegin.size(), 1);
+		m_orderDirty = false;
+	}
+
+	size_t _updateTrees(const size_t & firstTree, const size_t & lastTree)
+	{
+		using namespace DirectX;
+		size_t rebuilt = 0;
+		for (size_t t = firstTree; t < lastTree; t++)
+		{
+			if (!m_treeDirty[t])
+				continue;
+			m_treeDirty[t] = 0;
+
+			const uint32_t begin = m_treeBegin[t];
+			const uint32_t end = t + 1 < m_treeBegin.size() ? m_treeBegin[t + 1] : static_cast<uint32_t>(m_node.size());
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const uint32_t parent = m_parentIndex[i];
+				const bool parentRebuilt = parent != NO_NODE && m_rebuilt[parent] == m_updateIndex;
+				if (!m_dirty[i] && !parentRebuilt)
+					continue;
+
+				if (parent == NO_NODE)
+					m_world[i] = m_local[i];
+				else
+					XMStoreFloat4x4A(&m_world[i], XMMatrixMultiply(XMLoadFloat4x4A(&m_local[i]), XMLoadFloat4x4A(&m_world[parent])));
+				m_dirty[i] = 0;
+				m_rebuilt[i] = m_updateIndex;
+				rebuilt++;
+			}
+		}
+		return rebuilt;
+	}
+};
@@ -0,0 +1,202 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstddef>
+
+// Quad-tree allocator for the square power of two shadow tiles in the shadow atlas.
+// Every level keeps a list of free nodes, a request takes a free node of its size or splits the smallest larger one.
+// Requests made from the largest to the smallest size never fragment the atlas.
+// Free of any D3D12 types so the packing can be measured without a device.
+class ShadowAtlasPacker
+{
+public:
+	struct Tile
+	{
+		unsigned int X;
+		unsigned int Y;
+		unsigned int Size;
+	};
+
+	ShadowAtlasPacker(const unsigned int & atlasSize, const unsigned int & minTileSize)
+		: m_atlasSize(atlasSize), m_minTileSize(minTileSize)
+	{
+		m_levels = 1;
+		while ((m_atlasSize >> m_levels) >= m_minTileSize && m_levels < 32)
+			m_levels++;
+		m_free.resize(m_levels);
+		Reset();
+	}
+
+	void Reset()
+	{
+		for (size_t i = 0; i < m_free.size(); i++)
+			m_free[i].clear();
+		m_free[0].push_back(Tile{ 0, 0, m_atlasSize });
+
+		m_requestedArea = 0;
+		m_allocatedArea = 0;
+		m_failed = 0;
+	}
+
+	// Size is rounded up to a power of two and clamped to [minTileSize, atlasSize]
+	bool Allocate(const unsigned int & size, Tile & tile)
+	{
+		const unsigned int level = _level(size);
+		const unsigned long long area = static_cast<unsigned long long>(m_atlasSize >> level) * (m_atlasSize >> level);
+		m_requestedArea += area;
+
+		if (!_allocate(level, tile))
+		{
+			m_failed++;
+			return false;
+		}
+		m_allocatedArea += area;
+		return true;
+	}
+
+	// Allocates count tiles of one size, all or none. The size is halved down to minTileSize until they fit.
+	// Returns the granted size or 0 when not even the smallest tiles fit
+	unsigned int AllocateGroup(const unsigned int & size, const unsigned int & count, Tile * tiles)
+	{
+		const unsigned int requestedLevel = _level(size);
+		const unsigned long long requestedSize = m_atlasSize >> requestedLevel;
+		m_requestedArea += requestedSize * requestedSize * count;
+
+		for (unsigned int level = requestedLevel; level < m_levels; level++)
+		{
+			unsigned int allocated = 0;
+			while (allocated < count && _allocate(level, tiles[allocated]))
+				allocated++;
+
+			if (allocated == count)
+			{
+				const unsigned long long grantedSize = m_atlasSize >> level;
+				m_allocatedArea += grantedSize * grantedSize * count;
+				return static_cast<unsigned int>(grantedSize);
+			}
+
+			//Hand the partial group back, smaller levels split these first
+			for (unsigned int i = 0; i < allocated; i++)
+				m_free[level].push_back(tiles[i]);
+		}
+		m_failed++;
+		return 0;
+	}
+
+	// Halves the largest requests, the last one of them first, until every request fits the atlas,
+	// so no light loses its shadow to a few large tiles. Requests sorted from largest to smallest stay sorted.
+	// Returns how many requests, in order, fit when even the smallest tiles are too many
+	size_t FitRequests(unsigned int * sizes, const unsigned int * counts, const size_t & count) const
+	{
+		const unsigned long long atlasArea = static_cast<unsigned long long>(m_atlasSize) * m_atlasSize;
+
+		unsigned long long total = 0;
+		for (size_t i = 0; i < count; i++)
+			total += static_cast<unsigned long long>(sizes[i]) * sizes[i] * counts[i];
+
+		while (total > atlasArea)
+		{
+			size_t largest = 0;
+			for (size_t i = 1; i < count; i++)
+			{
+				if (sizes[i] >= sizes[largest])
+					largest = i;
+			}
+			if (sizes[largest] <= m_minTileSize)
+				break;
+
+			const unsigned long long area = static_cast<unsigned long long>(sizes[largest]) * sizes[largest] * counts[largest];
+			total -= area - area / 4;
+			sizes[largest] >>= 1;
+		}
+
+		total = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			total += static_cast<unsigned long long>(sizes[i]) * sizes[i] * counts[i];
+			if (total > atlasArea)
+				return i;
+		}
+		return count;
+	}
+
+	// Tile size for a light of the given radius, larger on screen and closer means more texels.
+	// A light filling the screen height gets maxSize
+	static unsigned int ChooseTileSize(
+		const float & distance,
+		const float & radius,
+		const float & fov,
+		const unsigned int & minSize,
+		const unsigned int & maxSize)
+	{
+		const float screenSize = distance <= radius ? 1.0f : radius / (distance * tanf(fov * 0.5f));
+		const float texels = screenSize * static_cast<float>(maxSize);
+
+		unsigned int size = minSize;
+		while (size < maxSize && static_cast<float>(size) < texels)
+			size <<= 1;
+		return size;
+	}
+
+	const unsigned int & GetAtlasSize() const { return m_atlasSize; }
+	const unsigned int & GetMinTileSize() const { return m_minTileSize; }
+
+	// Share of the atlas handed out
+	float GetOccupancy() const
+	{
+		return static_cast<float>(static_cast<double>(m_allocatedArea) / (static_cast<double>(m_atlasSize) * m_atlasSize));
+	}
+	// Share of the requested texels that were granted, below 1 when tiles were shrunk or dropped
+	float GetGrantedRatio() const
+	{
+		return m_requestedArea ? static_cast<float>(static_cast<double>(m_allocatedArea) / m_requestedArea) : 1.0f;
+	}
+	const unsigned int & GetFailedCount() const { return m_failed; }
+
+private:
+	unsigned int _level(const unsigned int & size) const
+	{
+		unsigned int level = 0;
+		while (level + 1 < m_levels && (m_atlasSize >> (level + 1)) >= size)
+			level++;
+		return level;
+	}
+
+	bool _allocate(const unsigned int & level, Tile & tile)
+	{
+		unsigned int source = level + 1;
+		while (source-- > 0)
+		{
+			if (!m_free[source].empty())
+				break;
+		}
+		if (source > level)
+			return false;
+
+		Tile node = m_free[source].back();
+		m_free[source].pop_back();
+
+		//Keep the top left child, the others are pushed in reverse so they are taken in Z order
+		while (source < level)
+		{
+			const unsigned int half = node.Size >> 1;
+			source++;
+			m_free[source].push_back(Tile{ node.X + half, node.Y + half, half });
+			m_free[source].push_back(Tile{ node.X, node.Y + half, half });
+			m_free[source].push_back(Tile{ node.X + half, node.Y, half });
+			node.Size = half;
+		}
+		tile = node;
+		return true;
+	}
+
+	unsigned int m_atlasSize;
+	unsigned int m_minTileSize;
+	unsigned int m_levels;
+
+	std::vector<std::vector<Tile>> m_free;
+
+	unsigned long long m_requestedArea = 0;
+	unsigned long long m_allocatedArea = 0;
+	unsigned int m_failed = 0;
+};
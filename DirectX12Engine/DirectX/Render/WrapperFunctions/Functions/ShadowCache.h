@@ -0,0 +1,223 @@
+#pragma once
+#include <DirectXMath.h>
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cstddef>
+#include "ParticleLod.h"
+
+// Decides which shadow faces have to be rendered again.
+// A face is dirty when its light moved, its tile moved, or a caster was added, removed or moved inside its frustum.
+// Lights and casters are only used as keys, so the tracking can be checked without a device.
+class ShadowCache
+{
+public:
+	static const unsigned int MAX_FACES = 6;
+
+	// Bounding sphere of the vertices, XYZ = center W = radius
+	static DirectX::XMFLOAT4 ComputeLocalBounds(const DirectX::XMFLOAT4 * positions, const size_t & count, const size_t & stride)
+	{
+		using namespace DirectX;
+
+		if (!count)
+			return XMFLOAT4(0, 0, 0, 0);
+
+		const unsigned char * data = reinterpret_cast<const unsigned char*>(positions);
+		XMVECTOR minimum = XMLoadFloat4(positions);
+		XMVECTOR maximum = minimum;
+		for (size_t i = 1; i < count; i++)
+		{
+			const XMVECTOR position = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(data + i * stride));
+			minimum = XMVectorMin(minimum, position);
+			maximum = XMVectorMax(maximum, position);
+		}
+
+		const XMVECTOR center = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+		float radius = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			const XMVECTOR position = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(data + i * stride));
+			const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(position, center)));
+			if (distance > radius)
+				radius = distance;
+		}
+
+		XMFLOAT4 bounds;
+		XMStoreFloat4(&bounds, XMVectorSetW(center, radius));
+		return bounds;
+	}
+
+	void BeginFrame()
+	{
+		m_frame++;
+		m_dirtyBounds.clear();
+		m_renderedFaces = 0;
+		m_cachedFaces = 0;
+	}
+
+	// Local bounds moved into world space, the radius grows with the largest scale axis.
+	// Expects the transposed world matrix Transform keeps for the shaders
+	static DirectX::XMFLOAT4 WorldBounds(const DirectX::XMFLOAT4X4 & worldMatrix, const DirectX::XMFLOAT4 & localBounds)
+	{
+		using namespace DirectX;
+
+		const XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix));
+		const XMVECTOR center = XMVector3Transform(XMVectorSet(localBounds.x, localBounds.y, localBounds.z, 1.0f), world);
+
+		float scale = XMVectorGetX(XMVector3Length(world.r[0]));
+		scale = (std::max)(scale, XMVectorGetX(XMVector3Length(world.r[1])));
+		scale = (std::max)(scale, XMVectorGetX(XMVector3Length(world.r[2])));
+
+		XMFLOAT4 bounds;
+		XMStoreFloat4(&bounds, XMVectorSetW(center, localBounds.w * scale));
+		return bounds;
+	}
+
+	// Expects the transposed world matrix Transform keeps for the shaders
+	void TrackCaster(const void * caster, const DirectX::XMFLOAT4X4A & worldMatrix, const DirectX::XMFLOAT4 & localBounds)
+	{
+		auto it = m_casters.find(caster);
+		if (it != m_casters.end())
+		{
+			it->second.LastFrame = m_frame;
+			if (!memcmp(&it->second.WorldMatrix, &worldMatrix, sizeof(worldMatrix)))
+				return;
+
+			//Both where it was and where it is now have to be redrawn
+			m_dirtyBounds.push_back(it->second.Bounds);
+			it->second.WorldMatrix = worldMatrix;
+			it->second.Bounds = WorldBounds(worldMatrix, localBounds);
+			m_dirtyBounds.push_back(it->second.Bounds);
+			return;
+		}
+
+		Caster newCaster;
+		newCaster.WorldMatrix = worldMatrix;
+		newCaster.Bounds = WorldBounds(worldMatrix, localBounds);
+		newCaster.LastFrame = m_frame;
+		m_casters.emplace(caster, newCaster);
+		m_dirtyBounds.push_back(newCaster.Bounds);
+	}
+
+	// Casters that were not tracked this frame left the scene, their shadows have to go
+	void EndCasters()
+	{
+		for (auto it = m_casters.begin(); it != m_casters.end();)
+		{
+			if (it->second.LastFrame != m_frame)
+			{
+				m_dirtyBounds.push_back(it->second.Bounds);
+				it = m_casters.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+
+	// Returns a bit per face that has to be rendered this frame.
+	// Expects the transposed view projection matrices the cameras keep for the shaders
+	unsigned int GetDirtyFaces(
+		const void * light,
+		const DirectX::XMFLOAT4X4A * viewProjection,
+		const unsigned int & faceCount,
+		const bool & tileMoved)
+	{
+		const unsigned int allFaces = (1u << faceCount) - 1u;
+
+		auto it = m_lights.find(light);
+		bool lightMoved = it == m_lights.end() || it->second.FaceCount != faceCount;
+		if (it == m_lights.end())
+			it = m_lights.emplace(light, Light()).first;
+
+		Light & cached = it->second;
+		cached.LastFrame = m_frame;
+		for (unsigned int i = 0; i < faceCount && !lightMoved; i++)
+			lightMoved = memcmp(&cached.ViewProjection[i], &viewProjection[i], sizeof(viewProjection[i])) != 0;
+
+		unsigned int dirtyFaces = 0;
+		if (lightMoved || tileMoved)
+		{
+			cached.FaceCount = faceCount;
+			for (unsigned int i = 0; i < faceCount; i++)
+			{
+				cached.ViewProjection[i] = viewProjection[i];
+				cached.Frustum[i] = ParticleLod::CreateFrustum(viewProjection[i]);
+			}
+			dirtyFaces = allFaces;
+		}
+		else
+		{
+			for (unsigned int i = 0; i < faceCount; i++)
+			{
+				for (size_t j = 0; j < m_dirtyBounds.size(); j++)
+				{
+					if (ParticleLod::Intersects(cached.Frustum[i], m_dirtyBounds[j], m_dirtyBounds[j].w))
+					{
+						dirtyFaces |= 1u << i;
+						break;
+					}
+				}
+			}
+		}
+
+		const unsigned int rendered = _countBits(dirtyFaces);
+		m_renderedFaces += rendered;
+		m_cachedFaces += faceCount - rendered;
+		return dirtyFaces;
+	}
+
+	// Lights that were not asked for this frame are forgotten, they start dirty when they return
+	void EndFrame()
+	{
+		for (auto it = m_lights.begin(); it != m_lights.end();)
+		{
+			if (it->second.LastFrame != m_frame)
+				it = m_lights.erase(it);
+			else
+				++it;
+		}
+	}
+
+	void Clear()
+	{
+		m_casters.clear();
+		m_lights.clear();
+		m_dirtyBounds.clear();
+	}
+
+	const unsigned int & GetRenderedFaces() const { return m_renderedFaces; }
+	const unsigned int & GetCachedFaces() const { return m_cachedFaces; }
+
+private:
+	struct Caster
+	{
+		DirectX::XMFLOAT4X4A WorldMatrix;
+		DirectX::XMFLOAT4 Bounds;
+		unsigned long long LastFrame;
+	};
+
+	struct Light
+	{
+		DirectX::XMFLOAT4X4A ViewProjection[MAX_FACES];
+		ParticleLod::Frustum Frustum[MAX_FACES];
+		unsigned int FaceCount = 0;
+		unsigned long long LastFrame = 0;
+	};
+
+	static unsigned int _countBits(unsigned int value)
+	{
+		unsigned int count = 0;
+		for (; value; value &= value - 1)
+			count++;
+		return count;
+	}
+
+	std::unordered_map<const void*, Caster> m_casters;
+	std::unordered_map<const void*, Light> m_lights;
+	std::vector<DirectX::XMFLOAT4> m_dirtyBounds;
+
+	unsigned long long m_frame = 0;
+	unsigned int m_renderedFaces = 0;
+	unsigned int m_cachedFaces = 0;
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cmath>
+#include <cstddef>
+#include "ParticleLod.h"
+
+// Per instance tessellation factors from the screen space size of the instance, and the triangle budget split.
+// Only depends on DirectXMath so the decisions can be checked without a device.
+namespace TessellationLod
+{
+	struct Settings
+	{
+		float FullDetailSize = 0.5f;	//Projected radius, in screen heights, where an instance gets MaxFactor
+		float MinFactor = 1.0f;
+		float MaxFactor = 64.0f;		//Hardware limit
+	};
+
+	// Largest scale of a world matrix kept transposed for the shaders
+	inline float MaxScale(const DirectX::XMFLOAT4X4 & worldMatrix)
+	{
+		const float x = worldMatrix._11 * worldMatrix._11 + worldMatrix._21 * worldMatrix._21 + worldMatrix._31 * worldMatrix._31;
+		const float y = worldMatrix._12 * worldMatrix._12 + worldMatrix._22 * worldMatrix._22 + worldMatrix._32 * worldMatrix._32;
+		const float z = worldMatrix._13 * worldMatrix._13 + worldMatrix._23 * worldMatrix._23 + worldMatrix._33 * worldMatrix._33;
+		const float largest = x > y ? (x > z ? x : z) : (y > z ? y : z);
+		return sqrtf(largest);
+	}
+
+	inline DirectX::XMFLOAT4 Position(const DirectX::XMFLOAT4X4 & worldMatrix)
+	{
+		return DirectX::XMFLOAT4(worldMatrix._14, worldMatrix._24, worldMatrix._34, 1.0f);
+	}
+
+	inline float Factor(const float & distance, const float & radius, const float & fov, const Settings & settings)
+	{
+		const float size = ParticleLod::ProjectedSize(distance, radius, fov);
+		float detail = settings.FullDetailSize > 0.0f ? size / settings.FullDetailSize : 1.0f;
+		if (detail > 1.0f)
+			detail = 1.0f;
+		return settings.MinFactor + (settings.MaxFactor - settings.MinFactor) * detail;
+	}
+
+	// A triangle tessellated with factor f becomes about f * f triangles.
+	// Scales every factor down by the same amount when the total is over budget, never below 1 so the mesh itself is always drawn.
+	// Returns the number of triangles granted
+	inline double ApplyBudget(const float * requested, const unsigned int * triangles, float * granted, const size_t & count, const double & budget)
+	{
+		double total = 0.0;
+		for (size_t i = 0; i < count; i++)
+			total += triangles[i] * static_cast<double>(requested[i]) * requested[i];
+
+		const float scale = budget > 0.0 && total > budget ? static_cast<float>(sqrt(budget / total)) : 1.0f;
+
+		double grantedTotal = 0.0;
+		for (size_t i = 0; i < count; i++)
+		{
+			granted[i] = requested[i] * scale;
+			if (granted[i] < 1.0f)
+				granted[i] = 1.0f;
+			grantedTotal += triangles[i] * static_cast<double>(granted[i]) * granted[i];
+		}
+		return grantedTotal;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Running statistics of one timer zone. Min, avg and max cover every sample since the last Reset,
+// p99 covers the last WINDOW samples so it follows the current load instead of the whole run.
+// Adding a sample never allocates after the window has filled.
+class TimerStatistics
+{
+public:
+	static const size_t WINDOW = 1024;
+
+	struct Summary
+	{
+		size_t Count = 0;
+		double Min = 0.0;
+		double Avg = 0.0;
+		double Max = 0.0;
+		double P99 = 0.0;
+	};
+
+	TimerStatistics()
+	{
+		m_window.reserve(WINDOW);
+	}
+
+	void AddSample(const double & sample)
+	{
+		if (!m_count || sample < m_min)
+			m_min = sample;
+		if (!m_count || sample > m_max)
+			m_max = sample;
+		m_sum += sample;
+		m_count++;
+
+		if (m_window.size() < WINDOW)
+			m_window.push_back(sample);
+		else
+			m_window[m_next] = sample;
+		m_next = (m_next + 1) % WINDOW;
+	}
+
+	// Sorts a copy of the window, call it when the numbers are shown rather than every frame
+	Summary GetSummary() const
+	{
+		Summary summary;
+		if (!m_count)
+			return summary;
+
+		summary.Count = m_count;
+		summary.Min = m_min;
+		summary.Avg = m_sum / static_cast<double>(m_count);
+		summary.Max = m_max;
+
+		std::vector<double> window(m_window);
+		const size_t rank = (window.size() * 99 + 99) / 100 - 1;
+		std::nth_element(window.begin(), window.begin() + rank, window.end());
+		summary.P99 = window[rank];
+		return summary;
+	}
+
+	const size_t & GetCount() const
+	{
+		return m_count;
+	}
+
+	void Reset()
+	{
+		m_count = 0;
+		m_min = m_max = m_sum = 0.0;
+		m_window.clear();
+		m_next = 0;
+	}
+
+private:
+	size_t m_count = 0;
+	double m_min = 0.0;
+	double m_max = 0.0;
+	double m_sum = 0.0;
+
+	std::vector<double> m_window;
+	size_t m_next = 0;
+};
@@ -0,0 +1,334 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <DirectXMath.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRANSFORM_STORE_AVX2
+#else
+#define TRANSFORM_STORE_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Position, rotation and scale of many objects kept as one array per component. Setters only mark a slot dirty,
+// Update rebuilds the world matrices of every dirty slot in one batch, eight at a time when the CPU has AVX2.
+// Matrices are stored transposed like Transform keeps them for the shaders. Not thread safe, the matrices
+// can be read from any thread while nothing is set or updated.
+class TransformStore
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle NO_HANDLE = 0xFFFFFFFF;
+
+	// The store every Drawable lives in
+	static TransformStore * GetInstance()
+	{
+		static TransformStore transformStore;
+		return &transformStore;
+	}
+
+	TransformStore()
+		: m_useAvx2(SupportsAvx2())
+	{
+	}
+
+	// A slot at the origin with no rotation and a scale of one, reused from freed slots first
+	Handle Allocate()
+	{
+		Handle handle;
+		if (!m_free.empty())
+		{
+			handle = m_free.back();
+			m_free.pop_back();
+		}
+		else
+		{
+			handle = static_cast<Handle>(m_world.size());
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				m_position[i].push_back(0.0f);
+				m_rotation[i].push_back(0.0f);
+				m_scale[i].push_back(1.0f);
+			}
+			m_world.push_back(DirectX::XMFLOAT4X4A());
+			m_dirtySlot.push_back(0);
+		}
+		_reset(handle);
+		return handle;
+	}
+
+	void Free(const Handle & handle)
+	{
+		if (handle >= m_world.size())
+			return;
+		_reset(handle);
+		m_free.push_back(handle);
+	}
+
+	// Only x, y and z are used, like the matrix functions Transform builds with
+	void SetPosition(const Handle & handle, const DirectX::XMFLOAT4 & position)
+	{
+		_set(m_position, handle, position);
+	}
+
+	void SetRotation(const Handle & handle, const DirectX::XMFLOAT4 & rotation)
+	{
+		_set(m_rotation, handle, rotation);
+	}
+
+	void SetScale(const Handle & handle, const DirectX::XMFLOAT4 & scale)
+	{
+		_set(m_scale, handle, scale);
+	}
+
+	bool IsDirty(const Handle & handle) const
+	{
+		return m_dirtySlot[handle] != 0;
+	}
+
+	bool IsDirty() const
+	{
+		return !m_dirty.empty();
+	}
+
+	// Rebuilds the world matrix of every slot set since the last update, returns how many were rebuilt
+	size_t Update()
+	{
+		const size_t count = m_dirty.size();
+		if (!count)
+			return 0;
+
+		size_t done = 0;
+		if (m_useAvx2)
+			done = _updateAvx2(m_dirty.data(), count);
+		for (size_t i = done; i < count; i++)
+			_updateScalar(m_dirty[i]);
+
+		for (size_t i = 0; i < count; i++)
+			m_dirtySlot[m_dirty[i]] = 0;
+		m_dirty.clear();
+		return count;
+	}
+
+	// The last rebuilt matrix, it moves when the store grows
+	const DirectX::XMFLOAT4X4A & GetWorldMatrix(const Handle & handle) const
+	{
+		return m_world[handle];
+	}
+
+	// For a slot whose matrix is made somewhere else, like a drawable in the scene graph. Its position, rotation
+	// and scale are not used again until one of them is set
+	void SetWorldMatrix(const Handle & handle, const DirectX::XMFLOAT4X4A & world)
+	{
+		//A pending rebuild would write over it
+		if (IsDirty(handle))
+			Update();
+		m_world[handle] = world;
+	}
+
+	// Writes the matrices of the handles one stride apart, straight into the records that are uploaded
+	void CopyWorldMatrices(const Handle * handles, const size_t & count, void * destination, const size_t & stride) const
+	{
+		char * out = static_cast<char*>(destination);
+		for (size_t i = 0; i < count; i++)
+			memcpy(out + i * stride, &m_world[handles[i]], sizeof(DirectX::XMFLOAT4X4A));
+	}
+
+	// Slots ever allocated, freed ones included
+	size_t GetCapacity() const
+	{
+		return m_world.size();
+	}
+
+	// Falls back to the DirectXMath path when the CPU has no AVX2
+	void SetUseAvx2(const bool & useAvx2)
+	{
+		m_useAvx2 = useAvx2 && SupportsAvx2();
+	}
+
+	const bool & GetUseAvx2() const
+	{
+		return m_useAvx2;
+	}
+
+	static bool SupportsAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		//The OS has to save the YMM registers as well
+		const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+		if (!avx || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+private:
+	std::vector<float> m_position[3];
+	std::vector<float> m_rotation[3];
+	std::vector<float> m_scale[3];
+	std::vector<DirectX::XMFLOAT4X4A> m_world;
+
+	std::vector<uint8_t> m_dirtySlot;
+	std::vector<Handle> m_dirty;
+	std::vector<Handle> m_free;
+
+	bool m_useAvx2;
+
+	void _reset(const Handle & handle)
+	{
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			m_position[i][handle] = 0.0f;
+			m_rotation[i][handle] = 0.0f;
+			m_scale[i][handle] = 1.0f;
+		}
+		_markDirty(handle);
+	}
+
+	void _markDirty(const Handle & handle)
+	{
+		if (m_dirtySlot[handle])
+			return;
+		m_dirtySlot[handle] = 1;
+		m_dirty.push_back(handle);
+	}
+
+	void _set(std::vector<float> (&component)[3], const Handle & handle, const DirectX::XMFLOAT4 & value)
+	{
+		if (component[0][handle] == value.x && component[1][handle] == value.y && component[2][handle] == value.z)
+			return;
+		component[0][handle] = value.x;
+		component[1][handle] = value.y;
+		component[2][handle] = value.z;
+		_markDirty(handle);
+	}
+
+	// The same matrix Transform builds
+	void _updateScalar(const Handle & handle)
+	{
+		using namespace DirectX;
+		const XMMATRIX scale = XMMatrixScalingFromVector(XMVectorSet(m_scale[0][handle], m_scale[1][handle], m_scale[2][handle], 0.0f));
+		const XMMATRIX rotation = XMMatrixRotationRollPitchYawFromVector(XMVectorSet(m_rotation[0][handle], m_rotation[1][handle], m_rotation[2][handle], 0.0f));
+		const XMMATRIX translation = XMMatrixTranslationFromVector(XMVectorSet(m_position[0][handle], m_position[1][handle], m_position[2][handle], 1.0f));
+		XMStoreFloat4x4A(&m_world[handle], XMMatrixTranspose(scale * rotation * translation));
+	}
+
+	// Sine and cosine of eight angles, the polynomials of the Cephes library with the quadrant picked from x * 4 / pi
+	static TRANSFORM_STORE_AVX2 void _sinCos(const __m256 & angle, __m256 & sin, __m256 & cos)
+	{
+		const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000)));
+		__m256 x = _mm256_andnot_ps(signMask, angle);
+		__m256 signSin = _mm256_and_ps(angle, signMask);
+
+		__m256i quadrant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+		quadrant = _mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+		const __m256 y = _mm256_cvtepi32_ps(quadrant);
+
+		signSin = _mm256_xor_ps(signSin, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(4)), 29)));
+		const __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(quadrant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+		const __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+
+		//Pi / 4 in three parts keeps the reduction exact for the angles a transform uses
+		x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(0.78515625f)));
+		x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f)));
+		x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(3.77489497744594108e-8f)));
+		const __m256 z = _mm256_mul_ps(x, x);
+
+		__m256 c = _mm256_set1_ps(2.443315711809948e-5f);
+		c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(-1.388731625493765e-3f));
+		c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(4.166664568298827e-2f));
+		c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+		c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(z, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+		__m256 s = _mm256_set1_ps(-1.9515295891e-4f);
+		s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(8.3321608736e-3f));
+		s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(-1.6666654611e-1f));
+		s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, z), x), x);
+
+		sin = _mm256_xor_ps(_mm256_blendv_ps(c, s, polyMask), signSin);
+		cos = _mm256_xor_ps(_mm256_blendv_ps(s, c, polyMask), signCos);
+	}
+
+	// Writes one row of eight matrices, a, b, c and d hold the four columns of the row for every matrix
+	static TRANSFORM_STORE_AVX2 void _storeRows(const __m256 & a, const __m256 & b, const __m256 & c, const __m256 & d, DirectX::XMFLOAT4X4A * const * matrices, const unsigned int & row)
+	{
+		const __m256 ab0 = _mm256_unpacklo_ps(a, b);
+		const __m256 ab1 = _mm256_unpackhi_ps(a, b);
+		const __m256 cd0 = _mm256_unpacklo_ps(c, d);
+		const __m256 cd1 = _mm256_unpackhi_ps(c, d);
+		const __m256 rows[4] =
+		{
+			_mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(1, 0, 1, 0)),
+			_mm256_shuffle_ps(ab0, cd0, _MM_SHUFFLE(3, 2, 3, 2)),
+			_mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(1, 0, 1, 0)),
+			_mm256_shuffle_ps(ab1, cd1, _MM_SHUFFLE(3, 2, 3, 2))
+		};
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			_mm_store_ps(matrices[i]->m[row], _mm256_castps256_ps128(rows[i]));
+			_mm_store_ps(matrices[i + 4]->m[row], _mm256_extractf128_ps(rows[i], 1));
+		}
+	}
+
+	static TRANSFORM_STORE_AVX2 __m256 _load(const std::vector<float> & component, const Handle * handles, const __m256i & index, const bool & contiguous)
+	{
+		return contiguous ? _mm256_loadu_ps(&component[handles[0]]) : _mm256_i32gather_ps(component.data(), index, 4);
+	}
+
+	// Rebuilds the matrices of whole groups of eight handles, returns how many handles it did
+	TRANSFORM_STORE_AVX2 size_t _updateAvx2(const Handle * handles, const size_t & count)
+	{
+		const size_t batched = count & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < batched; i += 8)
+		{
+			const Handle * batch = handles + i;
+			//Slots set in the order they were allocated are loaded directly, the rest are gathered
+			bool contiguous = true;
+			for (unsigned int j = 1; j < 8 && contiguous; j++)
+				contiguous = batch[j] == batch[0] + j;
+			const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(batch));
+
+			__m256 sp, cp, sy, cy, sr, cr;
+			_sinCos(_load(m_rotation[0], batch, index, contiguous), sp, cp);
+			_sinCos(_load(m_rotation[1], batch, index, contiguous), sy, cy);
+			_sinCos(_load(m_rotation[2], batch, index, contiguous), sr, cr);
+			const __m256 scaleX = _load(m_scale[0], batch, index, contiguous);
+			const __m256 scaleY = _load(m_scale[1], batch, index, contiguous);
+			const __m256 scaleZ = _load(m_scale[2], batch, index, contiguous);
+
+			//Rows of the roll pitch yaw matrix DirectXMath builds
+			const __m256 spsy = _mm256_mul_ps(sp, sy);
+			const __m256 spcy = _mm256_mul_ps(sp, cy);
+			const __m256 r00 = _mm256_add_ps(_mm256_mul_ps(cr, cy), _mm256_mul_ps(sr, spsy));
+			const __m256 r01 = _mm256_mul_ps(sr, cp);
+			const __m256 r02 = _mm256_sub_ps(_mm256_mul_ps(sr, spcy), _mm256_mul_ps(cr, sy));
+			const __m256 r10 = _mm256_sub_ps(_mm256_mul_ps(cr, spsy), _mm256_mul_ps(sr, cy));
+			const __m256 r11 = _mm256_mul_ps(cr, cp);
+			const __m256 r12 = _mm256_add_ps(_mm256_mul_ps(sr, sy), _mm256_mul_ps(cr, spcy));
+			const __m256 r20 = _mm256_mul_ps(cp, sy);
+			const __m256 r21 = _mm256_xor_ps(sp, _mm256_set1_ps(-0.0f));
+			const __m256 r22 = _mm256_mul_ps(cp, cy);
+
+			DirectX::XMFLOAT4X4A * matrices[8];
+			for (unsigned int j = 0; j < 8; j++)
+				matrices[j] = &m_world[batch[j]];
+
+			//Transposed scale * rotation * translation, the translation ends up in the last column
+			_storeRows(_mm256_mul_ps(scaleX, r00), _mm256_mul_ps(scaleY, r10), _mm256_mul_ps(scaleZ, r20), _load(m_position[0], batch, index, contiguous), matrices, 0);
+			_storeRows(_mm256_mul_ps(scaleX, r01), _mm256_mul_ps(scaleY, r11), _mm256_mul_ps(scaleZ, r21), _load(m_position[1], batch, index, contiguous), matrices, 1);
+			_storeRows(_mm256_mul_ps(scaleX, r02), _mm256_mul_ps(scaleY, r12), _mm256_mul_ps(scaleZ, r22), _load(m_position[2], batch, index, contiguous), matrices, 2);
+			const __m256 zero = _mm256_setzero_ps();
+			_storeRows(zero, zero, zero, _mm256_set1_ps(1.0f), matrices, 3);
+		}
+		return batched;
+	}
+};
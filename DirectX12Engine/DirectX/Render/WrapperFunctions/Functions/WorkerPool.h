@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that are started once and then parked between jobs.
+// Run hands out task indices to the workers and the calling thread and returns when all are done.
+class WorkerPool
+{
+public:
+	// threadCount includes the calling thread, 0 uses every hardware thread
+	explicit WorkerPool(const unsigned int & threadCount = 0)
+	{
+		const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		m_threadCount = threadCount ? threadCount : (hardwareThreads ? hardwareThreads : 1);
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (std::thread & thread : m_threads)
+			thread.join();
+	}
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool & operator=(const WorkerPool &) = delete;
+
+	unsigned int GetThreadCount() const
+	{
+		return m_threadCount;
+	}
+
+	// Calls task(index) once for every index below count, the workers are only started on the first job that needs them
+	void Run(const unsigned int & count, const std::function<void(unsigned int)> & task)
+	{
+		if (count == 0)
+			return;
+		if (count == 1 || m_threadCount == 1)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				task(i);
+			return;
+		}
+
+		if (m_threads.empty())
+		{
+			for (unsigned int t = 1; t < m_threadCount; t++)
+				m_threads.emplace_back(&WorkerPool::_work, this);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_task = &task;
+			m_count = count;
+			m_next.store(0);
+			m_busy = static_cast<unsigned int>(m_threads.size());
+			m_job++;
+		}
+		m_wake.notify_all();
+
+		_drain();
+
+		//Every worker has to check in so none of them picks up this job after it is gone
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_busy == 0; });
+		m_task = nullptr;
+	}
+
+private:
+	void _work()
+	{
+		unsigned long long job = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&]() { return m_stop || m_job != job; });
+				if (m_stop)
+					return;
+				job = m_job;
+			}
+
+			_drain();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busy == 0)
+				m_done.notify_one();
+		}
+	}
+
+	void _drain()
+	{
+		for (unsigned int i = m_next++; i < m_count; i = m_next++)
+			(*m_task)(i);
+	}
+
+	unsigned int m_threadCount;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	const std::function<void(unsigned int)> * m_task = nullptr;
+	unsigned int m_count = 0;
+	std::atomic<unsigned int> m_next{ 0 };
+	unsigned int m_busy = 0;
+	unsigned long long m_job = 0;
+	bool m_stop = false;
+};
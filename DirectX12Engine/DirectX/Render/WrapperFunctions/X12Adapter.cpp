@@ -1,5 +1,7 @@
 #include "DirectX12EnginePCH.h"
 #include "X12Adapter.h"
+#include "X12PipelineStateCache.h"
+#include "X12GpuProfiler.h"
 
 
 X12Adapter::X12Adapter()
@@ -31,6 +33,21 @@ HRESULT X12Adapter::CreateDevice(IDXGIAdapter1* adapter, const D3D_FEATURE_LEVEL
 		return hr;
 	}
 	m_incrementalSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	DXGI_ADAPTER_DESC1 adapterDesc{};
+	adapter->GetDesc1(&adapterDesc);
+	const UINT adapterId[] = { adapterDesc.VendorId, adapterDesc.DeviceId, adapterDesc.SubSysId, adapterDesc.Revision };
+
+	//Adapter descriptions are plain ascii
+	const std::wstring description(adapterDesc.Description);
+	SAFE_NEW(m_gpuProfiler, new X12GpuProfiler());
+	if (FAILED(hr = m_gpuProfiler->Create(m_device, RenderingManager::GetInstance()->GetProfiler(), std::string(description.begin(), description.end()))))
+	{
+		return hr;
+	}
+
+	SAFE_NEW(m_pipelineStateCache, new X12PipelineStateCache());
+	hr = m_pipelineStateCache->Init(m_device, ShaderCache::Hash(adapterId, sizeof(adapterId)));
 	return hr;
 }
 
@@ -44,6 +61,16 @@ ID3D12DescriptorHeap* X12Adapter::GetCpuDescriptorHeap() const
 	return m_cpuDescriptorHeap;
 }
 
+X12PipelineStateCache * X12Adapter::GetPipelineStateCache() const
+{
+	return m_pipelineStateCache;
+}
+
+X12GpuProfiler * X12Adapter::GetGpuProfiler() const
+{
+	return m_gpuProfiler;
+}
+
 const SIZE_T& X12Adapter::GetDescriptorHandleIncrementSize() const
 {
 	return m_incrementalSize;
@@ -61,6 +88,16 @@ X12Adapter::Handle X12Adapter::GetNextHandle()
 ULONG X12Adapter::Release()
 {
 	SAFE_RELEASE(m_cpuDescriptorHeap);	
+	if (m_pipelineStateCache)
+	{
+		m_pipelineStateCache->Save();
+		m_pipelineStateCache->Release();
+	}
+	SAFE_DELETE(m_pipelineStateCache);
+
+	if (m_gpuProfiler)
+		m_gpuProfiler->Release();
+	SAFE_DELETE(m_gpuProfiler);
 
 	const ULONG ret = m_device ? m_device->Release() : 0;
 	if (ret == 0)
@@ -2,6 +2,9 @@
 
 #define MAX_DESCRIPTOR_SIZE 1000000
 
+class X12PipelineStateCache;
+class X12GpuProfiler;
+
 class X12Adapter
 {
 struct Handle
@@ -20,6 +23,8 @@ public:
 
 	ID3D12Device * GetDevice() const;
 	ID3D12DescriptorHeap * GetCpuDescriptorHeap() const;
+	X12PipelineStateCache * GetPipelineStateCache() const;
+	X12GpuProfiler * GetGpuProfiler() const;
 
 	const SIZE_T & GetDescriptorHandleIncrementSize() const;
 
@@ -30,6 +35,8 @@ public:
 private:
 	ID3D12Device * m_device = nullptr;
 	ID3D12DescriptorHeap * m_cpuDescriptorHeap = nullptr;
+	X12PipelineStateCache * m_pipelineStateCache = nullptr;
+	X12GpuProfiler * m_gpuProfiler = nullptr;
 
 	SIZE_T m_currentIndex = 0;
 	SIZE_T m_incrementalSize = 0;
@@ -0,0 +1,77 @@
+#include "DirectX12EnginePCH.h"
+#include "X12CommandContext.h"
+
+static_assert(sizeof(ICommandContext::VertexBufferView) == sizeof(D3D12_VERTEX_BUFFER_VIEW), "VertexBufferView has to match D3D12_VERTEX_BUFFER_VIEW");
+static_assert(offsetof(ICommandContext::VertexBufferView, SizeInBytes) == offsetof(D3D12_VERTEX_BUFFER_VIEW, SizeInBytes), "VertexBufferView has to match D3D12_VERTEX_BUFFER_VIEW");
+static_assert(offsetof(ICommandContext::VertexBufferView, StrideInBytes) == offsetof(D3D12_VERTEX_BUFFER_VIEW, StrideInBytes), "VertexBufferView has to match D3D12_VERTEX_BUFFER_VIEW");
+
+X12CommandContext::X12CommandContext(ID3D12Device * device, ID3D12GraphicsCommandList * commandList, FrameStatsRecorder * frameStats)
+	: m_device(device), m_commandList(commandList), m_frameStats(frameStats)
+{
+}
+
+void X12CommandContext::CopyDescriptors(const CpuDescriptor & destination, const CpuDescriptor & source, const uint32_t & count)
+{
+	m_device->CopyDescriptorsSimple(
+		count,
+		{ static_cast<SIZE_T>(destination) },
+		{ static_cast<SIZE_T>(source) },
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	m_frameStats->RecordDescriptorCopies(count);
+}
+
+void X12CommandContext::SetGraphicsRootDescriptorTable(const uint32_t & rootParameterIndex, const GpuDescriptor & table)
+{
+	m_commandList->SetGraphicsRootDescriptorTable(rootParameterIndex, { table });
+}
+
+uint8_t * X12CommandContext::BeginUpload(Resource destination, Resource intermediate, const uint64_t & size)
+{
+	ID3D12Resource * upload = static_cast<ID3D12Resource*>(intermediate);
+	if (size > upload->GetDesc().Width || size > static_cast<ID3D12Resource*>(destination)->GetDesc().Width)
+		return nullptr;
+
+	//Only written by the CPU
+	const D3D12_RANGE readRange{ 0, 0 };
+	void * data = nullptr;
+	if (FAILED(upload->Map(0, &readRange, &data)))
+		return nullptr;
+	return static_cast<uint8_t*>(data);
+}
+
+void X12CommandContext::EndUpload(Resource destination, Resource intermediate, const uint64_t & size)
+{
+	ID3D12Resource * dstResource = static_cast<ID3D12Resource*>(destination);
+	ID3D12Resource * upload = static_cast<ID3D12Resource*>(intermediate);
+	const D3D12_RANGE writtenRange{ 0, static_cast<SIZE_T>(size) };
+	upload->Unmap(0, &writtenRange);
+
+	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(dstResource, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_COPY_DEST));
+	m_commandList->CopyBufferRegion(dstResource, 0, upload, 0, size);
+	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(dstResource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
+
+	m_frameStats->RecordBarriers(2);
+	m_frameStats->RecordUpload(size);
+}
+
+uint64_t X12CommandContext::GetGpuAddress(Resource resource) const
+{
+	return static_cast<ID3D12Resource*>(resource)->GetGPUVirtualAddress();
+}
+
+void X12CommandContext::SetVertexBuffers(const uint32_t & startSlot, const uint32_t & count, const VertexBufferView * views)
+{
+	m_commandList->IASetVertexBuffers(startSlot, count, reinterpret_cast<const D3D12_VERTEX_BUFFER_VIEW*>(views));
+}
+
+void X12CommandContext::DrawInstanced(const uint32_t & vertexCount, const uint32_t & instanceCount, const uint32_t & startVertex, const uint32_t & startInstance)
+{
+	m_commandList->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+	//Triangle lists, like IRender::p_countDraw
+	m_frameStats->RecordDraw(vertexCount, instanceCount, static_cast<uint64_t>(vertexCount / 3) * instanceCount);
+}
+
+ID3D12GraphicsCommandList * X12CommandContext::GetCommandList() const
+{
+	return m_commandList;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Functions/CommandContext.h"
+
+class FrameStatsRecorder;
+
+// Command context on a D3D12 command list. Counts what it records in the frame stats, which forward it to an attached command stream
+class X12CommandContext :
+	public ICommandContext
+{
+public:
+	X12CommandContext(ID3D12Device * device, ID3D12GraphicsCommandList * commandList, FrameStatsRecorder * frameStats);
+	~X12CommandContext() = default;
+
+	void CopyDescriptors(const CpuDescriptor & destination, const CpuDescriptor & source, const uint32_t & count) override;
+	void SetGraphicsRootDescriptorTable(const uint32_t & rootParameterIndex, const GpuDescriptor & table) override;
+
+	uint8_t * BeginUpload(Resource destination, Resource intermediate, const uint64_t & size) override;
+	void EndUpload(Resource destination, Resource intermediate, const uint64_t & size) override;
+	uint64_t GetGpuAddress(Resource resource) const override;
+
+	void SetVertexBuffers(const uint32_t & startSlot, const uint32_t & count, const VertexBufferView * views) override;
+	void DrawInstanced(const uint32_t & vertexCount, const uint32_t & instanceCount, const uint32_t & startVertex, const uint32_t & startInstance) override;
+
+	ID3D12GraphicsCommandList * GetCommandList() const;
+
+private:
+	ID3D12Device * m_device;
+	ID3D12GraphicsCommandList * m_commandList;
+	FrameStatsRecorder * m_frameStats;
+};
@@ -135,6 +135,7 @@ void X12ConstantBuffer::SetGraphicsRootShaderResourceView(ID3D12GraphicsCommandL
 void X12ConstantBuffer::Copy(void const* data, const UINT& sizeOf, const UINT & offset)
 {
 	memcpy(m_constantBufferGPUAddress[p_renderingManager->GetFrameIndex()] + offset, data, sizeOf);
+	p_renderingManager->GetFrameStats()->RecordUpload(sizeOf);
 }
 
 void X12ConstantBuffer::Release()
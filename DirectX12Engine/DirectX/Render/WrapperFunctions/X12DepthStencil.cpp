@@ -109,27 +109,33 @@ ID3D12DescriptorHeap* X12DepthStencil::GetDescriptorHeap() const
 	return this->m_depthStencilDescriptorHeap;
 }
 
-void X12DepthStencil::ClearDepthStencil(ID3D12GraphicsCommandList * commandList) const
+void X12DepthStencil::ClearDepthStencil(ID3D12GraphicsCommandList * commandList, const D3D12_RECT * rects, const UINT & numRects) const
 {
 	commandList->ClearDepthStencilView(
 		m_depthStencilDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
 		D3D12_CLEAR_FLAG_DEPTH,
-		1.0f, 0, 0,
-		nullptr);
+		1.0f, 0, numRects,
+		rects);
 	
 }
 
 void X12DepthStencil::SwitchToDSV(ID3D12GraphicsCommandList * commandList)
 {	
 	if (D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE == m_currentState)
+	{
 		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_depthStencilBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+		p_renderingManager->GetFrameStats()->RecordBarriers();
+	}
 	m_currentState = D3D12_RESOURCE_STATE_DEPTH_WRITE;	
 }
 
 void X12DepthStencil::SwitchToSRV(ID3D12GraphicsCommandList * commandList)
 {
 	if (D3D12_RESOURCE_STATE_DEPTH_WRITE == m_currentState)
+	{
 		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_depthStencilBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		p_renderingManager->GetFrameStats()->RecordBarriers();
+	}
 	m_currentState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
 
 }
@@ -15,7 +15,7 @@ public:
 	ID3D12Resource * GetResource() const;
 	ID3D12DescriptorHeap * GetDescriptorHeap() const;
 
-	void ClearDepthStencil(ID3D12GraphicsCommandList * commandList) const;
+	void ClearDepthStencil(ID3D12GraphicsCommandList * commandList, const D3D12_RECT * rects = nullptr, const UINT & numRects = 0) const;
 
 	void SwitchToDSV(ID3D12GraphicsCommandList * commandList);
 	void SwitchToSRV(ID3D12GraphicsCommandList * commandList);
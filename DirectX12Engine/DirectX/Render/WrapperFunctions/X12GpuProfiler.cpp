@@ -0,0 +1,162 @@
+#include "DirectX12EnginePCH.h"
+#include "X12GpuProfiler.h"
+#include "Functions/FrameProfiler.h"
+#include <algorithm>
+
+HRESULT X12GpuProfiler::Create(ID3D12Device * device, FrameProfiler * profiler, const std::string & name)
+{
+	HRESULT hr = 0;
+	m_profiler = profiler;
+	m_name = name;
+
+	D3D12_QUERY_HEAP_DESC queryHeapDesc{};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = FRAME_BUFFER_COUNT * MAX_ZONES * 2;
+	if (FAILED(hr = device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_queryHeap))))
+	{
+		return hr;
+	}
+	SET_NAME(m_queryHeap, L"Gpu profiler query heap");
+
+	if (FAILED(hr = device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * queryHeapDesc.Count),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&m_readback))))
+	{
+		return hr;
+	}
+	SET_NAME(m_readback, L"Gpu profiler readback");
+
+	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
+	{
+		m_slots[i].ProfilerFrame = FrameProfiler::NO_FRAME;
+		m_slots[i].Count = 0;
+	}
+	return hr;
+}
+
+void X12GpuProfiler::Release()
+{
+	SAFE_RELEASE(m_queryHeap);
+	SAFE_RELEASE(m_readback);
+	m_recording = false;
+}
+
+void X12GpuProfiler::BeginFrame(const UINT & frameSlot, const uint64_t & profilerFrame)
+{
+	if (!m_queryHeap)
+		return;
+	m_currentSlot = frameSlot;
+	m_slots[frameSlot].ProfilerFrame = profilerFrame;
+	m_slots[frameSlot].Count = 0;
+	m_recording = true;
+}
+
+void X12GpuProfiler::Collect(const UINT & frameSlot)
+{
+	FrameSlot & slot = m_slots[frameSlot];
+	const UINT count = slot.Count < MAX_ZONES ? static_cast<UINT>(slot.Count) : MAX_ZONES;
+	if (!m_readback || !m_profiler || !count || slot.ProfilerFrame == FrameProfiler::NO_FRAME)
+		return;
+
+	UINT64 * timestamps = nullptr;
+	const D3D12_RANGE readRange{ sizeof(UINT64) * _query(frameSlot, 0), sizeof(UINT64) * _query(frameSlot, count) };
+	const D3D12_RANGE writeRange{ 0, 0 };
+	if (FAILED(m_readback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps))))
+	{
+		return;
+	}
+
+	//One calibration per queue, the ticks of each queue are moved onto the CPU clock on their own
+	ID3D12CommandQueue * queue = nullptr;
+	FrameProfiler::Calibration calibration;
+	uint32_t track = 0;
+	for (UINT i = 0; i < count; i++)
+	{
+		const Zone & zone = slot.Zones[i];
+		if (!zone.Ended)
+			continue;
+
+		if (zone.Queue != queue)
+		{
+			queue = zone.Queue;
+			UINT64 cpuTicks = 0;
+			LARGE_INTEGER cpuFrequency{};
+			calibration = FrameProfiler::Calibration();
+			if (FAILED(queue->GetTimestampFrequency(&calibration.Frequency)) ||
+				FAILED(queue->GetClockCalibration(&calibration.GpuTicks, &cpuTicks)) ||
+				!QueryPerformanceFrequency(&cpuFrequency))
+			{
+				queue = nullptr;
+				continue;
+			}
+			//steady_clock counts the performance counter on Windows
+			const UINT64 frequency = static_cast<UINT64>(cpuFrequency.QuadPart);
+			calibration.CpuTime = static_cast<int64_t>((cpuTicks / frequency) * 1000000000ull + (cpuTicks % frequency) * 1000000000ull / frequency);
+
+			track = _track(queue);
+		}
+
+		const UINT query = _query(frameSlot, i);
+		m_profiler->AddGpuZone(
+			slot.ProfilerFrame,
+			zone.Name,
+			track,
+			FrameProfiler::ToCpuTime(calibration, timestamps[query]),
+			FrameProfiler::ToCpuTime(calibration, timestamps[query + 1]));
+	}
+
+	m_readback->Unmap(0, &writeRange);
+	slot.ProfilerFrame = FrameProfiler::NO_FRAME;
+	slot.Count = 0;
+}
+
+UINT X12GpuProfiler::BeginZone(ID3D12GraphicsCommandList * commandList, const std::string & name)
+{
+	if (!m_recording)
+		return NO_ZONE;
+
+	FrameSlot & slot = m_slots[m_currentSlot];
+	const UINT zone = slot.Count++;
+	if (zone >= MAX_ZONES)
+		return NO_ZONE;
+
+	slot.Zones[zone].Name = name;
+	slot.Zones[zone].Queue = nullptr;
+	slot.Zones[zone].Ended = false;
+	commandList->EndQuery(m_queryHeap, D3D12_QUERY_TYPE_TIMESTAMP, _query(m_currentSlot, zone));
+	return zone;
+}
+
+void X12GpuProfiler::EndZone(ID3D12GraphicsCommandList * commandList, const UINT & zone, ID3D12CommandQueue * commandQueue)
+{
+	if (zone >= MAX_ZONES || !m_recording)
+		return;
+
+	const UINT query = _query(m_currentSlot, zone);
+	commandList->EndQuery(m_queryHeap, D3D12_QUERY_TYPE_TIMESTAMP, query + 1);
+	commandList->ResolveQueryData(m_queryHeap, D3D12_QUERY_TYPE_TIMESTAMP, query, 2, m_readback, sizeof(UINT64) * query);
+
+	m_slots[m_currentSlot].Zones[zone].Queue = commandQueue;
+	m_slots[m_currentSlot].Zones[zone].Ended = true;
+}
+
+uint32_t X12GpuProfiler::_track(ID3D12CommandQueue * queue)
+{
+	auto it = std::find(m_queues.begin(), m_queues.end(), queue);
+	const size_t index = it - m_queues.begin();
+	if (it == m_queues.end())
+		m_queues.push_back(queue);
+
+	const D3D12_COMMAND_QUEUE_DESC desc = queue->GetDesc();
+	const char * type = desc.Type == D3D12_COMMAND_LIST_TYPE_COMPUTE ? " compute " : desc.Type == D3D12_COMMAND_LIST_TYPE_COPY ? " copy " : " direct ";
+	return m_profiler->GetGpuTrack(m_name + type + std::to_string(index));
+}
+
+UINT X12GpuProfiler::_query(const UINT & frameSlot, const UINT & zone) const
+{
+	return (frameSlot * MAX_ZONES + zone) * 2;
+}
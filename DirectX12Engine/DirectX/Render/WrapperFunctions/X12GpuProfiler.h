@@ -0,0 +1,62 @@
+#pragma once
+#include "Template/IX12Object.h"
+#include <atomic>
+
+class FrameProfiler;
+
+// GPU zones of one device for the FrameProfiler. Every frame in flight has its own range of timestamp queries,
+// a zone resolves its two queries on the command list that wrote them and the frame is read back once its fence has passed.
+class X12GpuProfiler :
+	public IX12Object
+{
+public:
+	static const UINT MAX_ZONES = 128;	//Per frame
+	static const UINT NO_ZONE = UINT_MAX;
+
+	X12GpuProfiler() = default;
+	~X12GpuProfiler() = default;
+
+	HRESULT Create(ID3D12Device * device, FrameProfiler * profiler, const std::string & name);
+	void Release() override;
+
+	// Starts recording into the queries of the frame slot, call Collect for the slot first
+	void BeginFrame(const UINT & frameSlot, const uint64_t & profilerFrame);
+	// Hands the zones of the last frame recorded in the slot to the profiler, the GPU has to be done with it
+	void Collect(const UINT & frameSlot);
+
+	// Returns NO_ZONE when the frame is full or no frame has begun, EndZone ignores it
+	UINT BeginZone(ID3D12GraphicsCommandList * commandList, const std::string & name);
+	// The queue the command list is executed on, its clock is what the timestamps count
+	void EndZone(ID3D12GraphicsCommandList * commandList, const UINT & zone, ID3D12CommandQueue * commandQueue);
+
+private:
+	struct Zone
+	{
+		std::string Name;
+		ID3D12CommandQueue * Queue;
+		bool Ended;
+	};
+
+	struct FrameSlot
+	{
+		uint64_t ProfilerFrame;
+		std::atomic<UINT> Count;
+		Zone Zones[MAX_ZONES];
+	};
+
+	FrameProfiler * m_profiler = nullptr;
+	std::string m_name;
+
+	ID3D12QueryHeap * m_queryHeap = nullptr;
+	ID3D12Resource * m_readback = nullptr;
+
+	FrameSlot m_slots[FRAME_BUFFER_COUNT];
+	UINT m_currentSlot = 0;
+	bool m_recording = false;
+
+	//Queues in the order they were first seen, numbers their tracks
+	std::vector<ID3D12CommandQueue*> m_queues;
+
+	uint32_t _track(ID3D12CommandQueue * queue);
+	UINT _query(const UINT & frameSlot, const UINT & zone) const;
+};
@@ -0,0 +1,246 @@
+#include "DirectX12EnginePCH.h"
+#include "X12PipelineStateCache.h"
+#include "Functions/PipelineStateHash.h"
+
+const char * const X12PipelineStateCache::LIBRARY_EXTENSION = ".psl";
+
+static_assert(PipelineStateHash::MAX_RENDER_TARGETS == D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT, "PipelineStateHash has to serialize every render target");
+static_assert(PipelineStateHash::PER_INSTANCE_DATA == D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, "PipelineStateHash has to know instance data");
+
+HRESULT X12PipelineStateCache::Init(ID3D12Device * device, const uint64_t & adapterKey, const std::string & directory)
+{
+	HRESULT hr = 0;
+	m_device = device;
+	m_directory = directory;
+	//One library per adapter, two adapters in the same machine do not overwrite each other
+	m_libraryKey = ShaderCache::Hash(&PipelineStateHash::FORMAT_VERSION, sizeof(PipelineStateHash::FORMAT_VERSION), ShaderCache::Hash("PipelineLibrary"));
+	m_libraryKey = ShaderCache::Hash(&adapterKey, sizeof(adapterKey), m_libraryKey);
+
+	ID3D12Device1 * device1 = nullptr;
+	if (FAILED(m_device->QueryInterface(IID_PPV_ARGS(&device1))))
+	{
+		return hr;
+	}
+
+	if (ShaderCache::Load(m_directory, m_libraryKey, m_libraryData, LIBRARY_EXTENSION))
+	{
+		//Fails when the driver or the adapter changed since it was written
+		if (FAILED(device1->CreatePipelineLibrary(m_libraryData.data(), m_libraryData.size(), IID_PPV_ARGS(&m_library))))
+		{
+			SAFE_RELEASE(m_library);
+			m_libraryData.clear();
+		}
+	}
+	if (!m_library)
+	{
+		if (FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&m_library))))
+		{
+			SAFE_RELEASE(m_library);
+		}
+	}
+	SAFE_RELEASE(device1);
+
+	return hr;
+}
+
+HRESULT X12PipelineStateCache::CreateRootSignature(const void * blob, const SIZE_T & size, ID3D12RootSignature ** rootSignature)
+{
+	HRESULT hr = 0;
+	const uint64_t key = PipelineStateHash::HashRootSignature(blob, size);
+
+	auto it = m_rootSignatures.find(key);
+	if (it != m_rootSignatures.end())
+	{
+		it->second->AddRef();
+		*rootSignature = it->second;
+		return hr;
+	}
+
+	ID3D12RootSignature * newRootSignature = nullptr;
+	if (FAILED(hr = m_device->CreateRootSignature(0, blob, size, IID_PPV_ARGS(&newRootSignature))))
+	{
+		return hr;
+	}
+
+	m_rootSignatures.emplace(key, newRootSignature);
+	m_rootSignatureKeys.emplace(newRootSignature, key);
+	newRootSignature->AddRef();
+	*rootSignature = newRootSignature;
+	return hr;
+}
+
+HRESULT X12PipelineStateCache::CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC & desc, ID3D12PipelineState ** pipelineState)
+{
+	HRESULT hr = 0;
+	const uint64_t rootSignatureKey = _rootSignatureKey(desc.pRootSignature);
+	const std::vector<unsigned char> serialized = PipelineStateHash::SerializeGraphics(desc, rootSignatureKey);
+	const uint64_t key = PipelineStateHash::Hash(serialized);
+
+	if ((*pipelineState = _find(key, serialized)))
+	{
+		return hr;
+	}
+
+	//Root signatures that did not come from here are only known by address, that does not carry over to the next run
+	const BOOL persistent = m_library && !desc.CachedPSO.pCachedBlob && m_rootSignatureKeys.count(desc.pRootSignature);
+	const std::wstring name = _name(key);
+	ID3D12PipelineState * newPipelineState = nullptr;
+	if (persistent && SUCCEEDED(m_library->LoadGraphicsPipeline(name.c_str(), &desc, IID_PPV_ARGS(&newPipelineState))))
+	{
+		m_loadedCount++;
+	}
+	else
+	{
+		SAFE_RELEASE(newPipelineState);
+		if (FAILED(hr = m_device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&newPipelineState))))
+		{
+			return hr;
+		}
+		m_createdCount++;
+		if (persistent && SUCCEEDED(m_library->StorePipeline(name.c_str(), newPipelineState)))
+		{
+			m_libraryChanged = TRUE;
+		}
+	}
+
+	_add(key, serialized, newPipelineState);
+	*pipelineState = newPipelineState;
+	return hr;
+}
+
+HRESULT X12PipelineStateCache::CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC & desc, ID3D12PipelineState ** pipelineState)
+{
+	HRESULT hr = 0;
+	const uint64_t rootSignatureKey = _rootSignatureKey(desc.pRootSignature);
+	const std::vector<unsigned char> serialized = PipelineStateHash::SerializeCompute(desc, rootSignatureKey);
+	const uint64_t key = PipelineStateHash::Hash(serialized);
+
+	if ((*pipelineState = _find(key, serialized)))
+	{
+		return hr;
+	}
+
+	const BOOL persistent = m_library && !desc.CachedPSO.pCachedBlob && m_rootSignatureKeys.count(desc.pRootSignature);
+	const std::wstring name = _name(key);
+	ID3D12PipelineState * newPipelineState = nullptr;
+	if (persistent && SUCCEEDED(m_library->LoadComputePipeline(name.c_str(), &desc, IID_PPV_ARGS(&newPipelineState))))
+	{
+		m_loadedCount++;
+	}
+	else
+	{
+		SAFE_RELEASE(newPipelineState);
+		if (FAILED(hr = m_device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&newPipelineState))))
+		{
+			return hr;
+		}
+		m_createdCount++;
+		if (persistent && SUCCEEDED(m_library->StorePipeline(name.c_str(), newPipelineState)))
+		{
+			m_libraryChanged = TRUE;
+		}
+	}
+
+	_add(key, serialized, newPipelineState);
+	*pipelineState = newPipelineState;
+	return hr;
+}
+
+HRESULT X12PipelineStateCache::Save()
+{
+	HRESULT hr = 0;
+	if (!m_library || !m_libraryChanged)
+	{
+		return hr;
+	}
+
+	std::vector<char> data(m_library->GetSerializedSize());
+	if (FAILED(hr = m_library->Serialize(data.data(), data.size())))
+	{
+		return hr;
+	}
+
+	CreateDirectoryA(m_directory.c_str(), nullptr);
+	if (!ShaderCache::Store(m_directory, m_libraryKey, data.data(), data.size(), LIBRARY_EXTENSION))
+	{
+		return E_FAIL;
+	}
+	m_libraryChanged = FALSE;
+	return hr;
+}
+
+const UINT & X12PipelineStateCache::GetSharedCount() const
+{
+	return m_sharedCount;
+}
+
+const UINT & X12PipelineStateCache::GetLoadedCount() const
+{
+	return m_loadedCount;
+}
+
+const UINT & X12PipelineStateCache::GetCreatedCount() const
+{
+	return m_createdCount;
+}
+
+void X12PipelineStateCache::Release()
+{
+	for (auto & pipelineState : m_pipelineStates)
+	{
+		SAFE_RELEASE(pipelineState.second.State);
+	}
+	for (auto & rootSignature : m_rootSignatures)
+	{
+		SAFE_RELEASE(rootSignature.second);
+	}
+	m_pipelineStates.clear();
+	m_rootSignatures.clear();
+	m_rootSignatureKeys.clear();
+
+	SAFE_RELEASE(m_library);
+	m_libraryData.clear();
+	m_libraryChanged = FALSE;
+	m_device = nullptr;
+}
+
+uint64_t X12PipelineStateCache::_rootSignatureKey(const ID3D12RootSignature * rootSignature) const
+{
+	auto it = m_rootSignatureKeys.find(rootSignature);
+	if (it != m_rootSignatureKeys.end())
+	{
+		return it->second;
+	}
+	return reinterpret_cast<uint64_t>(rootSignature);
+}
+
+ID3D12PipelineState * X12PipelineStateCache::_find(const uint64_t & key, const std::vector<unsigned char> & desc)
+{
+	auto it = m_pipelineStates.find(key);
+	if (it == m_pipelineStates.end() || it->second.Desc != desc)
+	{
+		return nullptr;
+	}
+
+	m_sharedCount++;
+	it->second.State->AddRef();
+	return it->second.State;
+}
+
+void X12PipelineStateCache::_add(const uint64_t & key, const std::vector<unsigned char> & desc, ID3D12PipelineState * pipelineState)
+{
+	//A hash collision keeps the first pipeline, the second one is still handed out but not shared
+	if (m_pipelineStates.count(key))
+	{
+		return;
+	}
+	pipelineState->AddRef();
+	m_pipelineStates.emplace(key, PipelineState{ desc, pipelineState });
+}
+
+std::wstring X12PipelineStateCache::_name(const uint64_t & key)
+{
+	wchar_t name[32];
+	swprintf_s(name, L"%016llx", static_cast<unsigned long long>(key));
+	return name;
+}
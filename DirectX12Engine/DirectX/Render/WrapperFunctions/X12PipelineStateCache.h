@@ -0,0 +1,59 @@
+#pragma once
+#include <unordered_map>
+
+// Pipeline states and root signatures keyed by a canonical hash of their description.
+// Identical descriptions share one object, and pipelines are kept in a pipeline library on disk so the next run loads them instead of compiling.
+// Every object handed out has a reference of its own the caller releases. Each adapter keeps one for its device.
+class X12PipelineStateCache
+{
+public:
+	static const char * const LIBRARY_EXTENSION;
+
+	X12PipelineStateCache() = default;
+	~X12PipelineStateCache() = default;
+
+	// Loads the library of the adapter from disk. A missing, broken or out of date library starts empty,
+	// devices without pipeline libraries only share objects within the run
+	HRESULT Init(ID3D12Device * device, const uint64_t & adapterKey, const std::string & directory = ShaderCache::DEFAULT_DIRECTORY);
+
+	HRESULT CreateRootSignature(const void * blob, const SIZE_T & size, ID3D12RootSignature ** rootSignature);
+	HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC & desc, ID3D12PipelineState ** pipelineState);
+	HRESULT CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC & desc, ID3D12PipelineState ** pipelineState);
+
+	// Writes the library if pipelines were added to it since it was loaded
+	HRESULT Save();
+
+	const UINT & GetSharedCount() const;
+	const UINT & GetLoadedCount() const;
+	const UINT & GetCreatedCount() const;
+
+	void Release();
+
+private:
+	struct PipelineState
+	{
+		std::vector<unsigned char> Desc;
+		ID3D12PipelineState * State;
+	};
+
+	ID3D12Device * m_device = nullptr;
+	ID3D12PipelineLibrary * m_library = nullptr;
+	//The library reads from this for as long as it lives
+	std::vector<char> m_libraryData;
+	std::string m_directory;
+	uint64_t m_libraryKey = 0;
+	BOOL m_libraryChanged = FALSE;
+
+	std::unordered_map<uint64_t, ID3D12RootSignature*> m_rootSignatures;
+	std::unordered_map<const ID3D12RootSignature*, uint64_t> m_rootSignatureKeys;
+	std::unordered_map<uint64_t, PipelineState> m_pipelineStates;
+
+	UINT m_sharedCount = 0;
+	UINT m_loadedCount = 0;
+	UINT m_createdCount = 0;
+
+	uint64_t _rootSignatureKey(const ID3D12RootSignature * rootSignature) const;
+	ID3D12PipelineState * _find(const uint64_t & key, const std::vector<unsigned char> & desc);
+	void _add(const uint64_t & key, const std::vector<unsigned char> & desc, ID3D12PipelineState * pipelineState);
+	static std::wstring _name(const uint64_t & key);
+};
@@ -161,7 +161,10 @@ void X12RenderTargetView::SwitchToRTV(ID3D12GraphicsCommandList * commandList)
 	const UINT frameIndex = p_renderingManager->GetFrameIndex();;
 
 	if (D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE == m_currentState[frameIndex])
+	{
 		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[frameIndex], D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET));
+		p_renderingManager->GetFrameStats()->RecordBarriers();
+	}
 	m_currentState[frameIndex] = D3D12_RESOURCE_STATE_RENDER_TARGET;
 	
 }
@@ -171,7 +174,10 @@ void X12RenderTargetView::SwitchToSRV(ID3D12GraphicsCommandList * commandList)
 	const UINT frameIndex = p_renderingManager->GetFrameIndex();;
 
 	if (D3D12_RESOURCE_STATE_RENDER_TARGET == m_currentState[frameIndex])
+	{
 		commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		p_renderingManager->GetFrameStats()->RecordBarriers();
+	}
 	m_currentState[frameIndex] = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
 }
 
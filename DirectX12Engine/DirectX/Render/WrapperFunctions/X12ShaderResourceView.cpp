@@ -65,11 +65,13 @@ HRESULT X12ShaderResourceView::CreateShaderResourceView(const UINT& width, const
 void X12ShaderResourceView::BeginCopy(ID3D12GraphicsCommandList * commandList) const
 {
 	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_resource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+	p_renderingManager->GetFrameStats()->RecordBarriers();
 }
 
 void X12ShaderResourceView::EndCopy(ID3D12GraphicsCommandList * commandList) const
 {
 	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+	p_renderingManager->GetFrameStats()->RecordBarriers();
 }
 
 void X12ShaderResourceView::CopySubresource(ID3D12GraphicsCommandList * commandList, const UINT & dstIndex, ID3D12Resource* resource) const
@@ -100,6 +102,7 @@ void X12ShaderResourceView::CopySubresource(ID3D12GraphicsCommandList * commandL
 	}
 	
 	commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(resource, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+	p_renderingManager->GetFrameStats()->RecordBarriers(2);
 }
 
 void X12ShaderResourceView::CopyDescriptorHeap()
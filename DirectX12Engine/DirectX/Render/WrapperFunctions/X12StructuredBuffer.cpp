@@ -53,6 +53,7 @@ HRESULT X12StructuredBuffer::Create(const std::wstring & name, const UINT& size)
 void X12StructuredBuffer::Copy(void* data, const UINT& size, const UINT& offset)
 {
 	memcpy(m_resourceAddress[p_renderingManager->GetFrameIndex()] + offset, data, size);
+	p_renderingManager->GetFrameStats()->RecordUpload(size);
 }
 
 void X12StructuredBuffer::SetGraphicsRootShaderResourceView(ID3D12GraphicsCommandList* commandList,
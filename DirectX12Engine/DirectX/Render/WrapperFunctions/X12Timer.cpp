@@ -11,18 +11,18 @@ X12Timer::~X12Timer()
 {
 }
 
-HRESULT X12Timer::CreateTimer(const UINT& numberOfIndexes, ID3D12Device * device, const D3D12_QUERY_HEAP_TYPE& heapType)
+HRESULT X12Timer::CreateTimer(const UINT& zoneCount, ID3D12Device * device, const D3D12_QUERY_HEAP_TYPE& heapType)
 {
 
 	m_pDevice = device ? device : RenderingManager::GetInstance()->GetMainAdapter()->GetDevice();
 	HRESULT hr = 0;
 
-	m_timerCount = numberOfIndexes;
+	m_zoneCount = zoneCount;
 
 	D3D12_QUERY_HEAP_DESC queryHeapDesc;
 	queryHeapDesc.Type = heapType;
 	queryHeapDesc.NodeMask = 0;
-	queryHeapDesc.Count = m_timerCount * 2;
+	queryHeapDesc.Count = FRAME_BUFFER_COUNT * m_zoneCount * 2;
 
 	if (SUCCEEDED(hr = m_pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_queryHeap))))
 	{
@@ -30,7 +30,7 @@ HRESULT X12Timer::CreateTimer(const UINT& numberOfIndexes, ID3D12Device * device
 		ZeroMemory(&resourceDesc, sizeof(resourceDesc));
 		resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 		resourceDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
-		resourceDesc.Width = sizeof(TimeStamp) * m_timerCount;
+		resourceDesc.Width = sizeof(TimeStamp) * FRAME_BUFFER_COUNT * m_zoneCount;
 		resourceDesc.Height = 1;
 		resourceDesc.DepthOrArraySize = 1;
 		resourceDesc.MipLevels = 1;
@@ -58,20 +58,16 @@ HRESULT X12Timer::CreateTimer(const UINT& numberOfIndexes, ID3D12Device * device
 		{
 			m_queryResourceCPU->SetName(L"queryResourceCPU_");
 		}
+	}
 
-		heapProp.Type = D3D12_HEAP_TYPE_DEFAULT;
-		if (SUCCEEDED(hr = m_pDevice->CreateCommittedResource(
-			&heapProp,
-			D3D12_HEAP_FLAG_NONE,
-			&resourceDesc,
-			D3D12_RESOURCE_STATE_COPY_SOURCE,
-			nullptr,
-			IID_PPV_ARGS(&m_queryResourceGPU))
-		))
-		{
-			m_queryResourceGPU->SetName(L"queryResourceGPU_");
-		}
+	for (UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
+	{
+		m_started[i].assign(m_zoneCount, FALSE);
+		m_stopped[i].assign(m_zoneCount, FALSE);
+		m_resolved[i].assign(m_zoneCount, FALSE);
 	}
+	m_lastTimeStamps.assign(m_zoneCount, TimeStamp());
+	m_statistics.assign(m_zoneCount, TimerStatistics());
 
 	return hr;
 }
@@ -80,12 +76,15 @@ void X12Timer::Release()
 {
 	SAFE_RELEASE(m_queryHeap);
 	SAFE_RELEASE(m_queryResourceCPU);
-	SAFE_RELEASE(m_queryResourceGPU);
 }
 
 void X12Timer::SetCommandQueue(ID3D12CommandQueue* commandQueue)
 {
 	this->m_pCommandQueue = commandQueue;
+	//The frequency of a queue does not change, asking once keeps it off the frame path
+	m_frequency = 0;
+	if (m_pCommandQueue)
+		m_pCommandQueue->GetTimestampFrequency(&m_frequency);
 }
 
 ID3D12CommandQueue* X12Timer::GetCommandQueue() const
@@ -93,125 +92,129 @@ ID3D12CommandQueue* X12Timer::GetCommandQueue() const
 	return this->m_pCommandQueue;
 }
 
-void X12Timer::Start(ID3D12GraphicsCommandList* commandList)
+void X12Timer::Collect(const UINT& frameSlot)
 {
-	if (m_active)
+	if (!m_queryResourceCPU || frameSlot >= FRAME_BUFFER_COUNT)
+		return;
+
+	std::vector<BOOL> & resolved = m_resolved[frameSlot];
+	if (std::find(resolved.begin(), resolved.end(), TRUE) == resolved.end())
 		return;
-	_start(commandList, m_counter);
+
+	TimeStamp* mapMem = nullptr;
+	const D3D12_RANGE readRange{ sizeof(TimeStamp) * m_zoneCount * frameSlot, sizeof(TimeStamp) * m_zoneCount * (frameSlot + 1) };
+	const D3D12_RANGE writeRange{ 0, 0 };
+	if (SUCCEEDED(m_queryResourceCPU->Map(0, &readRange, (void**)&mapMem)))
+	{
+		const TimeStamp * stamps = mapMem + m_zoneCount * frameSlot;
+		const double timestampToMs = m_frequency ? 1000.0 / static_cast<double>(m_frequency) : 0.0;
+		for (UINT i = 0; i < m_zoneCount; i++)
+		{
+			if (!resolved[i])
+				continue;
+			m_lastTimeStamps[i] = stamps[i];
+			if (m_frequency && stamps[i].Stop >= stamps[i].Start)
+				m_statistics[i].AddSample((stamps[i].Stop - stamps[i].Start) * timestampToMs);
+		}
+		m_queryResourceCPU->Unmap(0, &writeRange);
+	}
+
+	resolved.assign(m_zoneCount, FALSE);
 }
 
-void X12Timer::Stop(ID3D12GraphicsCommandList* commandList)
+void X12Timer::BeginFrame(const UINT& frameSlot)
 {
-	if (!m_active)
+	if (frameSlot >= FRAME_BUFFER_COUNT)
 		return;
-	_stop(commandList, m_counter);
+	m_currentSlot = frameSlot;
+	m_started[frameSlot].assign(m_zoneCount, FALSE);
+	m_stopped[frameSlot].assign(m_zoneCount, FALSE);
+	m_resolved[frameSlot].assign(m_zoneCount, FALSE);
 }
 
-void X12Timer::ResolveQueryToCpu(ID3D12GraphicsCommandList* commandList) const
+void X12Timer::Start(ID3D12GraphicsCommandList* commandList, const UINT & zone)
 {
-	if (m_counter >= m_timerCount)
+	if (zone >= m_zoneCount || m_started[m_currentSlot][zone])
 		return;
-
-	commandList->ResolveQueryData(
-		m_queryHeap,
-		D3D12_QUERY_TYPE_TIMESTAMP,
-		m_counter * 2,
-		2,
-		m_queryResourceCPU,
-		sizeof(TimeStamp) * m_counter
-	);
+	m_started[m_currentSlot][zone] = TRUE;
+	commandList->EndQuery(m_queryHeap, D3D12_QUERY_TYPE_TIMESTAMP, _query(m_currentSlot, zone));
 }
 
-void X12Timer::CountTimer()
+void X12Timer::Stop(ID3D12GraphicsCommandList* commandList, const UINT & zone)
 {
-	m_counter++;
+	if (zone >= m_zoneCount || !m_started[m_currentSlot][zone] || m_stopped[m_currentSlot][zone])
+		return;
+	m_stopped[m_currentSlot][zone] = TRUE;
+	commandList->EndQuery(m_queryHeap, D3D12_QUERY_TYPE_TIMESTAMP, _query(m_currentSlot, zone) + 1);
 }
 
-X12Timer::TimeStamp X12Timer::GetTimeStamp(const UINT& index) const
+void X12Timer::ResolveQueryToCpu(ID3D12GraphicsCommandList* commandList)
 {
-	TimeStamp p{};
+	const std::vector<BOOL> & stopped = m_stopped[m_currentSlot];
+	std::vector<BOOL> & resolved = m_resolved[m_currentSlot];
 
-	TimeStamp* mapMem = nullptr;
-	const D3D12_RANGE readRange{ sizeof(p) * index, sizeof(p) * (index + 1) };
-	const D3D12_RANGE writeRange{ 0, 0 };
-	if (SUCCEEDED(m_queryResourceCPU->Map(0, &readRange, (void**)&mapMem)))
+	//One resolve per run of neighbouring zones, zones that were never stopped hold no timestamps to resolve
+	UINT zone = 0;
+	while (zone < m_zoneCount)
 	{
-		mapMem += index;
-		p = *mapMem;
-		m_queryResourceCPU->Unmap(0, &writeRange);
+		if (!stopped[zone] || resolved[zone])
+		{
+			zone++;
+			continue;
+		}
+		const UINT first = zone;
+		while (zone < m_zoneCount && stopped[zone] && !resolved[zone])
+			resolved[zone++] = TRUE;
+
+		commandList->ResolveQueryData(
+			m_queryHeap,
+			D3D12_QUERY_TYPE_TIMESTAMP,
+			_query(m_currentSlot, first),
+			(zone - first) * 2,
+			m_queryResourceCPU,
+			sizeof(UINT64) * _query(m_currentSlot, first)
+		);
 	}
-
-	return p;
 }
 
-const UINT& X12Timer::GetCount() const
+const X12Timer::TimeStamp& X12Timer::GetTimeStamp(const UINT& zone) const
 {
-	return m_counter;
+	return m_lastTimeStamps[zone];
 }
 
-void X12Timer::PrintToFile(const char* path) const
+TimerStatistics::Summary X12Timer::GetStatistics(const UINT& zone) const
 {
-	std::ofstream out(path);
-
-	if (out)
-	{
-		for (UINT i = 0; i < m_timerCount; i++)
-		{
-			const TimeStamp stamp = GetTimeStamp(i);
-
-			if (m_pCommandQueue)
-			{
-				UINT64 queueFreq;
-				m_pCommandQueue->GetTimestampFrequency(&queueFreq);
-				const double timestampToMs = (1.0 / queueFreq) * 1000.0;
-
-				out << "Start\t" << stamp.Start << "\tEnd:\t" << stamp.Stop << "\tTot:\t" << stamp.Stop - stamp.Start << "\tdt:\t" << (stamp.Stop - stamp.Start) * timestampToMs << " ms" <<  std::endl;
-
-
-			}
-			else
-				out << "Start\t" << stamp.Start << "\tEnd:\t" << stamp.Stop << "\tTot:\t" << stamp.Stop - stamp.Start << std::endl;
-
-		}
-		out.close();
-	}	
+	return m_statistics[zone].GetSummary();
 }
 
-void X12Timer::ExportToMagnusTimelineCreator(const char* path) const
+void X12Timer::ResetStatistics()
 {
-	if (!m_pCommandQueue)
-		throw "No CommandQueue";
+	for (UINT i = 0; i < m_zoneCount; i++)
+		m_statistics[i].Reset();
+}
 
+const UINT& X12Timer::GetZoneCount() const
+{
+	return m_zoneCount;
+}
 
+void X12Timer::PrintToFile(const char* path) const
+{
 	std::ofstream out(path);
+
 	if (out)
 	{
-		for (UINT i = 0; i < m_timerCount; i++)
+		out << "Zone\tCount\tMin ms\tAvg ms\tMax ms\tP99 ms" << std::endl;
+		for (UINT i = 0; i < m_zoneCount; i++)
 		{
-			const TimeStamp stamp = GetTimeStamp(i);
-
-			UINT64 queueFreq;
-			m_pCommandQueue->GetTimestampFrequency(&queueFreq);
-			const double timestampToMs = (1.0 / queueFreq) * 1000.0;
-
-			out << stamp.Start << "\t" << stamp.Stop << "\t" << (stamp.Stop - stamp.Start) * timestampToMs << std::endl;
+			const TimerStatistics::Summary summary = m_statistics[i].GetSummary();
+			out << i << "\t" << summary.Count << "\t" << summary.Min << "\t" << summary.Avg << "\t" << summary.Max << "\t" << summary.P99 << std::endl;
 		}
 		out.close();
 	}
 }
 
-void X12Timer::_start(ID3D12GraphicsCommandList* commandList, const UINT& timeStampIndex)
+UINT X12Timer::_query(const UINT& frameSlot, const UINT& zone) const
 {
-	if (timeStampIndex >= m_timerCount)
-		return;
-	m_active = true;
-	commandList->EndQuery(m_queryHeap, D3D12_QUERY_TYPE_TIMESTAMP, timeStampIndex * 2);
-}
-
-void X12Timer::_stop(ID3D12GraphicsCommandList* commandList, const UINT& timeStampIndex)
-{
-	if (timeStampIndex >= m_timerCount)
-		return;
-	m_active = false;
-	commandList->EndQuery(m_queryHeap, D3D12_QUERY_TYPE_TIMESTAMP, timeStampIndex * 2 + 1);
+	return (frameSlot * m_zoneCount + zone) * 2;
 }
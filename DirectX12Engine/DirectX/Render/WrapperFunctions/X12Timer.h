@@ -1,7 +1,10 @@
 #pragma once
 #include "Template/IX12Object.h"
+#include "Functions/TimerStatistics.h"
 
 
+// GPU time of a few zones per frame. Every frame in flight resolves into its own part of one readback ring,
+// which is mapped once when the fence of the frame has passed and streamed into the statistics of each zone.
 class X12Timer :
 	public IX12Object
 {
@@ -16,39 +19,55 @@ public:
 	X12Timer();
 	~X12Timer();
 
-	HRESULT CreateTimer(const UINT & numberOfIndexes, ID3D12Device * device = nullptr, const D3D12_QUERY_HEAP_TYPE & heapType = D3D12_QUERY_HEAP_TYPE_TIMESTAMP);
+	HRESULT CreateTimer(const UINT & zoneCount = 1, ID3D12Device * device = nullptr, const D3D12_QUERY_HEAP_TYPE & heapType = D3D12_QUERY_HEAP_TYPE_TIMESTAMP);
 	void Release() override;
 
+	// The queue the timed command lists run on, its frequency converts the ticks
 	void SetCommandQueue(ID3D12CommandQueue * commandQueue);
 	ID3D12CommandQueue * GetCommandQueue() const;
 
-	void Start(ID3D12GraphicsCommandList * commandList);
-	void Stop(ID3D12GraphicsCommandList * commandList);
-	void ResolveQueryToCpu(ID3D12GraphicsCommandList* commandList) const;
-	void CountTimer();
+	// Streams the last frame recorded in the slot into the statistics, the GPU has to be done with it
+	void Collect(const UINT & frameSlot);
+	// Starts recording into the slot, call Collect for the slot first
+	void BeginFrame(const UINT & frameSlot);
 
-	TimeStamp GetTimeStamp(const UINT & index) const;
+	void Start(ID3D12GraphicsCommandList * commandList, const UINT & zone = 0);
+	void Stop(ID3D12GraphicsCommandList * commandList, const UINT & zone = 0);
+	// Resolves every zone stopped this frame into the readback ring
+	void ResolveQueryToCpu(ID3D12GraphicsCommandList* commandList);
 
-	const UINT & GetCount() const;
+	// The last collected stamps of the zone
+	const TimeStamp & GetTimeStamp(const UINT & zone = 0) const;
+	// In milliseconds
+	TimerStatistics::Summary GetStatistics(const UINT & zone = 0) const;
+	void ResetStatistics();
 
+	const UINT & GetZoneCount() const;
+
+	// Writes the statistics of every zone, not meant for the frame path
 	void PrintToFile(const char * path) const;
-	void ExportToMagnusTimelineCreator(const char * path) const;
 
 private:
-	void _start(ID3D12GraphicsCommandList * commandList, const UINT & timeStampIndex);
-	void _stop(ID3D12GraphicsCommandList * commandList, const UINT & timeStampIndex);
+	UINT _query(const UINT & frameSlot, const UINT & zone) const;
 
 private:
-	UINT m_counter = 0;
 	ID3D12CommandQueue * m_pCommandQueue = nullptr;
+	UINT64 m_frequency = 0;
 
 	ID3D12Device*		m_pDevice = nullptr;
 	ID3D12QueryHeap*	m_queryHeap = nullptr;
 	ID3D12Resource*		m_queryResourceCPU = nullptr;
-	ID3D12Resource*		m_queryResourceGPU = nullptr;
 
-	bool	m_active = false;
-	UINT	m_timerCount = 0;
+	UINT	m_zoneCount = 0;
+	UINT	m_currentSlot = 0;
+
+	//Per frame slot, the zones started, stopped and resolved in it
+	std::vector<BOOL> m_started[FRAME_BUFFER_COUNT];
+	std::vector<BOOL> m_stopped[FRAME_BUFFER_COUNT];
+	std::vector<BOOL> m_resolved[FRAME_BUFFER_COUNT];
+
+	std::vector<TimeStamp> m_lastTimeStamps;
+	std::vector<TimerStatistics> m_statistics;
 
 };
 
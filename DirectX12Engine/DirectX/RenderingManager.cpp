@@ -10,6 +10,10 @@
 #include "Render/ReflectionPass.h"
 
 #include "Render/WrapperFunctions/X12Timer.h"
+#include "Render/WrapperFunctions/X12PipelineStateCache.h"
+#include "Objects/Light/LightRegistry.h"
+#include "Render/WrapperFunctions/X12GpuProfiler.h"
+#include "Render/WrapperFunctions/Functions/FrameProfiler.h"
 
 
 RenderingManager * RenderingManager::thisRenderingManager = nullptr;
@@ -33,13 +37,24 @@ RenderingManager* RenderingManager::GetPointerInstance()
 	return thisRenderingManager;
 }
 
-HRESULT RenderingManager::Init(const Window * window, const BOOL & enableDebugLayer)
+HRESULT RenderingManager::Init(const Window * window, const BOOL & enableDebugLayer, const BOOL & useWarpAdapter)
 {
 	HRESULT hr;
 	IDXGIAdapter1 * adapter = nullptr, * adapter1 = nullptr;
 	IDXGIFactory4 * dxgiFactory = nullptr;
 
+	SAFE_NEW(m_profiler, new FrameProfiler());
+	m_profiler->SetThreadName("Main");
+	SAFE_NEW(m_frameStats, new FrameStatsRecorder());
+	m_deferredStatsPass = m_frameStats->RegisterPass("Deferred");
 
+	//The shaders compile on the shader threads while the device and the passes are created, each pass waits for its own in _initShaders
+	GeometryPass::QueueShaders();
+	ShadowPass::QueueShaders();
+	DeferredRender::QueueShaders();
+	ParticlePass::QueueShaders();
+	SSAOPass::QueueShaders();
+	ReflectionPass::QueueShaders();
 
 	if (enableDebugLayer)
 	{
@@ -49,12 +64,17 @@ HRESULT RenderingManager::Init(const Window * window, const BOOL & enableDebugLa
 			m_debugLayer->EnableDebugLayer();
 		}
 	}
-	if (SUCCEEDED(hr = this->_checkAdapterSupport(adapter, dxgiFactory, 0)))
+	if (useWarpAdapter || FAILED(hr = this->_checkAdapterSupport(adapter, dxgiFactory, 0)))
+	{
+		hr = this->_getWarpAdapter(adapter, dxgiFactory);
+	}
+	if (SUCCEEDED(hr))
 	{	
 		SAFE_NEW(m_mainAdapter, new X12Adapter());
 		if (SUCCEEDED(hr = m_mainAdapter->CreateDevice(adapter)))
 		{
-			if (SUCCEEDED(hr = this->_checkAdapterSupport(adapter1, dxgiFactory, 1)))
+			//Copying particles between a software and a hardware adapter costs more than it saves
+			if (!m_useWarpAdapter && SUCCEEDED(hr = this->_checkAdapterSupport(adapter1, dxgiFactory, 1)))
 			{
 				SAFE_NEW(m_secondaryAdapter, new X12Adapter());
 				if (FAILED(hr = m_secondaryAdapter->CreateDevice(adapter1)))
@@ -97,6 +117,9 @@ HRESULT RenderingManager::Init(const Window * window, const BOOL & enableDebugLa
 				return Window::CreateError(hr);
 			}
 			
+			SAFE_NEW(m_lightRegistry, new LightRegistry());
+			m_lightRegistry->Reserve(MAX_LIGHTS, 16);
+
 			SAFE_NEW(m_geometryPass, new GeometryPass(this, *window));
 			if (FAILED(hr = m_geometryPass->Init()))
 			{
@@ -127,6 +150,18 @@ HRESULT RenderingManager::Init(const Window * window, const BOOL & enableDebugLa
 			{
 				return Window::CreateError(hr);
 			}
+			ShaderCreator::FinishQueue();
+			_printShaderCompileTimes();
+
+			//Pipelines compiled this run are loaded from disk the next
+			X12PipelineStateCache * pipelineStateCache = m_mainAdapter->GetPipelineStateCache();
+			pipelineStateCache->Save();
+			if (m_secondaryAdapter)
+				m_secondaryAdapter->GetPipelineStateCache()->Save();
+			PRINT("Pipelines: created " + std::to_string(pipelineStateCache->GetCreatedCount()) + 
+				" loaded " + std::to_string(pipelineStateCache->GetLoadedCount()) + 
+				" shared " + std::to_string(pipelineStateCache->GetSharedCount()));
+			NEW_LINE;
 		}		
 	}
 
@@ -166,20 +201,35 @@ HRESULT RenderingManager::_updatePipeline(const Camera & camera, const float & d
 {
 	HRESULT hr = S_OK;
 
-	if (FAILED(hr = _waitForPreviousFrame(TRUE, TRUE)))
+	const uint64_t profilerFrame = m_profiler->BeginFrame();
 	{
-		return hr;
+		FrameProfiler::Scope scope(m_profiler, "Wait for frame");
+		if (FAILED(hr = _waitForPreviousFrame(TRUE, TRUE)))
+		{
+			return hr;
+		}
 	}
 
-	if (m_timers[SHADOW_PASS]->GetCount() >= TIMER_COUNT)
+	//The GPU is done with the frame that used this slot, its zones can be read back before the slot is reused
+	X12Adapter * adapters[] = { m_mainAdapter, m_secondaryAdapter };
+	for (X12Adapter * adapter : adapters)
 	{
-		m_timers[SHADOW_PASS]->ExportToMagnusTimelineCreator("ShadowPass.txt");
+		if (!adapter)
+			continue;
+		adapter->GetGpuProfiler()->Collect(m_frameIndex);
+		adapter->GetGpuProfiler()->BeginFrame(m_frameIndex, profilerFrame);
 	}
-
-	if (m_timers[PARTICLE_PASS]->GetCount() >= TIMER_COUNT)
+	for (X12Timer * timer : m_timers)
 	{
-		m_timers[PARTICLE_PASS]->ExportToMagnusTimelineCreator("ParticlePass.txt");
+		if (!timer)
+			continue;
+		timer->Collect(m_frameIndex);
+		timer->BeginFrame(m_frameIndex);
 	}
+	FrameProfiler::Scope scope(m_profiler, "Update pipeline");
+	CommandStream * commandStream = m_frameStats->GetCommandStream();
+	if (commandStream)
+		commandStream->SetThreadPass("Main");
 
 	if (FAILED(hr = m_commandAllocator[m_frameIndex]->Reset()))
 	{
@@ -199,6 +249,14 @@ HRESULT RenderingManager::_updatePipeline(const Camera & camera, const float & d
 
 	ResourceDescriptorHeap(m_commandList[m_frameIndex]);
 
+	const UINT gpuZone = m_mainAdapter->GetGpuProfiler()->BeginZone(m_commandList[m_frameIndex], "Frame");
+
+	{
+		//The passes read the world matrices on their threads, every drawable that changed is rebuilt here first
+		FrameProfiler::Scope transformScope(m_profiler, "Transforms");
+		Drawable::UpdateTransforms();
+	}
+
 	m_particlePass->ThreadUpdate(camera, deltaTime);
 	m_shadowPass->ThreadUpdate(camera, deltaTime);
 	
@@ -224,8 +282,21 @@ HRESULT RenderingManager::_updatePipeline(const Camera & camera, const float & d
 	const float clearColor[] = { 1.0f, 0.0f, 1.0f, 1.0f };
 	m_commandList[m_frameIndex]->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
 
-	m_deferredPass->Update(camera, deltaTime);
-	m_deferredPass->Draw();
+	{
+		FrameProfiler::Scope deferredScope(m_profiler, "Deferred");
+		const int64_t begin = FrameProfiler::Now();
+		if (commandStream)
+			commandStream->SetThreadPass("Deferred");
+		m_deferredPass->Update(camera, deltaTime);
+		m_deferredPass->Draw();
+		if (commandStream)
+			commandStream->SetThreadPass("Main");
+		m_frameStats->AddPassTime(m_deferredStatsPass, FrameProfiler::Now() - begin);
+	}
+	{
+		FrameProfiler::Scope particleScope(m_profiler, "Particles");
+		m_geometryPass->DrawParticles(m_commandList[m_frameIndex], rtvHandle);
+	}
 	//---------------------------------------------------------------------
 
 	m_commandList[m_frameIndex]->ResourceBarrier(1,
@@ -233,6 +304,8 @@ HRESULT RenderingManager::_updatePipeline(const Camera & camera, const float & d
 			m_renderTargets[m_frameIndex],
 			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
+	m_frameStats->RecordBarriers(2);
+	m_mainAdapter->GetGpuProfiler()->EndZone(m_commandList[m_frameIndex], gpuZone, m_commandQueue);
 	m_commandList[m_frameIndex]->Close();
 
 	return hr;
@@ -256,6 +329,8 @@ HRESULT RenderingManager::_flush(const Camera & camera, const float & deltaTime)
 
 
 	_clear();
+	m_profiler->EndFrame();
+	m_frameStats->EndFrame();
 	return hr;
 }
 
@@ -275,6 +350,7 @@ void RenderingManager::_clear()
 	m_particlePass->Clear();
 	m_ssaoPass->Clear();
 	m_reflectionPass->Clear();
+	m_lightRegistry->Clear();
 
 	m_copyOffset = 0;
 }
@@ -319,6 +395,8 @@ void RenderingManager::Release(const BOOL & waitForFrames, const BOOL & reportMe
 	m_frameIndex = 0;
 	m_rtvDescriptorSize = 0;
 
+	ShaderCreator::FinishQueue();
+
 	m_geometryPass->KillThread();
 	m_geometryPass->Release();
 	SAFE_DELETE(m_geometryPass);
@@ -343,6 +421,8 @@ void RenderingManager::Release(const BOOL & waitForFrames, const BOOL & reportMe
 	m_ssaoPass->Release();
 	SAFE_DELETE(m_ssaoPass);
 
+	SAFE_DELETE(m_lightRegistry);
+
 	if (m_secondaryAdapter)
 		m_secondaryAdapter->Release();
 	SAFE_DELETE(m_secondaryAdapter);
@@ -368,6 +448,8 @@ void RenderingManager::Release(const BOOL & waitForFrames, const BOOL & reportMe
 	}
 	SAFE_DELETE(m_mainAdapter);
 
+	SAFE_DELETE(m_profiler);
+	SAFE_DELETE(m_frameStats);
 }
 
 void RenderingManager::WaitForFrames()
@@ -384,6 +466,11 @@ void RenderingManager::UnsafeInit(const Window* window, const bool& enableDebugT
 	this->Init(window, enableDebugTools);
 }
 
+const BOOL& RenderingManager::GetUseWarpAdapter() const
+{
+	return m_useWarpAdapter;
+}
+
 X12Adapter* RenderingManager::GetSecondAdapter() const
 {
 	return m_secondaryAdapter;
@@ -469,6 +556,26 @@ ReflectionPass* RenderingManager::GetReflectionPass() const
 	return this->m_reflectionPass;
 }
 
+LightRegistry* RenderingManager::GetLightRegistry() const
+{
+	return this->m_lightRegistry;
+}
+
+FrameProfiler* RenderingManager::GetProfiler() const
+{
+	return this->m_profiler;
+}
+
+FrameStatsRecorder* RenderingManager::GetFrameStats() const
+{
+	return this->m_frameStats;
+}
+
+BOOL RenderingManager::ExportProfile(const std::string& path) const
+{
+	return m_profiler && m_profiler->ExportChromeTrace(path);
+}
+
 void RenderingManager::NewTimer(const UINT& index)
 {
 	SAFE_NEW(m_timers[index], new X12Timer());
@@ -552,6 +659,7 @@ D3D12_GPU_DESCRIPTOR_HANDLE RenderingManager::CopyToGpuDescriptorHeap(
 		destHandle,
 		descriptorHandle,
 		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	m_frameStats->RecordDescriptorCopies(numDescriptors);
 	
 	m_copyOffset += m_resourceIncrementalSize * numDescriptors;
 
@@ -635,6 +743,22 @@ HRESULT RenderingManager::_checkAdapterSupport(IDXGIAdapter1*& adapter, IDXGIFac
 	return hr;
 }
 
+HRESULT RenderingManager::_getWarpAdapter(IDXGIAdapter1*& adapter, IDXGIFactory4*& dxgiFactory)
+{
+	HRESULT hr = 0;
+	SAFE_RELEASE(adapter);
+
+	if (!dxgiFactory)
+		if (FAILED(hr = CreateDXGIFactory1(IID_PPV_ARGS(&dxgiFactory))))
+			return hr;
+
+	if (SUCCEEDED(hr = dxgiFactory->EnumWarpAdapter(IID_PPV_ARGS(&adapter))))
+	{
+		m_useWarpAdapter = TRUE;
+	}
+	return hr;
+}
+
 HRESULT RenderingManager::_createCommandQueue()
 {
 	HRESULT hr = 0;
@@ -790,3 +914,19 @@ HRESULT RenderingManager::_createCbvSrvUavDescriptorHeap()
 
 	return hr;
 }
+
+void RenderingManager::_printShaderCompileTimes() const
+{
+	const ShaderCompileQueue<ShaderCreator::CompiledShader> & queue = ShaderCreator::GetQueue();
+	const std::vector<ShaderCompileQueue<ShaderCreator::CompiledShader>::Timing> timings = queue.GetTimings();
+	for (size_t i = 0; i < timings.size(); i++)
+	{
+		PRINT("Shader " + timings[i].Key + ": " + std::to_string(timings[i].Milliseconds) + " ms");
+		NEW_LINE;
+	}
+	PRINT("Shaders: " + std::to_string(timings.size()) + 
+		" serial " + std::to_string(queue.GetSerialMilliseconds()) + 
+		" ms wall " + std::to_string(queue.GetWallMilliseconds()) + 
+		" ms saved " + std::to_string(queue.GetSavedMilliseconds()) + " ms");
+	NEW_LINE;
+}
@@ -3,6 +3,7 @@
 #include <d3d12.h>
 #include <dxgi1_5.h>
 #include "Render/WrapperFunctions/X12Adapter.h"
+#include "Render/WrapperFunctions/Functions/FrameStats.h"
 
 class SSAOPass;
 class DeferredRender;
@@ -13,14 +14,14 @@ class ReflectionPass;
 class Camera;
 class X12Fence;
 class X12Timer;
+class LightRegistry;
+class FrameProfiler;
 
 #define PASS_FENCES 10
 
 #define SHADOW_PASS 0
 #define PARTICLE_PASS 1
 
-#define TIMER_COUNT 100
-
 const unsigned int FRAME_BUFFER_COUNT = 3;
 class RenderingManager
 {
@@ -33,7 +34,8 @@ public:
 	static RenderingManager * GetInstance();
 	static RenderingManager * GetPointerInstance();
 
-	HRESULT Init(const Window * window, const BOOL & enableDebugLayer = FALSE);
+	// The WARP software adapter runs the whole pipeline on machines without a GPU, it is also used when no hardware adapter supports D3D12
+	HRESULT Init(const Window * window, const BOOL & enableDebugLayer = FALSE, const BOOL & useWarpAdapter = FALSE);
 	void Flush(const Camera * camera, const float & deltaTime, const BOOL & present = TRUE);
 	void Present() const;
 	void Release(const BOOL & waitForFrames = TRUE, const BOOL & reportMemoryLeaks = TRUE);
@@ -43,6 +45,7 @@ public:
 
 	X12Adapter * GetMainAdapter() const;
 	X12Adapter * GetSecondAdapter() const;
+	const BOOL & GetUseWarpAdapter() const;
 	IDXGISwapChain4 * GetSwapChain() const;
 	ID3D12GraphicsCommandList * GetCommandList() const;
 	ID3D12CommandQueue * GetCommandQueue() const;
@@ -63,6 +66,13 @@ public:
 	ParticlePass * GetParticlePass() const;
 	SSAOPass * GetSSAOPass() const;
 	ReflectionPass * GetReflectionPass() const;
+	LightRegistry * GetLightRegistry() const;
+	FrameProfiler * GetProfiler() const;
+	// Counters and pass times of the last frames, the current frame is counted into it by the passes
+	FrameStatsRecorder * GetFrameStats() const;
+
+	// Writes the frames the profiler still holds as Chrome trace_event JSON
+	BOOL ExportProfile(const std::string & path) const;
 
 	void NewTimer(const UINT & index);
 	void DeleteTimer(const UINT & index);
@@ -82,6 +92,7 @@ private:
 	   
 	X12Adapter	*				m_mainAdapter = nullptr;
 	X12Adapter	*				m_secondaryAdapter = nullptr;
+	BOOL						m_useWarpAdapter = FALSE;
 
 	IDXGISwapChain4 *			m_swapChain = nullptr;
 	
@@ -109,12 +120,14 @@ private:
 	HRESULT _waitForPreviousFrame(const BOOL & updateFrame = TRUE, const BOOL & waitOnCpu = FALSE);
 
 	HRESULT _checkAdapterSupport(IDXGIAdapter1 *& adapter, IDXGIFactory4 *& dxgiFactory, const UINT & adapterIndex = 0) const;
+	HRESULT _getWarpAdapter(IDXGIAdapter1 *& adapter, IDXGIFactory4 *& dxgiFactory);
 	HRESULT _createCommandQueue();
 	HRESULT _createSwapChain(const Window & window, IDXGIFactory4 * dxgiFactory);
 	HRESULT _createRenderTargetDescriptorHeap();
 	HRESULT _createCommandAllocators();
 	HRESULT _createCommandList();
 	HRESULT _createFenceAndFenceEvent();
+	void _printShaderCompileTimes() const;
 	
 	GeometryPass *	m_geometryPass = nullptr;
 	ShadowPass *	m_shadowPass = nullptr;
@@ -122,6 +135,10 @@ private:
 	ParticlePass * m_particlePass = nullptr;
 	SSAOPass * m_ssaoPass = nullptr;
 	ReflectionPass * m_reflectionPass = nullptr;
+	LightRegistry * m_lightRegistry = nullptr;
+	FrameProfiler * m_profiler = nullptr;
+	FrameStatsRecorder * m_frameStats = nullptr;
+	UINT m_deferredStatsPass = FrameStatsRecorder::NO_PASS;
 
 	SIZE_T m_copyOffset = 0;
 	SIZE_T m_resourceIncrementalSize = 0;
@@ -8,16 +8,30 @@ struct VS_OUTPUT
 cbuffer LIGHT_BUFFER : register(b0, space2)
 {
     float4 CameraPosition;
-    uint4 NumberOfLights;
+    uint4 NumberOfLights; //X = lights in the table Y = directional lights at the end of the table
+    float4x4 ViewMatrix;
+    uint4 ClusterSize; //X = tiles x Y = tiles y Z = depth slices
+    float4 ClusterDepth; //X = slice scale Y = slice bias
 }
 
 StructuredBuffer<LIGHT_STRUCT> LIGHT_STRUCT_BUFFER : register(t0, space2);
+StructuredBuffer<uint2> CLUSTER_RANGES : register(t1, space2); //X = offset Y = count
+StructuredBuffer<uint> LIGHT_INDICES : register(t2, space2);
+
+uint ClusterIndex(float2 uv, float4 worldPos)
+{
+    const float viewDepth = mul(worldPos, ViewMatrix).z;
+    const uint slice = (uint) clamp(floor(log(max(viewDepth, 1e-4f)) * ClusterDepth.x + ClusterDepth.y), 0.0f, (float) (ClusterSize.z - 1));
+    const uint2 tile = min((uint2) (saturate(uv) * float2(ClusterSize.xy)), ClusterSize.xy - 1);
+    return (slice * ClusterSize.y + tile.y) * ClusterSize.x + tile.x;
+}
 
 struct SHADOW_LIGHT
 {
-    uint4 size;
+    uint4 size; //X = faces Y = the faces are cascades
     float4 lightValues;
     float4x4 viewProjection[6];
+    float4 atlasRect[6]; //XY = tile offset ZW = tile size, in atlas uv
 };
 cbuffer SHADOW_BUFFER : register(b0, space1)
 {
@@ -25,7 +39,7 @@ cbuffer SHADOW_BUFFER : register(b0, space1)
 }
 StructuredBuffer<SHADOW_LIGHT> SHADOW_LIGHT_BUFFER : register(t0, space1);
 
-Texture2DArray shadowMap[] : register(t1, space1);
+Texture2D shadowAtlas : register(t1, space1);
 
 
 SamplerState defaultSampler : register(s0);
@@ -59,9 +73,23 @@ float4 main(VS_OUTPUT input) : SV_Target
        
     float4 finalColor = float4(0, 0, 0, 1);
    
-    for (uint i = 0; i < NumberOfLights.x; i++)
+    uint i;
+    //The pass picks the variant with only the light types that are in the scene
+#ifdef DIRECTIONAL_LIGHTS
+    for (i = 0; i < NumberOfLights.y; i++)
+    {
+        finalColor += DirectionalLightCalculations(LIGHT_STRUCT_BUFFER[NumberOfLights.x - NumberOfLights.y + i], 
+                                        albedo, 
+                                        normal);
+    }
+#endif
+
+#ifdef POINT_LIGHTS
+    //Only point lights are clustered
+    const uint2 cluster = CLUSTER_RANGES[ClusterIndex(input.uv.xy, worldPos)];
+    for (i = 0; i < cluster.y; i++)
     {
-        finalColor += SingelLightCalculations(LIGHT_STRUCT_BUFFER[i], 
+        finalColor += PointLightCalculations(LIGHT_STRUCT_BUFFER[LIGHT_INDICES[cluster.x + i]], 
                                         CameraPosition,
                                         worldPos, 
                                         albedo, 
@@ -69,21 +97,27 @@ float4 main(VS_OUTPUT input) : SV_Target
                                         metallic, 
                                         specular);
     }
+#endif
 
+    const float atlasTexelSize = TexelSize(shadowAtlas);
     int divider = 1;
     for (uint k = 0; k < values.x; k++)
     {
         float currentShadowCoeff = 0;
         for (uint j = 0; j < SHADOW_LIGHT_BUFFER[k].size.x; j++)
         {
-            divider += ShadowCalculations(shadowMap[k],
-            j,
+            const int hit = ShadowAtlasCalculations(shadowAtlas,
+            SHADOW_LIGHT_BUFFER[k].atlasRect[j],
             shadowSampler,
-            TexelSize(shadowMap[k]),
+            atlasTexelSize,
             FragmentLightPos(worldPos, SHADOW_LIGHT_BUFFER[k].viewProjection[j]),
             currentShadowCoeff,
             1);
+            divider += hit;
 
+            //Cascades are sorted near to far, the first one holding the fragment has the most texels
+            if (hit && SHADOW_LIGHT_BUFFER[k].size.y)
+                break;
         }
         currentShadowCoeff *= saturate(SHADOW_LIGHT_BUFFER[k].lightValues.x);
         shadowCoeff += currentShadowCoeff;
@@ -1,4 +1,3 @@
-
 struct VS_OUTPUT
 {
     float4 position : SV_POSITION;
@@ -6,25 +5,16 @@ struct VS_OUTPUT
     float4 UV : TEXCORD;
 };
 
-struct PS_OUTPUT
+cbuffer EMITTER : register(b1)
 {
-    float4 worldPos : SV_target0;
-    float4 albedo : SV_target1;
-    float4 normal : SV_target2;
-    float4 metallic : SV_target3;
-};
+    uint TextureIndex;
+}
 
 SamplerState defaultSampler : register(s0);
-Texture2DArray textureArray : register(t0);
+Texture2DArray EmitterTextures[] : register(t0);
 
-PS_OUTPUT main(VS_OUTPUT input)
+// Blended over the lit frame, the alpha of the texture is the coverage
+float4 main(VS_OUTPUT input) : SV_TARGET
 {
-    PS_OUTPUT output = (PS_OUTPUT) 0;
-
-    output.worldPos = input.worldPos;
-    output.albedo = textureArray.Sample(defaultSampler, input.UV.xyz);
-    output.normal = float4(0, 0, 0, 0);
-    output.metallic = float4(0, 0, 0, 0);
-
-    return output;
-}
\ No newline at end of file
+    return EmitterTextures[TextureIndex].Sample(defaultSampler, input.UV.xyz);
+}
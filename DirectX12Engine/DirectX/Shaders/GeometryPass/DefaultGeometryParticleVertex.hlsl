@@ -1,8 +1,9 @@
-
 struct VS_INPUT
 {
-    float4 position : POSITION;
-    float4 UV : TEXCORD;
+    float3 position : POSITION;
+    float2 size : SIZE;
+    uint textureIndex : TEXTURE_INDEX;
+    uint vertexId : SV_VertexID;
 };
 
 struct VS_OUTPUT
@@ -18,13 +19,28 @@ cbuffer CAMERA_BUFFER : register(b0)
     float4x4 ViewProjection;
 }
 
+// lowerLeft, upperLeft, upperRight, lowerRight, lowerLeft, upperRight
+static const float2 QuadCorners[6] =
+{
+    float2(-1, -1), float2(-1, 1), float2(1, 1),
+    float2(1, -1), float2(-1, -1), float2(1, 1)
+};
+
 VS_OUTPUT main(VS_INPUT input)
 {
     VS_OUTPUT output = (VS_OUTPUT) 0;
 
-    output.position = mul(input.position, ViewProjection);
-    output.worldPos = input.position;
-    output.UV = input.UV;
+    const float2 corner = QuadCorners[input.vertexId % 6];
+
+    float3 dir = normalize(input.position - CameraPos.xyz);
+    float3 right = normalize(cross(dir, float3(0, 1, 0)));
+    float3 up = normalize(cross(dir, right));
+
+    float4 worldPos = float4(input.position + (right * corner.x * input.size.x) + (up * corner.y * input.size.y), 1);
+
+    output.position = mul(worldPos, ViewProjection);
+    output.worldPos = worldPos;
+    output.UV = float4(corner.x * 0.5f + 0.5f, 0.5f - corner.y * 0.5f, input.textureIndex, 0);
 
     return output;
-}
\ No newline at end of file
+}
@@ -26,7 +26,11 @@ PS_OUTPUT main(HS_OUTPUT input)
     PS_OUTPUT output = (PS_OUTPUT) 0;
 
 	float4 albedo = BindlessMap[input.textureIndex.x + 0].Sample(defaultSampler, input.texCord.xy);
+#ifdef NORMAL_MAP
 	float4 normal = float4(normalize(input.normal.xyz + mul((2.0f * BindlessMap[input.textureIndex.x + 1].Sample(defaultSampler, input.texCord.xy).xyz - 1.0f), input.TBN)), 0);
+#else
+	float4 normal = float4(normalize(input.normal.xyz), 0);
+#endif
 	float4 metallic = BindlessMap[input.textureIndex.x + 2].Sample(defaultSampler, input.texCord.xy);
 
 
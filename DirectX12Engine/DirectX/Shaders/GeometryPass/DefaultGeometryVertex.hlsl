@@ -7,6 +7,7 @@ struct VS_INPUT
 
     float4x4 worldMatrix : WORLD;
 	uint4 textureIndex : TEXTURE_INDEX;
+    float tessFactor : TESS_FACTOR;
 };
 
 
@@ -19,7 +20,9 @@ struct VS_OUTPUT
     float4 texCord : TEXCORD;
 	uint4 textureIndex : TEXTURE_INDEX;
 
+#ifdef TESSELLATION
     float tessFactor : TESSFACTOR;
+#endif
 };
 
 cbuffer CAMERA_BUFFER : register(b0)
@@ -28,10 +31,11 @@ cbuffer CAMERA_BUFFER : register(b0)
     float4x4 ViewProjection;
 }
 
-#define MAX_TESS 128
-#define MIN_TESS 128
-#define MIN_TESS_DIST 2
-#define MAX_TESS_DIST 10
+#ifdef DISPLACEMENT
+SamplerState defaultSampler : register(s0);
+
+Texture2D BindlessMap[] : register(t0);
+#endif
 
 VS_OUTPUT main(VS_INPUT input)
 {
@@ -48,11 +52,19 @@ VS_OUTPUT main(VS_INPUT input)
     output.TBN = TBN;
     output.texCord = input.texCord;
 
-    float distanceToCamera = length(CameraPos - output.worldPos);
+#ifdef DISPLACEMENT
+    //What the domain shader does at a tessellation factor of 1, so dropping the tessellation does not pop
+    float height = length(BindlessMap[input.textureIndex.x + 3].SampleLevel(defaultSampler, input.texCord.xy, 0).rgb);
+    height = clamp(height, 0.0f, 1.0f);
+
+    output.worldPos += lerp(0, 0.01f, height) * output.normal;
+    output.pos = mul(output.worldPos, ViewProjection);
+#endif
 
-    float tess = saturate((MIN_TESS_DIST - distanceToCamera) / (MIN_TESS_DIST - MAX_TESS_DIST));
-    output.tessFactor = tess * (MAX_TESS - MIN_TESS);
-    output.tessFactor = MAX_TESS - output.tessFactor;
+#ifdef TESSELLATION
+    //Picked per instance on the CPU from the size of the instance on screen
+    output.tessFactor = input.tessFactor;
+#endif
 	output.textureIndex = input.textureIndex;
 
     return output;
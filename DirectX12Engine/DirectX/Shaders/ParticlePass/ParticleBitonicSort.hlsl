@@ -0,0 +1,83 @@
+cbuffer ParticleInfo : register(b0)
+{
+    float4      CameraPosition;
+    float4x4    WorldMatrix;
+    uint4       ParticleCount; //X = particles packed in ParticleBuffer
+};
+
+struct ParticleInstance
+{
+    float3 Position;
+    float2 Size;
+    uint TextureIndex;
+};
+
+StructuredBuffer<uint2> EmitterRanges : register(t0); //X = offset Y = count
+
+RWStructuredBuffer<ParticleInstance> InstanceBuffer : register(u0);
+RWStructuredBuffer<ParticleInstance> SortedInstanceBuffer : register(u1);
+
+// One group sorts one emitter range, MAX_PARTICLES keys fill the 32kb of groupshared memory
+#define SORT_SIZE 4096
+#define THREAD_GROUP_SIZE 1024
+
+groupshared uint2 SortData[SORT_SIZE]; //X = key Y = index
+
+bool Greater(uint2 a, uint2 b)
+{
+    return a.x > b.x || (a.x == b.x && a.y > b.y);
+}
+
+[numthreads(THREAD_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    const uint2 range = EmitterRanges[groupId.x];
+    const uint count = min(range.y, SORT_SIZE);
+
+    uint sortSize = 2;
+    while (sortSize < count)
+        sortSize <<= 1;
+
+    uint i;
+    for (i = groupIndex; i < sortSize; i += THREAD_GROUP_SIZE)
+    {
+        if (i < count)
+        {
+            const float3 toCamera = InstanceBuffer[range.x + i].Position - CameraPosition.xyz;
+            //Inverted so the farthest particle ends up first
+            SortData[i] = uint2(~asuint(dot(toCamera, toCamera)), i);
+        }
+        else
+            SortData[i] = uint2(0xffffffff, i);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint k = 2; k <= sortSize; k <<= 1)
+    {
+        for (uint j = k >> 1; j > 0; j >>= 1)
+        {
+            for (i = groupIndex; i < sortSize; i += THREAD_GROUP_SIZE)
+            {
+                const uint partner = i ^ j;
+                if (partner > i)
+                {
+                    const uint2 a = SortData[i];
+                    const uint2 b = SortData[partner];
+                    if (Greater(a, b) == ((i & k) == 0))
+                    {
+                        SortData[i] = b;
+                        SortData[partner] = a;
+                    }
+                }
+            }
+            GroupMemoryBarrierWithGroupSync();
+        }
+    }
+
+    for (i = groupIndex; i < count; i += THREAD_GROUP_SIZE)
+        SortedInstanceBuffer[range.x + i] = InstanceBuffer[range.x + SortData[i].y];
+
+    //Ranges larger than the groupshared memory keep their tail unsorted
+    for (i = count + groupIndex; i < range.y; i += THREAD_GROUP_SIZE)
+        SortedInstanceBuffer[range.x + i] = InstanceBuffer[range.x + i];
+}
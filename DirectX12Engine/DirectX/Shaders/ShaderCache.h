@@ -0,0 +1,218 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+// Content addressed cache of compiled shader bytecode.
+// The key covers the source, every file it includes, the target, the entry point, the flags and the compiler version,
+// so editing an include like LightCalculations.hlsli gives every shader using it a new key.
+// Only uses the standard library so the hashing and the file format can be checked without the shader compiler.
+namespace ShaderCache
+{
+	static const char * const DEFAULT_DIRECTORY = "ShaderCache";
+	static const uint32_t FILE_MAGIC = 0x41434853;	//"SHCA"
+	static const uint32_t FILE_VERSION = 1;
+
+	struct FileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t Key;
+		uint64_t DataHash;
+		uint64_t DataSize;
+	};
+
+	// FNV-1a, continues from hash so several pieces can be chained into one key
+	inline uint64_t Hash(const void * data, const size_t & size, uint64_t hash = 14695981039346656037ull)
+	{
+		const unsigned char * bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	inline uint64_t Hash(const std::string & text, const uint64_t & hash = 14695981039346656037ull)
+	{
+		//The length keeps "ab" + "c" and "a" + "bc" apart
+		const uint64_t size = text.size();
+		return Hash(text.data(), text.size(), Hash(&size, sizeof(size), hash));
+	}
+
+	inline bool ReadFile(const std::string & path, std::string & contents)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	inline std::string Directory(const std::string & path)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	// Files named by #include, in order, comments skipped. Both "" and <> are returned,
+	// the standard include handler looks for both next to the including file
+	inline std::vector<std::string> ParseIncludes(const std::string & source)
+	{
+		std::vector<std::string> includes;
+		bool lineStart = true;
+		for (size_t i = 0; i < source.size(); i++)
+		{
+			const char c = source[i];
+			if (c == '/' && i + 1 < source.size() && source[i + 1] == '/')
+			{
+				i = source.find('\n', i);
+				if (i == std::string::npos)
+					break;
+				lineStart = true;
+				continue;
+			}
+			if (c == '/' && i + 1 < source.size() && source[i + 1] == '*')
+			{
+				i = source.find("*/", i + 2);
+				if (i == std::string::npos)
+					break;
+				i++;
+				continue;
+			}
+			if (c == '\n')
+			{
+				lineStart = true;
+				continue;
+			}
+			if (c == ' ' || c == '\t' || c == '\r')
+				continue;
+
+			if (c == '#' && lineStart)
+			{
+				size_t j = i + 1;
+				while (j < source.size() && (source[j] == ' ' || source[j] == '\t'))
+					j++;
+				if (source.compare(j, 7, "include") == 0)
+				{
+					j += 7;
+					while (j < source.size() && (source[j] == ' ' || source[j] == '\t'))
+						j++;
+					if (j < source.size() && (source[j] == '"' || source[j] == '<'))
+					{
+						const char close = source[j] == '"' ? '"' : '>';
+						const size_t end = source.find_first_of(std::string(1, close) + "\n", j + 1);
+						if (end != std::string::npos && source[end] == close)
+							includes.push_back(source.substr(j + 1, end - j - 1));
+					}
+				}
+				i = source.find('\n', i);
+				if (i == std::string::npos)
+					break;
+				lineStart = true;
+				continue;
+			}
+			lineStart = false;
+		}
+		return includes;
+	}
+
+	// Hash of the file and, depth first, every file it includes. Each file is counted once so include cycles end.
+	// Missing includes are hashed by name, the compiler reports them
+	inline uint64_t HashSourceTree(const std::string & path, std::unordered_set<std::string> & visited, uint64_t hash)
+	{
+		if (!visited.insert(path).second)
+			return hash;
+
+		std::string source;
+		if (!ReadFile(path, source))
+			return Hash("missing:" + path, hash);
+
+		hash = Hash(source, hash);
+		const std::string directory = Directory(path);
+		const std::vector<std::string> includes = ParseIncludes(source);
+		for (size_t i = 0; i < includes.size(); i++)
+			hash = HashSourceTree(directory + includes[i], visited, hash);
+		return hash;
+	}
+
+	// Returns 0 when the source can not be read, the shader is then compiled so the error is reported
+	inline uint64_t ComputeKey(
+		const std::string & path,
+		const std::string & target,
+		const std::string & entryPoint,
+		const uint32_t & flags,
+		const uint32_t & compilerVersion,
+		const std::string & defines = std::string())
+	{
+		std::string source;
+		if (!ReadFile(path, source))
+			return 0;
+
+		std::unordered_set<std::string> visited;
+		uint64_t key = HashSourceTree(path, visited, 14695981039346656037ull);
+		key = Hash(target, key);
+		key = Hash(entryPoint, key);
+		key = Hash(&flags, sizeof(flags), key);
+		key = Hash(&compilerVersion, sizeof(compilerVersion), key);
+		key = Hash(defines, key);
+		return key ? key : 1;
+	}
+
+	inline std::string FilePath(const std::string & directory, const uint64_t & key, const char * extension = ".cso")
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+		return directory + "/" + name + extension;
+	}
+
+	// False when there is no entry or it is truncated, corrupt or from another version
+	inline bool Load(const std::string & directory, const uint64_t & key, std::vector<char> & bytecode, const char * extension = ".cso")
+	{
+		std::ifstream file(FilePath(directory, key, extension), std::ios::binary);
+		if (!file)
+			return false;
+
+		FileHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+			return false;
+		if (header.Magic != FILE_MAGIC || header.Version != FILE_VERSION || header.Key != key || header.DataSize == 0 || header.DataSize > (1ull << 28))
+			return false;
+
+		bytecode.resize(static_cast<size_t>(header.DataSize));
+		if (!file.read(bytecode.data(), bytecode.size()))
+			return false;
+		return Hash(bytecode.data(), bytecode.size()) == header.DataHash;
+	}
+
+	// Written next to the entry and renamed over it, a crash half way never leaves a broken entry behind
+	inline bool Store(const std::string & directory, const uint64_t & key, const void * bytecode, const size_t & size, const char * extension = ".cso")
+	{
+		const std::string path = FilePath(directory, key, extension);
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file)
+				return false;
+
+			FileHeader header;
+			header.Magic = FILE_MAGIC;
+			header.Version = FILE_VERSION;
+			header.Key = key;
+			header.DataHash = Hash(bytecode, size);
+			header.DataSize = size;
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(static_cast<const char*>(bytecode), size);
+			if (!file)
+				return false;
+		}
+		std::remove(path.c_str());
+		return std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+}
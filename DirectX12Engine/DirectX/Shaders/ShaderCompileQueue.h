@@ -0,0 +1,220 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Runs queued shader compiles on a pool of threads, each result is waited on by the pass that needs it.
+// A compile nobody has started yet when it is asked for runs on the asking thread, so a pass never waits behind the queue.
+// Free of any D3D12 types so the scheduling and the timings can be checked without the shader compiler.
+template <typename Result>
+class ShaderCompileQueue
+{
+public:
+	struct Timing
+	{
+		std::string Key;
+		double Milliseconds;
+	};
+
+	ShaderCompileQueue() = default;
+	ShaderCompileQueue(const ShaderCompileQueue &) = delete;
+	ShaderCompileQueue & operator=(const ShaderCompileQueue &) = delete;
+	~ShaderCompileQueue()
+	{
+		Stop();
+	}
+
+	// The threads start with the first task. Returns false when the key is already queued
+	bool Queue(const std::string & key, std::function<Result()> task, const unsigned int & threadCount = 0)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_jobs.find(key) != m_jobs.end())
+			return false;
+
+		if (m_threads.empty())
+		{
+			unsigned int count = threadCount ? threadCount : std::thread::hardware_concurrency();
+			if (count == 0)
+				count = 1;
+			m_stopping = false;
+			m_timings.clear();
+			m_start = Clock::now();
+			m_end = m_start;
+			for (unsigned int i = 0; i < count; i++)
+				m_threads.emplace_back(&ShaderCompileQueue::_work, this);
+		}
+
+		Job & job = m_jobs[key];
+		job.Task = std::move(task);
+		m_pending.push_back(key);
+		m_work.notify_one();
+		return true;
+	}
+
+	// Blocks until the task is done and hands its result over. Only the first Take of a key gets the result,
+	// returns false when the key was never queued, is already taken or its task threw
+	bool Take(const std::string & key, Result & result)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto it = m_jobs.find(key);
+		if (it == m_jobs.end() || it->second.Taken)
+			return false;
+
+		//Nobody else erases the job once it is taken, the reference stays valid while waiting
+		Job & job = it->second;
+		job.Taken = true;
+		if (job.State == Pending)
+		{
+			m_pending.erase(std::find(m_pending.begin(), m_pending.end(), key));
+			_run(lock, key, job);
+		}
+		m_done.wait(lock, [&job] { return job.State == Done; });
+
+		const bool succeeded = !job.Failed;
+		if (succeeded)
+			result = std::move(job.Output);
+		m_jobs.erase(key);
+		return succeeded;
+	}
+
+	// Finishes what is queued and stops the threads. Results nobody took are handed to discard,
+	// jobs a Take is still waiting on are left to it
+	void Stop(const std::function<void(Result &)> & discard = nullptr)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_work.notify_all();
+		for (std::thread & thread : m_threads)
+			thread.join();
+		m_threads.clear();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (auto it = m_jobs.begin(); it != m_jobs.end();)
+		{
+			if (it->second.Taken)
+			{
+				++it;
+				continue;
+			}
+			if (discard && !it->second.Failed)
+				discard(it->second.Output);
+			it = m_jobs.erase(it);
+		}
+	}
+
+	std::vector<Timing> GetTimings() const
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_timings;
+	}
+
+	// Sum of every compile, what compiling them one after another would have taken
+	double GetSerialMilliseconds() const
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		double total = 0.0;
+		for (const Timing & timing : m_timings)
+			total += timing.Milliseconds;
+		return total;
+	}
+
+	// From the first queued task until the last one was done
+	double GetWallMilliseconds() const
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return std::chrono::duration<double, std::milli>(m_end - m_start).count();
+	}
+
+	double GetSavedMilliseconds() const
+	{
+		const double saved = GetSerialMilliseconds() - GetWallMilliseconds();
+		return saved > 0.0 ? saved : 0.0;
+	}
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	enum JobState
+	{
+		Pending,
+		Running,
+		Done
+	};
+
+	struct Job
+	{
+		std::function<Result()> Task;
+		Result Output{};
+		JobState State = Pending;
+		bool Taken = false;
+		bool Failed = false;
+	};
+
+	void _work()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_work.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+			if (m_pending.empty())
+				return;
+
+			const std::string key = m_pending.front();
+			m_pending.pop_front();
+			_run(lock, key, m_jobs[key]);
+		}
+	}
+
+	// Called and returns with the lock held, the task itself runs without it
+	void _run(std::unique_lock<std::mutex> & lock, const std::string & key, Job & job)
+	{
+		job.State = Running;
+		std::function<Result()> task = std::move(job.Task);
+		lock.unlock();
+
+		//A task that throws still finishes its job, or every Take of it would wait forever
+		const Clock::time_point start = Clock::now();
+		Result result{};
+		bool failed = false;
+		try
+		{
+			result = task();
+		}
+		catch (...)
+		{
+			failed = true;
+		}
+		const Clock::time_point end = Clock::now();
+
+		lock.lock();
+		job.Output = std::move(result);
+		job.Failed = failed;
+		job.State = Done;
+		m_timings.push_back(Timing{ key, std::chrono::duration<double, std::milli>(end - start).count() });
+		if (end > m_end)
+			m_end = end;
+		m_done.notify_all();
+	}
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_work;
+	std::condition_variable m_done;
+
+	std::vector<std::thread> m_threads;
+	std::unordered_map<std::string, Job> m_jobs;
+	std::deque<std::string> m_pending;
+	bool m_stopping = false;
+
+	std::vector<Timing> m_timings;
+	Clock::time_point m_start;
+	Clock::time_point m_end;
+};
@@ -1,11 +1,98 @@
 #pragma once
 #include "DirectX12EnginePCH.h"
+#include "ShaderCache.h"
+#include "ShaderCompileQueue.h"
+#include "ShaderPermutation.h"
 
 
 class ShaderCreator
 {	
 public:
-	static HRESULT CreateShader(const std::wstring & path, ID3DBlob *& blob, const std::string & target, const std::string & entryPoint = "main")
+	struct CompiledShader
+	{
+		HRESULT Result = E_FAIL;
+		ID3DBlob * Blob = nullptr;
+	};
+
+	// Lets a pass name its shaders once for both QueueShader and CreateShader
+	struct ShaderDesc
+	{
+		const wchar_t * Path;
+		const char * Target;
+		const char * EntryPoint = "main";
+	};
+
+	// Starts compiling on the shader threads, CreateShader with the same arguments waits for it instead of compiling.
+	// Every define is set to 1
+	static void QueueShader(const std::wstring & path, const std::string & target, const std::string & entryPoint = "main", const std::vector<std::string> & defines = {})
+	{
+		_queue().Queue(_key(path, target, entryPoint, defines), [path, target, entryPoint, defines]()
+		{
+			CompiledShader shader;
+			shader.Result = _compileShader(path, shader.Blob, target, entryPoint, defines);
+			return shader;
+		});
+	}
+
+	static void QueueShader(const ShaderDesc & shader, const ShaderPermutation::Key & permutation = 0)
+	{
+		QueueShader(shader.Path, shader.Target, shader.EntryPoint, ShaderPermutation::Defines(permutation));
+	}
+
+	static HRESULT CreateShader(const std::wstring & path, ID3DBlob *& blob, const std::string & target, const std::string & entryPoint = "main", const std::vector<std::string> & defines = {})
+	{
+		CompiledShader shader;
+		if (_queue().Take(_key(path, target, entryPoint, defines), shader))
+		{
+			blob = shader.Blob;
+			return shader.Result;
+		}
+		return _compileShader(path, blob, target, entryPoint, defines);
+	}
+
+	static HRESULT CreateShader(const ShaderDesc & shader, ID3DBlob *& blob, const ShaderPermutation::Key & permutation = 0)
+	{
+		return CreateShader(shader.Path, blob, shader.Target, shader.EntryPoint, ShaderPermutation::Defines(permutation));
+	}
+
+	// Stops the shader threads, queued shaders nobody asked for are released
+	static void FinishQueue()
+	{
+		_queue().Stop([](CompiledShader & shader)
+		{
+			if (shader.Blob)
+				shader.Blob->Release();
+			shader.Blob = nullptr;
+		});
+	}
+
+	// Per shader compile times and how much wall clock time the shader threads saved
+	static const ShaderCompileQueue<CompiledShader> & GetQueue()
+	{
+		return _queue();
+	}
+
+private:
+	static ShaderCompileQueue<CompiledShader> & _queue()
+	{
+		static ShaderCompileQueue<CompiledShader> queue;
+		return queue;
+	}
+
+	static std::string _defines(const std::vector<std::string> & defines)
+	{
+		std::string text;
+		for (size_t i = 0; i < defines.size(); i++)
+			text += " " + defines[i];
+		return text;
+	}
+
+	static std::string _key(const std::wstring & path, const std::string & target, const std::string & entryPoint, const std::vector<std::string> & defines)
+	{
+		return std::string(path.begin(), path.end()) + " " + target + " " + entryPoint + _defines(defines);
+	}
+
+	static HRESULT _compileShader(const std::wstring & path, ID3DBlob *& blob, const std::string & target, const std::string & entryPoint, const std::vector<std::string> & defines)
 	{
 		HRESULT hr;
 		std::wstring newPath;
@@ -15,14 +102,35 @@ public:
 		newPath = path;
 #endif
 		
+		const UINT flags = D3DCOMPILE_ENABLE_UNBOUNDED_DESCRIPTOR_TABLES;
+
+		//Shader paths are plain ascii
+		const std::string sourcePath(newPath.begin(), newPath.end());
+		const uint64_t key = ShaderCache::ComputeKey(sourcePath, target, entryPoint, flags, D3D_COMPILER_VERSION, _defines(defines));
+
+		std::vector<char> bytecode;
+		if (key && ShaderCache::Load(ShaderCache::DEFAULT_DIRECTORY, key, bytecode))
+		{
+			if (SUCCEEDED(hr = D3DCreateBlob(bytecode.size(), &blob)))
+			{
+				memcpy(blob->GetBufferPointer(), bytecode.data(), bytecode.size());
+				return hr;
+			}
+		}
+		
+		std::vector<D3D_SHADER_MACRO> macros;
+		for (size_t i = 0; i < defines.size(); i++)
+			macros.push_back({ defines[i].c_str(), "1" });
+		macros.push_back({ nullptr, nullptr });
+
 		ID3DBlob * errorBlob = nullptr;
 		if (FAILED(hr = D3DCompileFromFile(
 			newPath.c_str(),
-			nullptr,
+			macros.data(),
 			D3D_COMPILE_STANDARD_FILE_INCLUDE,
 			entryPoint.c_str(),
 			target.c_str(),
-			D3DCOMPILE_ENABLE_UNBOUNDED_DESCRIPTOR_TABLES,
+			flags,
 			0,
 			&blob,
 			&errorBlob
@@ -34,6 +142,11 @@ public:
 			OutputDebugStringA(static_cast<char*>(errorBlob->GetBufferPointer()));
 			OutputDebugStringW(std::wstring(L"\n\n}\n").c_str());
 		}
+		else if (key)
+		{
+			CreateDirectoryA(ShaderCache::DEFAULT_DIRECTORY, nullptr);
+			ShaderCache::Store(ShaderCache::DEFAULT_DIRECTORY, key, blob->GetBufferPointer(), blob->GetBufferSize());
+		}
 
 		if (errorBlob) errorBlob->Release(); errorBlob = nullptr;
 		return hr;
@@ -9,7 +9,7 @@ struct LIGHT_STRUCT
     float4 LightVector;
 };
 
-float4 SingelLightCalculations(in LIGHT_STRUCT light,
+float4 PointLightCalculations(in LIGHT_STRUCT light,
 	in float4 cameraPosition,
 	in float4 worldPosition,
 	in float4 albedo,
@@ -20,76 +20,26 @@ float4 SingelLightCalculations(in LIGHT_STRUCT light,
     float4 worldToCamera = normalize(cameraPosition - worldPosition);
     float4 posToLight = light.LightPosition - worldPosition;
     float4 finalColor = float4(0, 0, 0, 0);
-    float4 halfWayDir = 0;
     float distanceToLight = length(posToLight);
-    float attenuation = 0;
-	
 
-    if (light.LightType.x == 0) //pointlight
-    {
-        attenuation = light.LightVector.x / (1.0f + light.LightVector.y * pow(distanceToLight, light.LightVector.z));
+    float attenuation = light.LightVector.x / (1.0f + light.LightVector.y * pow(distanceToLight, light.LightVector.z));
 
-        halfWayDir = normalize(posToLight + worldToCamera);
+    float4 halfWayDir = normalize(posToLight + worldToCamera);
 
-        specular += pow(max(dot(normal, halfWayDir), 0.0f), 128.0f) * length(metallic.rgb) * attenuation * light.LightColor;
+    specular += pow(max(dot(normal, halfWayDir), 0.0f), 128.0f) * length(metallic.rgb) * attenuation * light.LightColor;
 
-        if (distanceToLight < light.LightVector.w)
-        {
-            finalColor = max(dot(normal, normalize(posToLight)), 0.0f) * light.LightColor * albedo * attenuation;
-        }
-    }
-    else if (light.LightType.x == 1) //Dir
+    if (distanceToLight < light.LightVector.w)
     {
-        finalColor = max(dot(normal, normalize(-float4(light.LightVector.xyz, 0))), 0.0f) * light.LightColor * albedo * light.LightVector.w;
+        finalColor = max(dot(normal, normalize(posToLight)), 0.0f) * light.LightColor * albedo * attenuation;
     }
     return finalColor;
 }
 
-float4 LightCalculation(
-    uint4 LightType[256],
-    float4 LightPosition[256], 
-    float4 LightColor[256], 
-    float4 LightVector[256],
-    float4 cameraPosition, 
-    float4 worldPos, 
-    float4 albedo, 
-    float4 normal, 
-    float4 metallic, 
-    inout float4 specular)
+float4 DirectionalLightCalculations(in LIGHT_STRUCT light,
+	in float4 albedo,
+	in float4 normal)
 {
-    float4 worldToCamera = normalize(cameraPosition - worldPos);
-    float4 posToLight = float4(0, 0, 0, 0);
-    float4 finalColor = float4(0, 0, 0, 0);
-    float4 halfWayDir = 0;
-    float distanceToLight = 0;
-    float attenuation = 0;   
-
-    for (uint i = 0; i < LightType[0].x && i < 256; i++)
-    {
-        posToLight = LightPosition[i] - worldPos;
-        distanceToLight = length(posToLight);
-     
-        if (LightType[i].y == 0) //pointlight
-        {
-            attenuation = LightVector[i].x / (1.0f + LightVector[i].y * pow(distanceToLight, LightVector[i].z));
-
-            halfWayDir = normalize(posToLight + worldToCamera);
-            
-            specular += pow(max(dot(normal, halfWayDir), 0.0f), 128.0f) * length(metallic.rgb) * attenuation * LightColor[i];
-
-            if (distanceToLight < LightVector[i].w)
-            {
-                finalColor += max(dot(normal, normalize(posToLight)), 0.0f) * LightColor[i] * albedo * attenuation;
-            }
-        }
-        else if (LightType[i].y == 1) //Dir
-        {
-            attenuation = LightVector[i].w;
-            finalColor += max(dot(normal, normalize(-float4(LightVector[i].xyz, 0))), 0.0f) * LightColor[i] * albedo * attenuation;
-        }
-    }
-    
-    return finalColor;
+    return max(dot(normal, normalize(-float4(light.LightVector.xyz, 0))), 0.0f) * light.LightColor * albedo * light.LightVector.w;
 }
 
 float4 FragmentLightPos(float4 worldPos, float4x4 ShadowViewProjection)
@@ -159,6 +109,37 @@ int ShadowCalculations(Texture2DArray shadowMap, uint index, SamplerComparisonSt
         }
     }
     
+    currentShadowCoeff /= divider;
+    shadowCoeff += currentShadowCoeff;
+    return 1;
+}
+
+// atlasRect = xy offset and zw size of the tile in atlas uv, samples are clamped to the tile so PCF does not read the neighbours
+int ShadowAtlasCalculations(Texture2D shadowAtlas, float4 atlasRect, SamplerComparisonState samplerState, in float texelSize, in float4 fragmentLightPos, inout float shadowCoeff, in int PFCSampleRate = 1)
+{
+    if (abs(fragmentLightPos.x) > 1 || abs(fragmentLightPos.y) > 1)
+        return 0;
+
+    const float2 tileMin = atlasRect.xy + texelSize * 0.5f;
+    const float2 tileMax = atlasRect.xy + atlasRect.zw - texelSize * 0.5f;
+
+    float2 smTex;
+    float2 baseUV = atlasRect.xy + FragmentLightUV(fragmentLightPos) * atlasRect.zw;
+    float depth = FragmentLightDepth(fragmentLightPos);
+    float epsilon = 0.01f;
+    float divider = 0.0f;
+    float currentShadowCoeff = 1.0f;
+
+    for (int x = -PFCSampleRate; x <= PFCSampleRate; ++x)
+    {
+        for (int y = -PFCSampleRate; y <= PFCSampleRate; ++y)
+        {
+            smTex = clamp(baseUV + (float2(x, y) * texelSize), tileMin, tileMax);
+            currentShadowCoeff += shadowAtlas.SampleCmpLevelZero(samplerState, smTex, depth - epsilon).r;
+            divider += 1.0f;
+        }
+    }
+    
     currentShadowCoeff /= divider;
     shadowCoeff += currentShadowCoeff;
     return 1;
@@ -0,0 +1,116 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Compile time variants of a shader. Every feature is a bit in the key and a define of the same name in the shader,
+// so a variant without a feature has the code for it compiled out instead of branching over it.
+// A pass varies on a subset of the features and keeps one pipeline per combination of them, the index packs that subset densely.
+namespace ShaderPermutation
+{
+	typedef uint32_t Key;
+
+	enum Feature : Key
+	{
+		TESSELLATION		= 1u << 0,
+		NORMAL_MAP			= 1u << 1,
+		POINT_LIGHTS		= 1u << 2,
+		DIRECTIONAL_LIGHTS	= 1u << 3,
+		DISPLACEMENT		= 1u << 4	//Displaced in the vertex shader, tessellated instances are displaced in the domain shader
+	};
+
+	static const unsigned int FEATURE_COUNT = 5;
+	static const char * const FEATURE_NAMES[FEATURE_COUNT] =
+	{
+		"TESSELLATION",
+		"NORMAL_MAP",
+		"POINT_LIGHTS",
+		"DIRECTIONAL_LIGHTS",
+		"DISPLACEMENT"
+	};
+
+	static const Key GEOMETRY_FEATURES = TESSELLATION | NORMAL_MAP | DISPLACEMENT;
+	static const Key DEFERRED_FEATURES = POINT_LIGHTS | DIRECTIONAL_LIGHTS;
+
+	constexpr unsigned int CountFeatures(Key features)
+	{
+		unsigned int count = 0;
+		for (; features; features &= features - 1)
+			count++;
+		return count;
+	}
+
+	// Number of pipelines a pass varying on features needs
+	constexpr unsigned int Count(const Key & features)
+	{
+		return 1u << CountFeatures(features);
+	}
+
+	// Packs the bits of key that are in features next to each other, lowest feature first
+	inline unsigned int Index(const Key & key, const Key & features)
+	{
+		unsigned int index = 0;
+		unsigned int bit = 0;
+		for (Key feature = 1; feature && feature <= features; feature <<= 1)
+		{
+			if (!(features & feature))
+				continue;
+			if (key & feature)
+				index |= 1u << bit;
+			bit++;
+		}
+		return index;
+	}
+
+	// Inverse of Index
+	inline Key FromIndex(const unsigned int & index, const Key & features)
+	{
+		Key key = 0;
+		unsigned int bit = 0;
+		for (Key feature = 1; feature && feature <= features; feature <<= 1)
+		{
+			if (!(features & feature))
+				continue;
+			if (index & (1u << bit))
+				key |= feature;
+			bit++;
+		}
+		return key;
+	}
+
+	inline Key SelectGeometry(const bool & tessellation, const bool & normalMapping)
+	{
+		return (tessellation ? TESSELLATION : 0) | (normalMapping ? NORMAL_MAP : 0);
+	}
+
+	// Light types that are not in the scene are compiled out of the light loop
+	inline Key SelectDeferred(const unsigned int & pointLights, const unsigned int & directionalLights)
+	{
+		return (pointLights ? POINT_LIGHTS : 0) | (directionalLights ? DIRECTIONAL_LIGHTS : 0);
+	}
+
+	inline std::vector<std::string> Defines(const Key & key)
+	{
+		std::vector<std::string> defines;
+		for (unsigned int i = 0; i < FEATURE_COUNT; i++)
+		{
+			if (key & (1u << i))
+				defines.push_back(FEATURE_NAMES[i]);
+		}
+		return defines;
+	}
+
+	inline std::string Name(const Key & key)
+	{
+		std::string name;
+		for (unsigned int i = 0; i < FEATURE_COUNT; i++)
+		{
+			if (!(key & (1u << i)))
+				continue;
+			if (!name.empty())
+				name += "|";
+			name += FEATURE_NAMES[i];
+		}
+		return name.empty() ? "BASE" : name;
+	}
+}
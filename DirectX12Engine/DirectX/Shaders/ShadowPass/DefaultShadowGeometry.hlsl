@@ -1,36 +1,43 @@
+struct VS_OUTPUT
+{
+    float4 pos : POSITION;
+    uint faces : FACES;
+};
+
 struct GSOutput
 {
 	float4 pos : SV_POSITION;
-    uint RTIndex : SV_RenderTargetArrayIndex;
+    uint ViewportIndex : SV_ViewportArrayIndex; //Every face has its own viewport over its tile in the shadow atlas
 };
 
-#define MAX_RENDERTARGETS 6
+#define MAX_VIEWPORTS 6
 
 cbuffer LIGHT_BUFFER : register(b0)
 {
-    uint4 LightType;
+    uint4 LightType; //X = light type Y = faces to render, the rest keep their cached depth Z = number of faces
     float4x4 ViewProjection[6];
 }
 
-[maxvertexcount(MAX_RENDERTARGETS * 3)]
+[maxvertexcount(MAX_VIEWPORTS * 3)]
 void main(
-	triangle float4 input[3] : POSITION, 
+	triangle VS_OUTPUT input[3], 
 	inout TriangleStream<GSOutput> output
 )
 {
-    uint index = 1;
-    if (LightType.x == 0)
-        index = 6;
-    else if (LightType.x == 1)
-        index = 1;
+    //Point lights have six faces, directional lights one per cascade
+    const uint index = min(LightType.z, MAX_VIEWPORTS);
 
     for (uint i = 0; i < index; i++)
 	{
+        //Faces the instance is outside of are culled on the cpu
+        if (!(LightType.y & input[0].faces & (1u << i)))
+            continue;
+
         for (uint j = 0; j < 3; j++)
         {
             GSOutput element = (GSOutput) 0;
-            element.pos = mul(input[j], ViewProjection[i]);
-            element.RTIndex = i;
+            element.pos = mul(input[j].pos, ViewProjection[i]);
+            element.ViewportIndex = i;
 		    output.Append(element);
         }
         output.RestartStrip();
@@ -6,6 +6,13 @@ struct VS_INPUT
     float4 texCord : TEXCORD;
 
     float4x4 worldMatrix : WORLD;
+    uint4 textureIndex : TEXTURE_INDEX; //Y = slot in the caster masks
+};
+
+struct VS_OUTPUT
+{
+    float4 pos : POSITION;
+    uint faces : FACES;
 };
 
 cbuffer LIGHT_BUFFER : register(b0)
@@ -14,7 +21,12 @@ cbuffer LIGHT_BUFFER : register(b0)
     float4x4 ViewProjection[6];
 }
 
-float4 main(VS_INPUT input) : POSITION
+StructuredBuffer<uint> CasterMasks : register(t0); //The faces every instance is inside of
+
+VS_OUTPUT main(VS_INPUT input)
 {
-    return mul(input.pos, input.worldMatrix);
+    VS_OUTPUT output;
+    output.pos = mul(input.pos, input.worldMatrix);
+    output.faces = CasterMasks[input.textureIndex.y];
+    return output;
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+struct VS_INPUT
+{
+    float4 pos : POSITION;
+    float4 normal : NORMAL;
+    float4 tangent : TANGENT;
+    float4 texCord : TEXCORD;
+
+    uint faceInstance : FACE_INSTANCE; //Caster slot << 3 | face
+};
+
+struct VS_OUTPUT
+{
+    float4 pos : SV_POSITION;
+    uint ViewportIndex : SV_ViewportArrayIndex; //Every face has its own viewport over its tile in the shadow atlas
+};
+
+struct CASTER
+{
+    float4x4 worldMatrix; //Uploaded transposed like ViewProjection, so mul(pos, worldMatrix) matches the WORLD input of DefaultShadowVertex
+};
+
+cbuffer LIGHT_BUFFER : register(b0)
+{
+    uint4 LightType; //X = light type Y = faces to render Z = number of faces
+    float4x4 ViewProjection[6];
+}
+
+StructuredBuffer<CASTER> CasterWorld : register(t1);
+
+VS_OUTPUT main(VS_INPUT input)
+{
+    const uint face = input.faceInstance & 7u;
+
+    VS_OUTPUT output;
+    output.pos = mul(mul(input.pos, CasterWorld[input.faceInstance >> 3].worldMatrix), ViewProjection[face]);
+    output.ViewportIndex = face;
+    return output;
+}
\ No newline at end of file
@@ -12,4 +12,17 @@ struct ParticleVertex
 {
 	DirectX::XMFLOAT4 Position;
 	DirectX::XMFLOAT4 TexCord;
-};
\ No newline at end of file
+};
+
+struct ParticleInstance
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT2 Size;
+	unsigned int TextureIndex;
+};
+
+struct ParticleCalculation
+{
+	DirectX::XMFLOAT4 Position;
+	DirectX::XMFLOAT4 ParticleInfo;
+};
@@ -2,6 +2,8 @@
 #include "DirectX12EnginePCH.h"
 #include "Utility/DeltaTime.h"
 #include "DirectX/Objects/ParticleEmitter.h"
+#include "DirectX/Render/WrapperFunctions/Functions/SceneGraph.h"
+#include "DirectX/Render/WrapperFunctions/Functions/BoundingVolumeHierarchy.h"
 
 
 #ifdef _DEBUG
@@ -40,7 +42,8 @@ inline BOOL InitDirectX12Engine(Window *& window,
 	const UINT & height,
 	const BOOL & fullscreen = FALSE,
 	const BOOL & debuggingTools = FALSE,
-	const BOOL & enableConsole = FALSE)
+	const BOOL & enableConsole = FALSE,
+	const BOOL & useWarpAdapter = FALSE)
 {
 	DEBUG::SetDbgFlag();
 	if (enableConsole)
@@ -58,7 +61,7 @@ inline BOOL InitDirectX12Engine(Window *& window,
 	{
 		PRINT("Init Window Done") NEW_LINE;
 		PRINT("Init DirectX12Engine Start") NEW_LINE;
-		if (SUCCEEDED(hr = renderingManager->Init(window, debuggingTools)))
+		if (SUCCEEDED(hr = renderingManager->Init(window, debuggingTools, useWarpAdapter)))
 		{
 			PRINT("Init DirectX12Engine Done") NEW_LINE;
 			return TRUE;
@@ -31,7 +31,9 @@
 #include "DirectX/Objects/Light/PointLight.h"
 #include "DirectX/Objects/Light/DirectionalLight.h"
 
-constexpr UINT SHADOW_MAP_SIZE = 512;
+constexpr UINT SHADOW_ATLAS_SIZE = 4096;
+constexpr UINT SHADOW_TILE_MIN_SIZE = 128;
+constexpr UINT SHADOW_TILE_MAX_SIZE = 1024;
 
 inline HRESULT SET_NAME(ID3D12Object * object, const std::wstring & name)
 {
@@ -0,0 +1,317 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <sstream>
+#include <ostream>
+#include <cstdio>
+#include <cstdlib>
+#include "DirectX/Render/WrapperFunctions/Functions/TimerStatistics.h"
+
+// Synthetic scenes for timing the CPU side of a frame, and the JSON report the timings are written to.
+// Only uses the standard library, the App builds the scenes and runs them through the engine.
+namespace Benchmark
+{
+	//Every drawable is an instance in the geometry and shadow instance buffers, which grow to hold them
+	static const unsigned int MAX_DRAWABLES = 100000;
+
+	struct Scene
+	{
+		std::string Name = "custom";
+		unsigned int Drawables = 16;
+		unsigned int Meshes = 1;			//Unique meshes, the drawables take turns using them
+		unsigned int Materials = 1;			//Unique texture sets, the drawables take turns using them
+		unsigned int Lights = 32;
+		unsigned int Emitters = 16;
+		float AnimatedFraction = 1.0f;		//Part of the drawables moved and updated every frame
+		unsigned int Frames = 300;
+		unsigned int WarmupFrames = 30;		//Run before the timed frames and left out of the report
+	};
+
+	struct Options
+	{
+		bool Enabled = false;
+		std::string SceneName = "all";
+		Scene Custom;
+		std::string OutputPath = "benchmark.json";
+		bool UseWarpAdapter = false;
+	};
+
+	inline Scene MakeScene(const std::string & name, const unsigned int & drawables, const unsigned int & meshes, const unsigned int & materials,
+		const unsigned int & lights, const unsigned int & emitters, const float & animatedFraction)
+	{
+		Scene scene;
+		scene.Name = name;
+		scene.Drawables = drawables;
+		scene.Meshes = meshes;
+		scene.Materials = materials;
+		scene.Lights = lights;
+		scene.Emitters = emitters;
+		scene.AnimatedFraction = animatedFraction;
+		return scene;
+	}
+
+	// The scenes run by -benchmark all. Each one stresses one part of the frame, default matches the App scene
+	inline std::vector<Scene> Suite()
+	{
+		return
+		{
+			MakeScene("default", 18, 2, 1, 32, 128, 1.0f),
+			MakeScene("drawables", 10000, 4, 4, 32, 16, 0.1f),
+			MakeScene("drawables_100k", MAX_DRAWABLES, 4, 4, 32, 16, 0.1f),
+			MakeScene("animated", 10000, 4, 4, 32, 16, 1.0f),
+			MakeScene("meshes", 512, 64, 64, 32, 16, 0.1f),
+			MakeScene("lights", 256, 4, 4, 2048, 16, 0.1f),
+			MakeScene("emitters", 256, 4, 4, 32, 512, 0.1f)
+		};
+	}
+
+	// Keeps a scene inside what the benchmark builds
+	inline Scene Clamp(Scene scene)
+	{
+		if (scene.Drawables > MAX_DRAWABLES)
+			scene.Drawables = MAX_DRAWABLES;
+		if (!scene.Meshes)
+			scene.Meshes = 1;
+		if (!scene.Materials)
+			scene.Materials = 1;
+		if (scene.AnimatedFraction < 0.0f)
+			scene.AnimatedFraction = 0.0f;
+		if (scene.AnimatedFraction > 1.0f)
+			scene.AnimatedFraction = 1.0f;
+		if (!scene.Frames)
+			scene.Frames = 1;
+		return scene;
+	}
+
+	// -benchmark [all|custom|<scene>] -frames N -warmup N -drawables N -meshes N -materials N -lights N -emitters N -animated F -out path -warp
+	// Any scene parameter makes the run custom. Returns false on an unknown or incomplete argument
+	inline bool ParseArguments(const std::string & commandLine, Options & options)
+	{
+		std::istringstream stream(commandLine);
+		std::vector<std::string> arguments;
+		std::string argument;
+		while (stream >> argument)
+			arguments.push_back(argument);
+
+		unsigned int frames = 0, warmup = 0;
+		bool setFrames = false, setWarmup = false;
+		for (size_t i = 0; i < arguments.size(); i++)
+		{
+			const std::string & name = arguments[i];
+			const bool hasValue = i + 1 < arguments.size() && arguments[i + 1][0] != '-';
+			if (name == "-benchmark")
+			{
+				options.Enabled = true;
+				if (hasValue)
+					options.SceneName = arguments[++i];
+				continue;
+			}
+			if (name == "-warp")
+			{
+				options.UseWarpAdapter = true;
+				continue;
+			}
+			if (!hasValue)
+				return false;
+
+			const std::string & value = arguments[++i];
+			const unsigned int number = static_cast<unsigned int>(strtoul(value.c_str(), nullptr, 10));
+			if (name == "-out")
+				options.OutputPath = value;
+			else if (name == "-frames")
+			{
+				frames = number;
+				setFrames = true;
+			}
+			else if (name == "-warmup")
+			{
+				warmup = number;
+				setWarmup = true;
+			}
+			else
+			{
+				Scene & custom = options.Custom;
+				if (name == "-drawables")
+					custom.Drawables = number;
+				else if (name == "-meshes")
+					custom.Meshes = number;
+				else if (name == "-materials")
+					custom.Materials = number;
+				else if (name == "-lights")
+					custom.Lights = number;
+				else if (name == "-emitters")
+					custom.Emitters = number;
+				else if (name == "-animated")
+					custom.AnimatedFraction = static_cast<float>(strtod(value.c_str(), nullptr));
+				else
+					return false;
+				options.SceneName = "custom";
+			}
+		}
+
+		if (setFrames)
+			options.Custom.Frames = frames;
+		if (setWarmup)
+			options.Custom.WarmupFrames = warmup;
+		return true;
+	}
+
+	// The scenes the options ask for with their frame counts, empty for an unknown name
+	inline std::vector<Scene> SelectScenes(const Options & options)
+	{
+		std::vector<Scene> scenes;
+		if (options.SceneName == "custom")
+		{
+			scenes.push_back(options.Custom);
+		}
+		else
+		{
+			const std::vector<Scene> suite = Suite();
+			for (size_t i = 0; i < suite.size(); i++)
+			{
+				if (options.SceneName == "all" || options.SceneName == suite[i].Name)
+					scenes.push_back(suite[i]);
+			}
+		}
+
+		for (size_t i = 0; i < scenes.size(); i++)
+		{
+			scenes[i].Frames = options.Custom.Frames;
+			scenes[i].WarmupFrames = options.Custom.WarmupFrames;
+			scenes[i] = Clamp(scenes[i]);
+		}
+		return scenes;
+	}
+
+	// Per scene statistics of every stage and counter, in the order they were first added
+	class Report
+	{
+	public:
+		void BeginScene(const Scene & scene)
+		{
+			m_results.push_back(Result());
+			m_results.back().Scene = scene;
+		}
+
+		// Milliseconds
+		void AddStage(const std::string & stage, const double & milliseconds)
+		{
+			if (!m_results.empty())
+				_find(m_results.back().Stages, stage).AddSample(milliseconds);
+		}
+
+		void AddCounter(const std::string & counter, const double & value)
+		{
+			if (!m_results.empty())
+				_find(m_results.back().Counters, counter).AddSample(value);
+		}
+
+		// Info is written as strings under "build", so runs of different builds can be told apart
+		void WriteJson(std::ostream & out, const std::vector<std::pair<std::string, std::string>> & info) const
+		{
+			out << "{\n\t\"build\": {";
+			for (size_t i = 0; i < info.size(); i++)
+			{
+				out << (i ? ", " : "");
+				_writeString(out, info[i].first);
+				out << ": ";
+				_writeString(out, info[i].second);
+			}
+			out << "},\n\t\"scenes\": [";
+
+			for (size_t i = 0; i < m_results.size(); i++)
+			{
+				const Result & result = m_results[i];
+				const Scene & scene = result.Scene;
+				out << (i ? "," : "") << "\n\t\t{\n\t\t\t\"name\": ";
+				_writeString(out, scene.Name);
+				out << ",\n\t\t\t\"parameters\": {\"drawables\": " << scene.Drawables <<
+					", \"meshes\": " << scene.Meshes <<
+					", \"materials\": " << scene.Materials <<
+					", \"lights\": " << scene.Lights <<
+					", \"emitters\": " << scene.Emitters <<
+					", \"animated_fraction\": ";
+				_writeNumber(out, scene.AnimatedFraction);
+				out << ", \"frames\": " << scene.Frames << ", \"warmup_frames\": " << scene.WarmupFrames << "},";
+				out << "\n\t\t\t\"stages_ms\": ";
+				_writeStatistics(out, result.Stages);
+				out << ",\n\t\t\t\"counters\": ";
+				_writeStatistics(out, result.Counters);
+				out << "\n\t\t}";
+			}
+			out << "\n\t]\n}\n";
+		}
+
+	private:
+		typedef std::vector<std::pair<std::string, TimerStatistics>> Statistics;
+
+		struct Result
+		{
+			Benchmark::Scene Scene;
+			Statistics Stages;
+			Statistics Counters;
+		};
+
+		std::vector<Result> m_results;
+
+		static TimerStatistics & _find(Statistics & statistics, const std::string & name)
+		{
+			for (size_t i = 0; i < statistics.size(); i++)
+			{
+				if (statistics[i].first == name)
+					return statistics[i].second;
+			}
+			statistics.push_back(std::make_pair(name, TimerStatistics()));
+			return statistics.back().second;
+		}
+
+		static void _writeStatistics(std::ostream & out, const Statistics & statistics)
+		{
+			out << "{";
+			for (size_t i = 0; i < statistics.size(); i++)
+			{
+				const TimerStatistics::Summary summary = statistics[i].second.GetSummary();
+				out << (i ? "," : "") << "\n\t\t\t\t";
+				_writeString(out, statistics[i].first);
+				out << ": {\"min\": ";
+				_writeNumber(out, summary.Min);
+				out << ", \"avg\": ";
+				_writeNumber(out, summary.Avg);
+				out << ", \"max\": ";
+				_writeNumber(out, summary.Max);
+				out << ", \"p99\": ";
+				_writeNumber(out, summary.P99);
+				out << "}";
+			}
+			out << (statistics.empty() ? "}" : "\n\t\t\t}");
+		}
+
+		static void _writeNumber(std::ostream & out, const double & value)
+		{
+			char text[32];
+			snprintf(text, sizeof(text), "%.4f", value);
+			out << text;
+		}
+
+		static void _writeString(std::ostream & out, const std::string & text)
+		{
+			out << '"';
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				const unsigned char c = static_cast<unsigned char>(text[i]);
+				if (c == '"' || c == '\\')
+					out << '\\' << c;
+				else if (c < 0x20)
+				{
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					out << escaped;
+				}
+				else
+					out << c;
+			}
+			out << '"';
+		}
+	};
+}
@@ -0,0 +1,111 @@
+#include "Test.h"
+#include "Utility/Benchmark.h"
+#include <algorithm>
+#include <sstream>
+
+TEST(Benchmark_SuiteRunsAtScale)
+{
+	const std::vector<Benchmark::Scene> suite = Benchmark::Suite();
+	CHECK(!suite.empty());
+	CHECK(suite.front().Name == "default");
+	//The drawable scenes are far past what one starting instance buffer holds
+	unsigned int most = 0, animated = 0;
+	for (size_t i = 0; i < suite.size(); i++)
+	{
+		most = (std::max)(most, suite[i].Drawables);
+		if (suite[i].AnimatedFraction == 1.0f)
+			animated = (std::max)(animated, suite[i].Drawables);
+	}
+	CHECK(most == Benchmark::MAX_DRAWABLES && most >= 100000);
+	CHECK(animated >= 10000);
+	for (size_t i = 0; i < suite.size(); i++)
+	{
+		const Benchmark::Scene & scene = suite[i];
+		CHECK(scene.Drawables > 0 && scene.Drawables <= Benchmark::MAX_DRAWABLES);
+		CHECK(scene.Meshes > 0 && scene.Meshes <= scene.Drawables);
+		CHECK(scene.Materials > 0 && scene.Materials <= scene.Drawables);
+		CHECK(scene.AnimatedFraction >= 0.0f && scene.AnimatedFraction <= 1.0f);
+		for (size_t j = 0; j < i; j++)
+			CHECK(suite[j].Name != scene.Name);
+	}
+}
+
+TEST(Benchmark_ParseArguments)
+{
+	Benchmark::Options off;
+	CHECK(Benchmark::ParseArguments("", off));
+	CHECK(!off.Enabled);
+
+	Benchmark::Options all;
+	CHECK(Benchmark::ParseArguments("-benchmark", all));
+	CHECK(all.Enabled && all.SceneName == "all");
+	const std::vector<Benchmark::Scene> scenes = Benchmark::SelectScenes(all);
+	CHECK(scenes.size() == Benchmark::Suite().size());
+	for (size_t i = 0; i < scenes.size(); i++)
+		CHECK(scenes[i].Frames == 300 && scenes[i].WarmupFrames == 30);
+
+	Benchmark::Options one;
+	CHECK(Benchmark::ParseArguments("-benchmark lights -frames 50 -warmup 5 -out run.json -warp", one));
+	const std::vector<Benchmark::Scene> lights = Benchmark::SelectScenes(one);
+	CHECK(lights.size() == 1);
+	if (!lights.empty())
+		CHECK(lights[0].Name == "lights" && lights[0].Frames == 50 && lights[0].WarmupFrames == 5);
+	CHECK(one.OutputPath == "run.json" && one.UseWarpAdapter);
+
+	Benchmark::Options unknown;
+	CHECK(Benchmark::ParseArguments("-benchmark nosuch", unknown));
+	CHECK(Benchmark::SelectScenes(unknown).empty());
+
+	Benchmark::Options bad;
+	CHECK(!Benchmark::ParseArguments("-benchmark -bogus 3", bad));
+	CHECK(!Benchmark::ParseArguments("-frames", bad));
+}
+
+TEST(Benchmark_CustomSceneIsClamped)
+{
+	Benchmark::Options options;
+	CHECK(Benchmark::ParseArguments("-benchmark -drawables 500000 -meshes 0 -animated 2.5 -lights 7 -frames 0", options));
+	const std::vector<Benchmark::Scene> scenes = Benchmark::SelectScenes(options);
+	CHECK(scenes.size() == 1);
+	if (scenes.empty())
+		return;
+	CHECK(scenes[0].Name == "custom");
+	CHECK(scenes[0].Drawables == Benchmark::MAX_DRAWABLES);
+	CHECK(scenes[0].Meshes == 1);
+	CHECK(scenes[0].AnimatedFraction == 1.0f);
+	CHECK(scenes[0].Lights == 7);
+	CHECK(scenes[0].Frames == 1);
+}
+
+TEST(Benchmark_ReportIsValidJson)
+{
+	Benchmark::Report report;
+	//Nothing to add to before the first scene
+	report.AddStage("dropped", 1.0);
+
+	std::vector<Benchmark::Scene> scenes = Benchmark::Suite();
+	scenes[0].Name = "quote \" backslash \\ newline \n";
+	for (size_t i = 0; i < scenes.size(); i++)
+	{
+		report.BeginScene(scenes[i]);
+		for (int frame = 0; frame < 10; frame++)
+		{
+			report.AddStage("queue", frame * 0.1);
+			report.AddStage("pass/Geometry", 1.0);
+			report.AddCounter("draw_calls", frame);
+		}
+	}
+	report.BeginScene(Benchmark::Scene());
+
+	std::ostringstream stream;
+	report.WriteJson(stream, { { "configuration", "Release" }, { "adapter", "WARP" } });
+	const std::string json = stream.str();
+
+	CHECK(Test::IsBalancedJson(json));
+	CHECK(json.find("\"dropped\"") == std::string::npos);
+	CHECK(json.find("quote \\\" backslash \\\\ newline \\u000a") != std::string::npos);
+	CHECK(json.find("\"adapter\": \"WARP\"") != std::string::npos);
+	CHECK(json.find("\"pass/Geometry\": {\"min\": 1.0000, \"avg\": 1.0000, \"max\": 1.0000") != std::string::npos);
+	//The scene without samples still writes empty objects
+	CHECK(json.find("\"stages_ms\": {}") != std::string::npos);
+}
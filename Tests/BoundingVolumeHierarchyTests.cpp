@@ -0,0 +1,370 @@
+#include "Test.h"
+#include "BoundingVolumeHierarchy.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+
+namespace
+{
+	using namespace DirectX;
+	typedef BoundingVolumeHierarchy Bvh;
+
+	// The boxes the tree was given, indexed by their user data, so every query can be checked against all of them
+	struct Scene
+	{
+		std::vector<Bvh::Box> Boxes;
+		std::vector<bool> Alive;
+		std::vector<Bvh::Item> Items;
+
+		void Insert(Bvh & tree, const Bvh::Box & box, const bool & bulk = false)
+		{
+			const uint32_t userData = static_cast<uint32_t>(Boxes.size());
+			Boxes.push_back(box);
+			Alive.push_back(true);
+			Items.push_back(bulk ? tree.Add(box, userData) : tree.Insert(box, userData));
+		}
+
+		void Remove(Bvh & tree, const size_t & index)
+		{
+			tree.Remove(Items[index]);
+			Alive[index] = false;
+		}
+	};
+
+	Bvh::Box _randomBox(std::mt19937 & random)
+	{
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.1f, 3.0f);
+		const XMFLOAT3 min(position(random), position(random), position(random));
+		return { min, XMFLOAT3(min.x + size(random), min.y + size(random), min.z + size(random)) };
+	}
+
+	bool _overlaps(const Bvh::Box & a, const Bvh::Box & b)
+	{
+		return a.Min.x <= b.Max.x && a.Max.x >= b.Min.x &&
+			a.Min.y <= b.Max.y && a.Max.y >= b.Min.y &&
+			a.Min.z <= b.Max.z && a.Max.z >= b.Min.z;
+	}
+
+	float _distanceSq(const Bvh::Box & box, const XMFLOAT3 & point)
+	{
+		const float x = point.x < box.Min.x ? box.Min.x - point.x : (point.x > box.Max.x ? point.x - box.Max.x : 0.0f);
+		const float y = point.y < box.Min.y ? box.Min.y - point.y : (point.y > box.Max.y ? point.y - box.Max.y : 0.0f);
+		const float z = point.z < box.Min.z ? box.Min.z - point.z : (point.z > box.Max.z ? point.z - box.Max.z : 0.0f);
+		return x * x + y * y + z * z;
+	}
+
+	bool _outsideFrustum(const Bvh::Box & box, const ParticleLod::Frustum & frustum)
+	{
+		for (const XMFLOAT4 & plane : frustum.Planes)
+		{
+			const float furthest = plane.w +
+				plane.x * (plane.x >= 0.0f ? box.Max.x : box.Min.x) +
+				plane.y * (plane.y >= 0.0f ? box.Max.y : box.Min.y) +
+				plane.z * (plane.z >= 0.0f ? box.Max.z : box.Min.z);
+			if (furthest < 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	// Slab test, the same arithmetic as the tree so the closest distances compare exactly
+	bool _rayBox(const Bvh::Box & box, const XMFLOAT3 & origin, const XMFLOAT3 & inverse, const float & maxDistance, float & entry)
+	{
+		const float minimum[3] = { box.Min.x, box.Min.y, box.Min.z };
+		const float maximum[3] = { box.Max.x, box.Max.y, box.Max.z };
+		const float start[3] = { origin.x, origin.y, origin.z };
+		const float scale[3] = { inverse.x, inverse.y, inverse.z };
+		float enter = 0.0f, exit = maxDistance;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			float t0 = (minimum[i] - start[i]) * scale[i];
+			float t1 = (maximum[i] - start[i]) * scale[i];
+			if (t0 > t1)
+				std::swap(t0, t1);
+			if (t0 > enter)
+				enter = t0;
+			if (t1 < exit)
+				exit = t1;
+			if (enter > exit)
+				return false;
+		}
+		entry = enter;
+		return true;
+	}
+
+	ParticleLod::Frustum _frustum(const XMFLOAT3 & eye, const XMFLOAT3 & at, const float & farPlane)
+	{
+		const XMMATRIX viewProjection =
+			XMMatrixLookAtLH(XMVectorSet(eye.x, eye.y, eye.z, 1.0f), XMVectorSet(at.x, at.y, at.z, 1.0f), XMVectorSet(0, 1, 0, 0)) *
+			XMMatrixPerspectiveFovLH(1.2f, 1.5f, 0.1f, farPlane);
+		XMFLOAT4X4A transposed;
+		XMStoreFloat4x4A(&transposed, XMMatrixTranspose(viewProjection));
+		return ParticleLod::CreateFrustum(transposed);
+	}
+
+	// Every kind of query against testing every live box, returns how many queries disagreed
+	int _compareQueries(const Bvh & tree, const Scene & scene, std::mt19937 & random)
+	{
+		int wrong = 0;
+		for (int q = 0; q < 50; q++)
+		{
+			Bvh::Box box = _randomBox(random);
+			box.Max = XMFLOAT3(box.Max.x + 20.0f, box.Max.y + 20.0f, box.Max.z + 20.0f);
+			std::multiset<uint32_t> found;
+			std::set<uint32_t> expected;
+			tree.QueryBox(box, [&](const uint32_t & userData) { found.insert(userData); });
+			for (uint32_t i = 0; i < scene.Boxes.size(); i++)
+			{
+				if (scene.Alive[i] && _overlaps(scene.Boxes[i], box))
+					expected.insert(i);
+			}
+			wrong += std::multiset<uint32_t>(expected.begin(), expected.end()) != found;
+
+			const XMFLOAT3 center = box.Min;
+			const float radius = 15.0f;
+			found.clear();
+			expected.clear();
+			tree.QuerySphere(center, radius, [&](const uint32_t & userData) { found.insert(userData); });
+			for (uint32_t i = 0; i < scene.Boxes.size(); i++)
+			{
+				if (scene.Alive[i] && _distanceSq(scene.Boxes[i], center) <= radius * radius)
+					expected.insert(i);
+			}
+			wrong += std::multiset<uint32_t>(expected.begin(), expected.end()) != found;
+
+			const XMFLOAT3 at = _randomBox(random).Min;
+			const ParticleLod::Frustum frustum = _frustum(center, at, 80.0f);
+			found.clear();
+			expected.clear();
+			tree.QueryFrustum(frustum, [&](const uint32_t & userData) { found.insert(userData); });
+			for (uint32_t i = 0; i < scene.Boxes.size(); i++)
+			{
+				if (scene.Alive[i] && !_outsideFrustum(scene.Boxes[i], frustum))
+					expected.insert(i);
+			}
+			wrong += std::multiset<uint32_t>(expected.begin(), expected.end()) != found;
+
+			//Along an axis every tenth ray, the slabs of the other axes are then open
+			const XMFLOAT3 direction = q % 10 == 0 ? XMFLOAT3(0, 0, 1) : XMFLOAT3(at.x - center.x, at.y - center.y, at.z - center.z);
+			float distance;
+			const uint32_t hit = tree.Raycast(center, direction, 1.0f, [](const uint32_t &, const float & entry) { return entry; }, distance);
+			const XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+			float closest = 1.0f;
+			bool any = false;
+			for (uint32_t i = 0; i < scene.Boxes.size(); i++)
+			{
+				float entry;
+				if (scene.Alive[i] && _rayBox(scene.Boxes[i], center, inverse, 1.0f, entry) && entry <= closest)
+				{
+					closest = entry;
+					any = true;
+				}
+			}
+			wrong += (hit != Bvh::NO_ITEM) != any;
+			if (hit != Bvh::NO_ITEM)
+				wrong += distance != closest;
+		}
+		return wrong;
+	}
+}
+
+TEST(BoundingVolumeHierarchy_QueriesMatchBruteForce)
+{
+	//One thread builds in order, four hand the subtrees to the pool
+	for (const unsigned int threads : { 1u, 4u })
+	{
+		std::mt19937 random(3);
+		Bvh tree(threads);
+		Scene scene;
+		for (int i = 0; i < 40000; i++)
+			scene.Insert(tree, _randomBox(random));
+		CHECK(tree.GetItemCount() == 40000);
+		CHECK(_compareQueries(tree, scene, random) == 0);
+
+		//The SAH build is at least as good as inserting one at a time
+		const float insertedCost = tree.GetCost();
+		tree.Build();
+		CHECK(_compareQueries(tree, scene, random) == 0);
+		CHECK(tree.GetCost() <= insertedCost);
+
+		//Moved items are found at their new box after the refit
+		for (int frame = 0; frame < 20; frame++)
+		{
+			for (int k = 0; k < 2000; k++)
+			{
+				const size_t i = random() % scene.Boxes.size();
+				Bvh::Box & box = scene.Boxes[i];
+				const float dx = (static_cast<int>(random() % 200) - 100) * 0.05f;
+				box.Min.x += dx;
+				box.Max.x += dx;
+				tree.Move(scene.Items[i], box);
+			}
+			tree.Refit();
+		}
+		CHECK(_compareQueries(tree, scene, random) == 0);
+
+		for (int k = 0; k < 10000; k++)
+		{
+			const size_t i = random() % scene.Boxes.size();
+			if (scene.Alive[i])
+				scene.Remove(tree, i);
+		}
+		for (int k = 0; k < 5000; k++)
+			scene.Insert(tree, _randomBox(random));
+		CHECK(_compareQueries(tree, scene, random) == 0);
+		bool userData = true;
+		for (uint32_t i = 0; i < scene.Items.size(); i++)
+			userData &= !scene.Alive[i] || tree.GetUserData(scene.Items[i]) == i;
+		CHECK(userData);
+
+		tree.Build();
+		CHECK(_compareQueries(tree, scene, random) == 0);
+	}
+}
+
+TEST(BoundingVolumeHierarchy_BulkAddWaitsForBuild)
+{
+	std::mt19937 random(9);
+	Bvh tree(4);
+	Scene scene;
+	for (int i = 0; i < 30000; i++)
+		scene.Insert(tree, _randomBox(random), true);
+
+	//Nothing is in the tree before the build, an item removed or moved before it is left out or built at its box
+	size_t found = 0;
+	tree.QueryBox({ XMFLOAT3(-200, -200, -200), XMFLOAT3(200, 200, 200) }, [&](const uint32_t &) { found++; });
+	CHECK(found == 0);
+	scene.Remove(tree, 7);
+	scene.Boxes[8].Min.y += 5.0f;
+	scene.Boxes[8].Max.y += 5.0f;
+	tree.Move(scene.Items[8], scene.Boxes[8]);
+	tree.Build();
+	CHECK(tree.GetItemCount() == 29999);
+	CHECK(_compareQueries(tree, scene, random) == 0);
+	tree.Refit();
+	CHECK(_compareQueries(tree, scene, random) == 0);
+
+	tree.Clear();
+	CHECK(tree.GetItemCount() == 0);
+	float distance;
+	CHECK(tree.Raycast(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), 1.0f, [](const uint32_t &, const float & entry) { return entry; }, distance) == Bvh::NO_ITEM);
+}
+
+TEST(BoundingVolumeHierarchy_IdenticalBoxes)
+{
+	//Every centroid on one spot, the binned split has nothing to bin by
+	Bvh tree(4);
+	for (uint32_t i = 0; i < 20000; i++)
+		tree.Insert({ XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1) }, i);
+	tree.Build();
+	std::vector<bool> seen(20000, false);
+	size_t found = 0;
+	tree.QuerySphere(XMFLOAT3(0.5f, 0.5f, 0.5f), 0.1f, [&](const uint32_t & userData)
+	{
+		found += !seen[userData];
+		seen[userData] = true;
+	});
+	CHECK(found == 20000);
+}
+
+BENCHMARK(BoundingVolumeHierarchy_BuildAndQuery)
+{
+	for (const int count : { 100000, 1000000 })
+	{
+		//About the same density at every count
+		std::mt19937 random(5);
+		const float extent = std::cbrt(static_cast<float>(count)) * 4.0f;
+		std::uniform_real_distribution<float> position(-extent, extent), size(0.5f, 2.0f);
+		std::vector<Bvh::Box> boxes;
+		for (int i = 0; i < count; i++)
+		{
+			const XMFLOAT3 min(position(random), position(random), position(random));
+			boxes.push_back({ min, XMFLOAT3(min.x + size(random), min.y + size(random), min.z + size(random)) });
+		}
+
+		Bvh tree(1), pooled(4);
+		std::vector<Bvh::Item> items;
+		const double insert = Test::Time([&]()
+		{
+			for (int i = 0; i < count; i++)
+				items.push_back(tree.Insert(boxes[i], i));
+		});
+		for (int i = 0; i < count; i++)
+			pooled.Add(boxes[i], i);
+		const double build = Test::Time([&]() { tree.Build(); });
+		const double pooledBuild = Test::Time([&]() { pooled.Build(); });
+
+		std::vector<size_t> moved;
+		for (int i = 0; i < count / 10; i++)
+			moved.push_back(random() % count);
+		const double refit = Test::Time([&]()
+		{
+			for (const size_t i : moved)
+			{
+				boxes[i].Min.x += 0.5f;
+				boxes[i].Max.x += 0.5f;
+				tree.Move(items[i], boxes[i]);
+			}
+			tree.Refit();
+		});
+
+		const int queries = 200;
+		std::vector<ParticleLod::Frustum> frustums;
+		std::vector<XMFLOAT3> eyes;
+		for (int q = 0; q < queries; q++)
+		{
+			eyes.push_back(XMFLOAT3(position(random), position(random), position(random)));
+			frustums.push_back(_frustum(eyes.back(), XMFLOAT3(position(random), position(random), position(random)), extent * 0.3f));
+		}
+		size_t found = 0, bruteFound = 0;
+		const double frustum = Test::Time([&]()
+		{
+			for (const ParticleLod::Frustum & f : frustums)
+				tree.QueryFrustum(f, [&](const uint32_t &) { found++; });
+		});
+		const double bruteFrustum = Test::Time([&]()
+		{
+			for (const ParticleLod::Frustum & f : frustums)
+			{
+				for (const Bvh::Box & box : boxes)
+					bruteFound += !_outsideFrustum(box, f);
+			}
+		});
+		CHECK(found == bruteFound);
+
+		const float radius = extent * 0.05f;
+		size_t sphereFound = 0, bruteSphereFound = 0;
+		const double sphere = Test::Time([&]()
+		{
+			for (const XMFLOAT3 & eye : eyes)
+				tree.QuerySphere(eye, radius, [&](const uint32_t &) { sphereFound++; });
+		});
+		const double bruteSphere = Test::Time([&]()
+		{
+			for (const XMFLOAT3 & eye : eyes)
+			{
+				for (const Bvh::Box & box : boxes)
+					bruteSphereFound += _distanceSq(box, eye) <= radius * radius;
+			}
+		});
+		CHECK(sphereFound == bruteSphereFound);
+
+		size_t hits = 0;
+		const double rays = Test::Time([&]()
+		{
+			for (int q = 0; q < queries; q++)
+			{
+				float distance;
+				const XMFLOAT3 direction(position(random), position(random), position(random));
+				hits += tree.Raycast(eyes[q], direction, 1.0f, [](const uint32_t &, const float & entry) { return entry; }, distance) != Bvh::NO_ITEM;
+			}
+		});
+
+		printf("  %d boxes: insert %.0f ms, build %.0f ms, build on 4 threads %.0f ms, refit of 10%% %.1f ms\n",
+			count, insert, build, pooledBuild, refit);
+		printf("    %d frustums %.1f ms (%zu found), brute force %.0f ms\n", queries, frustum, found, bruteFrustum);
+		printf("    %d spheres %.2f ms (%zu found), brute force %.0f ms; %d rays %.2f ms (%zu hit)\n",
+			queries, sphere, sphereFound, bruteSphere, queries, rays, hits);
+	}
+}
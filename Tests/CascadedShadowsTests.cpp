@@ -0,0 +1,142 @@
+#include "Test.h"
+#include "CascadedShadows.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const float FOV = XM_PI * 0.45f;
+	const float ASPECT_RATIO = 16.0f / 9.0f;
+	const float NEAR_PLANE = 0.1f;
+	const float FAR_PLANE = 500.0f;
+	const unsigned int RESOLUTION = 1024;
+	const XMFLOAT4 LIGHT_DIRECTION(0.3f, -1.0f, 0.4f, 0.0f);
+
+	// The camera keeps its view matrix transposed
+	XMFLOAT4X4A ViewMatrix(const XMVECTOR & position, const XMVECTOR & direction)
+	{
+		XMFLOAT4X4A view;
+		XMStoreFloat4x4A(&view, XMMatrixTranspose(XMMatrixLookToLH(position, direction, XMVectorSet(0, 1, 0, 0))));
+		return view;
+	}
+
+	XMVECTOR Project(const CascadedShadows::Cascade & cascade, const XMVECTOR & position)
+	{
+		return XMVector3TransformCoord(position, XMMatrixTranspose(XMLoadFloat4x4A(&cascade.ViewProjection)));
+	}
+
+	// Where the position lands in the shadow map, in texels
+	void ToTexels(const CascadedShadows::Cascade & cascade, const XMVECTOR & position, float & x, float & y)
+	{
+		const XMVECTOR projected = Project(cascade, position);
+		x = (XMVectorGetX(projected) * 0.5f + 0.5f) * RESOLUTION;
+		y = (XMVectorGetY(projected) * -0.5f + 0.5f) * RESOLUTION;
+	}
+}
+
+TEST(CascadedShadows_SplitsBlendUniformAndLogarithmic)
+{
+	float splits[CascadedShadows::MAX_CASCADES + 1];
+	CascadedShadows::ComputeSplits(1.0f, 100.0f, 4, 0.75f, splits);
+	CHECK(splits[0] == 1.0f && splits[4] == 100.0f);
+	for (unsigned int i = 0; i < 4; i++)
+		CHECK(splits[i] < splits[i + 1]);
+
+	CascadedShadows::ComputeSplits(1.0f, 100.0f, 4, 0.0f, splits);
+	CHECK(fabsf(splits[2] - 50.5f) < 1e-4f);
+	CascadedShadows::ComputeSplits(1.0f, 100.0f, 4, 1.0f, splits);
+	CHECK(fabsf(splits[2] - 10.0f) < 1e-4f);
+}
+
+TEST(CascadedShadows_CascadesContainTheirSlice)
+{
+	const XMVECTOR position = XMVectorSet(5, 3, -7, 1);
+	const XMVECTOR forward = XMVector3Normalize(XMVectorSet(0.4f, -0.2f, 1, 0));
+	const XMVECTOR right = XMVector3Normalize(XMVector3Cross(XMVectorSet(0, 1, 0, 0), forward));
+	const XMVECTOR up = XMVector3Cross(forward, right);
+	const float tanHalfFov = tanf(FOV * 0.5f);
+
+	CascadedShadows::Settings settings;
+	CascadedShadows::Cascade cascades[CascadedShadows::MAX_CASCADES];
+	const unsigned int count = CascadedShadows::ComputeCascades(ViewMatrix(position, forward), FOV, ASPECT_RATIO, NEAR_PLANE, FAR_PLANE, LIGHT_DIRECTION, RESOLUTION, settings, cascades);
+	CHECK(count == settings.CascadeCount);
+	CHECK(cascades[count - 1].SplitFar == settings.ShadowDistance);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const CascadedShadows::Cascade & cascade = cascades[i];
+		if (i)
+			CHECK(cascade.SplitNear == cascades[i - 1].SplitFar);
+
+		bool inside = true;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const float depth = corner & 4 ? cascade.SplitFar : cascade.SplitNear;
+			const float x = (corner & 1 ? 1.0f : -1.0f) * tanHalfFov * ASPECT_RATIO * depth;
+			const float y = (corner & 2 ? 1.0f : -1.0f) * tanHalfFov * depth;
+			const XMVECTOR point = XMVectorSetW(XMVectorAdd(position, XMVectorAdd(XMVectorScale(forward, depth), XMVectorAdd(XMVectorScale(right, x), XMVectorScale(up, y)))), 1.0f);
+
+			const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(point, XMLoadFloat4(&cascade.Bounds))));
+			inside &= distance <= cascade.Bounds.w * 1.0001f + 1e-4f;
+
+			const XMVECTOR projected = Project(cascade, point);
+			inside &= fabsf(XMVectorGetX(projected)) <= 1.0001f && fabsf(XMVectorGetY(projected)) <= 1.0001f;
+			inside &= XMVectorGetZ(projected) >= 0.0f && XMVectorGetZ(projected) <= 1.0f;
+		}
+		CHECK(inside);
+	}
+}
+
+TEST(CascadedShadows_RadiusIgnoresCameraRotation)
+{
+	const XMVECTOR position = XMVectorSet(0, 2, 0, 1);
+	CascadedShadows::Settings settings;
+	CascadedShadows::Cascade first[CascadedShadows::MAX_CASCADES];
+	CascadedShadows::Cascade turned[CascadedShadows::MAX_CASCADES];
+	CascadedShadows::ComputeCascades(ViewMatrix(position, XMVectorSet(0, 0, 1, 0)), FOV, ASPECT_RATIO, NEAR_PLANE, FAR_PLANE, LIGHT_DIRECTION, RESOLUTION, settings, first);
+	CascadedShadows::ComputeCascades(ViewMatrix(position, XMVector3Normalize(XMVectorSet(1, -0.3f, 0.2f, 0))), FOV, ASPECT_RATIO, NEAR_PLANE, FAR_PLANE, LIGHT_DIRECTION, RESOLUTION, settings, turned);
+	for (unsigned int i = 0; i < settings.CascadeCount; i++)
+		CHECK(first[i].Bounds.w == turned[i].Bounds.w);
+}
+
+TEST(CascadedShadows_SnappingMovesWholeTexels)
+{
+	const XMVECTOR position = XMVectorSet(5, 3, -7, 1);
+	const XMVECTOR forward = XMVector3Normalize(XMVectorSet(0.4f, -0.2f, 1, 0));
+	const XMVECTOR probe = XMVectorSet(1.234f, 0.5f, 2.5f, 1.0f);
+
+	CascadedShadows::Settings settings;
+	CascadedShadows::Cascade reference[CascadedShadows::MAX_CASCADES];
+	CascadedShadows::ComputeCascades(ViewMatrix(position, forward), FOV, ASPECT_RATIO, NEAR_PLANE, FAR_PLANE, LIGHT_DIRECTION, RESOLUTION, settings, reference);
+
+	//A fixed world point may only jump by whole texels while the camera slides in sub texel steps
+	float drift = 0.0f;
+	for (int step = 0; step < 200; step++)
+	{
+		const XMVECTOR moved = XMVectorAdd(position, XMVectorSet(step * 0.013f, 0.0f, step * 0.007f, 0.0f));
+		CascadedShadows::Cascade cascades[CascadedShadows::MAX_CASCADES];
+		CascadedShadows::ComputeCascades(ViewMatrix(moved, forward), FOV, ASPECT_RATIO, NEAR_PLANE, FAR_PLANE, LIGHT_DIRECTION, RESOLUTION, settings, cascades);
+		for (unsigned int i = 0; i < settings.CascadeCount; i++)
+		{
+			float x, y, referenceX, referenceY;
+			ToTexels(cascades[i], probe, x, y);
+			ToTexels(reference[i], probe, referenceX, referenceY);
+			drift = (std::max)(drift, fabsf((x - referenceX) - roundf(x - referenceX)));
+			drift = (std::max)(drift, fabsf((y - referenceY) - roundf(y - referenceY)));
+		}
+	}
+	CHECK(drift < 0.02f);
+}
+
+BENCHMARK(CascadedShadows_ComputeCascades)
+{
+	const XMFLOAT4X4A view = ViewMatrix(XMVectorSet(5, 3, -7, 1), XMVector3Normalize(XMVectorSet(0.4f, -0.2f, 1, 0)));
+	CascadedShadows::Settings settings;
+	CascadedShadows::Cascade cascades[CascadedShadows::MAX_CASCADES];
+	const double time = Test::Time([&]()
+	{
+		CascadedShadows::ComputeCascades(view, FOV, ASPECT_RATIO, NEAR_PLANE, FAR_PLANE, LIGHT_DIRECTION, RESOLUTION, settings, cascades);
+	}, 100000);
+	printf("  %u cascades: %.3f us\n", settings.CascadeCount, time * 1000.0);
+}
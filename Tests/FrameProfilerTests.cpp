@@ -0,0 +1,147 @@
+#include "Test.h"
+#include "FrameProfiler.h"
+#include <sstream>
+
+namespace
+{
+	size_t _count(const std::string & text, const std::string & pattern)
+	{
+		size_t count = 0;
+		for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + pattern.size()))
+			count++;
+		return count;
+	}
+}
+
+TEST(FrameProfiler_ZonesOutsideFramesAreDropped)
+{
+	FrameProfiler profiler(4);
+	CHECK(profiler.GetCurrentFrame() == FrameProfiler::NO_FRAME);
+	{
+		FrameProfiler::Scope scope(&profiler, "dropped");
+	}
+	CHECK(profiler.GetFrames().empty());
+	{
+		FrameProfiler::Scope scope(nullptr, "no profiler");
+	}
+}
+
+TEST(FrameProfiler_RingKeepsLastFrames)
+{
+	FrameProfiler profiler(4);
+	const unsigned int threads = 4;
+	for (uint64_t f = 0; f < 10; f++)
+	{
+		const uint64_t frame = profiler.BeginFrame();
+		CHECK(frame == f);
+		CHECK(profiler.GetCurrentFrame() == f);
+
+		std::vector<std::thread> workers;
+		for (unsigned int t = 0; t < threads; t++)
+		{
+			workers.emplace_back([&profiler]()
+			{
+				for (int i = 0; i < 100; i++)
+					FrameProfiler::Scope scope(&profiler, "zone");
+			});
+		}
+		for (std::thread & worker : workers)
+			worker.join();
+
+		CHECK(profiler.AddGpuZone(frame, "gpu", profiler.GetGpuTrack("Direct"), 0, 1));
+		if (frame >= 3)
+			CHECK(profiler.AddGpuZone(frame - 3, "late", 0, 0, 1));
+		if (frame >= 4)
+			CHECK(!profiler.AddGpuZone(frame - 4, "lost", 0, 0, 1));
+		CHECK(!profiler.AddGpuZone(frame + 1, "future", 0, 0, 1));
+		profiler.EndFrame();
+	}
+
+	const std::vector<FrameProfiler::Frame> frames = profiler.GetFrames();
+	CHECK(frames.size() == 4);
+	CHECK(frames.front().Index == 6);
+	CHECK(frames.back().Index == 9);
+	CHECK(frames.back().CpuZones.size() == threads * 100);
+	for (const FrameProfiler::Frame & frame : frames)
+		CHECK(frame.End >= frame.Begin && frame.End != 0);
+}
+
+TEST(FrameProfiler_GpuTicksToCpuTime)
+{
+	FrameProfiler::Calibration calibration;
+	calibration.GpuTicks = 1000;
+	calibration.Frequency = 10000000;
+	calibration.CpuTime = 5000;
+	CHECK(FrameProfiler::ToCpuTime(calibration, 1000) == 5000);
+	CHECK(FrameProfiler::ToCpuTime(calibration, 1010) == 6000);
+	CHECK(FrameProfiler::ToCpuTime(calibration, 990) == 4000);
+	//An hour of ticks does not overflow
+	CHECK(FrameProfiler::ToCpuTime(calibration, 1000 + 36000000000ull) == 5000 + 3600000000000ll);
+
+	calibration.Frequency = 0;
+	CHECK(FrameProfiler::ToCpuTime(calibration, 1234) == 5000);
+}
+
+TEST(FrameProfiler_ChromeTraceIsValid)
+{
+	FrameProfiler profiler(8);
+	profiler.SetThreadName("Main \"render\"");
+	const uint32_t copy = profiler.GetGpuTrack("Copy");
+	for (int f = 0; f < 3; f++)
+	{
+		const uint64_t frame = profiler.BeginFrame();
+		FrameProfiler::Scope scope(&profiler, "quote \" backslash \\ newline \n tab \t");
+		profiler.AddGpuZone(frame, "upload", copy, FrameProfiler::Now(), FrameProfiler::Now() + 10);
+	}
+	profiler.EndFrame();
+
+	std::ostringstream stream;
+	profiler.WriteChromeTrace(stream);
+	const std::string trace = stream.str();
+
+	CHECK(Test::IsBalancedJson(trace));
+	CHECK(trace.find("\"traceEvents\"") != std::string::npos);
+	CHECK(trace.find("Main \\\"render\\\"") != std::string::npos);
+	CHECK(trace.find("newline \\u000a tab \\u0009") != std::string::npos);
+	CHECK(_count(trace, "\"cat\":\"frame\"") == 3);
+	CHECK(_count(trace, "\"cat\":\"cpu\"") == 3);
+	CHECK(_count(trace, "\"cat\":\"gpu\"") == 3);
+	CHECK(_count(trace, "\"process_name\"") == 2);
+
+	const std::string path = "FrameProfilerTrace.json";
+	CHECK(profiler.ExportChromeTrace(path));
+	std::ifstream file(path);
+	std::stringstream exported;
+	exported << file.rdbuf();
+	CHECK(exported.str() == trace);
+	file.close();
+	std::remove(path.c_str());
+}
+
+BENCHMARK(FrameProfiler_ScopeAndExport)
+{
+	FrameProfiler profiler(120);
+	const uint32_t direct = profiler.GetGpuTrack("Direct");
+	for (int f = 0; f < 120; f++)
+	{
+		const uint64_t frame = profiler.BeginFrame();
+		for (int i = 0; i < 200; i++)
+			FrameProfiler::Scope scope(&profiler, "pass");
+		profiler.AddGpuZone(frame, "gpu", direct, 0, 1);
+	}
+	profiler.EndFrame();
+
+	std::string trace;
+	const double exportTime = Test::Time([&]()
+	{
+		std::ostringstream stream;
+		profiler.WriteChromeTrace(stream);
+		trace = stream.str();
+	}, 10);
+	const double scopeTime = Test::Time([&]()
+	{
+		FrameProfiler::Scope scope(&profiler, "scope");
+	}, 100000);
+
+	printf("  export 120 frames x 201 zones: %.3f ms, %zu KiB, scope %.1f ns\n", exportTime, trace.size() / 1024, scopeTime * 1e6);
+}
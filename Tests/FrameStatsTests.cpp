@@ -0,0 +1,116 @@
+#include "Test.h"
+#include "FrameStats.h"
+#include <thread>
+
+TEST(FrameStats_EmptyBeforeTheFirstFrame)
+{
+	FrameStatsRecorder recorder(8);
+	CHECK(recorder.GetLast().Counters[FrameStats::DRAW_CALLS] == 0);
+	CHECK(recorder.GetHistoryCount() == 0);
+	CHECK(recorder.FrameTimePercentile(99.0) == 0.0);
+}
+
+TEST(FrameStats_CountersAddUpAcrossThreads)
+{
+	FrameStatsRecorder recorder(8);
+	const unsigned int geometry = recorder.RegisterPass("Geometry");
+	const unsigned int shadow = recorder.RegisterPass("Shadow");
+	CHECK(geometry == 0 && shadow == 1);
+	CHECK(recorder.RegisterPass("Geometry") == geometry);
+
+	const unsigned int threads = 4;
+	for (uint64_t f = 0; f < 20; f++)
+	{
+		std::vector<std::thread> workers;
+		for (unsigned int t = 0; t < threads; t++)
+		{
+			workers.emplace_back([&recorder, f, t, geometry, shadow]()
+			{
+				for (int i = 0; i < 1000; i++)
+					recorder.RecordDraw(36, 1, f + 1);
+				recorder.RecordBarriers(2);
+				recorder.RecordUpload(256);
+				recorder.AddPassTime(t % 2 ? shadow : geometry, 1000000);
+			});
+		}
+		for (std::thread & worker : workers)
+			worker.join();
+
+		const FrameStats stats = recorder.EndFrame();
+		CHECK(stats.Index == f);
+		CHECK(stats.Counters[FrameStats::DRAW_CALLS] == threads * 1000);
+		CHECK(stats.Counters[FrameStats::INSTANCES] == threads * 1000);
+		CHECK(stats.Counters[FrameStats::TRIANGLES] == threads * 1000 * (f + 1));
+		CHECK(stats.Counters[FrameStats::BARRIERS] == threads * 2);
+		CHECK(stats.Counters[FrameStats::UPLOAD_BYTES] == threads * 256);
+		CHECK(stats.Counters[FrameStats::DISPATCHES] == 0);
+		CHECK(stats.PassTime[geometry] == 2.0 && stats.PassTime[shadow] == 2.0);
+		CHECK(stats.FrameTime >= 0.0);
+	}
+
+	//The next frame starts from zero
+	CHECK(recorder.EndFrame().Counters[FrameStats::DRAW_CALLS] == 0);
+}
+
+TEST(FrameStats_HistoryPercentiles)
+{
+	FrameStatsRecorder recorder(8);
+	const unsigned int pass = recorder.RegisterPass("Geometry");
+	for (uint64_t f = 0; f < 20; f++)
+	{
+		recorder.Add(FrameStats::TRIANGLES, 1000 * (f + 1));
+		recorder.AddPassTime(pass, 2000000);
+		recorder.EndFrame();
+	}
+
+	CHECK(recorder.GetHistoryCount() == 8);
+	const std::vector<FrameStats> history = recorder.GetHistory();
+	CHECK(history.front().Index == 12 && history.back().Index == 19);
+	CHECK(recorder.GetLast().Index == 19);
+
+	//Frames 13 to 20 are kept, nearest rank over 8 values
+	CHECK(recorder.CounterPercentile(FrameStats::TRIANGLES, 0.0) == 13000.0);
+	CHECK(recorder.CounterPercentile(FrameStats::TRIANGLES, 50.0) == 16000.0);
+	CHECK(recorder.CounterPercentile(FrameStats::TRIANGLES, 100.0) == 20000.0);
+	CHECK(recorder.CounterPercentile(FrameStats::TRIANGLES, 150.0) == 20000.0);
+	CHECK(recorder.PassTimePercentile(pass, 99.0) == 2.0);
+	CHECK(recorder.PassTimePercentile(FrameStatsRecorder::NO_PASS, 99.0) == 0.0);
+}
+
+TEST(FrameStats_PassesRunOut)
+{
+	FrameStatsRecorder recorder(1);
+	for (unsigned int i = 0; i < FrameStats::MAX_PASSES; i++)
+		CHECK(recorder.RegisterPass("Pass " + std::to_string(i)) == i);
+	CHECK(recorder.RegisterPass("One too many") == FrameStatsRecorder::NO_PASS);
+	CHECK(recorder.GetPassCount() == FrameStats::MAX_PASSES);
+	CHECK(recorder.GetPassName(3) == "Pass 3");
+	CHECK(recorder.GetPassName(FrameStatsRecorder::NO_PASS).empty());
+
+	//Time for a pass that was never registered is dropped
+	recorder.AddPassTime(FrameStatsRecorder::NO_PASS, 5);
+	const FrameStats stats = recorder.EndFrame();
+	double total = 0.0;
+	for (unsigned int i = 0; i < FrameStats::MAX_PASSES; i++)
+		total += stats.PassTime[i];
+	CHECK(total == 0.0);
+}
+
+BENCHMARK(FrameStats_CounterCost)
+{
+	FrameStatsRecorder recorder;
+	const int count = 1000000;
+	const double add = Test::Time([&]()
+	{
+		for (int i = 0; i < count; i++)
+			recorder.Add(FrameStats::BARRIERS);
+	});
+	const double draw = Test::Time([&]()
+	{
+		for (int i = 0; i < count; i++)
+			recorder.RecordDraw(36, 1, 12);
+	});
+	recorder.EndFrame();
+
+	printf("  Add %.2f ns, RecordDraw %.2f ns\n", add * 1e6 / count, draw * 1e6 / count);
+}
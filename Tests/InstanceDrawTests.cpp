@@ -0,0 +1,221 @@
+#include "Test.h"
+#include "InstanceDraw.h"
+#include "RecordingCommandContext.h"
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	// Same layout as Instancing::InstanceBuffer
+	struct Instance
+	{
+		float WorldMatrix[16];
+		uint32_t TextureIndex[4];
+		float TessFactor;
+	};
+
+	const uint32_t TEXTURE_TABLE = 2;
+
+	struct Frame
+	{
+		CommandStream Stream;
+		RecordingCommandContext Context{ &Stream };
+		DescriptorHeapCursor Heap;
+		int InstanceBuffer = 0;
+		int Intermediate = 0;
+		std::vector<InstanceDraw::Group> Groups;
+		std::vector<size_t> BegunGroups;
+
+		Frame(const std::vector<uint32_t> & instanceCounts, const uint64_t & bufferSize)
+		{
+			Context.AddResource(&InstanceBuffer, bufferSize);
+			Context.AddResource(&Intermediate, bufferSize);
+			Heap.Reset(0x1000, 0x900000, 32, 1024);
+			for (size_t i = 0; i < instanceCounts.size(); i++)
+			{
+				InstanceDraw::Group group{};
+				group.Mesh = { 0x500000 + i * 0x1000, 36 * 48, 48 };
+				group.VertexCount = 36;
+				group.InstanceCount = instanceCounts[i];
+				for (uint32_t t = 0; t < InstanceDraw::TEXTURES; t++)
+				{
+					group.Textures[t] = 0x100 * (i + 1) + t;
+					group.TextureDescriptors[t] = 1;
+				}
+				Groups.push_back(group);
+			}
+		}
+
+		// Instance k of the frame gets k in its world matrix, like the transforms IRender copies in
+		bool Record(const bool & textures = true)
+		{
+			Heap.Rewind();
+			BegunGroups.clear();
+			return InstanceDraw::Draw(
+				Context,
+				textures ? &Heap : nullptr,
+				TEXTURE_TABLE,
+				&InstanceBuffer,
+				&Intermediate,
+				sizeof(Instance),
+				Groups,
+				[this](const size_t & group, const uint32_t & textureIndex, const uint32_t & firstInstance, uint8_t * destination)
+				{
+					for (uint32_t j = 0; j < Groups[group].InstanceCount; j++)
+					{
+						Instance instance{};
+						instance.WorldMatrix[0] = static_cast<float>(firstInstance + j);
+						instance.TextureIndex[0] = textureIndex;
+						instance.TessFactor = 1.0f;
+						memcpy(destination + j * sizeof(Instance), &instance, sizeof(Instance));
+					}
+				},
+				[this](const size_t & group) { BegunGroups.push_back(group); });
+		}
+
+		Instance Uploaded(const size_t & index)
+		{
+			Instance instance;
+			memcpy(&instance, Context.GetData(&InstanceBuffer).data() + index * sizeof(Instance), sizeof(Instance));
+			return instance;
+		}
+	};
+}
+
+TEST(InstanceDraw_RecordsOneFrame)
+{
+	Frame frame({ 3, 0, 5 }, 64 * 1024);
+	CHECK(frame.Record());
+
+	//Textures of every group next to each other, bound once
+	const std::vector<RecordingCommandContext::DescriptorCopy> & copies = frame.Context.GetDescriptorCopies();
+	CHECK(copies.size() == 3 * InstanceDraw::TEXTURES);
+	bool packed = true;
+	for (size_t i = 0; i < copies.size(); i++)
+	{
+		packed &= copies[i].Destination == 0x1000 + 32 * i;
+		packed &= copies[i].Source == frame.Groups[i / InstanceDraw::TEXTURES].Textures[i % InstanceDraw::TEXTURES];
+	}
+	CHECK(packed);
+	CHECK(frame.Context.GetRootTable(TEXTURE_TABLE) == 0x900000);
+
+	//Every instance uploaded once, in group order
+	const size_t instances = 8;
+	CHECK(frame.Stream.Sum(CommandStream::UPLOAD) == instances * sizeof(Instance));
+	CHECK(frame.Stream.Sum(CommandStream::BARRIER) == 2);
+	CHECK(frame.Stream.Sum(CommandStream::DESCRIPTOR_COPY) == 12);
+	bool inOrder = true;
+	for (size_t i = 0; i < instances; i++)
+		inOrder &= frame.Uploaded(i).WorldMatrix[0] == static_cast<float>(i);
+	CHECK(inOrder);
+	CHECK(frame.Uploaded(0).TextureIndex[0] == 0);
+	CHECK(frame.Uploaded(3).TextureIndex[0] == 2 * InstanceDraw::TEXTURES);
+
+	//The empty group is not drawn, the others draw their range of the instance buffer
+	const std::vector<RecordingCommandContext::Draw> & draws = frame.Context.GetDraws();
+	CHECK(frame.BegunGroups == std::vector<size_t>({ 0, 2 }));
+	CHECK(draws.size() == 2);
+	CHECK(frame.Stream.Count(CommandStream::DRAW) == 2);
+	if (draws.size() == 2)
+	{
+		CHECK(draws[0].InstanceCount == 3 && draws[0].StartInstance == 0);
+		CHECK(draws[1].InstanceCount == 5 && draws[1].StartInstance == 3);
+		CHECK(draws[1].VertexBuffers.size() == 2);
+		CHECK(draws[1].VertexBuffers[0].BufferLocation == frame.Groups[2].Mesh.BufferLocation);
+		CHECK(draws[1].VertexBuffers[1].BufferLocation == frame.Context.GetGpuAddress(&frame.InstanceBuffer));
+		CHECK(draws[1].VertexBuffers[1].SizeInBytes == instances * sizeof(Instance));
+		CHECK(draws[1].VertexBuffers[1].StrideInBytes == sizeof(Instance));
+	}
+}
+
+TEST(InstanceDraw_WithoutTexturesCopiesNoDescriptors)
+{
+	Frame frame({ 4 }, 64 * 1024);
+	CHECK(frame.Record(false));
+	CHECK(frame.Context.GetDescriptorCopies().empty());
+	CHECK(frame.Context.GetRootTable(TEXTURE_TABLE) == 0);
+	CHECK(frame.Context.GetDraws().size() == 1);
+}
+
+TEST(InstanceDraw_EmptyFrameRecordsNothing)
+{
+	Frame frame({ 0, 0 }, 64 * 1024);
+	CHECK(frame.Record());
+	CHECK(frame.Stream.GetCommands().empty());
+	CHECK(frame.BegunGroups.empty());
+}
+
+TEST(InstanceDraw_FailsWhenTheInstancesDoNotFit)
+{
+	Frame frame({ 10 }, 9 * sizeof(Instance));
+	CHECK(!frame.Record());
+	CHECK(frame.Context.GetDraws().empty());
+	CHECK(frame.Stream.Count(CommandStream::UPLOAD) == 0);
+}
+
+TEST(InstanceDraw_BufferGrowsToFitTheFrame)
+{
+	//The starting size until it is outgrown, then doubled
+	const uint64_t fits = InstanceDraw::INSTANCE_BUFFER_SIZE / sizeof(Instance);
+	CHECK(InstanceDraw::BufferSize(0, sizeof(Instance)) == InstanceDraw::INSTANCE_BUFFER_SIZE);
+	CHECK(InstanceDraw::BufferSize(fits, sizeof(Instance)) == InstanceDraw::INSTANCE_BUFFER_SIZE);
+	CHECK(InstanceDraw::BufferSize(fits + 1, sizeof(Instance)) == 2 * InstanceDraw::INSTANCE_BUFFER_SIZE);
+	CHECK(InstanceDraw::BufferSize(100000, sizeof(Instance)) == 16u * 1024u * 1024u);
+
+	//100k instances in groups of 1024, like Instancing splits them, all drawn from the grown buffer
+	std::vector<uint32_t> counts(97, 1024);
+	counts.push_back(100000 - 97 * 1024);
+	Frame frame(counts, InstanceDraw::BufferSize(100000, sizeof(Instance)));
+	CHECK(InstanceDraw::CountInstances(frame.Groups) == 100000);
+	CHECK(frame.Record());
+	CHECK(frame.Context.GetDraws().size() == counts.size());
+	if (frame.Context.GetDraws().size() == counts.size())
+		CHECK(frame.Context.GetDraws().back().StartInstance == 97 * 1024);
+	CHECK(frame.Uploaded(99999).WorldMatrix[0] == 99999.0f);
+}
+
+TEST(InstanceDraw_FramesRecordTheSameText)
+{
+	Frame frame({ 7, 2, 9 }, 64 * 1024);
+	frame.Stream.SetThreadPass("Geometry");
+	frame.Record();
+	std::ostringstream first;
+	frame.Stream.WriteText(first);
+
+	frame.Stream.Clear();
+	frame.Context.Clear();
+	frame.Record();
+	std::ostringstream second;
+	frame.Stream.WriteText(second);
+
+	CHECK(!first.str().empty());
+	CHECK(first.str() == second.str());
+}
+
+TEST(DescriptorHeapCursor_StopsWhenFull)
+{
+	RecordingCommandContext context;
+	DescriptorHeapCursor heap;
+	heap.Reset(0x1000, 0x2000, 16, 4);
+	CHECK(heap.Copy(context, 0x10, 0) == 0);
+	CHECK(heap.Copy(context, 0x10, 3) == 0x2000);
+	CHECK(heap.Copy(context, 0x20, 2) == 0);
+	CHECK(heap.Copy(context, 0x20, 1) == 0x2000 + 3 * 16);
+	CHECK(heap.GetUsed() == 4);
+	heap.Rewind();
+	CHECK(heap.Copy(context, 0x30, 1) == 0x2000);
+	CHECK(context.GetDescriptorCopies().size() == 3);
+}
+
+BENCHMARK(InstanceDraw_HeadlessFrame)
+{
+	const std::vector<uint32_t> counts(256, 16);
+	Frame frame(counts, counts.size() * 16 * sizeof(Instance));
+	const double milliseconds = Test::Time([&]()
+	{
+		frame.Stream.Clear();
+		frame.Context.Clear();
+		frame.Record();
+	}, 200);
+	printf("  256 groups x 16 instances recorded in %.3f ms\n", milliseconds);
+}
@@ -0,0 +1,124 @@
+#include "Test.h"
+#include "LightClusterBuilder.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+	const float IDENTITY[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	struct LightSet
+	{
+		std::vector<float> X, Y, Z, Radius;
+
+		LightClusterBuilder::PointLights Get() const
+		{
+			return { X.data(), Y.data(), Z.data(), Radius.data(), X.size() };
+		}
+	};
+
+	LightSet RandomLights(const size_t & count, const unsigned int & seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> side(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> depth(-5.0f, 110.0f);
+		std::uniform_real_distribution<float> radius(0.5f, 4.0f);
+		LightSet lights;
+		for (size_t i = 0; i < count; i++)
+		{
+			lights.X.push_back(side(random));
+			lights.Y.push_back(side(random) * 0.5f);
+			lights.Z.push_back(depth(random));
+			lights.Radius.push_back(radius(random));
+		}
+		return lights;
+	}
+
+	LightClusterBuilder::Frustum CameraFrustum()
+	{
+		return { IDENTITY, 3.14159265f * 0.5f, 16.0f / 9.0f, 0.1f, 100.0f };
+	}
+}
+
+TEST(LightCluster_EveryTouchingLightIsListed)
+{
+	const LightSet lights = RandomLights(2000, 1);
+	const LightClusterBuilder::Frustum frustum = CameraFrustum();
+	LightClusterBuilder builder;
+	builder.Build(frustum, lights.Get());
+
+	float scale, bias;
+	builder.GetSliceScaleBias(scale, bias);
+	const float tanY = tanf(frustum.Fov * 0.5f);
+	const float tanX = tanY * frustum.AspectRatio;
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	size_t misses = 0, touches = 0;
+	for (int sample = 0; sample < 5000; sample++)
+	{
+		const float screenX = unit(random), screenY = unit(random);
+		const float z = frustum.NearPlane * powf(frustum.FarPlane / frustum.NearPlane, unit(random));
+		const float x = (-1.0f + 2.0f * screenX) * tanX * z;
+		const float y = (1.0f - 2.0f * screenY) * tanY * z;
+
+		const unsigned int tileX = (std::min)(LightClusterBuilder::TILES_X - 1, static_cast<unsigned int>(screenX * LightClusterBuilder::TILES_X));
+		const unsigned int tileY = (std::min)(LightClusterBuilder::TILES_Y - 1, static_cast<unsigned int>(screenY * LightClusterBuilder::TILES_Y));
+		const float slice = logf(z) * scale + bias;
+		const unsigned int s = slice < 0.0f ? 0 : (std::min)(LightClusterBuilder::DEPTH_SLICES - 1, static_cast<unsigned int>(slice));
+
+		const LightClusterBuilder::Range range = builder.GetClusterRanges()[LightClusterBuilder::GetClusterIndex(tileX, tileY, s)];
+		const unsigned int * begin = builder.GetLightIndices().data() + range.Offset;
+		const unsigned int * end = begin + range.Count;
+		for (size_t i = 0; i < lights.X.size(); i++)
+		{
+			const float dx = lights.X[i] - x, dy = lights.Y[i] - y, dz = lights.Z[i] - z;
+			if (dx * dx + dy * dy + dz * dz >= lights.Radius[i] * lights.Radius[i])
+				continue;
+			touches++;
+			if (std::find(begin, end, static_cast<unsigned int>(i)) == end)
+				misses++;
+		}
+	}
+	CHECK(touches > 0);
+	CHECK(misses == 0);
+}
+
+TEST(LightCluster_PooledMatchesSerial)
+{
+	const LightSet lights = RandomLights(4000, 3);
+	LightClusterBuilder pooled(1u << 20, 4);
+	LightClusterBuilder serial(1u << 20, 1);
+	//Twice so the second build runs on parked workers
+	for (int frame = 0; frame < 2; frame++)
+	{
+		pooled.Build(CameraFrustum(), lights.Get());
+		serial.Build(CameraFrustum(), lights.Get());
+		CHECK(pooled.GetLightIndices() == serial.GetLightIndices());
+	}
+}
+
+TEST(LightCluster_IndexListIsCapped)
+{
+	const LightSet lights = RandomLights(4000, 4);
+	LightClusterBuilder builder(1000);
+	builder.Build(CameraFrustum(), lights.Get());
+	CHECK(builder.GetLightIndices().size() == 1000);
+	const LightClusterBuilder::Range last = builder.GetClusterRanges().back();
+	CHECK(last.Offset + last.Count <= 1000);
+}
+
+BENCHMARK(LightCluster_Build)
+{
+	const unsigned int hardwareThreads = (std::max)(1u, std::thread::hardware_concurrency());
+	LightClusterBuilder pooled;
+	LightClusterBuilder serial(1u << 20, 1);
+	for (const size_t count : { size_t(1000), size_t(4000), size_t(10000), size_t(16000) })
+	{
+		const LightSet lights = RandomLights(count, 5);
+		pooled.Build(CameraFrustum(), lights.Get());
+		const double pooledTime = Test::Time([&]() { pooled.Build(CameraFrustum(), lights.Get()); }, 50);
+		const double serialTime = Test::Time([&]() { serial.Build(CameraFrustum(), lights.Get()); }, 50);
+		printf("  %5zu lights: %u threads %.3f ms, serial %.3f ms, %zu indices\n", count, hardwareThreads, pooledTime, serialTime, pooled.GetLightIndices().size());
+	}
+}
@@ -0,0 +1,111 @@
+#include "Test.h"
+#include "LightRegistry.h"
+#include <cstring>
+#include <memory>
+#include <random>
+
+namespace
+{
+	const unsigned int POINT_TYPE = 0;
+	const unsigned int DIRECTIONAL_TYPE = 1;
+
+	// Stand ins for the lights of the old DeferredRender::_copyLightData loop
+	struct LightBase { virtual ~LightBase() = default; LightRegistry::GpuLight Row; };
+	struct PointLightStandIn : LightBase {};
+	struct DirectionalLightStandIn : LightBase {};
+}
+
+TEST(LightRegistry_ArraysStayParallel)
+{
+	LightRegistry registry;
+	registry.QueuePoint(nullptr, POINT_TYPE, DirectX::XMFLOAT4(1, 2, 3, 1), DirectX::XMFLOAT4(1, 0, 0, 1), DirectX::XMFLOAT4(2, 1, 3, 8));
+	registry.QueuePoint(nullptr, POINT_TYPE, DirectX::XMFLOAT4(4, 5, 6, 1), DirectX::XMFLOAT4(0, 1, 0, 1), DirectX::XMFLOAT4(1, 1, 1, 4));
+	registry.QueueDirectional(nullptr, DIRECTIONAL_TYPE, DirectX::XMFLOAT4(0, 10, 0, 1), DirectX::XMFLOAT4(1, 1, 1, 1), DirectX::XMFLOAT4(0, -1, 0, 0), 5.0f);
+
+	const LightRegistry::PointLights & points = registry.GetPointLights();
+	CHECK(points.Lights.size() == 2 && points.X.size() == 2 && points.Radius.size() == 2 && points.Table.size() == 2);
+	CHECK(points.X[1] == 4.0f && points.Y[1] == 5.0f && points.Z[1] == 6.0f);
+	CHECK(points.Radius[0] == 8.0f && points.Table[0].Vector.w == 8.0f);
+	CHECK(points.Table[1].Type.x == POINT_TYPE && points.Table[1].Color.y == 1.0f);
+
+	const LightRegistry::DirectionalLights & directionals = registry.GetDirectionalLights();
+	CHECK(directionals.Table.size() == 1);
+	CHECK(directionals.Table[0].Type.x == DIRECTIONAL_TYPE);
+	CHECK(directionals.Table[0].Vector.y == -1.0f && directionals.Table[0].Vector.w == 5.0f);
+	CHECK(registry.GetSize() == 3);
+
+	registry.Clear();
+	CHECK(registry.GetSize() == 0 && registry.GetPointLights().Table.empty() && registry.GetPointLights().X.empty());
+}
+
+TEST(LightRegistry_TableMatchesShaderStride)
+{
+	CHECK(sizeof(LightRegistry::GpuLight) == 64);
+}
+
+BENCHMARK(LightRegistry_TenThousandLights)
+{
+	const size_t count = 10000;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+	//1% directional, the rest point lights, in queue order
+	std::vector<std::unique_ptr<LightBase>> lights;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (i % 100 == 0)
+			lights.emplace_back(new DirectionalLightStandIn());
+		else
+			lights.emplace_back(new PointLightStandIn());
+		lights.back()->Row.Position = DirectX::XMFLOAT4(position(random), position(random), position(random), 1.0f);
+		lights.back()->Row.Vector = DirectX::XMFLOAT4(1.0f, 1.0f, 2.0f, 5.0f);
+	}
+	std::vector<LightRegistry::GpuLight> upload(count);
+
+	//Two casts, the cluster arrays and one copy per light
+	std::vector<float> x, y, z, radius;
+	std::vector<unsigned int> pointIndices, unclustered;
+	const double perLight = Test::Time([&]()
+	{
+		x.clear(); y.clear(); z.clear(); radius.clear();
+		pointIndices.clear(); unclustered.clear();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			LightRegistry::GpuLight values = lights[i]->Row;
+			if (PointLightStandIn * point = dynamic_cast<PointLightStandIn*>(lights[i].get()))
+			{
+				x.push_back(point->Row.Position.x);
+				y.push_back(point->Row.Position.y);
+				z.push_back(point->Row.Position.z);
+				radius.push_back(point->Row.Vector.w);
+				pointIndices.push_back(i);
+			}
+			else
+				unclustered.push_back(i);
+			if (DirectionalLightStandIn * directional = dynamic_cast<DirectionalLightStandIn*>(lights[i].get()))
+				values.Vector = directional->Row.Vector;
+			memcpy(&upload[i], &values, sizeof(LightRegistry::GpuLight));
+		}
+	}, 100);
+
+	LightRegistry registry;
+	registry.Reserve(count, count / 100);
+	const double registryTime = Test::Time([&]()
+	{
+		registry.Clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			const LightRegistry::GpuLight & row = lights[i]->Row;
+			if (i % 100 == 0)
+				registry.QueueDirectional(nullptr, DIRECTIONAL_TYPE, row.Position, row.Color, row.Vector, row.Vector.w);
+			else
+				registry.QueuePoint(nullptr, POINT_TYPE, row.Position, row.Color, row.Vector);
+		}
+		const LightRegistry::PointLights & points = registry.GetPointLights();
+		const LightRegistry::DirectionalLights & directionals = registry.GetDirectionalLights();
+		memcpy(upload.data(), points.Table.data(), points.Table.size() * sizeof(LightRegistry::GpuLight));
+		memcpy(upload.data() + points.Table.size(), directionals.Table.data(), directionals.Table.size() * sizeof(LightRegistry::GpuLight));
+	}, 100);
+
+	printf("  %zu lights: cast and copy per light %.3f ms, registry queue and two copies %.3f ms\n", count, perLight, registryTime);
+}
@@ -0,0 +1,35 @@
+#include "Test.h"
+#include <cstring>
+
+// HeadlessTests [--bench] [name filter]
+int main(int argc, char * argv[])
+{
+	bool benchmark = false;
+	const char * filter = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+			benchmark = true;
+		else
+			filter = argv[i];
+	}
+
+	int ran = 0;
+	for (const Test::Case & testCase : Test::Registry())
+	{
+		if (testCase.Benchmark != benchmark)
+			continue;
+		if (filter && strstr(testCase.Name, filter) == nullptr)
+			continue;
+
+		const int failures = Test::Failures();
+		printf("%s\n", testCase.Name);
+		testCase.Function();
+		if (Test::Failures() != failures)
+			printf("  %d check(s) failed\n", Test::Failures() - failures);
+		ran++;
+	}
+
+	printf("%d %s, %d failed check(s)\n", ran, benchmark ? "benchmark(s)" : "test(s)", Test::Failures());
+	return Test::Failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,338 @@
+#include "Test.h"
+#include "OcclusionCuller.h"
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	using namespace DirectX;
+
+	const unsigned int WIDTH = 256, HEIGHT = 128;
+
+	// Same stride as StaticVertex, the culler reads the positions out of the vertex buffers
+	struct Vertex
+	{
+		XMFLOAT4 Position;
+		float Rest[12];
+	};
+
+	// Looks down +z from z = -10, 60 degrees high and twice as wide as high
+	XMFLOAT4X4A _camera(const float & aspect = 2.0f, const float & farPlane = 100.0f)
+	{
+		const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, -10, 1), XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 0));
+		const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PI / 3.0f, aspect, 0.1f, farPlane);
+		XMFLOAT4X4A viewProjection;
+		XMStoreFloat4x4A(&viewProjection, XMMatrixTranspose(view * projection));
+		return viewProjection;
+	}
+
+	XMFLOAT4X4 _translation(const float & x, const float & y, const float & z)
+	{
+		XMFLOAT4X4A aligned;
+		XMStoreFloat4x4A(&aligned, XMMatrixTranspose(XMMatrixTranslation(x, y, z)));
+		XMFLOAT4X4 world;
+		memcpy(&world, &aligned, sizeof(world));
+		return world;
+	}
+
+	// World x that lands on screen pixel column x at distance z from the plane the camera looks at
+	float _worldX(const float & x, const float & z)
+	{
+		return (x / (WIDTH * 0.5f) - 1.0f) * (z + 10.0f) * std::tan(XM_PI / 6.0f) * 2.0f;
+	}
+
+	Vertex _vertex(const float & x, const float & y, const float & z)
+	{
+		Vertex vertex{};
+		vertex.Position = XMFLOAT4(x, y, z, 1.0f);
+		return vertex;
+	}
+
+	void _addQuad(std::vector<Vertex> & vertices, const float & x0, const float & y0, const float & x1, const float & y1, const float & z)
+	{
+		const Vertex corners[4] = { _vertex(x0, y0, z), _vertex(x1, y0, z), _vertex(x1, y1, z), _vertex(x0, y1, z) };
+		for (const int i : { 0, 1, 2, 0, 2, 3 })
+			vertices.push_back(corners[i]);
+	}
+
+	void _draw(OcclusionCuller & culler, const XMFLOAT4X4A & viewProjection, const std::vector<Vertex> & vertices)
+	{
+		culler.BeginFrame(viewProjection);
+		if (!vertices.empty())
+			culler.AddOccluder(&vertices[0].Position, vertices.size(), sizeof(Vertex), _translation(0, 0, 0));
+		culler.Rasterize();
+	}
+
+	// One triangle after the other in plain double math, covering the same pixel centers as the culler. The depth of a
+	// covered pixel is the farthest the triangle gets over the pixel, the culler keeps that too
+	struct ReferenceRasterizer
+	{
+		XMFLOAT4X4A ViewProjection;
+		std::vector<float> Depth = std::vector<float>(WIDTH * HEIGHT, 1.0f);
+
+		explicit ReferenceRasterizer(const XMFLOAT4X4A & viewProjection) : ViewProjection(viewProjection) {}
+
+		bool ToScreen(const XMFLOAT4 & position, double & x, double & y, double & z) const
+		{
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(XMLoadFloat4(&position), XMMatrixTranspose(XMLoadFloat4x4A(&ViewProjection))));
+			if (clip.z < 0.0f || clip.w <= 0.0f)
+				return false;
+			x = (clip.x / clip.w * 0.5 + 0.5) * WIDTH;
+			y = (0.5 - clip.y / clip.w * 0.5) * HEIGHT;
+			z = clip.z / clip.w;
+			return true;
+		}
+
+		// Calls covered(x, y, depth) for every pixel center inside the triangle, which has to be in front of the near plane
+		template<typename Covered>
+		void Rasterize(const XMFLOAT4 & a, const XMFLOAT4 & b, const XMFLOAT4 & c, const Covered & covered) const
+		{
+			double x[3], y[3], z[3];
+			if (!ToScreen(a, x[0], y[0], z[0]) || !ToScreen(b, x[1], y[1], z[1]) || !ToScreen(c, x[2], y[2], z[2]))
+				return;
+			const double area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (area == 0.0)
+				return;
+
+			const auto depthAt = [&](const double & px, const double & py, bool & inside)
+			{
+				double weight[3];
+				for (int i = 0; i < 3; i++)
+				{
+					const int j = (i + 1) % 3;
+					weight[(i + 2) % 3] = ((x[j] - x[i]) * (py - y[i]) - (y[j] - y[i]) * (px - x[i])) / area;
+				}
+				inside = weight[0] >= -1e-6 && weight[1] >= -1e-6 && weight[2] >= -1e-6;
+				return weight[0] * z[0] + weight[1] * z[1] + weight[2] * z[2];
+			};
+			for (unsigned int py = 0; py < HEIGHT; py++)
+			{
+				for (unsigned int px = 0; px < WIDTH; px++)
+				{
+					bool inside = false, unused;
+					depthAt(px + 0.5, py + 0.5, inside);
+					if (!inside)
+						continue;
+					double farthest = 0.0;
+					for (int corner = 0; corner < 4; corner++)
+						farthest = (std::max)(farthest, depthAt(px + (corner & 1), py + (corner >> 1), unused));
+					covered(px, py, static_cast<float>(farthest));
+				}
+			}
+		}
+
+		void Draw(const std::vector<Vertex> & vertices)
+		{
+			for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+			{
+				Rasterize(vertices[i].Position, vertices[i + 1].Position, vertices[i + 2].Position, [this](const unsigned int & x, const unsigned int & y, const float & depth)
+				{
+					Depth[y * WIDTH + x] = (std::min)(Depth[y * WIDTH + x], depth);
+				});
+			}
+		}
+
+		// Whether any pixel of the box is in front of what was drawn
+		bool Sees(const XMFLOAT3 & center, const XMFLOAT3 & extents) const
+		{
+			static const int faces[12][3] = { { 0, 1, 3 }, { 0, 3, 2 }, { 4, 5, 7 }, { 4, 7, 6 }, { 0, 1, 5 }, { 0, 5, 4 },
+				{ 2, 3, 7 }, { 2, 7, 6 }, { 0, 2, 6 }, { 0, 6, 4 }, { 1, 3, 7 }, { 1, 7, 5 } };
+			XMFLOAT4 corners[8];
+			for (int i = 0; i < 8; i++)
+			{
+				corners[i] = XMFLOAT4(center.x + (i & 1 ? extents.x : -extents.x), center.y + (i & 2 ? extents.y : -extents.y),
+					center.z + (i & 4 ? extents.z : -extents.z), 1.0f);
+			}
+			bool seen = false;
+			for (int f = 0; f < 12; f++)
+			{
+				Rasterize(corners[faces[f][0]], corners[faces[f][1]], corners[faces[f][2]], [&](const unsigned int & x, const unsigned int & y, const float & depth)
+				{
+					seen |= depth <= 1.0f && depth < Depth[y * WIDTH + x] - 1e-4f;
+				});
+			}
+			return seen;
+		}
+	};
+}
+
+TEST(OcclusionCuller_WallHidesWhatIsBehindIt)
+{
+	const XMFLOAT4X4A viewProjection = _camera();
+	OcclusionCuller culler(WIDTH, HEIGHT, 1);
+	CHECK(culler.GetWidth() == WIDTH && culler.GetHeight() == HEIGHT);
+	std::vector<Vertex> wall;
+	_addQuad(wall, -5, -5, 5, 5, 0);
+	_draw(culler, viewProjection, wall);
+	CHECK(culler.GetTriangleCount() == 2);
+
+	const XMFLOAT3 boxMin(-0.5f, -0.5f, -0.5f), boxMax(0.5f, 0.5f, 0.5f);
+	CHECK(!culler.IsVisible(boxMin, boxMax, _translation(0, 0, 5)));
+	CHECK(culler.IsVisible(boxMin, boxMax, _translation(0, 0, -3)));
+	CHECK(culler.IsVisible(boxMin, boxMax, _translation(8, 0, 5)));
+	//Peeking past the edge
+	CHECK(culler.IsVisible(boxMin, boxMax, _translation(7.3f, 0, 5)));
+	//Through the near plane, and around the whole wall
+	CHECK(culler.IsVisible(boxMin, boxMax, _translation(0, 0, -9.95f)));
+	CHECK(culler.IsVisible(XMFLOAT3(-20, -20, -1), XMFLOAT3(20, 20, 1), _translation(0, 0, 0)));
+	//Off screen and past the far plane
+	CHECK(!culler.IsVisible(boxMin, boxMax, _translation(200, 0, 5)));
+	CHECK(!culler.IsVisible(boxMin, boxMax, _translation(0, 0, 500)));
+
+	//Nothing drawn, everything on screen is visible
+	_draw(culler, viewProjection, {});
+	CHECK(culler.IsVisible(boxMin, boxMax, _translation(0, 0, 5)));
+	CHECK(culler.GetDepth(10, 10) == 1.0f);
+}
+
+TEST(OcclusionCuller_EdgeCoveringPixelCentersHidesNothingPastIt)
+{
+	//The wall ends 0.6 into the last pixel column of an 8 x 8 block, so every pixel center of the block is behind it
+	const XMFLOAT4X4A viewProjection = _camera();
+	OcclusionCuller culler(WIDTH, HEIGHT, 1);
+	std::vector<Vertex> wall;
+	_addQuad(wall, -20, -20, _worldX(127.6f, 0.0f), 20, 0);
+	_draw(culler, viewProjection, wall);
+	CHECK(culler.GetDepth(127, 64) < 1.0f);
+	CHECK(culler.GetDepth(128, 64) == 1.0f);
+
+	//A thin box behind the wall that only shows in the rest of that column
+	const float left = _worldX(127.7f, 5.0f), right = _worldX(127.9f, 5.0f);
+	CHECK(culler.IsVisible(XMFLOAT3(left, -0.2f, -0.05f), XMFLOAT3(right, 0.2f, 0.05f), _translation(0, 0, 5)));
+	//The same box a few pixels further in is hidden
+	const float inside = _worldX(120.0f, 5.0f) - right;
+	CHECK(!culler.IsVisible(XMFLOAT3(left + inside, -0.2f, -0.05f), XMFLOAT3(right + inside, 0.2f, 0.05f), _translation(0, 0, 5)));
+}
+
+TEST(OcclusionCuller_ClippedTriangleStillOccludes)
+{
+	//Starts behind the camera and reaches past the wall plane
+	const XMFLOAT4X4A viewProjection = _camera();
+	OcclusionCuller culler(WIDTH, HEIGHT, 1);
+	const std::vector<Vertex> floor = { _vertex(-50, -50, -20), _vertex(50, -50, -20), _vertex(0, 50, 2) };
+	_draw(culler, viewProjection, floor);
+	CHECK(culler.GetTriangleCount() >= 1);
+
+	bool inRange = true;
+	for (unsigned int y = 0; y < HEIGHT; y++)
+	{
+		for (unsigned int x = 0; x < WIDTH; x++)
+			inRange &= culler.GetDepth(x, y) >= 0.0f && culler.GetDepth(x, y) <= 1.0f;
+	}
+	CHECK(inRange);
+	CHECK(culler.GetDepth(WIDTH / 2, HEIGHT / 2) < 1.0f);
+}
+
+TEST(OcclusionCuller_MatchesReferenceAndNeverHidesWhatIsSeen)
+{
+	const XMFLOAT4X4A viewProjection = _camera();
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (int scene = 0; scene < 10; scene++)
+	{
+		std::vector<Vertex> triangles;
+		for (int t = 0; t < 20; t++)
+		{
+			const XMFLOAT3 center(unit(random) * 8.0f, unit(random) * 5.0f, unit(random) * 8.0f);
+			for (int v = 0; v < 3; v++)
+				triangles.push_back(_vertex(center.x + unit(random) * 3.0f, center.y + unit(random) * 3.0f, center.z + unit(random) * 3.0f));
+		}
+		OcclusionCuller culler(WIDTH, HEIGHT, 1);
+		_draw(culler, viewProjection, triangles);
+		ReferenceRasterizer reference(viewProjection);
+		reference.Draw(triangles);
+
+		//Pixel centers right on an edge can go either way
+		int different = 0;
+		for (unsigned int i = 0; i < WIDTH * HEIGHT; i++)
+			different += std::fabs(reference.Depth[i] - culler.GetDepth(i % WIDTH, i / WIDTH)) > 1e-4f;
+		CHECK(different < 10);
+
+		int wronglyHidden = 0;
+		for (int b = 0; b < 300; b++)
+		{
+			const XMFLOAT3 center(unit(random) * 10.0f, unit(random) * 6.0f, unit(random) * 15.0f);
+			const XMFLOAT3 extents(1.1f + unit(random), 1.1f + unit(random), 1.1f + unit(random));
+			if (reference.Sees(center, extents) && !culler.IsVisible(XMFLOAT3(-extents.x, -extents.y, -extents.z), extents, _translation(center.x, center.y, center.z)))
+				wronglyHidden++;
+		}
+		CHECK(wronglyHidden == 0);
+	}
+}
+
+TEST(OcclusionCuller_PoolDrawsTheSameDepth)
+{
+	const XMFLOAT4X4A viewProjection = _camera();
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Vertex> triangles;
+	for (int t = 0; t < 3000; t++)
+	{
+		const XMFLOAT3 center(unit(random) * 12.0f, unit(random) * 7.0f, unit(random) * 20.0f);
+		for (int v = 0; v < 3; v++)
+			triangles.push_back(_vertex(center.x + unit(random), center.y + unit(random), center.z + unit(random)));
+	}
+
+	//Enough triangles for the pool, and drawn twice so the parked workers are woken again
+	OcclusionCuller serial(WIDTH, HEIGHT, 1), pooled(WIDTH, HEIGHT, 4);
+	_draw(serial, viewProjection, triangles);
+	_draw(pooled, viewProjection, triangles);
+	_draw(pooled, viewProjection, triangles);
+	bool same = true;
+	for (unsigned int y = 0; y < HEIGHT; y++)
+	{
+		for (unsigned int x = 0; x < WIDTH; x++)
+			same &= serial.GetDepth(x, y) == pooled.GetDepth(x, y);
+	}
+	CHECK(same);
+	for (int b = 0; b < 1000; b++)
+	{
+		const XMFLOAT4X4 world = _translation(unit(random) * 10.0f, unit(random) * 6.0f, unit(random) * 20.0f);
+		const XMFLOAT3 boxMin(-0.3f, -0.3f, -0.3f), boxMax(0.3f, 0.3f, 0.3f);
+		same &= serial.IsVisible(boxMin, boxMax, world) == pooled.IsVisible(boxMin, boxMax, world);
+	}
+	CHECK(same);
+}
+
+TEST(OcclusionCuller_RoundsUpToTiles)
+{
+	OcclusionCuller culler(100, 50, 1);
+	CHECK(culler.GetWidth() == 128 && culler.GetHeight() == 64);
+}
+
+BENCHMARK(OcclusionCuller_DrawAndTest)
+{
+	const XMFLOAT4X4A viewProjection = _camera(16.0f / 9.0f, 200.0f);
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (const int count : { 1000, 10000, 50000 })
+	{
+		std::vector<Vertex> triangles;
+		for (int t = 0; t < count; t++)
+		{
+			const XMFLOAT3 center(unit(random) * 20.0f, unit(random) * 12.0f, 5.0f + (unit(random) + 1.0f) * 40.0f);
+			for (int v = 0; v < 3; v++)
+				triangles.push_back(_vertex(center.x + unit(random) * 2.0f, center.y + unit(random) * 2.0f, center.z + unit(random) * 2.0f));
+		}
+		std::vector<XMFLOAT4X4> boxes;
+		for (int b = 0; b < 10000; b++)
+			boxes.push_back(_translation(unit(random) * 25.0f, unit(random) * 15.0f, 10.0f + (unit(random) + 1.0f) * 50.0f));
+
+		for (const unsigned int threads : { 1u, 0u })
+		{
+			OcclusionCuller culler(WIDTH, HEIGHT, threads);
+			const double draw = Test::Time([&]() { _draw(culler, viewProjection, triangles); }, 20);
+			size_t visible = 0;
+			const double test = Test::Time([&]()
+			{
+				visible = 0;
+				for (const XMFLOAT4X4 & box : boxes)
+					visible += culler.IsVisible(XMFLOAT3(-0.5f, -0.5f, -0.5f), XMFLOAT3(0.5f, 0.5f, 0.5f), box);
+			}, 20);
+			printf("  %d triangles, %u threads: drawn in %.3f ms, 10000 boxes tested in %.3f ms, %.1f%% hidden\n",
+				count, threads ? threads : std::thread::hardware_concurrency(), draw, test, 100.0 - visible / 100.0);
+		}
+	}
+}
@@ -0,0 +1,159 @@
+#include "Test.h"
+#include "ParticleBillboard.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+	using namespace DirectX;
+
+	std::string _readShader(const char * path)
+	{
+		std::ifstream file(path);
+		std::stringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+
+	// The float2 values of a constant array in HLSL, in the order they are written
+	std::vector<XMFLOAT2> _parseCorners(const std::string & shader, const std::string & name)
+	{
+		std::vector<XMFLOAT2> corners;
+		const size_t start = shader.find(name);
+		const size_t end = shader.find("};", start);
+		if (start == std::string::npos || end == std::string::npos)
+			return corners;
+		for (size_t at = shader.find("float2(", start); at < end; at = shader.find("float2(", at + 1))
+		{
+			char * next = nullptr;
+			const float x = std::strtof(shader.c_str() + at + 7, &next);
+			const float y = std::strtof(next + 1, nullptr);
+			corners.push_back(XMFLOAT2(x, y));
+		}
+		return corners;
+	}
+
+	float _distance(const XMFLOAT4 & a, const XMFLOAT4 & b)
+	{
+		return XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat4(&a), XMLoadFloat4(&b))));
+	}
+
+	float _dot(const XMFLOAT4 & a, const XMFLOAT4 & b, const XMFLOAT4 & direction)
+	{
+		return XMVectorGetX(XMVector3Dot(XMVectorSubtract(XMLoadFloat4(&a), XMLoadFloat4(&b)), XMLoadFloat4(&direction)));
+	}
+
+	ParticleInstance _instance(const XMFLOAT3 & position, const XMFLOAT2 & size, const unsigned int & textureIndex)
+	{
+		ParticleInstance instance;
+		instance.Position = position;
+		instance.Size = size;
+		instance.TextureIndex = textureIndex;
+		return instance;
+	}
+}
+
+TEST(ParticleBillboard_ShaderMatchesReference)
+{
+	//The corner table of the vertex shader is the one of the reference, in the same SV_VertexID order
+	const std::string vertexShader = _readShader(ENGINE_SHADER_DIR "/GeometryPass/DefaultGeometryParticleVertex.hlsl");
+	const std::vector<XMFLOAT2> corners = _parseCorners(vertexShader, "QuadCorners[6]");
+	CHECK(corners.size() == ParticleBillboard::VERTICES_PER_PARTICLE);
+	bool sameCorners = corners.size() == ParticleBillboard::VERTICES_PER_PARTICLE;
+	for (unsigned int i = 0; i < corners.size(); i++)
+		sameCorners &= corners[i].x == ParticleBillboard::GetCorner(i).x && corners[i].y == ParticleBillboard::GetCorner(i).y;
+	CHECK(sameCorners);
+	CHECK(vertexShader.find("QuadCorners[input.vertexId % 6]") != std::string::npos);
+	CHECK(vertexShader.find("(right * corner.x * input.size.x) + (up * corner.y * input.size.y)") != std::string::npos);
+	CHECK(vertexShader.find("float4(corner.x * 0.5f + 0.5f, 0.5f - corner.y * 0.5f, input.textureIndex, 0)") != std::string::npos);
+
+	//The compute shader writes the instance the reference expands and picks the texture by thirds of the life
+	const std::string computeShader = _readShader(ENGINE_SHADER_DIR "/ParticlePass/DefaultParticleCompute.hlsl");
+	CHECK(computeShader.find("float3 Position;\n    float2 Size;\n    uint TextureIndex;") != std::string::npos);
+	CHECK(computeShader.find("float third = particleInfo.z / 3.0f;") != std::string::npos);
+	CHECK(computeShader.find("if (particleInfo.y > third)\n        textureIndex = 1;") != std::string::npos);
+	CHECK(computeShader.find("if (particleInfo.y > third * 2)\n        textureIndex = 2;") != std::string::npos);
+}
+
+TEST(ParticleBillboard_ExpandsCornersAndUVs)
+{
+	//Looking down +z the cross products of the shader make right -x and up -y
+	const XMFLOAT4 camera(0, 0, -10, 1);
+	const ParticleInstance instance = _instance(XMFLOAT3(0, 0, 0), XMFLOAT2(1, 1), 2);
+	ParticleVertex vertices[ParticleBillboard::VERTICES_PER_PARTICLE];
+	ParticleBillboard::Expand(instance, camera, vertices);
+
+	const XMFLOAT4 expected[4] = { XMFLOAT4(1, 1, 0, 1), XMFLOAT4(1, -1, 0, 1), XMFLOAT4(-1, -1, 0, 1), XMFLOAT4(-1, 1, 0, 1) };
+	const XMFLOAT2 uvs[4] = { XMFLOAT2(0, 1), XMFLOAT2(0, 0), XMFLOAT2(1, 0), XMFLOAT2(1, 1) };
+	bool corners = true;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		corners &= _distance(vertices[i].Position, expected[i]) < 1e-5f && vertices[i].Position.w == 1.0f;
+		corners &= vertices[i].TexCord.x == uvs[i].x && vertices[i].TexCord.y == uvs[i].y && vertices[i].TexCord.z == 2.0f;
+	}
+	CHECK(corners);
+
+	//Two triangles, the last two vertices close the quad again
+	CHECK(memcmp(&vertices[4], &vertices[0], sizeof(ParticleVertex)) == 0);
+	CHECK(memcmp(&vertices[5], &vertices[2], sizeof(ParticleVertex)) == 0);
+	const ParticleVertex wrapped = ParticleBillboard::ExpandVertex(instance, camera, 7);
+	CHECK(memcmp(&wrapped, &vertices[1], sizeof(ParticleVertex)) == 0);
+}
+
+TEST(ParticleBillboard_ScalesBySize)
+{
+	//Size is half the width and height of the quad, each along its own axis and facing the camera from any side
+	const XMFLOAT4 camera(3, 4, -2, 1);
+	const XMFLOAT3 position(-1, 2, 5);
+	const ParticleInstance instance = _instance(position, XMFLOAT2(0.5f, 2.0f), 0);
+	ParticleVertex vertices[ParticleBillboard::VERTICES_PER_PARTICLE];
+	ParticleBillboard::Expand(instance, camera, vertices);
+
+	XMFLOAT4 right, up, toCamera;
+	XMStoreFloat4(&right, XMVectorSubtract(XMLoadFloat4(&vertices[3].Position), XMLoadFloat4(&vertices[0].Position)));
+	XMStoreFloat4(&up, XMVectorSubtract(XMLoadFloat4(&vertices[1].Position), XMLoadFloat4(&vertices[0].Position)));
+	XMStoreFloat4(&toCamera, XMVectorSubtract(XMLoadFloat4(&camera), XMLoadFloat3(&position)));
+	CHECK(std::fabs(XMVectorGetX(XMVector3Length(XMLoadFloat4(&right))) - 1.0f) < 1e-5f);
+	CHECK(std::fabs(XMVectorGetX(XMVector3Length(XMLoadFloat4(&up))) - 4.0f) < 1e-5f);
+	CHECK(std::fabs(_dot(vertices[3].Position, vertices[0].Position, up)) < 1e-5f);
+	CHECK(std::fabs(_dot(vertices[3].Position, vertices[0].Position, toCamera)) < 1e-5f);
+	CHECK(std::fabs(_dot(vertices[1].Position, vertices[0].Position, toCamera)) < 1e-5f);
+
+	//Centered on the particle
+	XMFLOAT4 center;
+	XMStoreFloat4(&center, XMVectorScale(XMVectorAdd(XMLoadFloat4(&vertices[0].Position), XMLoadFloat4(&vertices[2].Position)), 0.5f));
+	CHECK(_distance(center, XMFLOAT4(position.x, position.y, position.z, 1)) < 1e-5f);
+
+	//Twice the size, twice as far from the center
+	ParticleVertex doubled[ParticleBillboard::VERTICES_PER_PARTICLE];
+	ParticleBillboard::Expand(_instance(position, XMFLOAT2(1.0f, 4.0f), 0), camera, doubled);
+	CHECK(std::fabs(_distance(doubled[2].Position, center) - 2.0f * _distance(vertices[2].Position, center)) < 1e-4f);
+}
+
+TEST(ParticleBillboard_PacksTextureByAge)
+{
+	CHECK(ParticleBillboard::GetTextureIndex(0.0f, 3.0f) == 0);
+	CHECK(ParticleBillboard::GetTextureIndex(1.0f, 3.0f) == 0);
+	CHECK(ParticleBillboard::GetTextureIndex(1.5f, 3.0f) == 1);
+	CHECK(ParticleBillboard::GetTextureIndex(2.0f, 3.0f) == 1);
+	CHECK(ParticleBillboard::GetTextureIndex(2.5f, 3.0f) == 2);
+	CHECK(ParticleBillboard::GetTextureIndex(10.0f, 3.0f) == ParticleBillboard::AGE_TEXTURES - 1);
+
+	//The index reaches the vertex shader untouched as the third texture coordinate
+	for (unsigned int textureIndex = 0; textureIndex < ParticleBillboard::AGE_TEXTURES; textureIndex++)
+	{
+		const ParticleVertex vertex = ParticleBillboard::ExpandVertex(_instance(XMFLOAT3(0, 0, 0), XMFLOAT2(1, 1), textureIndex), XMFLOAT4(0, 0, -1, 1), 0);
+		CHECK(vertex.TexCord.z == static_cast<float>(textureIndex));
+	}
+}
+
+TEST(ParticleBillboard_InstanceIsAnEighthOfTheQuad)
+{
+	//What the compute shader used to write per particle against what it writes now
+	CHECK(sizeof(ParticleInstance) == 24);
+	CHECK(sizeof(ParticleVertex) * ParticleBillboard::VERTICES_PER_PARTICLE == 8 * sizeof(ParticleInstance));
+}
@@ -0,0 +1,137 @@
+#include "Test.h"
+#include "ParticleLod.h"
+#include <random>
+
+namespace
+{
+	using namespace DirectX;
+
+	const float FOV = XM_PI / 3.0f;
+
+	// Camera at the origin looking down +z, the transposed matrix the camera keeps for the shaders
+	ParticleLod::Frustum _frustum()
+	{
+		const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 0, 1, 1), XMVectorSet(0, 1, 0, 0));
+		const XMMATRIX projection = XMMatrixPerspectiveFovLH(FOV, 1.0f, 0.1f, 1000.0f);
+		XMFLOAT4X4A viewProjection;
+		XMStoreFloat4x4A(&viewProjection, XMMatrixTranspose(view * projection));
+		return ParticleLod::CreateFrustum(viewProjection);
+	}
+
+	// Distance where an emitter of the radius is projected to the size
+	float _distanceFor(const float & size, const float & radius)
+	{
+		return radius / (size * std::tan(FOV * 0.5f));
+	}
+
+	ParticleLod::Result _evaluate(const float & z, const ParticleLod::Settings & settings, const bool & sleeping = false, const float & x = 0.0f)
+	{
+		return ParticleLod::Evaluate(_frustum(), XMFLOAT4(0, 0, 0, 1), FOV, XMFLOAT4(x, 0, z, 1), 1.0f, settings, sleeping);
+	}
+}
+
+TEST(ParticleLod_ScalesByScreenSize)
+{
+	const ParticleLod::Settings settings;
+	const ParticleLod::Result close = _evaluate(2.0f, settings);
+	CHECK(close.Visible && !close.Sleeping && close.Scale == 1.0f);
+
+	//Half the full detail size runs at half the rate
+	const ParticleLod::Result half = _evaluate(_distanceFor(settings.FullDetailSize * 0.5f, 1.0f), settings);
+	CHECK(half.Visible && !half.Sleeping);
+	CHECK(std::fabs(half.Scale - 0.5f) < 1e-3f);
+
+	//Never below the minimum while still awake
+	const ParticleLod::Result far = _evaluate(_distanceFor(settings.SleepSize * 1.5f, 1.0f), settings);
+	CHECK(far.Visible && !far.Sleeping && far.Scale == settings.MinScale);
+}
+
+TEST(ParticleLod_OutsideTheFrustumGetsNothing)
+{
+	const ParticleLod::Settings settings;
+	const ParticleLod::Result behind = _evaluate(-20.0f, settings);
+	CHECK(!behind.Visible && behind.Scale == 0.0f);
+	const ParticleLod::Result beside = _evaluate(10.0f, settings, false, 50.0f);
+	CHECK(!beside.Visible && beside.Scale == 0.0f);
+	//Past the far plane
+	CHECK(_evaluate(1100.0f, settings).Scale == 0.0f);
+	//The bounds reaching into the frustum are enough
+	CHECK(_evaluate(10.0f, settings, false, 6.5f).Visible);
+}
+
+TEST(ParticleLod_SleepsUntilWithinWakeDistance)
+{
+	const ParticleLod::Settings settings;
+	const float sleepDistance = _distanceFor(settings.SleepSize, 1.0f);
+	const float wakeDistance = _distanceFor(settings.WakeSize, 1.0f);
+	CHECK(wakeDistance < sleepDistance);
+
+	//Coming closer from far away, asleep until the wake distance and not at the sleep distance
+	bool sleeping = false;
+	bool wokeEarly = false, wokeLate = false;
+	for (float z = sleepDistance * 1.5f; z > wakeDistance * 0.5f; z -= 1.0f)
+	{
+		const ParticleLod::Result result = _evaluate(z, settings, sleeping);
+		if (z > sleepDistance * 1.01f)
+			CHECK(result.Sleeping);
+		wokeEarly |= !result.Sleeping && z > wakeDistance * 1.01f;
+		wokeLate |= result.Sleeping && z < wakeDistance * 0.99f;
+		sleeping = result.Sleeping;
+	}
+	CHECK(!wokeEarly);
+	CHECK(!wokeLate);
+	CHECK(!sleeping);
+
+	//Going away again it runs until the sleep distance, between the two it keeps what it was
+	const float between = (sleepDistance + wakeDistance) * 0.5f;
+	CHECK(!_evaluate(between, settings, false).Sleeping);
+	CHECK(_evaluate(between, settings, true).Sleeping);
+	CHECK(_evaluate(sleepDistance * 1.01f, settings, false).Sleeping);
+
+	//Leaving the frustum does not wake it
+	const ParticleLod::Result offScreen = _evaluate(-between, settings, true);
+	CHECK(!offScreen.Visible && offScreen.Sleeping);
+}
+
+TEST(ParticleLod_BudgetIsNeverExceeded)
+{
+	//Under the budget everything is granted
+	const unsigned int small[3] = { 100, 0, 250 };
+	unsigned int granted[3];
+	CHECK(ParticleLod::ApplyBudget(small, granted, 3, 1000) == 350);
+	CHECK(granted[0] == 100 && granted[1] == 0 && granted[2] == 250);
+
+	std::mt19937 random(5);
+	for (int round = 0; round < 200; round++)
+	{
+		std::vector<unsigned int> requested(1 + random() % 300);
+		unsigned long long total = 0;
+		for (unsigned int & count : requested)
+		{
+			count = random() % 4097;
+			total += count;
+		}
+		const unsigned int budget = static_cast<unsigned int>(random() % (total + 1));
+		std::vector<unsigned int> given(requested.size());
+		const unsigned int grantedTotal = ParticleLod::ApplyBudget(requested.data(), given.data(), requested.size(), budget);
+
+		unsigned long long sum = 0;
+		bool proportional = true;
+		for (size_t i = 0; i < requested.size(); i++)
+		{
+			sum += given[i];
+			//The same share of the budget as of the requests, rounded down
+			const double share = static_cast<double>(requested[i]) * budget / total;
+			proportional &= given[i] <= requested[i] && given[i] <= share + 1e-6 && given[i] + 1 > share - 1e-6;
+		}
+		CHECK(sum == grantedTotal);
+		CHECK(grantedTotal <= budget);
+		CHECK(grantedTotal + requested.size() >= budget);
+		CHECK(proportional);
+	}
+
+	//No budget, nothing granted
+	const unsigned int requested[2] = { 10, 20 };
+	CHECK(ParticleLod::ApplyBudget(requested, granted, 2, 0) == 0);
+	CHECK(granted[0] == 0 && granted[1] == 0);
+}
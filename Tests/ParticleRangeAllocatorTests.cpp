@@ -0,0 +1,125 @@
+#include "Test.h"
+#include "ParticleRangeAllocator.h"
+#include <cstddef>
+
+namespace
+{
+	// ParticlePass::THREAD_GROUP_SIZE, the compute shaders run 64 particles per group
+	const unsigned int THREAD_GROUP_SIZE = 64;
+
+	// Every range inside the allocated part, one after the other without gaps or overlap
+	bool _isPacked(const ParticleRangeAllocator & ranges)
+	{
+		unsigned int offset = 0;
+		for (size_t i = 0; i < ranges.GetRangeCount(); i++)
+		{
+			if (ranges.GetRange(i).Offset != offset)
+				return false;
+			offset += ranges.GetRange(i).Count;
+		}
+		return offset == ranges.GetAllocated() && offset <= ranges.GetCapacity();
+	}
+}
+
+TEST(ParticleRangeAllocator_ClampsToThePool)
+{
+	ParticleRangeAllocator ranges(100);
+	CHECK(ranges.Allocate(60).Count == 60);
+	const ParticleRangeAllocator::Range clamped = ranges.Allocate(60);
+	CHECK(clamped.Offset == 60 && clamped.Count == 40);
+
+	//A full pool still hands out a range so the indices match the emitters
+	const ParticleRangeAllocator::Range empty = ranges.Allocate(10);
+	CHECK(empty.Offset == 100 && empty.Count == 0);
+	CHECK(ranges.GetRangeCount() == 3);
+	CHECK(ranges.GetAllocated() == 100);
+	CHECK(ranges.GetDrawArguments(2).InstanceCount == 0);
+	CHECK(_isPacked(ranges));
+
+	//A single emitter asking for more than everything
+	ranges.SetCapacity(32);
+	CHECK(ranges.GetRangeCount() == 0);
+	CHECK(ranges.Allocate(1000).Count == 32);
+}
+
+TEST(ParticleRangeAllocator_RangesDoNotOverlapAfterAddAndRemove)
+{
+	//The ranges are packed again every frame from the emitters that are left
+	std::vector<unsigned int> emitters = { 10, 200, 0, 64, 7 };
+	ParticleRangeAllocator ranges(1000);
+	for (int frame = 0; frame < 4; frame++)
+	{
+		ranges.Reset();
+		for (const unsigned int count : emitters)
+			ranges.Allocate(count);
+		CHECK(ranges.GetRangeCount() == emitters.size());
+		CHECK(_isPacked(ranges));
+
+		//The range of an emitter is what its draw reads
+		bool drawsItsRange = true;
+		for (size_t i = 0; i < ranges.GetRangeCount(); i++)
+		{
+			const ParticleRangeAllocator::DrawArguments arguments = ranges.GetDrawArguments(i);
+			drawsItsRange &= arguments.StartInstanceLocation == ranges.GetRange(i).Offset;
+			drawsItsRange &= arguments.InstanceCount == ranges.GetRange(i).Count;
+			drawsItsRange &= arguments.VertexCountPerInstance == 6 && arguments.StartVertexLocation == 0;
+		}
+		CHECK(drawsItsRange);
+
+		emitters.erase(emitters.begin() + 1);
+		emitters.push_back(300 + frame);
+		emitters.insert(emitters.begin(), 5);
+	}
+
+	//More than fits, the last emitters are cut and nothing overlaps
+	emitters.assign(8, 300);
+	ranges.Reset();
+	for (const unsigned int count : emitters)
+		ranges.Allocate(count);
+	CHECK(_isPacked(ranges));
+	CHECK(ranges.GetAllocated() == 1000);
+	CHECK(ranges.GetRange(3).Count == 100 && ranges.GetRange(4).Count == 0);
+}
+
+TEST(ParticleRangeAllocator_RoundsDispatchUpToGroups)
+{
+	ParticleRangeAllocator ranges(1000);
+	CHECK(ranges.GetDispatchGroups(THREAD_GROUP_SIZE) == 0);
+	ranges.Allocate(1);
+	CHECK(ranges.GetDispatchGroups(THREAD_GROUP_SIZE) == 1);
+	ranges.Allocate(63);
+	CHECK(ranges.GetDispatchGroups(THREAD_GROUP_SIZE) == 1);
+	ranges.Allocate(1);
+	CHECK(ranges.GetDispatchGroups(THREAD_GROUP_SIZE) == 2);
+	ranges.Allocate(63);
+	CHECK(ranges.GetDispatchGroups(THREAD_GROUP_SIZE) == 2);
+
+	//Empty emitters add no groups
+	ranges.Reset();
+	ranges.Allocate(0);
+	ranges.Allocate(0);
+	CHECK(ranges.GetDispatchGroups(THREAD_GROUP_SIZE) == 0);
+}
+
+TEST(ParticleRangeAllocator_DrawCommandLayout)
+{
+	//The command signature reads the texture index root constant and then D3D12_DRAW_ARGUMENTS, tightly packed
+	CHECK(sizeof(ParticleRangeAllocator::DrawArguments) == 4 * sizeof(unsigned int));
+	CHECK(offsetof(ParticleRangeAllocator::DrawArguments, VertexCountPerInstance) == 0);
+	CHECK(offsetof(ParticleRangeAllocator::DrawArguments, InstanceCount) == 4);
+	CHECK(offsetof(ParticleRangeAllocator::DrawArguments, StartVertexLocation) == 8);
+	CHECK(offsetof(ParticleRangeAllocator::DrawArguments, StartInstanceLocation) == 12);
+	CHECK(offsetof(ParticleRangeAllocator::DrawCommand, TextureIndex) == 0);
+	CHECK(offsetof(ParticleRangeAllocator::DrawCommand, Arguments) == 4);
+	CHECK(sizeof(ParticleRangeAllocator::DrawCommand) == 20);
+
+	//Commands written one after the other are read back at the stride
+	ParticleRangeAllocator ranges(100, 4);
+	ranges.Allocate(30);
+	ranges.Allocate(50);
+	const ParticleRangeAllocator::DrawCommand commands[2] = { { 3, ranges.GetDrawArguments(0) }, { 9, ranges.GetDrawArguments(1) } };
+	const unsigned int * words = reinterpret_cast<const unsigned int *>(commands);
+	const unsigned int stride = sizeof(ParticleRangeAllocator::DrawCommand) / sizeof(unsigned int);
+	CHECK(words[0] == 3 && words[1] == 4 && words[2] == 30 && words[3] == 0 && words[4] == 0);
+	CHECK(words[stride] == 9 && words[stride + 1] == 4 && words[stride + 2] == 50 && words[stride + 3] == 0 && words[stride + 4] == 30);
+}
@@ -0,0 +1,88 @@
+#include "Test.h"
+#include "ParticleSort.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+namespace
+{
+	std::vector<float> RandomKeys(const size_t & count, const unsigned int & seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+		std::vector<float> keys(count);
+		for (float & key : keys)
+			key = distribution(random);
+		//Duplicates to check stability
+		for (size_t i = 1; i < count; i += 7)
+			keys[i] = keys[i - 1];
+		return keys;
+	}
+
+	std::vector<unsigned int> ReferenceOrder(const std::vector<float> & keys, const bool & descending)
+	{
+		std::vector<unsigned int> order(keys.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](const unsigned int & a, const unsigned int & b)
+		{
+			return descending ? keys[a] > keys[b] : keys[a] < keys[b];
+		});
+		return order;
+	}
+}
+
+TEST(ParticleSort_FloatKeysKeepOrder)
+{
+	const float values[] = { -1e30f, -5.0f, -0.5f, -0.0f, 0.0f, 0.25f, 3.0f, 1e30f };
+	for (size_t i = 1; i < sizeof(values) / sizeof(values[0]); i++)
+		CHECK(ParticleSort::FloatToKey(values[i - 1]) <= ParticleSort::FloatToKey(values[i]));
+}
+
+TEST(ParticleSort_MatchesStableSort)
+{
+	ParticleSort sort;
+	for (const size_t count : { size_t(0), size_t(1), size_t(7), size_t(1000), size_t(65536) })
+	{
+		const std::vector<float> keys = RandomKeys(count, static_cast<unsigned int>(count));
+		CHECK(sort.SortAscending(keys.data(), count) == ReferenceOrder(keys, false));
+		CHECK(sort.SortDescending(keys.data(), count) == ReferenceOrder(keys, true));
+	}
+}
+
+TEST(ParticleSort_UnsignedKeys)
+{
+	ParticleSort sort;
+	const unsigned int keys[] = { 5, 0xFFFFFFFFu, 3, 5, 0, 0x10000u };
+	const std::vector<unsigned int> expected = { 4, 2, 0, 3, 5, 1 };
+	CHECK(sort.Sort(keys, 6) == expected);
+}
+
+TEST(ParticleSort_ReusesScratchAcrossSizes)
+{
+	ParticleSort sort;
+	const std::vector<float> large = RandomKeys(4096, 1);
+	sort.SortDescending(large.data(), large.size());
+	const std::vector<float> small = RandomKeys(10, 2);
+	CHECK(sort.SortDescending(small.data(), small.size()) == ReferenceOrder(small, true));
+}
+
+BENCHMARK(ParticleSort_RadixVersusStdSort)
+{
+	ParticleSort sort;
+	//Up to the particle pool of ParticlePass
+	for (const size_t count : { size_t(1024), size_t(16384), size_t(4096 * 32) })
+	{
+		const std::vector<float> keys = RandomKeys(count, 3);
+		std::vector<unsigned int> order(count);
+		const int repetitions = count > 16384 ? 20 : 200;
+
+		const double radix = Test::Time([&]() { sort.SortDescending(keys.data(), count); }, repetitions);
+		const double reference = Test::Time([&]()
+		{
+			std::iota(order.begin(), order.end(), 0u);
+			std::sort(order.begin(), order.end(), [&](const unsigned int & a, const unsigned int & b) { return keys[a] > keys[b]; });
+		}, repetitions);
+
+		printf("  %7zu keys: radix %.3f ms, std::sort %.3f ms\n", count, radix, reference);
+	}
+}
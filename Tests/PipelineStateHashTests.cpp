@@ -0,0 +1,180 @@
+#include "Test.h"
+#include "PipelineStateHash.h"
+#include <cstring>
+
+namespace
+{
+	// The fields of the D3D12 descriptions PipelineStateHash reads, with the same names and types
+	struct ShaderBytecode { const void * pShaderBytecode; size_t BytecodeLength; };
+	struct SoDeclarationEntry { unsigned int Stream; const char * SemanticName; unsigned int SemanticIndex; unsigned char StartComponent; unsigned char ComponentCount; unsigned char OutputSlot; };
+	struct StreamOutputDesc { const SoDeclarationEntry * pSODeclaration; unsigned int NumEntries; const unsigned int * pBufferStrides; unsigned int NumStrides; unsigned int RasterizedStream; };
+	struct RenderTargetBlendDesc { int BlendEnable; int LogicOpEnable; int SrcBlend, DestBlend, BlendOp, SrcBlendAlpha, DestBlendAlpha, BlendOpAlpha, LogicOp; unsigned char RenderTargetWriteMask; };
+	struct BlendDesc { int AlphaToCoverageEnable; int IndependentBlendEnable; RenderTargetBlendDesc RenderTarget[8]; };
+	struct RasterizerDesc { int FillMode; int CullMode; int FrontCounterClockwise; int DepthBias; float DepthBiasClamp; float SlopeScaledDepthBias; int DepthClipEnable; int MultisampleEnable; int AntialiasedLineEnable; unsigned int ForcedSampleCount; int ConservativeRaster; };
+	struct DepthStencilOpDesc { int StencilFailOp, StencilDepthFailOp, StencilPassOp, StencilFunc; };
+	struct DepthStencilDesc { int DepthEnable; int DepthWriteMask; int DepthFunc; int StencilEnable; unsigned char StencilReadMask; unsigned char StencilWriteMask; DepthStencilOpDesc FrontFace, BackFace; };
+	enum InputClassification { PER_VERTEX_DATA = 0, PER_INSTANCE_DATA = 1 };
+	struct InputElementDesc { const char * SemanticName; unsigned int SemanticIndex; int Format; unsigned int InputSlot; unsigned int AlignedByteOffset; InputClassification InputSlotClass; unsigned int InstanceDataStepRate; };
+	struct InputLayoutDesc { const InputElementDesc * pInputElementDescs; unsigned int NumElements; };
+	struct MultisampleDesc { unsigned int Count; unsigned int Quality; };
+	struct CachedPipelineState { const void * pCachedBlob; size_t CachedBlobSizeInBytes; };
+	struct GraphicsPipelineStateDesc { void * pRootSignature; ShaderBytecode VS, PS, DS, HS, GS; StreamOutputDesc StreamOutput; BlendDesc BlendState; unsigned int SampleMask; RasterizerDesc RasterizerState; DepthStencilDesc DepthStencilState; InputLayoutDesc InputLayout; int IBStripCutValue; int PrimitiveTopologyType; unsigned int NumRenderTargets; int RTVFormats[8]; int DSVFormat; MultisampleDesc SampleDesc; unsigned int NodeMask; CachedPipelineState CachedPSO; int Flags; };
+	struct ComputePipelineStateDesc { void * pRootSignature; ShaderBytecode CS; unsigned int NodeMask; CachedPipelineState CachedPSO; int Flags; };
+
+	const int FORMAT_R32G32B32A32_FLOAT = 2;
+	const int FORMAT_R32G32B32A32_UINT = 3;
+	const int FORMAT_D32_FLOAT = 40;
+
+	unsigned char g_vertexShader[256];
+	unsigned char g_copiedVertexShader[256];
+	InputElementDesc g_layouts[2][2];
+
+	// Ignored fields and padding are filled with garbage, they must not reach the key
+	GraphicsPipelineStateDesc Describe(const void * vertexShader, const char * position, const unsigned char & garbage, InputElementDesc * layout)
+	{
+		GraphicsPipelineStateDesc desc;
+		memset(&desc, garbage, sizeof(desc));
+		layout[0] = { position, 0, FORMAT_R32G32B32A32_FLOAT, 0, 0, PER_VERTEX_DATA, garbage };
+		layout[1] = { "WORLD", 0, FORMAT_R32G32B32A32_FLOAT, 1, 0, PER_INSTANCE_DATA, 1 };
+
+		desc.pRootSignature = nullptr;
+		desc.VS = { vertexShader, 256 };
+		desc.PS = desc.DS = desc.HS = desc.GS = { nullptr, 0 };
+		desc.StreamOutput.pSODeclaration = nullptr;
+		desc.StreamOutput.NumEntries = 0;
+		desc.StreamOutput.pBufferStrides = nullptr;
+		desc.StreamOutput.NumStrides = 0;
+		desc.BlendState.AlphaToCoverageEnable = 0;
+		desc.BlendState.IndependentBlendEnable = 0;
+		desc.BlendState.RenderTarget[0].BlendEnable = 0;
+		desc.BlendState.RenderTarget[0].LogicOpEnable = 0;
+		desc.BlendState.RenderTarget[0].RenderTargetWriteMask = 15;
+		desc.SampleMask = ~0u;
+		desc.RasterizerState = { 3, 3, 0, 0, 0.0f, 0.0f, 1, 0, 0, 0, 0 };
+		desc.DepthStencilState.DepthEnable = 1;
+		desc.DepthStencilState.DepthWriteMask = 1;
+		desc.DepthStencilState.DepthFunc = 2;
+		desc.DepthStencilState.StencilEnable = 0;
+		desc.InputLayout = { layout, 2 };
+		desc.IBStripCutValue = 0;
+		desc.PrimitiveTopologyType = 3;
+		desc.NumRenderTargets = 2;
+		desc.RTVFormats[0] = desc.RTVFormats[1] = FORMAT_R32G32B32A32_FLOAT;
+		desc.DSVFormat = FORMAT_D32_FLOAT;
+		desc.SampleDesc = { 1, 0 };
+		desc.NodeMask = 0;
+		desc.Flags = 0;
+		desc.CachedPSO = { garbage ? &g_vertexShader : nullptr, garbage };
+		return desc;
+	}
+
+	uint64_t Key(const GraphicsPipelineStateDesc & desc, const uint64_t & rootSignature = 5)
+	{
+		return PipelineStateHash::Hash(PipelineStateHash::SerializeGraphics(desc, rootSignature));
+	}
+
+	void FillShaders()
+	{
+		for (int i = 0; i < 256; i++)
+			g_vertexShader[i] = g_copiedVertexShader[i] = static_cast<unsigned char>(i * 7);
+	}
+}
+
+TEST(PipelineStateHash_EqualPipelinesShareAKey)
+{
+	FillShaders();
+	//Different garbage, a copy of the bytecode and the semantic in lower case build the same pipeline
+	const std::vector<unsigned char> a = PipelineStateHash::SerializeGraphics(Describe(g_vertexShader, "POSITION", 0x00, g_layouts[0]), 5);
+	const std::vector<unsigned char> b = PipelineStateHash::SerializeGraphics(Describe(g_copiedVertexShader, "position", 0xCD, g_layouts[1]), 5);
+	CHECK(a == b);
+	CHECK(PipelineStateHash::Hash(a) == PipelineStateHash::Hash(b));
+}
+
+TEST(PipelineStateHash_IgnoredFieldsKeepTheKey)
+{
+	FillShaders();
+	const GraphicsPipelineStateDesc base = Describe(g_vertexShader, "POSITION", 0, g_layouts[0]);
+	const uint64_t key = Key(base);
+
+	GraphicsPipelineStateDesc desc = base;
+	desc.RTVFormats[5] = FORMAT_R32G32B32A32_UINT;
+	CHECK(Key(desc) == key);
+
+	desc = base;
+	desc.BlendState.RenderTarget[1].BlendEnable = 1;
+	CHECK(Key(desc) == key);
+
+	desc = base;
+	desc.RasterizerState.SlopeScaledDepthBias = -0.0f;
+	CHECK(Key(desc) == key);
+
+	desc = base;
+	desc.DepthStencilState.DepthEnable = 0;
+	GraphicsPipelineStateDesc other = desc;
+	other.DepthStencilState.DepthFunc = 7;
+	CHECK(Key(desc) == Key(other));
+}
+
+TEST(PipelineStateHash_RealChangesChangeTheKey)
+{
+	FillShaders();
+	const GraphicsPipelineStateDesc base = Describe(g_vertexShader, "POSITION", 0, g_layouts[0]);
+	const uint64_t key = Key(base);
+
+	GraphicsPipelineStateDesc desc = base;
+	desc.RasterizerState.CullMode = 1;
+	CHECK(Key(desc) != key);
+
+	desc = base;
+	desc.RTVFormats[1] = FORMAT_R32G32B32A32_UINT;
+	CHECK(Key(desc) != key);
+
+	desc = base;
+	desc.BlendState.IndependentBlendEnable = 1;
+	desc.BlendState.RenderTarget[1] = desc.BlendState.RenderTarget[0];
+	CHECK(Key(desc) != key);
+
+	desc = base;
+	desc.DepthStencilState.DepthFunc = 4;
+	CHECK(Key(desc) != key);
+
+	desc = base;
+	desc.RasterizerState.SlopeScaledDepthBias = 1.0f;
+	CHECK(Key(desc) != key);
+
+	desc = base;
+	desc.SampleDesc.Count = 4;
+	CHECK(Key(desc) != key);
+
+	CHECK(Key(base, 6) != key);
+
+	g_copiedVertexShader[100] ^= 1;
+	desc = base;
+	desc.VS = { g_copiedVertexShader, 256 };
+	CHECK(Key(desc) != key);
+
+	desc.VS = { g_vertexShader, 255 };
+	CHECK(Key(desc) != key);
+}
+
+TEST(PipelineStateHash_ComputeIgnoresTheCachedBlob)
+{
+	FillShaders();
+	ComputePipelineStateDesc desc {};
+	desc.CS = { g_vertexShader, 256 };
+	ComputePipelineStateDesc cached = desc;
+	cached.CachedPSO = { g_copiedVertexShader, 3 };
+	CHECK(PipelineStateHash::SerializeCompute(desc, 1) == PipelineStateHash::SerializeCompute(cached, 1));
+	CHECK(PipelineStateHash::SerializeCompute(desc, 1) != PipelineStateHash::SerializeCompute(desc, 2));
+	//A compute and a graphics pipeline never share a key
+	CHECK(PipelineStateHash::SerializeCompute(desc, 1) != PipelineStateHash::SerializeGraphics(Describe(g_vertexShader, "POSITION", 0, g_layouts[0]), 1));
+}
+
+BENCHMARK(PipelineStateHash_GraphicsKey)
+{
+	FillShaders();
+	const GraphicsPipelineStateDesc desc = Describe(g_vertexShader, "POSITION", 0, g_layouts[0]);
+	uint64_t sink = 0, rootSignature = 0;
+	const double time = Test::Time([&]() { sink += Key(desc, rootSignature++); }, 100000);
+	printf("  %.2f us per graphics pipeline key (%llu)\n", time * 1000.0, static_cast<unsigned long long>(sink & 1));
+}
@@ -0,0 +1,261 @@
+#include "Test.h"
+#include "SceneGraph.h"
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+
+namespace
+{
+	using namespace DirectX;
+
+	// The world matrix walked up the parents, what the graph has to match
+	XMMATRIX _referenceWorld(const SceneGraph & graph, SceneGraph::Node node)
+	{
+		XMMATRIX world = XMLoadFloat4x4A(&graph.GetLocal(node));
+		for (SceneGraph::Node parent = graph.GetParent(node); parent != SceneGraph::NO_NODE; parent = graph.GetParent(parent))
+			world = world * XMLoadFloat4x4A(&graph.GetLocal(parent));
+		return world;
+	}
+
+	// Largest difference relative to the size of the value, deep chains of translations grow large
+	float _maxError(const SceneGraph & graph, const std::vector<SceneGraph::Node> & nodes)
+	{
+		float error = 0.0f;
+		for (const SceneGraph::Node node : nodes)
+		{
+			if (!graph.IsAlive(node))
+				continue;
+			XMFLOAT4X4A reference;
+			XMStoreFloat4x4A(&reference, _referenceWorld(graph, node));
+			const XMFLOAT4X4A & world = graph.GetWorld(node);
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++)
+					error = (std::max)(error, std::fabs(reference.m[i][j] - world.m[i][j]) / (1.0f + std::fabs(reference.m[i][j])));
+			}
+		}
+		return error;
+	}
+
+	XMFLOAT4 _random(std::mt19937 & random, const float & low, const float & high)
+	{
+		std::uniform_real_distribution<float> distribution(low, high);
+		return XMFLOAT4(distribution(random), distribution(random), distribution(random), 0.0f);
+	}
+
+	bool _isBelow(const SceneGraph & graph, SceneGraph::Node node, const SceneGraph::Node & ancestor)
+	{
+		for (; node != SceneGraph::NO_NODE; node = graph.GetParent(node))
+		{
+			if (node == ancestor)
+				return true;
+		}
+		return false;
+	}
+
+	// Every 50th node a root, the others below a random earlier node
+	std::vector<SceneGraph::Node> _randomForest(SceneGraph & graph, std::mt19937 & random, const size_t & count)
+	{
+		std::vector<SceneGraph::Node> nodes;
+		for (size_t i = 0; i < count; i++)
+		{
+			const SceneGraph::Node parent = i % 50 == 0 ? SceneGraph::NO_NODE : nodes[random() % nodes.size()];
+			nodes.push_back(graph.Create(parent));
+			graph.SetLocal(nodes.back(), _random(random, -1.0f, 1.0f), _random(random, -0.3f, 0.3f), XMFLOAT4(1, 1, 1, 0));
+		}
+		return nodes;
+	}
+}
+
+TEST(SceneGraph_PropagatesToChildren)
+{
+	//One thread walks the trees in order, four split them over the pool
+	for (const unsigned int threads : { 1u, 4u })
+	{
+		std::mt19937 random(7);
+		SceneGraph graph(threads);
+		std::vector<SceneGraph::Node> nodes = _randomForest(graph, random, 200000);
+		CHECK(graph.IsDirty());
+		CHECK(graph.Update() == nodes.size());
+		CHECK(!graph.IsDirty());
+		CHECK(_maxError(graph, nodes) < 1e-4f);
+		CHECK(graph.Update() == 0);
+
+		//Only the set node and everything below it is rebuilt
+		const SceneGraph::Node moved = nodes[12345];
+		const uint32_t version = graph.GetWorldVersion(moved);
+		graph.SetLocal(moved, _random(random, -1.0f, 1.0f), _random(random, -1.0f, 1.0f), XMFLOAT4(1, 1, 1, 0));
+		size_t below = 0;
+		for (const SceneGraph::Node node : nodes)
+			below += _isBelow(graph, node, moved);
+		CHECK(graph.Update() == below);
+		CHECK(graph.GetWorldVersion(moved) != version);
+		CHECK(graph.GetWorldVersion(nodes[0]) != graph.GetWorldVersion(moved));
+		CHECK(_maxError(graph, nodes) < 1e-4f);
+	}
+}
+
+TEST(SceneGraph_ReparentsAndRejectsCycles)
+{
+	std::mt19937 random(11);
+	SceneGraph graph(4);
+	std::vector<SceneGraph::Node> nodes = _randomForest(graph, random, 50000);
+	graph.Update();
+
+	const SceneGraph::Node node = nodes[12345];
+	SceneGraph::Node root = node;
+	while (graph.GetParent(root) != SceneGraph::NO_NODE)
+		root = graph.GetParent(root);
+	CHECK(root == node || !graph.SetParent(root, node));
+	CHECK(!graph.SetParent(node, node));
+
+	//Keeps its local matrix and follows the new parent
+	const XMFLOAT4X4A local = graph.GetLocal(nodes[500]);
+	CHECK(graph.SetParent(nodes[500], nodes[99]));
+	CHECK(graph.GetParent(nodes[500]) == nodes[99]);
+	graph.Update();
+	CHECK(memcmp(&graph.GetLocal(nodes[500]), &local, sizeof(local)) == 0);
+	CHECK(_maxError(graph, nodes) < 1e-4f);
+
+	//A root again
+	CHECK(graph.SetParent(nodes[500], SceneGraph::NO_NODE));
+	graph.Update();
+	CHECK(memcmp(&graph.GetWorld(nodes[500]), &local, sizeof(local)) == 0);
+}
+
+TEST(SceneGraph_DestroysSubtreesAndReusesNodes)
+{
+	std::mt19937 random(3);
+	SceneGraph graph(4);
+	std::vector<SceneGraph::Node> nodes = _randomForest(graph, random, 50000);
+	graph.Update();
+
+	size_t below = 0;
+	for (const SceneGraph::Node node : nodes)
+		below += _isBelow(graph, node, nodes[3]);
+	graph.Destroy(nodes[3]);
+	CHECK(!graph.IsAlive(nodes[3]));
+	CHECK(graph.GetNodeCount() == nodes.size() - below);
+	graph.Destroy(nodes[777]);
+
+	//Destroyed nodes are handed out again before the next update sorts them away
+	for (int i = 0; i < 1000; i++)
+	{
+		const SceneGraph::Node node = graph.Create(nodes[random() % 1000]);
+		graph.SetLocal(node, _random(random, -1.0f, 1.0f), _random(random, -1.0f, 1.0f), XMFLOAT4(2, 2, 2, 0));
+		nodes.push_back(node);
+	}
+	graph.Update();
+	CHECK(_maxError(graph, nodes) < 1e-4f);
+
+	size_t alive = 0;
+	for (SceneGraph::Node node = 0; node < nodes.size() * 2; node++)
+		alive += graph.IsAlive(node);
+	CHECK(alive == graph.GetNodeCount());
+
+	//Below a destroyed node whose number is handed out again, a root and not its own parent
+	const SceneGraph::Node leaf = graph.Create(nodes[0]);
+	graph.Destroy(leaf);
+	const SceneGraph::Node reused = graph.Create(leaf);
+	CHECK(reused == leaf);
+	CHECK(graph.GetParent(reused) == SceneGraph::NO_NODE);
+	graph.Update();
+	CHECK(_maxError(graph, { reused }) < 1e-4f);
+}
+
+namespace
+{
+	// What a hierarchy of objects pointing at their children does, walked recursively
+	struct PointerNode
+	{
+		XMFLOAT4X4A Local;
+		XMFLOAT4X4A World;
+		std::vector<PointerNode *> Children;
+		bool Dirty = true;
+	};
+
+	void _walk(PointerNode * node, const XMMATRIX & parent, bool changed)
+	{
+		changed |= node->Dirty;
+		if (changed)
+		{
+			XMStoreFloat4x4A(&node->World, XMLoadFloat4x4A(&node->Local) * parent);
+			node->Dirty = false;
+		}
+		const XMMATRIX world = XMLoadFloat4x4A(&node->World);
+		for (PointerNode * child : node->Children)
+			_walk(child, world, changed);
+	}
+
+	// 1000 roots, every other node hangs below one of the 64 nodes made just before its tree row
+	size_t _benchmarkParent(std::mt19937 & random, const size_t & i, const size_t & roots)
+	{
+		const size_t range = i - roots + 1;
+		return i - roots - (random() % (std::min)(range, static_cast<size_t>(64))) % range;
+	}
+}
+
+BENCHMARK(SceneGraph_MillionNodes)
+{
+	const size_t count = 1000000, roots = 1000;
+	for (const unsigned int threads : { 1u, 0u })
+	{
+		std::mt19937 random(1);
+		SceneGraph graph(threads);
+		std::vector<SceneGraph::Node> nodes;
+		nodes.reserve(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			nodes.push_back(graph.Create(i < roots ? SceneGraph::NO_NODE : nodes[_benchmarkParent(random, i, roots)]));
+			graph.SetLocal(nodes.back(), XMFLOAT4(1, 0, 0, 0), XMFLOAT4(0, 0.01f, 0, 0), XMFLOAT4(1, 1, 1, 0));
+		}
+
+		const double first = Test::Time([&]() { graph.Update(); });
+		const double everything = Test::Time([&]()
+		{
+			for (size_t i = 0; i < count; i++)
+				graph.SetLocal(nodes[i], graph.GetLocal(nodes[i]));
+			graph.Update();
+		}, 3);
+		size_t rebuilt = 0;
+		const double onePercent = Test::Time([&]()
+		{
+			for (size_t i = 0; i < count; i += 100)
+				graph.SetLocal(nodes[i], graph.GetLocal(nodes[i]));
+			rebuilt = graph.Update();
+		}, 3);
+		const double clean = Test::Time([&]() { graph.Update(); }, 10);
+
+		printf("  %u threads: first update with the sort %.1f ms, every node set %.2f ms, 1%% set (%zu rebuilt) %.2f ms, nothing set %.3f ms\n",
+			threads ? threads : std::thread::hardware_concurrency(), first, everything, rebuilt, onePercent, clean);
+	}
+
+	//The same shape as objects pointing at their children
+	std::mt19937 random(1);
+	std::vector<std::unique_ptr<PointerNode>> pointerNodes;
+	std::vector<PointerNode *> pointerRoots;
+	pointerNodes.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		pointerNodes.emplace_back(new PointerNode());
+		XMStoreFloat4x4A(&pointerNodes.back()->Local, XMMatrixTranslation(1, 0, 0));
+		if (i < roots)
+			pointerRoots.push_back(pointerNodes.back().get());
+		else
+			pointerNodes[_benchmarkParent(random, i, roots)]->Children.push_back(pointerNodes.back().get());
+	}
+	const double pointerEverything = Test::Time([&]()
+	{
+		for (std::unique_ptr<PointerNode> & node : pointerNodes)
+			node->Dirty = true;
+		for (PointerNode * root : pointerRoots)
+			_walk(root, XMMatrixIdentity(), false);
+	}, 3);
+	const double pointerClean = Test::Time([&]()
+	{
+		for (PointerNode * root : pointerRoots)
+			_walk(root, XMMatrixIdentity(), false);
+	}, 3);
+	printf("  pointer tree: every node set %.2f ms, nothing set %.2f ms\n", pointerEverything, pointerClean);
+}
@@ -0,0 +1,128 @@
+#include "Test.h"
+#include "ShaderCache.h"
+
+namespace
+{
+	// Written into the working directory, ctest runs in the build directory
+	void WriteFile(const std::string & path, const std::string & contents)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << contents;
+	}
+
+	std::vector<char> TestBlob()
+	{
+		std::vector<char> blob(5000);
+		for (size_t i = 0; i < blob.size(); i++)
+			blob[i] = static_cast<char>(i * 7);
+		return blob;
+	}
+}
+
+TEST(ShaderCache_ParsesOnlyRealIncludes)
+{
+	const std::vector<std::string> includes = ShaderCache::ParseIncludes(
+		"// #include \"comment.h\"\n"
+		"/* #include \"block.h\" */\n"
+		"  #  include \"a.hlsli\"\n"
+		"float x; #include \"mid.h\"\n"
+		"#include <b.h>\n"
+		"#define include\n");
+	CHECK(includes.size() == 2 && includes[0] == "a.hlsli" && includes[1] == "b.h");
+}
+
+TEST(ShaderCache_KeyCoversEveryInput)
+{
+	WriteFile("ShaderCacheTest_Common.hlsli", "float4 Shade() { return 1; }\n");
+	WriteFile("ShaderCacheTest_Pixel.hlsl", "#include \"ShaderCacheTest_Common.hlsli\"\nfloat4 main() : SV_TARGET { return Shade(); }\n");
+	WriteFile("ShaderCacheTest_Other.hlsl", "float4 main() : SV_TARGET { return 0; }\n");
+
+	const std::string pixel = "ShaderCacheTest_Pixel.hlsl";
+	const uint64_t key = ShaderCache::ComputeKey(pixel, "ps_5_1", "main", 0x100, 47);
+	const uint64_t other = ShaderCache::ComputeKey("ShaderCacheTest_Other.hlsl", "ps_5_1", "main", 0x100, 47);
+	CHECK(key != 0 && key == ShaderCache::ComputeKey(pixel, "ps_5_1", "main", 0x100, 47));
+	CHECK(ShaderCache::ComputeKey(pixel, "ps_5_0", "main", 0x100, 47) != key);
+	CHECK(ShaderCache::ComputeKey(pixel, "ps_5_1", "main2", 0x100, 47) != key);
+	CHECK(ShaderCache::ComputeKey(pixel, "ps_5_1", "main", 0x101, 47) != key);
+	CHECK(ShaderCache::ComputeKey(pixel, "ps_5_1", "main", 0x100, 48) != key);
+	CHECK(ShaderCache::ComputeKey(pixel, "ps_5_1", "main", 0x100, 47, "TESSELLATION") != key);
+	CHECK(ShaderCache::ComputeKey("ShaderCacheTest_Missing.hlsl", "ps_5_1", "main", 0, 0) == 0);
+
+	//Editing the include changes the key of the shader using it, not of the others
+	WriteFile("ShaderCacheTest_Common.hlsli", "float4 Shade() { return 2; }\n");
+	CHECK(ShaderCache::ComputeKey(pixel, "ps_5_1", "main", 0x100, 47) != key);
+	CHECK(ShaderCache::ComputeKey("ShaderCacheTest_Other.hlsl", "ps_5_1", "main", 0x100, 47) == other);
+
+	std::remove("ShaderCacheTest_Common.hlsli");
+	std::remove("ShaderCacheTest_Pixel.hlsl");
+	std::remove("ShaderCacheTest_Other.hlsl");
+}
+
+TEST(ShaderCache_IncludeCyclesTerminate)
+{
+	WriteFile("ShaderCacheTest_CycleA.hlsli", "#include \"ShaderCacheTest_CycleB.hlsli\"\n");
+	WriteFile("ShaderCacheTest_CycleB.hlsli", "#include \"ShaderCacheTest_CycleA.hlsli\"\n");
+	CHECK(ShaderCache::ComputeKey("ShaderCacheTest_CycleA.hlsli", "vs_5_1", "main", 0, 0) != 0);
+	std::remove("ShaderCacheTest_CycleA.hlsli");
+	std::remove("ShaderCacheTest_CycleB.hlsli");
+}
+
+TEST(ShaderCache_RejectsDamagedEntries)
+{
+	const uint64_t key = 0x1234567890abcdefull;
+	const std::vector<char> blob = TestBlob();
+	std::vector<char> loaded;
+
+	CHECK(ShaderCache::Store(".", key, blob.data(), blob.size()));
+	CHECK(ShaderCache::Load(".", key, loaded) && loaded == blob);
+	CHECK(!ShaderCache::Load(".", key + 1, loaded));
+
+	{
+		std::fstream file(ShaderCache::FilePath(".", key), std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(100);
+		file.put(0x55);
+	}
+	CHECK(!ShaderCache::Load(".", key, loaded));
+
+	//Truncated, rewritten with the header and only half the bytecode
+	CHECK(ShaderCache::Store(".", key, blob.data(), blob.size()));
+	std::string contents;
+	ShaderCache::ReadFile(ShaderCache::FilePath(".", key), contents);
+	WriteFile(ShaderCache::FilePath(".", key), contents.substr(0, contents.size() / 2));
+	CHECK(!ShaderCache::Load(".", key, loaded));
+
+	//The pipeline library lives next to the shaders under its own extension
+	CHECK(ShaderCache::Store(".", key, blob.data(), blob.size(), ".psl"));
+	CHECK(ShaderCache::Load(".", key, loaded, ".psl") && loaded == blob);
+
+	std::remove(ShaderCache::FilePath(".", key).c_str());
+	std::remove(ShaderCache::FilePath(".", key, ".psl").c_str());
+}
+
+BENCHMARK(ShaderCache_KeysOfTheEngineShaders)
+{
+	const char * shaders[] =
+	{
+		ENGINE_SHADER_DIR "/DeferredPass/DefaultDeferredPixel.hlsl",
+		ENGINE_SHADER_DIR "/GeometryPass/DefaultGeometryVertex.hlsl",
+		ENGINE_SHADER_DIR "/GeometryPass/DefaultGeometryPixel.hlsl",
+		ENGINE_SHADER_DIR "/ShadowPass/DefaultShadowVertex.hlsl",
+	};
+	for (const char * shader : shaders)
+		CHECK(ShaderCache::ComputeKey(shader, "ps_5_1", "main", 0, 0) != 0);
+
+	const double keyTime = Test::Time([&]()
+	{
+		for (const char * shader : shaders)
+			ShaderCache::ComputeKey(shader, "ps_5_1", "main", 0, 0);
+	}, 1000);
+
+	const uint64_t key = 0xfedcba0987654321ull;
+	const std::vector<char> blob = TestBlob();
+	std::vector<char> loaded;
+	ShaderCache::Store(".", key, blob.data(), blob.size());
+	const double loadTime = Test::Time([&]() { ShaderCache::Load(".", key, loaded); }, 1000);
+	std::remove(ShaderCache::FilePath(".", key).c_str());
+
+	printf("  ComputeKey %.1f us per shader, Load of a %zu byte entry %.1f us\n", keyTime * 1000.0 / 4, blob.size(), loadTime * 1000.0);
+}
@@ -0,0 +1,219 @@
+#include "Test.h"
+#include "ShaderCompileQueue.h"
+#include <atomic>
+#include <stdexcept>
+
+namespace
+{
+	// Holds tasks back until the test lets them go
+	class Gate
+	{
+	public:
+		void Open()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_open = true;
+			m_changed.notify_all();
+		}
+
+		void Wait()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_changed.wait(lock, [this] { return m_open; });
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_changed;
+		bool m_open = false;
+	};
+
+	// Which tasks ran, in order, and on which thread
+	struct Log
+	{
+		std::mutex Mutex;
+		std::vector<std::string> Keys;
+		std::vector<std::thread::id> Threads;
+
+		std::function<int()> Task(const std::string & key, const int & result, Gate * gate = nullptr, Gate * started = nullptr)
+		{
+			return [this, key, result, gate, started]()
+			{
+				if (started)
+					started->Open();
+				if (gate)
+					gate->Wait();
+				std::unique_lock<std::mutex> lock(Mutex);
+				Keys.push_back(key);
+				Threads.push_back(std::this_thread::get_id());
+				return result;
+			};
+		}
+	};
+}
+
+TEST(ShaderCompileQueue_RunsInQueueOrder)
+{
+	ShaderCompileQueue<int> queue;
+	Log log;
+	Gate gate, started;
+	CHECK(queue.Queue("first", log.Task("first", 1, &gate, &started), 1));
+	started.Wait();
+	for (const char * key : { "a", "b", "c", "d" })
+		CHECK(queue.Queue(key, log.Task(key, 2), 1));
+	CHECK(!queue.Queue("b", log.Task("b", 3), 1));
+	gate.Open();
+
+	//Nothing taken, the one thread works through the queue front to back
+	int sum = 0;
+	queue.Stop([&](int & output) { sum += output; });
+	CHECK(log.Keys == std::vector<std::string>({ "first", "a", "b", "c", "d" }));
+	CHECK(sum == 9);
+}
+
+TEST(ShaderCompileQueue_TakeRunsWhatNobodyStarted)
+{
+	//The only thread is stuck, so the asking thread compiles the shader itself and skips the queue
+	ShaderCompileQueue<int> queue;
+	Log log;
+	Gate gate, started;
+	queue.Queue("blocking", log.Task("blocking", 1, &gate, &started), 1);
+	started.Wait();
+	queue.Queue("waiting", log.Task("waiting", 2), 1);
+	queue.Queue("wanted", log.Task("wanted", 3), 1);
+
+	int result = 0;
+	CHECK(queue.Take("wanted", result) && result == 3);
+	CHECK(log.Keys.size() == 1 && log.Keys[0] == "wanted");
+	CHECK(log.Threads.size() == 1 && log.Threads[0] == std::this_thread::get_id());
+	CHECK(!queue.Take("wanted", result));
+	CHECK(!queue.Take("never queued", result));
+
+	gate.Open();
+	CHECK(queue.Take("blocking", result) && result == 1);
+	CHECK(queue.Take("waiting", result) && result == 2);
+	CHECK(log.Keys == std::vector<std::string>({ "wanted", "blocking", "waiting" }));
+	queue.Stop();
+}
+
+TEST(ShaderCompileQueue_OnlyOneTakeGetsTheResult)
+{
+	for (int round = 0; round < 20; round++)
+	{
+		ShaderCompileQueue<int> queue;
+		Log log;
+		Gate gate, started;
+		queue.Queue("shader", log.Task("shader", 7, &gate, &started), 1);
+		started.Wait();
+
+		//Both ask while the worker still runs it, the second one must not wait on a job the first erases
+		std::atomic<int> taken{ 0 }, refused{ 0 };
+		std::vector<std::thread> takers;
+		for (int t = 0; t < 2; t++)
+		{
+			takers.emplace_back([&]()
+			{
+				int result = 0;
+				if (queue.Take("shader", result))
+					taken += result == 7;
+				else
+					refused++;
+			});
+		}
+		gate.Open();
+		for (std::thread & taker : takers)
+			taker.join();
+		CHECK(taken == 1 && refused == 1);
+		queue.Stop();
+	}
+}
+
+TEST(ShaderCompileQueue_ThrowingTaskDoesNotHang)
+{
+	ShaderCompileQueue<int> queue;
+	Log log;
+	queue.Queue("broken", []() -> int { throw std::runtime_error("compiler crashed"); }, 1);
+	queue.Queue("fine", log.Task("fine", 5), 1);
+
+	//The worker lives on and the waiting Take gives up instead of blocking
+	int result = 0;
+	CHECK(!queue.Take("broken", result));
+	CHECK(queue.Take("fine", result) && result == 5);
+
+	//Thrown while taken on the asking thread as well
+	Gate gate, started;
+	queue.Queue("blocking", log.Task("blocking", 1, &gate, &started), 1);
+	started.Wait();
+	queue.Queue("broken again", []() -> int { throw std::runtime_error("compiler crashed"); }, 1);
+	CHECK(!queue.Take("broken again", result));
+	gate.Open();
+	queue.Stop();
+}
+
+TEST(ShaderCompileQueue_StopDiscardsWhatNobodyTook)
+{
+	ShaderCompileQueue<int> queue;
+	Log log;
+	for (int i = 0; i < 10; i++)
+		queue.Queue("shader " + std::to_string(i), log.Task("shader", i), 2);
+	int result = 0;
+	CHECK(queue.Take("shader 4", result) && result == 4);
+
+	//Every other shader still finishes and is handed to discard once
+	int discarded = 0, sum = 0;
+	queue.Stop([&](int & output)
+	{
+		discarded++;
+		sum += output;
+	});
+	CHECK(discarded == 9);
+	CHECK(sum == 45 - 4);
+	CHECK(log.Keys.size() == 10);
+	CHECK(!queue.Take("shader 5", result));
+
+	//The threads start again with the next task
+	CHECK(queue.Queue("after", log.Task("after", 11), 1));
+	CHECK(queue.Take("after", result) && result == 11);
+	queue.Stop();
+}
+
+TEST(ShaderCompileQueue_AccountsTheSavedTime)
+{
+	//Four 40 ms compiles on four threads take about 40 ms instead of 160 ms, even on one core since they sleep
+	ShaderCompileQueue<int> queue;
+	for (int i = 0; i < 4; i++)
+	{
+		queue.Queue("shader " + std::to_string(i), [i]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(40));
+			return i;
+		}, 4);
+	}
+	int result = 0;
+	for (int i = 0; i < 4; i++)
+		queue.Take("shader " + std::to_string(i), result);
+
+	const std::vector<ShaderCompileQueue<int>::Timing> timings = queue.GetTimings();
+	CHECK(timings.size() == 4);
+	double sum = 0.0;
+	bool eachTimed = true;
+	for (const ShaderCompileQueue<int>::Timing & timing : timings)
+	{
+		sum += timing.Milliseconds;
+		eachTimed &= timing.Milliseconds >= 39.0 && timing.Key.compare(0, 7, "shader ") == 0;
+	}
+	CHECK(eachTimed);
+	CHECK(queue.GetSerialMilliseconds() == sum);
+	CHECK(queue.GetWallMilliseconds() >= 39.0);
+	CHECK(queue.GetWallMilliseconds() < queue.GetSerialMilliseconds());
+	CHECK(queue.GetSavedMilliseconds() == queue.GetSerialMilliseconds() - queue.GetWallMilliseconds());
+	CHECK(queue.GetSavedMilliseconds() > 60.0);
+
+	//A restarted queue counts from its own first task
+	queue.Stop();
+	queue.Queue("alone", []() { return 0; }, 1);
+	queue.Take("alone", result);
+	CHECK(queue.GetTimings().size() == 1);
+	CHECK(queue.GetSavedMilliseconds() == 0.0);
+	queue.Stop();
+}
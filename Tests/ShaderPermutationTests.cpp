@@ -0,0 +1,119 @@
+#include "Test.h"
+#include "ShaderPermutation.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	// Every subset of features as a key, the empty one first
+	std::vector<ShaderPermutation::Key> _subsets(const ShaderPermutation::Key & features)
+	{
+		std::vector<ShaderPermutation::Key> subsets;
+		ShaderPermutation::Key subset = 0;
+		do
+		{
+			subsets.push_back(subset);
+			subset = (subset - features) & features;
+		} while (subset);
+		return subsets;
+	}
+
+	bool _roundTrips(const ShaderPermutation::Key & features)
+	{
+		const std::vector<ShaderPermutation::Key> subsets = _subsets(features);
+		if (subsets.size() != ShaderPermutation::Count(features))
+			return false;
+
+		//Every combination gets its own index below the count and comes back as itself
+		std::vector<bool> used(ShaderPermutation::Count(features), false);
+		for (const ShaderPermutation::Key key : subsets)
+		{
+			const unsigned int index = ShaderPermutation::Index(key, features);
+			if (index >= used.size() || used[index] || ShaderPermutation::FromIndex(index, features) != key)
+				return false;
+			used[index] = true;
+
+			//Features the pass does not vary on do not move the index
+			const ShaderPermutation::Key everyFeature = (1u << ShaderPermutation::FEATURE_COUNT) - 1;
+			if (ShaderPermutation::Index(key | (everyFeature & ~features), features) != index)
+				return false;
+		}
+		return true;
+	}
+
+	std::string _readShader(const char * path)
+	{
+		std::ifstream file(path);
+		std::stringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+}
+
+TEST(ShaderPermutation_IndexRoundTrips)
+{
+	using namespace ShaderPermutation;
+	CHECK(Count(GEOMETRY_FEATURES) == 8);
+	CHECK(Count(DEFERRED_FEATURES) == 4);
+	CHECK(_roundTrips(GEOMETRY_FEATURES));
+	CHECK(_roundTrips(DEFERRED_FEATURES));
+	CHECK(_roundTrips(GEOMETRY_FEATURES | DEFERRED_FEATURES));
+	CHECK(_roundTrips(0));
+
+	//Lowest feature first, packed without the gap between TESSELLATION | NORMAL_MAP and DISPLACEMENT
+	CHECK(Index(TESSELLATION, GEOMETRY_FEATURES) == 1);
+	CHECK(Index(NORMAL_MAP, GEOMETRY_FEATURES) == 2);
+	CHECK(Index(DISPLACEMENT, GEOMETRY_FEATURES) == 4);
+	CHECK(Index(POINT_LIGHTS, DEFERRED_FEATURES) == 1);
+	CHECK(Index(DIRECTIONAL_LIGHTS, DEFERRED_FEATURES) == 2);
+	CHECK(FromIndex(7, GEOMETRY_FEATURES) == GEOMETRY_FEATURES);
+}
+
+TEST(ShaderPermutation_SelectsFeatures)
+{
+	using namespace ShaderPermutation;
+	CHECK(SelectGeometry(false, false) == 0);
+	CHECK(SelectGeometry(true, false) == TESSELLATION);
+	CHECK(SelectGeometry(false, true) == NORMAL_MAP);
+	CHECK(SelectGeometry(true, true) == (TESSELLATION | NORMAL_MAP));
+	CHECK((SelectGeometry(true, true) & ~GEOMETRY_FEATURES) == 0);
+
+	CHECK(SelectDeferred(0, 0) == 0);
+	CHECK(SelectDeferred(3, 0) == POINT_LIGHTS);
+	CHECK(SelectDeferred(0, 1) == DIRECTIONAL_LIGHTS);
+	CHECK(SelectDeferred(100, 2) == DEFERRED_FEATURES);
+}
+
+TEST(ShaderPermutation_DefinesAndNames)
+{
+	using namespace ShaderPermutation;
+	CHECK(Defines(0).empty());
+	CHECK(Name(0) == "BASE");
+	CHECK(Defines(NORMAL_MAP) == std::vector<std::string>({ "NORMAL_MAP" }));
+	CHECK(Defines(DISPLACEMENT | TESSELLATION) == std::vector<std::string>({ "TESSELLATION", "DISPLACEMENT" }));
+	CHECK(Name(DISPLACEMENT | TESSELLATION) == "TESSELLATION|DISPLACEMENT");
+	CHECK(Name(DEFERRED_FEATURES) == "POINT_LIGHTS|DIRECTIONAL_LIGHTS");
+
+	//Names tell every variant apart and list one define per feature bit
+	const std::vector<Key> keys = _subsets(GEOMETRY_FEATURES | DEFERRED_FEATURES);
+	std::vector<std::string> names;
+	bool onePerBit = true;
+	for (const Key key : keys)
+	{
+		names.push_back(Name(key));
+		onePerBit &= Defines(key).size() == CountFeatures(key);
+	}
+	CHECK(onePerBit);
+	std::sort(names.begin(), names.end());
+	CHECK(std::unique(names.begin(), names.end()) == names.end());
+
+	//The shaders test the same names the defines are made of
+	const std::string shaders = _readShader(ENGINE_SHADER_DIR "/GeometryPass/DefaultGeometryVertex.hlsl")
+		+ _readShader(ENGINE_SHADER_DIR "/GeometryPass/DefaultGeometryPixel.hlsl")
+		+ _readShader(ENGINE_SHADER_DIR "/DeferredPass/DefaultDeferredPixel.hlsl");
+	bool used = true;
+	for (unsigned int i = 0; i < FEATURE_COUNT; i++)
+		used &= shaders.find(FEATURE_NAMES[i]) != std::string::npos;
+	CHECK(used);
+}
@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "ShadowAtlasPacker.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+	const unsigned int ATLAS_SIZE = 4096;
+	const unsigned int MIN_TILE_SIZE = 128;
+	const unsigned int MAX_TILE_SIZE = 1024;
+
+	bool Overlaps(const ShadowAtlasPacker::Tile & a, const ShadowAtlasPacker::Tile & b)
+	{
+		return a.X < b.X + b.Size && b.X < a.X + a.Size && a.Y < b.Y + b.Size && b.Y < a.Y + a.Size;
+	}
+
+	struct Frame
+	{
+		std::vector<ShadowAtlasPacker::Tile> Tiles;
+		float Occupancy;
+		float Granted;
+		unsigned int Failed;
+	};
+
+	// Packs one frame the way ShadowPass does: point lights take six faces, sorted largest first and fitted to the atlas
+	Frame PackFrame(std::mt19937 & random, const int & lights)
+	{
+		std::uniform_real_distribution<float> distance(1.0f, 60.0f);
+		std::uniform_real_distribution<float> radius(5.0f, 50.0f);
+
+		std::vector<std::pair<unsigned int, unsigned int>> requests;
+		for (int i = 0; i < lights; i++)
+			requests.push_back({ ShadowAtlasPacker::ChooseTileSize(distance(random), radius(random), 1.57f, MIN_TILE_SIZE, MAX_TILE_SIZE), i % 4 == 3 ? 1u : 6u });
+		std::sort(requests.begin(), requests.end(), [](const std::pair<unsigned int, unsigned int> & a, const std::pair<unsigned int, unsigned int> & b) { return a.first > b.first; });
+
+		std::vector<unsigned int> sizes, counts;
+		for (const std::pair<unsigned int, unsigned int> & request : requests)
+		{
+			sizes.push_back(request.first);
+			counts.push_back(request.second);
+		}
+
+		ShadowAtlasPacker packer(ATLAS_SIZE, MIN_TILE_SIZE);
+		const size_t fit = packer.FitRequests(sizes.data(), counts.data(), sizes.size());
+
+		Frame frame;
+		ShadowAtlasPacker::Tile tiles[6];
+		for (size_t i = 0; i < fit; i++)
+		{
+			if (packer.AllocateGroup(sizes[i], counts[i], tiles))
+				frame.Tiles.insert(frame.Tiles.end(), tiles, tiles + counts[i]);
+		}
+		frame.Occupancy = packer.GetOccupancy();
+		frame.Granted = packer.GetGrantedRatio();
+		frame.Failed = packer.GetFailedCount();
+		return frame;
+	}
+}
+
+TEST(ShadowAtlasPacker_FillsTheAtlasWithoutGaps)
+{
+	ShadowAtlasPacker packer(1024, 128);
+	ShadowAtlasPacker::Tile tile;
+	CHECK(packer.Allocate(512, tile) && tile.Size == 512);
+	for (int i = 0; i < 12; i++)
+		CHECK(packer.Allocate(256, tile) && tile.Size == 256);
+	CHECK(packer.GetOccupancy() == 1.0f);
+	CHECK(!packer.Allocate(128, tile));
+	CHECK(packer.GetFailedCount() == 1);
+}
+
+TEST(ShadowAtlasPacker_RoundsAndClampsSizes)
+{
+	ShadowAtlasPacker packer(1024, 128);
+	ShadowAtlasPacker::Tile tile;
+	CHECK(packer.Allocate(300, tile) && tile.Size == 512);
+	CHECK(packer.Allocate(1, tile) && tile.Size == 128);
+	packer.Reset();
+	CHECK(packer.Allocate(4096, tile) && tile.Size == 1024);
+}
+
+TEST(ShadowAtlasPacker_GroupsShrinkToFit)
+{
+	ShadowAtlasPacker packer(1024, 128);
+	ShadowAtlasPacker::Tile tiles[6];
+	CHECK(packer.AllocateGroup(1024, 1, tiles) == 1024);
+	packer.Reset();
+	//Six 512 faces do not fit, six 256 faces do
+	CHECK(packer.AllocateGroup(512, 6, tiles) == 256);
+	CHECK(packer.GetGrantedRatio() == 0.25f);
+}
+
+TEST(ShadowAtlasPacker_FitRequestsHalvesTheLargest)
+{
+	ShadowAtlasPacker packer(1024, 128);
+	unsigned int sizes[] = { 1024, 512, 128 };
+	const unsigned int counts[] = { 1, 1, 6 };
+	CHECK(packer.FitRequests(sizes, counts, 3) == 3);
+	CHECK(sizes[0] == 512 && sizes[1] == 512 && sizes[2] == 128);
+}
+
+TEST(ShadowAtlasPacker_RandomFramesNeverOverlap)
+{
+	std::mt19937 random(7);
+	for (const int lights : { 8, 32, 64 })
+	{
+		for (int iteration = 0; iteration < 50; iteration++)
+		{
+			const Frame frame = PackFrame(random, lights);
+			bool separate = true;
+			for (size_t a = 0; a < frame.Tiles.size(); a++)
+			{
+				const ShadowAtlasPacker::Tile & tile = frame.Tiles[a];
+				separate &= tile.X + tile.Size <= ATLAS_SIZE && tile.Y + tile.Size <= ATLAS_SIZE;
+				for (size_t b = a + 1; b < frame.Tiles.size(); b++)
+					separate &= !Overlaps(tile, frame.Tiles[b]);
+			}
+			CHECK(separate);
+			CHECK(frame.Failed == 0);
+		}
+	}
+}
+
+BENCHMARK(ShadowAtlasPacker_Efficiency)
+{
+	std::mt19937 random(7);
+	for (const int lights : { 8, 16, 32, 64 })
+	{
+		const int frames = 1000;
+		double occupancy = 0.0, granted = 0.0;
+		unsigned int failed = 0;
+		const double time = Test::Time([&]()
+		{
+			const Frame frame = PackFrame(random, lights);
+			occupancy += frame.Occupancy;
+			granted += frame.Granted;
+			failed += frame.Failed;
+		}, frames);
+		printf("  %2d lights: occupancy %.3f, granted %.3f, failed groups %u, %.4f ms per frame\n", lights, occupancy / frames, granted / frames, failed, time);
+	}
+}
@@ -0,0 +1,156 @@
+#include "Test.h"
+#include "ShadowCache.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Two faces looking down +Z, one around x = 0 and one around x = 100
+	void FaceMatrices(const float & offset, XMFLOAT4X4A * viewProjection)
+	{
+		for (unsigned int i = 0; i < 2; i++)
+		{
+			const XMMATRIX view = XMMatrixLookToLH(XMVectorSet(offset + i * 100.0f, 0, -10, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+			XMStoreFloat4x4A(&viewProjection[i], XMMatrixTranspose(XMMatrixMultiply(view, XMMatrixOrthographicLH(20.0f, 20.0f, 0.1f, 50.0f))));
+		}
+	}
+
+	// Transform keeps the world matrix transposed
+	XMFLOAT4X4A Translation(const float & x, const float & y, const float & z)
+	{
+		XMFLOAT4X4A world;
+		XMStoreFloat4x4A(&world, XMMatrixTranspose(XMMatrixTranslation(x, y, z)));
+		return world;
+	}
+
+	const XMFLOAT4 UNIT_BOUNDS(0, 0, 0, 1);
+	const int CASTER_A = 0;
+	const int CASTER_B = 1;
+	const int LIGHT = 2;
+}
+
+TEST(ShadowCache_StaticSceneIsCached)
+{
+	XMFLOAT4X4A faces[2];
+	FaceMatrices(0.0f, faces);
+	ShadowCache cache;
+
+	cache.BeginFrame();
+	cache.TrackCaster(&CASTER_A, Translation(0, 0, 5), UNIT_BOUNDS);
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 3u);
+	cache.EndFrame();
+
+	for (int frame = 0; frame < 3; frame++)
+	{
+		cache.BeginFrame();
+		cache.TrackCaster(&CASTER_A, Translation(0, 0, 5), UNIT_BOUNDS);
+		cache.EndCasters();
+		CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 0u);
+		cache.EndFrame();
+	}
+	CHECK(cache.GetRenderedFaces() == 0 && cache.GetCachedFaces() == 2);
+}
+
+TEST(ShadowCache_MovingCasterOnlyDirtiesItsFaces)
+{
+	XMFLOAT4X4A faces[2];
+	FaceMatrices(0.0f, faces);
+	ShadowCache cache;
+
+	cache.BeginFrame();
+	cache.TrackCaster(&CASTER_A, Translation(0, 0, 5), UNIT_BOUNDS);
+	cache.TrackCaster(&CASTER_B, Translation(100, 0, 5), UNIT_BOUNDS);
+	cache.EndCasters();
+	cache.GetDirtyFaces(&LIGHT, faces, 2, false);
+	cache.EndFrame();
+
+	//Inside face 0 before and after
+	cache.BeginFrame();
+	cache.TrackCaster(&CASTER_A, Translation(2, 0, 5), UNIT_BOUNDS);
+	cache.TrackCaster(&CASTER_B, Translation(100, 0, 5), UNIT_BOUNDS);
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 1u);
+	cache.EndFrame();
+
+	//Moved from face 0 to face 1, both lose the old or gain the new shadow
+	cache.BeginFrame();
+	cache.TrackCaster(&CASTER_A, Translation(98, 0, 5), UNIT_BOUNDS);
+	cache.TrackCaster(&CASTER_B, Translation(100, 0, 5), UNIT_BOUNDS);
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 3u);
+	cache.EndFrame();
+
+	//Far outside both faces
+	cache.BeginFrame();
+	cache.TrackCaster(&CASTER_A, Translation(98, 0, 5), UNIT_BOUNDS);
+	cache.TrackCaster(&CASTER_B, Translation(100, 0, 5), UNIT_BOUNDS);
+	cache.EndCasters();
+	cache.GetDirtyFaces(&LIGHT, faces, 2, false);
+	cache.EndFrame();
+	cache.BeginFrame();
+	cache.TrackCaster(&CASTER_A, Translation(98, 0, 5), UNIT_BOUNDS);
+	cache.TrackCaster(&CASTER_B, Translation(100, 500, 5), UNIT_BOUNDS);
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 2u);
+	cache.EndFrame();
+}
+
+TEST(ShadowCache_RemovedCasterDirtiesItsFaces)
+{
+	XMFLOAT4X4A faces[2];
+	FaceMatrices(0.0f, faces);
+	ShadowCache cache;
+
+	cache.BeginFrame();
+	cache.TrackCaster(&CASTER_B, Translation(100, 0, 5), UNIT_BOUNDS);
+	cache.EndCasters();
+	cache.GetDirtyFaces(&LIGHT, faces, 2, false);
+	cache.EndFrame();
+
+	cache.BeginFrame();
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 2u);
+	cache.EndFrame();
+}
+
+TEST(ShadowCache_LightOrTileChangesDirtyEveryFace)
+{
+	XMFLOAT4X4A faces[2];
+	FaceMatrices(0.0f, faces);
+	ShadowCache cache;
+
+	cache.BeginFrame();
+	cache.EndCasters();
+	cache.GetDirtyFaces(&LIGHT, faces, 2, false);
+	cache.EndFrame();
+
+	cache.BeginFrame();
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, true) == 3u);
+	cache.EndFrame();
+
+	FaceMatrices(0.5f, faces);
+	cache.BeginFrame();
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 3u);
+	cache.EndFrame();
+
+	//A light skipped for a frame is forgotten
+	cache.BeginFrame();
+	cache.EndCasters();
+	cache.EndFrame();
+	cache.BeginFrame();
+	cache.EndCasters();
+	CHECK(cache.GetDirtyFaces(&LIGHT, faces, 2, false) == 3u);
+	cache.EndFrame();
+}
+
+TEST(ShadowCache_WorldBoundsScaleTheRadius)
+{
+	XMFLOAT4X4A world;
+	XMStoreFloat4x4A(&world, XMMatrixTranspose(XMMatrixMultiply(XMMatrixScaling(1, 3, 2), XMMatrixTranslation(4, 5, 6))));
+	const XMFLOAT4 bounds = ShadowCache::WorldBounds(world, XMFLOAT4(1, 0, 0, 2));
+	CHECK(bounds.x == 5.0f && bounds.y == 5.0f && bounds.z == 6.0f);
+	CHECK(bounds.w == 6.0f);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal registry for the headless tests and benchmarks, no external framework needed.
+// TEST bodies report failures with CHECK, BENCHMARK bodies print their own timings.
+namespace Test
+{
+	struct Case
+	{
+		const char * Name;
+		std::function<void()> Function;
+		bool Benchmark;
+	};
+
+	inline std::vector<Case> & Registry()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	inline int & Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	struct Registrar
+	{
+		Registrar(const char * name, const std::function<void()> & function, const bool & benchmark)
+		{
+			Registry().push_back({ name, function, benchmark });
+		}
+	};
+
+	inline void Fail(const char * expression, const char * file, const int & line)
+	{
+		printf("  FAILED %s (%s:%d)\n", expression, file, line);
+		Failures()++;
+	}
+
+	// Average milliseconds of one call over the given repetitions
+	template<typename T>
+	double Time(const T & function, const int & repetitions = 1)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < repetitions; i++)
+			function();
+		const auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+	}
+
+	// Walks text as JSON just far enough to know strings are closed and brackets balance
+	inline bool IsBalancedJson(const std::string & text)
+	{
+		std::vector<char> stack;
+		bool inString = false;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			const char c = text[i];
+			if (inString)
+			{
+				if (c == '\\')
+					i++;
+				else if (c == '"')
+					inString = false;
+				else if (static_cast<unsigned char>(c) < 0x20)
+					return false;
+				continue;
+			}
+			if (c == '"')
+				inString = true;
+			else if (c == '{' || c == '[')
+				stack.push_back(c);
+			else if (c == '}' || c == ']')
+			{
+				if (stack.empty() || stack.back() != (c == '}' ? '{' : '['))
+					return false;
+				stack.pop_back();
+			}
+		}
+		return !inString && stack.empty();
+	}
+}
+
+#define TEST_CONCAT_INNER(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_INNER(a, b)
+
+#define TEST_REGISTER(name, benchmark) \
+	static void name(); \
+	static Test::Registrar TEST_CONCAT(name, _registrar)(#name, name, benchmark); \
+	static void name()
+
+#define TEST(name) TEST_REGISTER(name, false)
+#define BENCHMARK(name) TEST_REGISTER(name, true)
+
+#define CHECK(expression) \
+	do { if (!(expression)) Test::Fail(#expression, __FILE__, __LINE__); } while (0)
@@ -0,0 +1,69 @@
+#include "Test.h"
+#include "TimerStatistics.h"
+#include <random>
+
+TEST(TimerStatistics_EmptySummary)
+{
+	TimerStatistics statistics;
+	const TimerStatistics::Summary summary = statistics.GetSummary();
+	CHECK(summary.Count == 0);
+	CHECK(summary.Min == 0.0 && summary.Avg == 0.0 && summary.Max == 0.0 && summary.P99 == 0.0);
+
+	//Empty again after a reset
+	statistics.AddSample(3.0);
+	statistics.Reset();
+	CHECK(statistics.GetCount() == 0);
+	CHECK(statistics.GetSummary().Count == 0 && statistics.GetSummary().P99 == 0.0);
+}
+
+TEST(TimerStatistics_KnownSequence)
+{
+	TimerStatistics statistics;
+	statistics.AddSample(4.0);
+	CHECK(statistics.GetSummary().Min == 4.0 && statistics.GetSummary().P99 == 4.0);
+	statistics.Reset();
+
+	//1 to 100 shuffled, the 99th percentile by nearest rank is 99
+	std::vector<double> samples;
+	for (int i = 1; i <= 100; i++)
+		samples.push_back(i);
+	std::shuffle(samples.begin(), samples.end(), std::mt19937(3));
+	for (const double sample : samples)
+		statistics.AddSample(sample);
+
+	const TimerStatistics::Summary summary = statistics.GetSummary();
+	CHECK(summary.Count == 100);
+	CHECK(summary.Min == 1.0);
+	CHECK(summary.Avg == 50.5);
+	CHECK(summary.Max == 100.0);
+	CHECK(summary.P99 == 99.0);
+}
+
+TEST(TimerStatistics_P99FollowsTheWindowAfterWrap)
+{
+	TimerStatistics statistics;
+	//A slow start that has left the window, then 1 to 1024
+	for (size_t i = 0; i < TimerStatistics::WINDOW + 10; i++)
+		statistics.AddSample(5000.0);
+	for (size_t i = 1; i <= TimerStatistics::WINDOW; i++)
+		statistics.AddSample(static_cast<double>(i));
+
+	TimerStatistics::Summary summary = statistics.GetSummary();
+	CHECK(summary.Count == 2 * TimerStatistics::WINDOW + 10);
+	//Min, avg and max still cover everything
+	CHECK(summary.Min == 1.0);
+	CHECK(summary.Max == 5000.0);
+	const double sum = 5000.0 * (TimerStatistics::WINDOW + 10) + TimerStatistics::WINDOW * (TimerStatistics::WINDOW + 1) / 2.0;
+	CHECK(summary.Avg == sum / summary.Count);
+	//ceil(1024 * 0.99) = 1014th smallest of the window
+	CHECK(summary.P99 == 1014.0);
+
+	//Ten slow samples replace the oldest ones, 1 to 10, the 1014th smallest is then the fastest of the rest
+	for (int i = 0; i < 10; i++)
+		statistics.AddSample(5000.0);
+	CHECK(statistics.GetSummary().P99 == 1024.0);
+	//The eleventh is in it
+	statistics.AddSample(5000.0);
+	CHECK(statistics.GetSummary().P99 == 5000.0);
+	CHECK(statistics.GetSummary().Min == 1.0);
+}
@@ -0,0 +1,237 @@
+#include "Test.h"
+#include "TransformStore.h"
+#include <cmath>
+#include <memory>
+#include <random>
+
+namespace
+{
+	using namespace DirectX;
+
+	// What Transform does per object: its own components, a dirty flag and the matrix built with DirectXMath
+	struct ObjectTransform
+	{
+		XMFLOAT4 Position = XMFLOAT4(0, 0, 0, 1);
+		XMFLOAT4 Rotation = XMFLOAT4(0, 0, 0, 1);
+		XMFLOAT4 Scale = XMFLOAT4(1, 1, 1, 1);
+		XMFLOAT4X4A WorldMatrix;
+		bool Dirty = true;
+
+		void Update()
+		{
+			if (!Dirty)
+				return;
+			const XMMATRIX scale = XMMatrixScalingFromVector(XMLoadFloat4(&Scale));
+			const XMMATRIX rotation = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat4(&Rotation));
+			const XMMATRIX translation = XMMatrixTranslationFromVector(XMLoadFloat4(&Position));
+			XMStoreFloat4x4A(&WorldMatrix, XMMatrixTranspose(scale * rotation * translation));
+			Dirty = false;
+		}
+	};
+
+	// Same layout as Instancing::InstanceBuffer, 84 bytes so every other matrix is not 16 byte aligned
+	struct Instance
+	{
+		XMFLOAT4X4 WorldMatrix;
+		XMUINT4 TextureIndex;
+		float TessFactor;
+	};
+
+	float _maxDifference(const XMFLOAT4X4 & a, const XMFLOAT4X4 & b)
+	{
+		float difference = 0.0f;
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+				difference = (std::max)(difference, std::fabs(a.m[i][j] - b.m[i][j]));
+		}
+		return difference;
+	}
+
+	struct RandomTransforms
+	{
+		std::mt19937 Random{ 1 };
+		std::uniform_real_distribution<float> Angle{ -20.0f, 20.0f };
+		std::uniform_real_distribution<float> Position{ -100.0f, 100.0f };
+		std::uniform_real_distribution<float> Scale{ 0.1f, 4.0f };
+
+		void Set(TransformStore & store, const TransformStore::Handle & handle, ObjectTransform & reference)
+		{
+			reference.Position = XMFLOAT4(Position(Random), Position(Random), Position(Random), 1.0f);
+			reference.Rotation = XMFLOAT4(Angle(Random), Angle(Random), Angle(Random), 0.0f);
+			reference.Scale = XMFLOAT4(Scale(Random), Scale(Random), Scale(Random), 1.0f);
+			reference.Dirty = true;
+			store.SetPosition(handle, reference.Position);
+			store.SetRotation(handle, reference.Rotation);
+			store.SetScale(handle, reference.Scale);
+		}
+	};
+}
+
+TEST(TransformStore_MatchesPerObjectMatrices)
+{
+	const size_t count = 1003;
+	RandomTransforms random;
+	TransformStore batched, scalar;
+	scalar.SetUseAvx2(false);
+	std::vector<TransformStore::Handle> handles;
+	std::vector<ObjectTransform> references(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		handles.push_back(batched.Allocate());
+		CHECK(scalar.Allocate() == handles.back());
+		random.Set(batched, handles[i], references[i]);
+		scalar.SetPosition(handles[i], references[i].Position);
+		scalar.SetRotation(handles[i], references[i].Rotation);
+		scalar.SetScale(handles[i], references[i].Scale);
+		references[i].Update();
+	}
+
+	CHECK(batched.IsDirty());
+	CHECK(batched.Update() == count);
+	CHECK(!batched.IsDirty());
+	scalar.Update();
+
+	float batchedDifference = 0.0f, scalarDifference = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		batchedDifference = (std::max)(batchedDifference, _maxDifference(batched.GetWorldMatrix(handles[i]), references[i].WorldMatrix));
+		scalarDifference = (std::max)(scalarDifference, _maxDifference(scalar.GetWorldMatrix(handles[i]), references[i].WorldMatrix));
+	}
+	CHECK(batchedDifference < 1e-4f);
+	CHECK(scalarDifference == 0.0f);
+
+	//Every third slot from the back, the batches gather scattered slots
+	for (size_t i = count; i-- > 0;)
+	{
+		if (i % 3)
+			continue;
+		references[i].Rotation = XMFLOAT4(random.Angle(random.Random), 0.5f, -1.0f, 0.0f);
+		references[i].Dirty = true;
+		references[i].Update();
+		batched.SetRotation(handles[i], references[i].Rotation);
+	}
+	CHECK(batched.Update() == (count + 2) / 3);
+	batchedDifference = 0.0f;
+	for (size_t i = 0; i < count; i++)
+		batchedDifference = (std::max)(batchedDifference, _maxDifference(batched.GetWorldMatrix(handles[i]), references[i].WorldMatrix));
+	CHECK(batchedDifference < 1e-4f);
+}
+
+TEST(TransformStore_UnchangedValuesStayClean)
+{
+	TransformStore store;
+	const TransformStore::Handle handle = store.Allocate();
+	store.Update();
+	store.SetPosition(handle, XMFLOAT4(0, 0, 0, 1));
+	store.SetScale(handle, XMFLOAT4(1, 1, 1, 1));
+	CHECK(!store.IsDirty(handle));
+	store.SetPosition(handle, XMFLOAT4(1, 0, 0, 1));
+	CHECK(store.IsDirty(handle));
+}
+
+TEST(TransformStore_FreedSlotsAreReset)
+{
+	TransformStore store;
+	const TransformStore::Handle first = store.Allocate();
+	const TransformStore::Handle second = store.Allocate();
+	store.SetPosition(second, XMFLOAT4(5, 6, 7, 1));
+	store.Update();
+	store.Free(second);
+	CHECK(store.Allocate() == second);
+	CHECK(store.GetCapacity() == 2);
+	store.Update();
+	const XMFLOAT4X4A & world = store.GetWorldMatrix(second);
+	CHECK(world._11 == 1.0f && world._22 == 1.0f && world._33 == 1.0f && world._44 == 1.0f);
+	CHECK(world._14 == 0.0f && world._24 == 0.0f && world._34 == 0.0f);
+	CHECK(first != second);
+}
+
+TEST(TransformStore_SetMatrixIsNotRebuiltOver)
+{
+	TransformStore store;
+	const TransformStore::Handle handle = store.Allocate();
+	XMFLOAT4X4A world;
+	XMStoreFloat4x4A(&world, XMMatrixTranslation(1, 2, 3));
+	//Set while the slot still waits for its first rebuild
+	store.SetWorldMatrix(handle, world);
+	CHECK(!store.IsDirty());
+	store.Update();
+	CHECK(memcmp(&store.GetWorldMatrix(handle), &world, sizeof(world)) == 0);
+}
+
+TEST(TransformStore_CopiesIntoInstanceRecords)
+{
+	RandomTransforms random;
+	TransformStore store;
+	std::vector<TransformStore::Handle> handles;
+	std::vector<ObjectTransform> references(5);
+	for (size_t i = 0; i < references.size(); i++)
+	{
+		handles.push_back(store.Allocate());
+		random.Set(store, handles.back(), references[i]);
+	}
+	store.Update();
+
+	//Backwards, the records follow the order of the handles and the rest of a record is left alone
+	const TransformStore::Handle order[3] = { handles[4], handles[2], handles[0] };
+	std::vector<Instance> records(3);
+	for (Instance & record : records)
+		record.TessFactor = 2.0f;
+	store.CopyWorldMatrices(order, 3, &records[0].WorldMatrix, sizeof(Instance));
+	bool copied = true;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		copied &= memcmp(&records[i].WorldMatrix, &store.GetWorldMatrix(order[i]), sizeof(XMFLOAT4X4)) == 0;
+		copied &= records[i].TessFactor == 2.0f;
+	}
+	CHECK(copied);
+}
+
+BENCHMARK(TransformStore_BatchedVersusPerObject)
+{
+	for (const size_t count : { 10000u, 100000u })
+	{
+		std::vector<std::unique_ptr<ObjectTransform>> objects;
+		TransformStore batched, scalar;
+		scalar.SetUseAvx2(false);
+		std::vector<TransformStore::Handle> handles;
+		for (size_t i = 0; i < count; i++)
+		{
+			objects.emplace_back(new ObjectTransform());
+			handles.push_back(batched.Allocate());
+			scalar.Allocate();
+		}
+
+		//Every transform turns every frame
+		int frame = 0;
+		const int frames = 20;
+		const double perObject = Test::Time([&]()
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				objects[i]->Rotation = XMFLOAT4(0.0f, frame * 0.01f + i, 0.0f, 0.0f);
+				objects[i]->Dirty = true;
+				objects[i]->Update();
+			}
+			frame++;
+		}, frames);
+		const double storeScalar = Test::Time([&]()
+		{
+			for (size_t i = 0; i < count; i++)
+				scalar.SetRotation(handles[i], XMFLOAT4(0.0f, frame * 0.01f + i, 0.0f, 0.0f));
+			scalar.Update();
+			frame++;
+		}, frames);
+		const double storeAvx2 = Test::Time([&]()
+		{
+			for (size_t i = 0; i < count; i++)
+				batched.SetRotation(handles[i], XMFLOAT4(0.0f, frame * 0.01f + i, 0.0f, 0.0f));
+			batched.Update();
+			frame++;
+		}, frames);
+
+		printf("  %zu transforms: per object %.3f ms, store scalar %.3f ms, store %s %.3f ms\n",
+			count, perObject, storeScalar, batched.GetUseAvx2() ? "AVX2" : "without AVX2", storeAvx2);
+	}
+}
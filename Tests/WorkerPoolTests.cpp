@@ -0,0 +1,52 @@
+#include "Test.h"
+#include "WorkerPool.h"
+#include <atomic>
+
+TEST(WorkerPool_RunsEveryIndexOnce)
+{
+	WorkerPool pool(4);
+	std::vector<std::atomic<int>> hits(1000);
+	for (int job = 0; job < 50; job++)
+	{
+		for (std::atomic<int> & hit : hits)
+			hit.store(0);
+		pool.Run(static_cast<unsigned int>(hits.size()), [&](const unsigned int i) { hits[i]++; });
+		bool once = true;
+		for (const std::atomic<int> & hit : hits)
+			once &= hit.load() == 1;
+		CHECK(once);
+	}
+}
+
+TEST(WorkerPool_SingleThreadRunsInline)
+{
+	WorkerPool pool(1);
+	const std::thread::id caller = std::this_thread::get_id();
+	bool onCaller = true;
+	pool.Run(16, [&](const unsigned int) { onCaller &= std::this_thread::get_id() == caller; });
+	CHECK(onCaller);
+	CHECK(pool.GetThreadCount() == 1);
+}
+
+BENCHMARK(WorkerPool_DispatchVersusThreadStart)
+{
+	const unsigned int threads = 4;
+	WorkerPool pool(threads);
+	std::atomic<unsigned int> sink{ 0 };
+	pool.Run(threads, [&](const unsigned int i) { sink += i; });
+
+	const double pooled = Test::Time([&]()
+	{
+		pool.Run(threads, [&](const unsigned int i) { sink += i; });
+	}, 1000);
+	const double started = Test::Time([&]()
+	{
+		std::vector<std::thread> workers;
+		for (unsigned int t = 0; t < threads; t++)
+			workers.emplace_back([&, t]() { sink += t; });
+		for (std::thread & worker : workers)
+			worker.join();
+	}, 1000);
+
+	printf("  %u tasks: pool %.4f ms, new threads %.4f ms\n", threads, pooled, started);
+}